@@ -47,8 +47,10 @@
 #include "xrow_io.h"
 #include "error.h"
 #include "session.h"
+#include "txn.h"
 
 double applier_timeout = 1;
+int applier_batch_size = 1;
 
 STRS(applier_state, applier_STATE);
 
@@ -349,6 +351,112 @@ finish:
 	applier_set_state(applier, APPLIER_READY);
 }
 
+/**
+ * Decode the next row if it has been read into the input buffer
+ * completely. Never reads from the socket.
+ * @retval true a row is decoded
+ * @retval false more data is needed
+ */
+static bool
+applier_read_buffered_xrow(struct ibuf *in, struct xrow_header *row)
+{
+	if (ibuf_used(in) < 1)
+		return false;
+	const char *pos = in->rpos;
+	if (mp_typeof(*pos) != MP_UINT) {
+		tnt_raise(ClientError, ER_INVALID_MSGPACK,
+			  "packet length");
+	}
+	if (mp_check_uint(pos, in->wpos) > 0)
+		return false;
+	uint32_t len = mp_decode_uint(&pos);
+	if ((size_t) (in->wpos - pos) < len)
+		return false;
+	in->rpos = (char *) pos;
+	xrow_header_decode_xc(row, (const char **) &in->rpos, in->rpos + len);
+	return true;
+}
+
+/**
+ * Apply a replicated row, unless it has already been applied,
+ * e.g. received from another master.
+ */
+static void
+applier_apply_row(struct applier *applier, struct xrow_header *row)
+{
+	if (vclock_get(&replicaset_vclock, row->replica_id) >= row->lsn)
+		return;
+	/**
+	 * Promote the replica set vclock before
+	 * applying the row. If there is an
+	 * exception (conflict) applying the row,
+	 * the row is skipped when the replication
+	 * is resumed.
+	 */
+	vclock_follow(&replicaset_vclock, row->replica_id, row->lsn);
+	xstream_write_xc(applier->subscribe_stream, row);
+}
+
+/**
+ * Apply a batch of replicated rows as a single transaction,
+ * so that it takes one WAL write instead of one per row.
+ *
+ * The vclock is promoted row by row, exactly as if the rows were
+ * applied one by one. If the batch fails (a conflict, a DDL row,
+ * rows of different engines, a yield in a trigger) it is rolled
+ * back and the whole batch is applied again one row per
+ * transaction: rows already promoted by this applier are
+ * re-applied, the rest go through applier_apply_row(). Thus
+ * a conflicting row fails on its own, as without batching.
+ */
+static void
+applier_apply_batch(struct applier *applier, struct xrow_header *rows,
+		    int count)
+{
+	int promoted = 0;
+	int i = 0;
+	struct txn *txn = txn_begin(false);
+	try {
+		for (; i < count; i++) {
+			struct xrow_header *row = &rows[i];
+			if (vclock_get(&replicaset_vclock,
+				       row->replica_id) >= row->lsn)
+				continue;
+			vclock_follow(&replicaset_vclock, row->replica_id,
+				      row->lsn);
+			/*
+			 * Rows to retry are kept in the head of the
+			 * array. A row is never moved after it was
+			 * passed to the stream, because the
+			 * transaction refers to it.
+			 */
+			rows[promoted++] = *row;
+			xstream_write_xc(applier->subscribe_stream,
+					 &rows[promoted - 1]);
+			if (in_txn() != txn) {
+				/* Aborted by a yield, see txn_begin(). */
+				tnt_raise(ClientError, ER_TRANSACTION_CONFLICT);
+			}
+		}
+		txn_commit(txn);
+		return;
+	} catch (FiberIsCancelled *e) {
+		txn_rollback();
+		throw;
+	} catch (Exception *e) {
+		txn_rollback();
+	}
+	for (int j = 0; j < promoted; j++)
+		xstream_write_xc(applier->subscribe_stream, &rows[j]);
+	/*
+	 * Rows following the one the batch failed on were not
+	 * promoted and are intact: promoted rows are only moved
+	 * towards the head of the array.
+	 */
+	for (i++; i < count; i++)
+		applier_apply_row(applier, &rows[i]);
+}
+
 /**
  * Execute and process SUBSCRIBE request (follow updates from a master).
  */
@@ -400,36 +508,57 @@ applier_subscribe(struct applier *applier)
 	/*
 	 * Process a stream of rows from the binary log.
 	 */
+	struct xrow_header *rows = NULL;
+	int rows_capacity = 0;
+	auto rows_guard = make_scoped_guard([&]{ free(rows); });
 	while (true) {
-		coio_read_xrow(coio, &iobuf->in, &row);
-		applier->lag = ev_now(loop()) - row.tm;
-		applier->last_row_time = ev_monotonic_now(loop());
-
-		if (iproto_type_is_error(row.type))
-			xrow_decode_error_xc(&row);  /* error */
-		/* Replication request. */
-		if (row.replica_id == REPLICA_ID_NIL ||
-		    row.replica_id >= VCLOCK_MAX) {
-			/*
-			 * A safety net, this can only occur
-			 * if we're fed a strangely broken xlog.
-			 */
-			tnt_raise(ClientError, ER_UNKNOWN_REPLICA,
-				  int2str(row.replica_id),
-				  tt_uuid_str(&REPLICASET_UUID));
+		int batch_size = applier_batch_size;
+		if (rows_capacity < batch_size) {
+			struct xrow_header *new_rows = (struct xrow_header *)
+				realloc(rows, batch_size * sizeof(*rows));
+			if (new_rows == NULL) {
+				tnt_raise(OutOfMemory,
+					  batch_size * sizeof(*rows),
+					  "realloc", "applier rows");
+			}
+			rows = new_rows;
+			rows_capacity = batch_size;
 		}
-		if (vclock_get(&replicaset_vclock, row.replica_id) < row.lsn) {
-			/**
-			 * Promote the replica set vclock before
-			 * applying the row. If there is an
-			 * exception (conflict) applying the row,
-			 * the row is skipped when the replication
-			 * is resumed.
-			 */
-			vclock_follow(&replicaset_vclock, row.replica_id,
-				      row.lsn);
-			xstream_write_xc(applier->subscribe_stream, &row);
+		/*
+		 * Wait for one row, then take whatever is already
+		 * buffered, without reading more: row bodies point
+		 * to the input buffer, which may be relocated by
+		 * a read.
+		 */
+		int count = 0;
+		coio_read_xrow(coio, &iobuf->in, &rows[count++]);
+		while (count < batch_size &&
+		       applier_read_buffered_xrow(&iobuf->in, &rows[count]))
+			count++;
+
+		for (int i = 0; i < count; i++) {
+			struct xrow_header *row = &rows[i];
+			applier->lag = ev_now(loop()) - row->tm;
+			applier->last_row_time = ev_monotonic_now(loop());
+
+			if (iproto_type_is_error(row->type))
+				xrow_decode_error_xc(row);  /* error */
+			/* Replication request. */
+			if (row->replica_id == REPLICA_ID_NIL ||
+			    row->replica_id >= VCLOCK_MAX) {
+				/*
+				 * A safety net, this can only occur
+				 * if we're fed a strangely broken xlog.
+				 */
+				tnt_raise(ClientError, ER_UNKNOWN_REPLICA,
+					  int2str(row->replica_id),
+					  tt_uuid_str(&REPLICASET_UUID));
+			}
 		}
+		if (count == 1)
+			applier_apply_row(applier, &rows[0]);
+		else
+			applier_apply_batch(applier, rows, count);
 		fiber_cond_signal(&applier->writer_cond);
 		iobuf_reset(iobuf);
 		fiber_gc();
@@ -46,6 +46,11 @@
 
 /** Network timeout */
 extern double applier_timeout;
+/**
+ * The max number of replicated rows applied as a single
+ * transaction, box.cfg.replication_apply_batch.
+ */
+extern int applier_batch_size;
 
 struct xstream;
 
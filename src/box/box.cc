@@ -71,6 +71,8 @@
 #include "call.h"
 #include "func.h"
 #include "sequence.h"
+#include "hotspot.h"
+#include "tuple_hash.h"
 
 static char status[64] = "unknown";
 
@@ -264,6 +266,80 @@ request_handle_sequence(struct request *request, struct space *space)
 	}
 }
 
+/**
+ * Account a sampled request to a key in the heavy hitter
+ * statistics. Partial keys (range scans) are not accounted.
+ */
+static void
+hotspot_sample_key(uint32_t space_id, uint32_t index_id,
+		   const struct key_def *key_def, const char *key,
+		   const char *key_end)
+{
+	const char *parts = key;
+	if (mp_decode_array(&parts) != key_def->part_count)
+		return;
+	hotspot_collect_key(space_id, index_id, key_hash(parts, key_def),
+			    key, key_end - key);
+}
+
+/**
+ * Account a sampled DML request in the heavy hitter
+ * statistics. The key is the primary key of the affected
+ * tuple if there is one.
+ */
+static void
+hotspot_sample_dml(struct space *space, struct request *request,
+		   struct tuple *tuple)
+{
+	uint32_t space_id = space->def->id;
+	hotspot_collect_space(space_id);
+	struct Index *pk = space_index(space, 0);
+	if (pk == NULL)
+		return;
+	struct key_def *key_def = pk->index_def->key_def;
+	const char *key;
+	uint32_t key_size;
+	if (tuple != NULL) {
+		key = tuple_extract_key(tuple, key_def, &key_size);
+	} else if (request->key != NULL) {
+		/* UPDATE or DELETE of a missing tuple. */
+		struct Index *index = space_index(space, request->index_id);
+		if (index == NULL)
+			return;
+		hotspot_sample_key(space_id, request->index_id,
+				   index->index_def->key_def,
+				   request->key, request->key_end);
+		return;
+	} else if (request->tuple != NULL) {
+		/* UPSERT */
+		key = tuple_extract_key_raw(request->tuple, request->tuple_end,
+					    key_def, &key_size);
+	} else {
+		return;
+	}
+	if (key == NULL) {
+		/* Statistics must not fail a request. */
+		diag_clear(&fiber()->diag);
+		return;
+	}
+	hotspot_sample_key(space_id, 0, key_def, key, key + key_size);
+}
+
+/**
+ * Account a sampled SELECT in the heavy hitter statistics.
+ */
+static void
+hotspot_sample_select(struct space *space, uint32_t index_id,
+		      const char *key, const char *key_end)
+{
+	hotspot_collect_space(space->def->id);
+	struct Index *index = space_index(space, index_id);
+	if (index == NULL || key == NULL)
+		return;
+	hotspot_sample_key(space->def->id, index_id,
+			   index->index_def->key_def, key, key_end);
+}
+
 static void
 process_rw(struct request *request, struct space *space, struct tuple **result)
 {
@@ -313,6 +389,8 @@ process_rw(struct request *request, struct space *space, struct tuple **result)
 		default:
 			tuple = NULL;
 		}
+		if (hotspot_need_sample())
+			hotspot_sample_dml(space, request, tuple);
 		/*
 		 * Pin the tuple locally before the commit,
 		 * otherwise it may go away during yield in
@@ -504,6 +582,17 @@ box_check_replication_timeout(void)
 	return timeout;
 }
 
+static int
+box_check_replication_apply_batch(void)
+{
+	int batch = cfg_geti("replication_apply_batch");
+	if (batch < 1) {
+		tnt_raise(ClientError, ER_CFG, "replication_apply_batch",
+			  "the value must not be less than one");
+	}
+	return batch;
+}
+
 static enum wal_mode
 box_check_wal_mode(const char *mode_name)
 {
@@ -525,6 +614,35 @@ box_check_readahead(int readahead)
 	}
 }
 
+static void
+box_check_hotspot_sample_rate(double rate)
+{
+	if (rate < 0 || rate > 1) {
+		tnt_raise(ClientError, ER_CFG, "hotspot_sample_rate",
+			  "the value must be within [0, 1]");
+	}
+}
+
+static void
+box_check_iproto_threads(int iproto_threads)
+{
+	if (iproto_threads < 1 || iproto_threads > IPROTO_THREADS_MAX) {
+		tnt_raise(ClientError, ER_CFG, "iproto_threads",
+			  "specified value is out of bounds");
+	}
+}
+
+static int
+box_check_snap_threads(const char *name)
+{
+	int threads = cfg_geti(name);
+	if (threads < 1 || threads > MEMTX_SNAP_THREADS_MAX) {
+		tnt_raise(ClientError, ER_CFG, name,
+			  "specified value is out of bounds");
+	}
+	return threads;
+}
+
 static void
 box_check_checkpoint_count(int checkpoint_count)
 {
@@ -556,6 +674,49 @@ box_check_wal_max_size(int64_t wal_max_size)
 	return wal_max_size;
 }
 
+static int64_t
+box_check_wal_relay_buffer_size(int64_t size)
+{
+	if (size < 0) {
+		tnt_raise(ClientError, ER_CFG, "wal_relay_buffer_size",
+			  "the value must not be negative");
+	}
+	return size;
+}
+
+static double
+box_check_wal_commit_delay(double delay)
+{
+	if (delay < 0) {
+		tnt_raise(ClientError, ER_CFG, "wal_commit_delay",
+			  "the value must not be negative");
+	}
+	return delay;
+}
+
+static int64_t
+box_check_wal_max_batch(const char *name)
+{
+	int64_t value = cfg_geti64(name);
+	if (value < 1) {
+		tnt_raise(ClientError, ER_CFG, name,
+			  "the value must be greater than zero");
+	}
+	return value;
+}
+
+static int
+box_check_compression_level(const char *name)
+{
+	int level = cfg_geti(name);
+	if (level < 0 || level > ZSTD_maxCLevel()) {
+		tnt_raise(ClientError, ER_CFG, name,
+			  tt_sprintf("the value must be between 0 and %d",
+				     ZSTD_maxCLevel()));
+	}
+	return level;
+}
+
 void
 box_check_config()
 {
@@ -563,11 +724,23 @@ box_check_config()
 	box_check_uri(cfg_gets("listen"), "listen");
 	box_check_replication();
 	box_check_replication_timeout();
+	box_check_replication_apply_batch();
 	box_check_readahead(cfg_geti("readahead"));
+	box_check_hotspot_sample_rate(cfg_getd("hotspot_sample_rate"));
+	box_check_iproto_threads(cfg_geti("iproto_threads"));
 	box_check_checkpoint_count(cfg_geti("checkpoint_count"));
 	box_check_wal_max_rows(cfg_geti64("rows_per_wal"));
 	box_check_wal_max_size(cfg_geti64("wal_max_size"));
+	box_check_wal_relay_buffer_size(cfg_geti64("wal_relay_buffer_size"));
 	box_check_wal_mode(cfg_gets("wal_mode"));
+	box_check_wal_commit_delay(cfg_getd("wal_commit_delay"));
+	box_check_wal_max_batch("wal_max_batch_rows");
+	box_check_wal_max_batch("wal_max_batch_bytes");
+	box_check_compression_level("wal_compression_level");
+	box_check_compression_level("snap_compression_level");
+	box_check_snap_threads("snap_write_threads");
+	box_check_snap_threads("snap_read_threads");
+	box_check_compression_level("vinyl_compression_level");
 	box_check_memtx_min_tuple_size(cfg_geti64("memtx_min_tuple_size"));
 	if (cfg_geti64("vinyl_page_size") > cfg_geti64("vinyl_range_size"))
 		tnt_raise(ClientError, ER_CFG, "vinyl_page_size",
@@ -666,6 +839,12 @@ box_set_replication_timeout(void)
 	replication_cfg_timeout = relay_timeout = applier_timeout = timeout;
 }
 
+void
+box_set_replication_apply_batch(void)
+{
+	applier_batch_size = box_check_replication_apply_batch();
+}
+
 void
 box_bind(void)
 {
@@ -699,6 +878,14 @@ box_set_snap_io_rate_limit(void)
 	memtx->setSnapIoRateLimit(cfg_getd("snap_io_rate_limit"));
 }
 
+void
+box_set_snap_write_threads(void)
+{
+	int snap_write_threads = box_check_snap_threads("snap_write_threads");
+	MemtxEngine *memtx = (MemtxEngine *) engine_find("memtx");
+	memtx->setSnapWriteThreads(snap_write_threads);
+}
+
 void
 box_set_memtx_max_tuple_size(void)
 {
@@ -712,6 +899,34 @@ box_set_too_long_threshold(void)
 	too_long_threshold = cfg_getd("too_long_threshold");
 }
 
+void
+box_set_hotspot_sample_rate(void)
+{
+	double rate = cfg_getd("hotspot_sample_rate");
+	box_check_hotspot_sample_rate(rate);
+	hotspot_set_sample_rate(rate);
+}
+
+void
+box_set_wal_commit_delay(void)
+{
+	double delay = box_check_wal_commit_delay(cfg_getd("wal_commit_delay"));
+	wal_set_commit_delay(delay);
+}
+
+void
+box_set_wal_max_batch_rows(void)
+{
+	wal_set_max_batch(box_check_wal_max_batch("wal_max_batch_rows"),
+			  box_check_wal_max_batch("wal_max_batch_bytes"));
+}
+
+void
+box_set_wal_max_batch_bytes(void)
+{
+	box_set_wal_max_batch_rows();
+}
+
 void
 box_set_readahead(void)
 {
@@ -901,6 +1116,8 @@ box_select(struct port *port, uint32_t space_id, uint32_t index_id,
 		space->handler->executeSelect(txn, space, index_id, iterator,
 					      offset, limit, key, key_end, port);
 		txn_commit_ro_stmt(txn);
+		if (hotspot_need_sample())
+			hotspot_sample_select(space, index_id, key, key_end);
 		return 0;
 	} catch (Exception *e) {
 		txn_rollback_stmt();
@@ -1466,7 +1683,10 @@ engine_init()
 					     cfg_geti("force_recovery"),
 					     cfg_getd("memtx_memory"),
 					     cfg_geti("memtx_min_tuple_size"),
-					     cfg_getd("slab_alloc_factor"));
+					     cfg_getd("slab_alloc_factor"),
+					     cfg_geti("snap_compression_level"));
+	memtx->setSnapReadThreads(cfg_geti("snap_read_threads"));
+	memtx->setUseMvccEngine(cfg_geti("memtx_use_mvcc_engine"));
 	engine_register(memtx);
 
 	SysviewEngine *sysview = new SysviewEngine();
@@ -1640,7 +1860,7 @@ box_cfg_xc(void)
 	schema_init();
 	replication_init();
 	port_init();
-	iproto_init();
+	iproto_init(cfg_geti("iproto_threads"));
 	wal_thread_start();
 
 	title("loading");
@@ -1780,9 +2000,15 @@ box_cfg_xc(void)
 	/* Start WAL writer */
 	int64_t wal_max_rows = box_check_wal_max_rows(cfg_geti64("rows_per_wal"));
 	int64_t wal_max_size = box_check_wal_max_size(cfg_geti64("wal_max_size"));
+	int64_t wal_relay_buffer_size = box_check_wal_relay_buffer_size(
+			cfg_geti64("wal_relay_buffer_size"));
 	enum wal_mode wal_mode = box_check_wal_mode(cfg_gets("wal_mode"));
+	int wal_compression_level =
+		box_check_compression_level("wal_compression_level");
 	wal_init(wal_mode, cfg_gets("wal_dir"), &INSTANCE_UUID,
-		 &replicaset_vclock, wal_max_rows, wal_max_size);
+		 &replicaset_vclock, wal_max_rows, wal_max_size,
+		 cfg_geti("wal_preallocate"), wal_relay_buffer_size,
+		 wal_compression_level);
 
 	rmean_cleanup(rmean_box);
 
@@ -147,6 +147,7 @@ void box_set_replication(void);
 void box_set_log_level(void);
 void box_set_io_collect_interval(void);
 void box_set_snap_io_rate_limit(void);
+void box_set_snap_write_threads(void);
 void box_set_too_long_threshold(void);
 void box_set_readahead(void);
 void box_set_checkpoint_count(void);
@@ -154,6 +155,11 @@ void box_set_memtx_max_tuple_size(void);
 void box_set_vinyl_max_tuple_size(void);
 void box_set_vinyl_timeout(void);
 void box_set_replication_timeout(void);
+void box_set_wal_commit_delay(void);
+void box_set_wal_max_batch_rows(void);
+void box_set_wal_max_batch_bytes(void);
+void box_set_hotspot_sample_rate(void);
+void box_set_replication_apply_batch(void);
 
 extern "C" {
 #endif /* defined(__cplusplus) */
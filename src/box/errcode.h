@@ -207,6 +207,7 @@ struct errcode_record {
 	/*152 */_(ER_SQL_EXECUTE,               "Failed to execute SQL statement: %s") \
 	/*153 */_(ER_SQL,			"SQL error: %s") \
 	/*154 */_(ER_SQL_BIND_NOT_FOUND,	"Parameter %s was not found in the statement") \
+	/*155 */_(ER_SQL_STMT_NOT_FOUND,	"Prepared statement %u was not found") \
 
 /*
  * !IMPORTANT! Please follow instructions at start of the file
@@ -37,11 +37,18 @@
 #include "small/region.h"
 #include "small/obuf.h"
 #include "diag.h"
+#include "say.h"
 #include "sql.h"
 #include "xrow.h"
 #include "schema.h"
-#include "port.h"
-#include "memtx_tuple.h"
+#include "fiber.h"
+#include "assoc.h"
+#include "small/rlist.h"
+
+enum {
+	/** Size of the first slab of the buffer for result rows. */
+	SQL_ROWS_BUF_SIZE = 16384,
+};
 
 const char *sql_type_strs[] = {
 	NULL,
@@ -77,6 +84,69 @@ struct sql_bind {
 	};
 };
 
+/**
+ * A compiled SQL statement kept in the statement cache.
+ */
+struct sql_stmt_entry {
+	/**
+	 * Statement id, see IPROTO_SQL_STMT_ID. Only prepared
+	 * statements have one, 0 for others.
+	 */
+	uint32_t id;
+	/** Statement text. */
+	char *sql;
+	/** Length of the @sql. */
+	uint32_t sql_len;
+	/**
+	 * Compiled statement. NULL if it has been dropped
+	 * on schema change and must be compiled again.
+	 */
+	struct sqlite3_stmt *stmt;
+	/** Schema version the statement was compiled with. */
+	uint32_t schema_version;
+	/**
+	 * Set while the statement is being executed. A busy
+	 * statement can't be evicted or finalized, concurrent
+	 * requests compile a private copy instead.
+	 */
+	bool is_busy;
+	/** Set if the statement was prepared by a client. */
+	bool is_prepared;
+	/** Link in sql_stmt_lru::list. */
+	struct rlist in_lru;
+};
+
+/** A list of cached statements of one kind. */
+struct sql_stmt_lru {
+	/** Entries, most recently used first. */
+	struct rlist list;
+	/** Number of entries in the list. */
+	uint32_t size;
+};
+
+/**
+ * Cache of compiled SQL statements, shared by all sessions.
+ * Saves parsing and planning of statements executed often.
+ *
+ * Statements prepared by clients and statements executed by
+ * text are evicted separately, so that a stream of ad-hoc
+ * statements never evicts a statement a client holds an id of.
+ */
+static struct sql_stmt_cache {
+	/** Statement text -> struct sql_stmt_entry. */
+	struct mh_strnptr_t *by_sql;
+	/** Prepared statement id -> struct sql_stmt_entry. */
+	struct mh_i32ptr_t *by_id;
+	/** Statements executed by text only. */
+	struct sql_stmt_lru adhoc;
+	/** Statements prepared by clients. */
+	struct sql_stmt_lru prepared;
+	/** Id to assign to the next new entry. */
+	uint32_t next_id;
+	/** Schema version cached statements are valid for. */
+	uint32_t schema_version;
+} sql_stmt_cache;
+
 /**
  * Return a string name of a parameter marker.
  * @param Bind to get name.
@@ -262,12 +332,14 @@ error:
 
 	uint32_t map_size = mp_decode_map(&data);
 	request->sql_text = NULL;
+	request->stmt_id = 0;
 	request->bind = NULL;
 	request->bind_count = 0;
 	request->sync = row->sync;
 	for (uint32_t i = 0; i < map_size; ++i) {
 		uint8_t key = *data;
-		if (key != IPROTO_SQL_BIND && key != IPROTO_SQL_TEXT) {
+		if (key != IPROTO_SQL_BIND && key != IPROTO_SQL_TEXT &&
+		    key != IPROTO_SQL_STMT_ID) {
 			mp_check(&data, end);   /* skip the key */
 			mp_check(&data, end);   /* skip the value */
 			continue;
@@ -278,11 +350,18 @@ error:
 		if (key == IPROTO_SQL_BIND) {
 			if (sql_bind_list_decode(request, value, region) != 0)
 				return -1;
+		} else if (key == IPROTO_SQL_STMT_ID) {
+			if (mp_typeof(*value) != MP_UINT)
+				goto error;
+			uint64_t id = mp_decode_uint(&value);
+			if (id == 0 || id > UINT32_MAX)
+				goto error;
+			request->stmt_id = id;
 		} else {
 			request->sql_text = value;
 		}
 	}
-	if (request->sql_text == NULL) {
+	if (request->sql_text == NULL && request->stmt_id == 0) {
 		diag_set(ClientError, ER_MISSING_REQUEST_FIELD,
 			 iproto_key_name(IPROTO_SQL_TEXT));
 		return -1;
@@ -297,14 +376,14 @@ error:
  * @param stmt Prepared and started statement. At least one
  *        sqlite3_step must be called.
  * @param i Column number.
- * @param region Allocator for column value.
+ * @param buf Buffer to append the column value to.
  *
  * @retval  0 Success.
  * @retval -1 Out of memory when resizing the output buffer.
  */
 static inline int
 sql_column_to_messagepack(struct sqlite3_stmt *stmt, int i,
-			  struct region *region)
+			  struct obuf *buf)
 {
 	size_t size;
 	int type = sqlite3_column_type(stmt, i);
@@ -315,7 +394,7 @@ sql_column_to_messagepack(struct sqlite3_stmt *stmt, int i,
 			size = mp_sizeof_uint(n);
 		else
 			size = mp_sizeof_int(n);
-		char *pos = (char *) region_alloc(region, size);
+		char *pos = (char *) obuf_alloc(buf, size);
 		if (pos == NULL)
 			goto oom;
 		if (n >= 0)
@@ -327,7 +406,7 @@ sql_column_to_messagepack(struct sqlite3_stmt *stmt, int i,
 	case SQLITE_FLOAT: {
 		double d = sqlite3_column_double(stmt, i);
 		size = mp_sizeof_double(d);
-		char *pos = (char *) region_alloc(region, size);
+		char *pos = (char *) obuf_alloc(buf, size);
 		if (pos == NULL)
 			goto oom;
 		mp_encode_double(pos, d);
@@ -336,7 +415,7 @@ sql_column_to_messagepack(struct sqlite3_stmt *stmt, int i,
 	case SQLITE_TEXT: {
 		uint32_t len = sqlite3_column_bytes(stmt, i);
 		size = mp_sizeof_str(len);
-		char *pos = (char *) region_alloc(region, size);
+		char *pos = (char *) obuf_alloc(buf, size);
 		if (pos == NULL)
 			goto oom;
 		const char *s;
@@ -347,7 +426,7 @@ sql_column_to_messagepack(struct sqlite3_stmt *stmt, int i,
 	case SQLITE_BLOB: {
 		uint32_t len = sqlite3_column_bytes(stmt, i);
 		size = mp_sizeof_bin(len);
-		char *pos = (char *) region_alloc(region, size);
+		char *pos = (char *) obuf_alloc(buf, size);
 		if (pos == NULL)
 			goto oom;
 		const char *s;
@@ -357,7 +436,7 @@ sql_column_to_messagepack(struct sqlite3_stmt *stmt, int i,
 	}
 	case SQLITE_NULL: {
 		size = mp_sizeof_nil();
-		char *pos = (char *) region_alloc(region, size);
+		char *pos = (char *) obuf_alloc(buf, size);
 		if (pos == NULL)
 			goto oom;
 		mp_encode_nil(pos);
@@ -368,55 +447,39 @@ sql_column_to_messagepack(struct sqlite3_stmt *stmt, int i,
 	}
 	return 0;
 oom:
-	diag_set(OutOfMemory, size, "region_alloc", "SQL value");
+	diag_set(OutOfMemory, size, "obuf_alloc", "SQL value");
 	return -1;
 }
 
 /**
- * Convert sqlite3 row into a tuple and append to a port.
+ * Encode sqlite3 row as a msgpack array and append it to
+ * a buffer.
  * @param stmt Started prepared statement. At least one
  *        sqlite3_step must be done.
  * @param column_count Statement's column count.
- * @param region Runtime allocator for temporary objects.
- * @param port Port to store tuples.
+ * @param buf Buffer to store the row.
  *
  * @retval  0 Success.
  * @retval -1 Memory error.
  */
 static inline int
-sql_row_to_port(struct sqlite3_stmt *stmt, int column_count,
-		struct region *region, struct port *port)
+sql_row_to_obuf(struct sqlite3_stmt *stmt, int column_count,
+		struct obuf *buf)
 {
 	assert(column_count > 0);
 	size_t size = mp_sizeof_array(column_count);
-	size_t svp = region_used(region);
-	char *pos = (char *) region_alloc(region, size);
+	char *pos = (char *) obuf_alloc(buf, size);
 	if (pos == NULL) {
-		diag_set(OutOfMemory, size, "region_alloc", "SQL row");
+		diag_set(OutOfMemory, size, "obuf_alloc", "SQL row");
 		return -1;
 	}
 	mp_encode_array(pos, column_count);
 
 	for (int i = 0; i < column_count; ++i) {
-		if (sql_column_to_messagepack(stmt, i, region) != 0)
-			goto error;
-	}
-	size = region_used(region) - svp;
-	pos = (char *) region_join(region, size);
-	if (pos == NULL) {
-		diag_set(OutOfMemory, size, "region_join", "pos");
-		goto error;
+		if (sql_column_to_messagepack(stmt, i, buf) != 0)
+			return -1;
 	}
-	struct tuple *tuple =
-		tuple_new(box_tuple_format_default(), pos, pos + size);
-	if (tuple == NULL)
-		goto error;
-	region_truncate(region, svp);
-	return port_add_tuple(port, tuple);
-
-error:
-	region_truncate(region, svp);
-	return -1;
+	return 0;
 }
 
 /**
@@ -546,17 +609,29 @@ sql_get_description(struct sqlite3_stmt *stmt, struct obuf *out,
 	return 0;
 }
 
+/**
+ * Run the prepared statement to completion.
+ * @param db SQLite engine.
+ * @param stmt Prepared statement.
+ * @param column_count Statement's column count.
+ * @param rows Buffer to store the result set rows.
+ * @param[out] row_count Number of rows in the result set.
+ *
+ * @retval  0 Success.
+ * @retval -1 Client or memory error.
+ */
 static inline int
 sql_execute(sqlite3 *db, struct sqlite3_stmt *stmt, int column_count,
-	    struct port *port, struct region *region)
+	    struct obuf *rows, uint32_t *row_count)
 {
 	int rc;
+	*row_count = 0;
 	if (column_count > 0) {
 		/* Either ROW or DONE or ERROR. */
 		while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
-			if (sql_row_to_port(stmt, column_count, region,
-					    port) != 0)
+			if (sql_row_to_obuf(stmt, column_count, rows) != 0)
 				return -1;
+			++*row_count;
 		}
 		assert(rc == SQLITE_DONE || rc != SQLITE_OK);
 	} else {
@@ -571,6 +646,29 @@ sql_execute(sqlite3 *db, struct sqlite3_stmt *stmt, int column_count,
 	return 0;
 }
 
+/**
+ * Append the contents of one output buffer to another.
+ *
+ * @retval  0 Success.
+ * @retval -1 Memory error.
+ */
+static inline int
+sql_obuf_append(struct obuf *out, struct obuf *buf)
+{
+	for (int i = 0; i <= buf->pos; i++) {
+		struct iovec *iov = &buf->iov[i];
+		if (iov->iov_len == 0)
+			continue;
+		if (obuf_dup(out, iov->iov_base, iov->iov_len) !=
+		    iov->iov_len) {
+			diag_set(OutOfMemory, iov->iov_len, "obuf_dup",
+				 "SQL rows");
+			return -1;
+		}
+	}
+	return 0;
+}
+
 /**
  * Execute the prepared statement and write to the @out obuf the
  * result. Result is either rows array in a case of not zero
@@ -579,19 +677,26 @@ sql_execute(sqlite3 *db, struct sqlite3_stmt *stmt, int column_count,
  * @param stmt Prepared statement.
  * @param out Out buffer.
  * @param sync IProto request sync.
- * @param region Runtime allocator for temporary objects.
  *
  * @retval  0 Success.
  * @retval -1 Client or memory error.
  */
 static inline int
 sql_execute_and_encode(sqlite3 *db, struct sqlite3_stmt *stmt, struct obuf *out,
-		       uint64_t sync, struct region *region)
+		       uint64_t sync)
 {
-	struct port port;
-	port_create(&port);
+	/*
+	 * Rows are encoded right away into a private buffer,
+	 * which is then appended to the response. They can't
+	 * be encoded into @out directly, since the statement
+	 * may yield and let another request of the same
+	 * connection write to @out in the meantime.
+	 */
+	struct obuf rows;
+	obuf_create(&rows, &cord()->slabc, SQL_ROWS_BUF_SIZE);
+	uint32_t row_count;
 	int column_count = sqlite3_column_count(stmt);
-	if (sql_execute(db, stmt, column_count, &port, region) != 0)
+	if (sql_execute(db, stmt, column_count, &rows, &row_count) != 0)
 		goto err_execute;
 
 	/*
@@ -606,15 +711,13 @@ sql_execute_and_encode(sqlite3 *db, struct sqlite3_stmt *stmt, struct obuf *out,
 		if (sql_get_description(stmt, out, column_count) != 0)
 			goto err_body;
 		keys = 2;
-		if (iproto_reply_array_key(out, port.size, IPROTO_DATA) != 0)
+		if (iproto_reply_array_key(out, row_count, IPROTO_DATA) != 0)
 			goto err_body;
-		if (port_dump(&port, out) != 0) {
-			/* Failed port dump destroyes the port. */
+		if (sql_obuf_append(out, &rows) != 0)
 			goto err_body;
-		}
 	} else {
 		keys = 1;
-		assert(port.size == 0);
+		assert(row_count == 0);
 		if (iproto_reply_map_key(out, 1, IPROTO_SQL_INFO) != 0)
 			goto err_body;
 		int changes = sqlite3_changes(db);
@@ -628,43 +731,386 @@ sql_execute_and_encode(sqlite3 *db, struct sqlite3_stmt *stmt, struct obuf *out,
 		buf = mp_encode_uint(buf, IPROTO_SQL_ROW_COUNT);
 		buf = mp_encode_uint(buf, changes);
 	}
-	port_destroy(&port);
+	obuf_destroy(&rows);
 	iproto_reply_sql(out, &header_svp, sync, schema_version, keys);
 	return 0;
 
 err_body:
 	obuf_rollback_to_svp(out, &header_svp);
 err_execute:
-	port_destroy(&port);
+	obuf_destroy(&rows);
 	return -1;
 }
 
-int
-sql_prepare_and_execute(const struct sql_request *request, struct obuf *out,
-			struct region *region)
+void
+sql_stmt_cache_init(void)
+{
+	struct sql_stmt_cache *cache = &sql_stmt_cache;
+	cache->by_sql = mh_strnptr_new();
+	cache->by_id = mh_i32ptr_new();
+	if (cache->by_sql == NULL || cache->by_id == NULL)
+		panic("failed to allocate SQL statement cache");
+	rlist_create(&cache->adhoc.list);
+	cache->adhoc.size = 0;
+	rlist_create(&cache->prepared.list);
+	cache->prepared.size = 0;
+	cache->next_id = 1;
+	cache->schema_version = schema_version;
+}
+
+static inline struct sql_stmt_lru *
+sql_stmt_cache_lru(struct sql_stmt_cache *cache,
+		   const struct sql_stmt_entry *entry)
+{
+	return entry->is_prepared ? &cache->prepared : &cache->adhoc;
+}
+
+static void
+sql_stmt_entry_delete(struct sql_stmt_cache *cache,
+		      struct sql_stmt_entry *entry)
+{
+	assert(!entry->is_busy);
+	mh_int_t i = mh_strnptr_find_inp(cache->by_sql, entry->sql,
+					 entry->sql_len);
+	assert(i != mh_end(cache->by_sql));
+	mh_strnptr_del(cache->by_sql, i, NULL);
+	if (entry->is_prepared) {
+		i = mh_i32ptr_find(cache->by_id, entry->id, NULL);
+		assert(i != mh_end(cache->by_id));
+		mh_i32ptr_del(cache->by_id, i, NULL);
+	}
+	rlist_del_entry(entry, in_lru);
+	sql_stmt_cache_lru(cache, entry)->size--;
+	sqlite3_finalize(entry->stmt);
+	free(entry);
+}
+
+static void
+sql_stmt_lru_free(struct sql_stmt_cache *cache, struct sql_stmt_lru *lru)
 {
-	const char *sql = request->sql_text;
-	uint32_t len;
-	sql = mp_decode_str(&sql, &len);
+	while (!rlist_empty(&lru->list)) {
+		struct sql_stmt_entry *entry =
+			rlist_first_entry(&lru->list, struct sql_stmt_entry,
+					  in_lru);
+		sql_stmt_entry_delete(cache, entry);
+	}
+}
+
+void
+sql_stmt_cache_free(void)
+{
+	struct sql_stmt_cache *cache = &sql_stmt_cache;
+	if (cache->by_sql == NULL)
+		return;
+	sql_stmt_lru_free(cache, &cache->adhoc);
+	sql_stmt_lru_free(cache, &cache->prepared);
+	mh_strnptr_delete(cache->by_sql);
+	mh_i32ptr_delete(cache->by_id);
+	cache->by_sql = NULL;
+	cache->by_id = NULL;
+}
+
+static void
+sql_stmt_lru_drop_stmts(struct sql_stmt_lru *lru)
+{
+	struct sql_stmt_entry *entry;
+	rlist_foreach_entry(entry, &lru->list, in_lru) {
+		/* Busy statements are dropped on release. */
+		if (entry->is_busy || entry->stmt == NULL)
+			continue;
+		sqlite3_finalize(entry->stmt);
+		entry->stmt = NULL;
+	}
+}
+
+/*
+ * Unlike tx_check_schema(), which rejects a request sent by a
+ * client with an outdated schema version, this check never
+ * fails: the statement text is kept, so the cache may recompile
+ * it transparently and the statement id stays valid across DDL.
+ * tx_check_schema() is still applied to EXECUTE and PREPARE
+ * before the cache is consulted.
+ */
+void
+sql_stmt_cache_check_schema(void)
+{
+	struct sql_stmt_cache *cache = &sql_stmt_cache;
+	if (cache->schema_version == schema_version)
+		return;
+	sql_stmt_lru_drop_stmts(&cache->adhoc);
+	sql_stmt_lru_drop_stmts(&cache->prepared);
+	cache->schema_version = schema_version;
+}
+
+/**
+ * Compile a statement.
+ * @param sql Statement text.
+ * @param len Length of the @sql.
+ *
+ * @retval not NULL Compiled statement.
+ * @retval     NULL Client or memory error.
+ */
+static struct sqlite3_stmt *
+sql_compile(const char *sql, uint32_t len)
+{
+	sqlite3 *db = sql_get();
 	struct sqlite3_stmt *stmt;
+	if (sqlite3_prepare_v2(db, sql, len, &stmt, NULL) != SQLITE_OK) {
+		diag_set(ClientError, ER_SQL_EXECUTE, sqlite3_errmsg(db));
+		return NULL;
+	}
+	assert(stmt != NULL);
+	return stmt;
+}
+
+/**
+ * Evict least recently used entries of a list that are not
+ * being executed to make room for a new entry.
+ */
+static void
+sql_stmt_cache_evict(struct sql_stmt_cache *cache, struct sql_stmt_lru *lru)
+{
+	struct sql_stmt_entry *entry =
+		rlist_last_entry(&lru->list, struct sql_stmt_entry, in_lru);
+	while (lru->size >= SQL_STMT_CACHE_SIZE &&
+	       &entry->in_lru != &lru->list) {
+		struct sql_stmt_entry *prev = rlist_prev_entry(entry, in_lru);
+		if (!entry->is_busy)
+			sql_stmt_entry_delete(cache, entry);
+		entry = prev;
+	}
+}
+
+/**
+ * Give a cached statement an id and move it to the list of
+ * prepared statements.
+ * @retval  0 Success.
+ * @retval -1 Memory error.
+ */
+static int
+sql_stmt_entry_prepare(struct sql_stmt_cache *cache,
+		       struct sql_stmt_entry *entry)
+{
+	assert(!entry->is_prepared);
+	const struct mh_i32ptr_node_t id_node = { cache->next_id, entry };
+	if (mh_i32ptr_put(cache->by_id, &id_node, NULL,
+			  NULL) == mh_end(cache->by_id)) {
+		diag_set(OutOfMemory, sizeof(id_node), "malloc", "by_id");
+		return -1;
+	}
+	entry->id = cache->next_id;
+	/*
+	 * Zero is reserved for "no statement id". Once the
+	 * counter wraps, skip ids of statements which are still
+	 * in the cache. An id of an evicted statement may be
+	 * given to another one after 2^32 - 1 prepares though,
+	 * so a client which holds a stale id for that long may
+	 * execute another statement.
+	 */
+	do {
+		if (++cache->next_id == 0)
+			cache->next_id = 1;
+	} while (mh_i32ptr_find(cache->by_id, cache->next_id,
+				NULL) != mh_end(cache->by_id));
+	sql_stmt_cache_evict(cache, &cache->prepared);
+	rlist_del_entry(entry, in_lru);
+	cache->adhoc.size--;
+	entry->is_prepared = true;
+	rlist_add_entry(&cache->prepared.list, entry, in_lru);
+	cache->prepared.size++;
+	return 0;
+}
+
+/**
+ * Add a compiled statement to the cache.
+ * @retval not NULL New cache entry.
+ * @retval     NULL Memory error.
+ */
+static struct sql_stmt_entry *
+sql_stmt_entry_new(struct sql_stmt_cache *cache, const char *sql,
+		   uint32_t len, struct sqlite3_stmt *stmt)
+{
+	size_t size = sizeof(struct sql_stmt_entry) + len;
+	struct sql_stmt_entry *entry = (struct sql_stmt_entry *) malloc(size);
+	if (entry == NULL) {
+		diag_set(OutOfMemory, size, "malloc", "entry");
+		return NULL;
+	}
+	entry->id = 0;
+	entry->sql = (char *) (entry + 1);
+	memcpy(entry->sql, sql, len);
+	entry->sql_len = len;
+	entry->stmt = stmt;
+	entry->schema_version = schema_version;
+	entry->is_busy = false;
+	entry->is_prepared = false;
+
+	uint32_t hash = mh_strn_hash(entry->sql, len);
+	const struct mh_strnptr_node_t sql_node = {
+		entry->sql, len, hash, entry
+	};
+	if (mh_strnptr_put(cache->by_sql, &sql_node, NULL,
+			   NULL) == mh_end(cache->by_sql)) {
+		diag_set(OutOfMemory, sizeof(sql_node), "malloc", "by_sql");
+		free(entry);
+		return NULL;
+	}
+	sql_stmt_cache_evict(cache, &cache->adhoc);
+	rlist_add_entry(&cache->adhoc.list, entry, in_lru);
+	cache->adhoc.size++;
+	return entry;
+}
+
+/**
+ * Find a statement in the cache by text or by id, compiling
+ * and caching it if needed.
+ * @param request EXECUTE or PREPARE request.
+ * @param is_prepare Set for PREPARE: give the statement an id.
+ *
+ * @retval not NULL Cache entry with a compiled statement.
+ * @retval     NULL Client or memory error.
+ */
+static struct sql_stmt_entry *
+sql_stmt_cache_get(const struct sql_request *request, bool is_prepare)
+{
+	struct sql_stmt_cache *cache = &sql_stmt_cache;
+	sql_stmt_cache_check_schema();
+	struct sql_stmt_entry *entry;
+	if (request->sql_text != NULL) {
+		const char *sql = request->sql_text;
+		uint32_t len;
+		sql = mp_decode_str(&sql, &len);
+		mh_int_t i = mh_strnptr_find_inp(cache->by_sql, sql, len);
+		if (i == mh_end(cache->by_sql)) {
+			struct sqlite3_stmt *stmt = sql_compile(sql, len);
+			if (stmt == NULL)
+				return NULL;
+			entry = sql_stmt_entry_new(cache, sql, len, stmt);
+			if (entry == NULL) {
+				sqlite3_finalize(stmt);
+				return NULL;
+			}
+		} else {
+			entry = (struct sql_stmt_entry *)
+				mh_strnptr_node(cache->by_sql, i)->val;
+		}
+		if (is_prepare && !entry->is_prepared &&
+		    sql_stmt_entry_prepare(cache, entry) != 0)
+			return NULL;
+	} else {
+		mh_int_t i = mh_i32ptr_find(cache->by_id, request->stmt_id,
+					    NULL);
+		if (i == mh_end(cache->by_id)) {
+			diag_set(ClientError, ER_SQL_STMT_NOT_FOUND,
+				 request->stmt_id);
+			return NULL;
+		}
+		entry = (struct sql_stmt_entry *)
+			mh_i32ptr_node(cache->by_id, i)->val;
+	}
+	/* Busy statements are never dropped. */
+	if (entry->stmt == NULL) {
+		assert(!entry->is_busy);
+		entry->stmt = sql_compile(entry->sql, entry->sql_len);
+		if (entry->stmt == NULL)
+			return NULL;
+		entry->schema_version = schema_version;
+	}
+	rlist_move_entry(&sql_stmt_cache_lru(cache, entry)->list, entry,
+			 in_lru);
+	return entry;
+}
+
+/**
+ * Prepare a cached statement for the next execution, dropping
+ * it if the schema has changed while it was being executed.
+ */
+static void
+sql_stmt_entry_release(struct sql_stmt_entry *entry)
+{
+	assert(entry->is_busy);
+	entry->is_busy = false;
+	sqlite3_reset(entry->stmt);
+	sqlite3_clear_bindings(entry->stmt);
+	if (entry->schema_version != schema_version) {
+		sqlite3_finalize(entry->stmt);
+		entry->stmt = NULL;
+	}
+}
+
+int
+sql_prepare_and_execute(const struct sql_request *request, struct obuf *out)
+{
 	sqlite3 *db = sql_get();
 	if (db == NULL) {
 		diag_set(ClientError, ER_LOADING);
 		return -1;
 	}
-	if (sqlite3_prepare_v2(db, sql, len, &stmt, NULL) != SQLITE_OK) {
-		diag_set(ClientError, ER_SQL_EXECUTE, sqlite3_errmsg(db));
+	struct sql_stmt_entry *entry = sql_stmt_cache_get(request, false);
+	if (entry == NULL)
 		return -1;
+	struct sqlite3_stmt *stmt;
+	bool is_cached = !entry->is_busy;
+	if (is_cached) {
+		stmt = entry->stmt;
+		entry->is_busy = true;
+	} else {
+		/*
+		 * The statement is being executed by another
+		 * fiber, use a private copy.
+		 */
+		stmt = sql_compile(entry->sql, entry->sql_len);
+		if (stmt == NULL)
+			return -1;
 	}
-	assert(stmt != NULL);
-	if (sql_bind(request, stmt) != 0)
-		goto err_stmt;
-	if (sql_execute_and_encode(db, stmt, out, request->sync,
-				   region) != 0)
-		goto err_stmt;
-	sqlite3_finalize(stmt);
+	int rc = sql_bind(request, stmt);
+	if (rc == 0)
+		rc = sql_execute_and_encode(db, stmt, out, request->sync);
+	if (is_cached)
+		sql_stmt_entry_release(entry);
+	else
+		sqlite3_finalize(stmt);
+	return rc;
+}
+
+int
+sql_prepare(const struct sql_request *request, struct obuf *out)
+{
+	if (request->sql_text == NULL) {
+		diag_set(ClientError, ER_MISSING_REQUEST_FIELD,
+			 iproto_key_name(IPROTO_SQL_TEXT));
+		return -1;
+	}
+	if (sql_get() == NULL) {
+		diag_set(ClientError, ER_LOADING);
+		return -1;
+	}
+	struct sql_stmt_entry *entry = sql_stmt_cache_get(request, true);
+	if (entry == NULL)
+		return -1;
+	struct obuf_svp header_svp;
+	if (iproto_prepare_header(out, &header_svp, IPROTO_SQL_HEADER_LEN) != 0)
+		return -1;
+	int keys = 1;
+	int size = mp_sizeof_uint(IPROTO_SQL_STMT_ID) +
+		   mp_sizeof_uint(entry->id);
+	char *buf = obuf_alloc(out, size);
+	if (buf == NULL) {
+		diag_set(OutOfMemory, size, "obuf_alloc", "buf");
+		goto err;
+	}
+	buf = mp_encode_uint(buf, IPROTO_SQL_STMT_ID);
+	buf = mp_encode_uint(buf, entry->id);
+	int column_count = sqlite3_column_count(entry->stmt);
+	if (column_count > 0) {
+		keys = 2;
+		if (sql_get_description(entry->stmt, out, column_count) != 0)
+			goto err;
+	}
+	iproto_reply_sql(out, &header_svp, request->sync, schema_version,
+			 keys);
 	return 0;
-err_stmt:
-	sqlite3_finalize(stmt);
+err:
+	obuf_rollback_to_svp(out, &header_svp);
 	return -1;
 }
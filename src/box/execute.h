@@ -43,11 +43,24 @@ struct region;
 struct sql_bind;
 struct xrow_header;
 
-/** EXECUTE request. */
+enum {
+	/**
+	 * Max number of compiled statements of each kind,
+	 * prepared and executed by text, kept in the cache.
+	 */
+	SQL_STMT_CACHE_SIZE = 1024,
+};
+
+/** EXECUTE or PREPARE request. */
 struct sql_request {
 	uint64_t sync;
-	/** SQL statement text. */
+	/**
+	 * SQL statement text. NULL if the statement is
+	 * referred to by @stmt_id.
+	 */
 	const char *sql_text;
+	/** Id of a prepared statement. */
+	uint32_t stmt_id;
 	/** Array of parameters. */
 	struct sql_bind *bind;
 	/** Length of the @bind. */
@@ -55,7 +68,27 @@ struct sql_request {
 };
 
 /**
- * Parse the EXECUTE request.
+ * Initialize the cache of compiled SQL statements.
+ */
+void
+sql_stmt_cache_init(void);
+
+/**
+ * Finalize all cached statements and free the cache.
+ */
+void
+sql_stmt_cache_free(void);
+
+/**
+ * Drop compiled statements from the cache if the schema has
+ * changed since they were prepared. Statement ids remain
+ * valid: the statements are compiled again on next use.
+ */
+void
+sql_stmt_cache_check_schema(void);
+
+/**
+ * Parse the EXECUTE or PREPARE request.
  * @param row Encoded data.
  * @param[out] request Request to decode to.
  * @param region Allocator.
@@ -97,15 +130,39 @@ xrow_decode_sql(const struct xrow_header *row, struct sql_request *request,
  *
  * @param request IProto request.
  * @param out Out buffer of the iproto message.
- * @param region Runtime allocator for temporary objects
- *        (columns, tuples ...).
  *
  * @retval  0 Success.
  * @retval -1 Client or memory error.
  */
 int
-sql_prepare_and_execute(const struct sql_request *request, struct obuf *out,
-			struct region *region);
+sql_prepare_and_execute(const struct sql_request *request, struct obuf *out);
+
+/**
+ * Compile an SQL statement, put it to the statement cache and
+ * encode its id in an iproto message, so that the statement
+ * can be executed later with EXECUTE without being parsed.
+ * Response structure:
+ * +----------------------------------------------+
+ * | IPROTO_OK, sync, schema_version   ...        | iproto_header
+ * +----------------------------------------------+---------------
+ * | IPROTO_BODY: {                               |
+ * |     IPROTO_SQL_STMT_ID: number,              |
+ * |     IPROTO_METADATA: [                       | iproto_body
+ * |         {IPROTO_FIELD_NAME: column name1},   |
+ * |         ...                                  |
+ * |     ]                                        |
+ * | }                                            |
+ * +----------------------------------------------+
+ * IPROTO_METADATA is omitted for statements returning no rows.
+ *
+ * @param request IProto request.
+ * @param out Out buffer of the iproto message.
+ *
+ * @retval  0 Success.
+ * @retval -1 Client or memory error.
+ */
+int
+sql_prepare(const struct sql_request *request, struct obuf *out);
 
 #if defined(__cplusplus)
 } /* extern "C" { */
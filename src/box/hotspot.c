@@ -0,0 +1,112 @@
+/*
+ * Copyright 2010-2017, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "hotspot.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+struct hotspot_top hotspot_spaces;
+struct hotspot_top hotspot_keys;
+int hotspot_sample_interval;
+int hotspot_sample_countdown;
+
+void
+hotspot_set_sample_rate(double rate)
+{
+	assert(rate >= 0 && rate <= 1);
+	if (rate == 0) {
+		hotspot_sample_interval = 0;
+		return;
+	}
+	double interval = round(1 / rate);
+	hotspot_sample_interval = interval < INT32_MAX ? interval : INT32_MAX;
+	hotspot_sample_countdown = hotspot_sample_interval;
+}
+
+void
+hotspot_top_collect(struct hotspot_top *top, uint32_t space_id,
+		    uint32_t index_id, uint32_t hash,
+		    const char *key, uint32_t key_size)
+{
+	struct hotspot_item *min = NULL;
+	for (int i = 0; i < top->size; i++) {
+		struct hotspot_item *item = &top->items[i];
+		if (item->space_id == space_id && item->index_id == index_id &&
+		    item->hash == hash) {
+			item->count++;
+			return;
+		}
+		if (min == NULL || min->count > item->count)
+			min = item;
+	}
+	if (top->size < HOTSPOT_TOP_SIZE) {
+		min = &top->items[top->size++];
+		min->count = 0;
+	}
+	min->space_id = space_id;
+	min->index_id = index_id;
+	min->hash = hash;
+	min->error = min->count;
+	min->count++;
+	if (key != NULL && key_size <= HOTSPOT_KEY_SIZE_MAX) {
+		memcpy(min->key, key, key_size);
+		min->key_size = key_size;
+	} else {
+		min->key_size = 0;
+	}
+}
+
+static int
+hotspot_item_cmp(const void *a, const void *b)
+{
+	const struct hotspot_item *item_a = a;
+	const struct hotspot_item *item_b = b;
+	if (item_a->count != item_b->count)
+		return item_a->count > item_b->count ? -1 : 1;
+	return 0;
+}
+
+int
+hotspot_top_get(const struct hotspot_top *top, struct hotspot_item *items)
+{
+	memcpy(items, top->items, top->size * sizeof(*items));
+	qsort(items, top->size, sizeof(*items), hotspot_item_cmp);
+	return top->size;
+}
+
+void
+hotspot_reset(void)
+{
+	hotspot_spaces.size = 0;
+	hotspot_keys.size = 0;
+}
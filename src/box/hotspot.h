@@ -0,0 +1,164 @@
+#ifndef TARANTOOL_BOX_HOTSPOT_H_INCLUDED
+#define TARANTOOL_BOX_HOTSPOT_H_INCLUDED
+/*
+ * Copyright 2010-2017, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * Heavy hitter detection: a sample of box_process1() and
+ * box_select() requests is accounted in two top-K sketches,
+ * one of spaces and one of keys. It helps to find a space
+ * or a key hammered by a client, see box.stat.hot().
+ */
+
+enum {
+	/** The number of items tracked by a top-K sketch. */
+	HOTSPOT_TOP_SIZE = 64,
+	/** Max size of a key copied to a tracked item. */
+	HOTSPOT_KEY_SIZE_MAX = 64,
+};
+
+/** An item tracked by a top-K sketch: a space or a key. */
+struct hotspot_item {
+	/** Space id. */
+	uint32_t space_id;
+	/** Index id, 0 for spaces. */
+	uint32_t index_id;
+	/** key_hash() of the key, 0 for spaces. */
+	uint32_t hash;
+	/**
+	 * Size of @key, 0 for spaces and for keys larger
+	 * than HOTSPOT_KEY_SIZE_MAX.
+	 */
+	uint32_t key_size;
+	/** The key, MsgPack array, first seen for the item. */
+	char key[HOTSPOT_KEY_SIZE_MAX];
+	/** The number of samples, an upper bound. */
+	uint64_t count;
+	/** The max overestimation of @count. */
+	uint64_t error;
+};
+
+/**
+ * A top-K sketch maintained with the space-saving algorithm:
+ * when an untracked item is sampled and the sketch is full,
+ * the item with the least count is replaced by the new one,
+ * which inherits the count as its error. Any item sampled
+ * more than total / HOTSPOT_TOP_SIZE times is guaranteed
+ * to be tracked.
+ */
+struct hotspot_top {
+	/** The number of tracked items. */
+	int size;
+	struct hotspot_item items[HOTSPOT_TOP_SIZE];
+};
+
+/** Hot spaces. */
+extern struct hotspot_top hotspot_spaces;
+/** Hot keys. */
+extern struct hotspot_top hotspot_keys;
+
+/** Sample every n-th request, 0 if sampling is disabled. */
+extern int hotspot_sample_interval;
+/** The number of requests left till the next sample. */
+extern int hotspot_sample_countdown;
+
+/**
+ * Return true if the current request must be sampled.
+ * Very cheap if sampling is disabled.
+ */
+static inline bool
+hotspot_need_sample(void)
+{
+	if (hotspot_sample_interval == 0)
+		return false;
+	if (--hotspot_sample_countdown > 0)
+		return false;
+	hotspot_sample_countdown = hotspot_sample_interval;
+	return true;
+}
+
+/**
+ * Set the share of requests to sample, 0 to disable
+ * sampling. @a rate must be within [0, 1].
+ */
+void
+hotspot_set_sample_rate(double rate);
+
+/**
+ * Account a sampled request in a top-K sketch. @a key is
+ * copied to the item if it becomes tracked, may be NULL.
+ */
+void
+hotspot_top_collect(struct hotspot_top *top, uint32_t space_id,
+		    uint32_t index_id, uint32_t hash,
+		    const char *key, uint32_t key_size);
+
+/** Account a sampled request to a space. */
+static inline void
+hotspot_collect_space(uint32_t space_id)
+{
+	hotspot_top_collect(&hotspot_spaces, space_id, 0, 0, NULL, 0);
+}
+
+/** Account a sampled request to a key with the given hash. */
+static inline void
+hotspot_collect_key(uint32_t space_id, uint32_t index_id, uint32_t hash,
+		    const char *key, uint32_t key_size)
+{
+	hotspot_top_collect(&hotspot_keys, space_id, index_id, hash,
+			    key, key_size);
+}
+
+/**
+ * Copy items tracked by a top-K sketch to @a items, which
+ * must fit HOTSPOT_TOP_SIZE items, most frequent first.
+ * Return the number of items.
+ */
+int
+hotspot_top_get(const struct hotspot_top *top, struct hotspot_item *items);
+
+/** Forget all collected samples. */
+void
+hotspot_reset(void);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
+
+#endif /* TARANTOOL_BOX_HOTSPOT_H_INCLUDED */
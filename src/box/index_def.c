@@ -35,29 +35,41 @@ const char *index_type_strs[] = { "HASH", "TREE", "BITSET", "RTREE" };
 
 const char *rtree_index_distance_type_strs[] = { "EUCLID", "MANHATTAN" };
 
+const char *rtree_index_coord_type_strs[] = { "DOUBLE", "FLOAT", "INT32" };
+
 const struct index_opts index_opts_default = {
 	/* .unique              = */ true,
+	/* .hint                = */ false,
 	/* .dimension           = */ 2,
 	/* .distance            = */ RTREE_INDEX_DISTANCE_TYPE_EUCLID,
+	/* .coord_type          = */ RTREE_INDEX_COORD_TYPE_DOUBLE,
 	/* .range_size          = */ 0,
 	/* .page_size           = */ 0,
 	/* .run_count_per_level = */ 2,
 	/* .run_size_ratio      = */ 3.5,
 	/* .bloom_fpr           = */ 0.05,
+	/* .bloom_per_page      = */ false,
+	/* .compression_dict_size = */ 0,
 	/* .lsn                 = */ 0,
 	/* .sql                 = */ NULL,
 };
 
 const struct opt_def index_opts_reg[] = {
 	OPT_DEF("unique", OPT_BOOL, struct index_opts, is_unique),
+	OPT_DEF("hint", OPT_BOOL, struct index_opts, hint),
 	OPT_DEF("dimension", OPT_INT, struct index_opts, dimension),
 	OPT_DEF_ENUM("distance", rtree_index_distance_type, struct index_opts,
 		     distance, NULL),
+	OPT_DEF_ENUM("coord_type", rtree_index_coord_type, struct index_opts,
+		     coord_type, NULL),
 	OPT_DEF("range_size", OPT_INT, struct index_opts, range_size),
 	OPT_DEF("page_size", OPT_INT, struct index_opts, page_size),
 	OPT_DEF("run_count_per_level", OPT_INT, struct index_opts, run_count_per_level),
 	OPT_DEF("run_size_ratio", OPT_FLOAT, struct index_opts, run_size_ratio),
 	OPT_DEF("bloom_fpr", OPT_FLOAT, struct index_opts, bloom_fpr),
+	OPT_DEF("bloom_per_page", OPT_BOOL, struct index_opts, bloom_per_page),
+	OPT_DEF("compression_dict_size", OPT_INT, struct index_opts,
+		compression_dict_size),
 	OPT_DEF("lsn", OPT_INT, struct index_opts, lsn),
 	OPT_DEF("sql", OPT_STRPTR, struct index_opts, sql),
 	OPT_END,
@@ -201,9 +213,14 @@ index_def_change_requires_rebuild(struct index_def *old_index_def,
 	}
 	if (old_index_def->type == RTREE) {
 		if (old_index_def->opts.dimension != new_index_def->opts.dimension
-		    || old_index_def->opts.distance != new_index_def->opts.distance)
+		    || old_index_def->opts.distance != new_index_def->opts.distance
+		    || old_index_def->opts.coord_type !=
+		       new_index_def->opts.coord_type)
 			return true;
 	}
+	if (old_index_def->type == TREE &&
+	    old_index_def->opts.hint != new_index_def->opts.hint)
+		return true;
 	return false;
 }
 
@@ -58,6 +58,17 @@ enum rtree_index_distance_type {
 };
 extern const char *rtree_index_distance_type_strs[];
 
+enum rtree_index_coord_type {
+	/* 64-bit floating point coordinates */
+	RTREE_INDEX_COORD_TYPE_DOUBLE,
+	/* 32-bit floating point coordinates */
+	RTREE_INDEX_COORD_TYPE_FLOAT,
+	/* 32-bit integer coordinates */
+	RTREE_INDEX_COORD_TYPE_INT32,
+	rtree_index_coord_type_MAX
+};
+extern const char *rtree_index_coord_type_strs[];
+
 /** Index options */
 struct index_opts {
 	/**
@@ -65,6 +76,13 @@ struct index_opts {
 	 * index
 	 */
 	bool is_unique;
+	/**
+	 * Cache a comparison hint of the first key part next
+	 * to each tuple in a memtx TREE index. Speeds up
+	 * lookups at the cost of doubling the size of tree
+	 * elements.
+	 */
+	bool hint;
 	/**
 	 * RTREE index dimension.
 	 */
@@ -73,6 +91,10 @@ struct index_opts {
 	 * RTREE distance type.
 	 */
 	enum rtree_index_distance_type distance;
+	/**
+	 * RTREE coordinate type.
+	 */
+	enum rtree_index_coord_type coord_type;
 	/**
 	 * Vinyl index options.
 	 */
@@ -91,6 +113,19 @@ struct index_opts {
 	double run_size_ratio;
 	/* Bloom filter false positive rate. */
 	double bloom_fpr;
+	/**
+	 * Build a bloom filter per run page instead of one
+	 * filter for the whole run. Page filters are loaded
+	 * on demand, so runs that are not read don't pin
+	 * their filters in memory.
+	 */
+	bool bloom_per_page;
+	/**
+	 * Size of the zstd dictionary trained on the first
+	 * pages of each run to compress the rest of the run
+	 * with, 0 disables dictionaries.
+	 */
+	int64_t compression_dict_size;
 	/**
 	 * LSN from the time of index creation.
 	 */
@@ -128,10 +163,14 @@ index_opts_cmp(const struct index_opts *o1, const struct index_opts *o2)
 {
 	if (o1->is_unique != o2->is_unique)
 		return o1->is_unique < o2->is_unique ? -1 : 1;
+	if (o1->hint != o2->hint)
+		return o1->hint < o2->hint ? -1 : 1;
 	if (o1->dimension != o2->dimension)
 		return o1->dimension < o2->dimension ? -1 : 1;
 	if (o1->distance != o2->distance)
 		return o1->distance < o2->distance ? -1 : 1;
+	if (o1->coord_type != o2->coord_type)
+		return o1->coord_type < o2->coord_type ? -1 : 1;
 	if (o1->range_size != o2->range_size)
 		return o1->range_size < o2->range_size ? -1 : 1;
 	if (o1->page_size != o2->page_size)
@@ -143,6 +182,11 @@ index_opts_cmp(const struct index_opts *o1, const struct index_opts *o2)
 		return o1->run_size_ratio < o2->run_size_ratio ? -1 : 1;
 	if (o1->bloom_fpr != o2->bloom_fpr)
 		return o1->bloom_fpr < o2->bloom_fpr ? -1 : 1;
+	if (o1->bloom_per_page != o2->bloom_per_page)
+		return o1->bloom_per_page < o2->bloom_per_page ? -1 : 1;
+	if (o1->compression_dict_size != o2->compression_dict_size)
+		return o1->compression_dict_size <
+		       o2->compression_dict_size ? -1 : 1;
 	return 0;
 }
 
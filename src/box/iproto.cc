@@ -45,8 +45,10 @@
 #include "coio.h"
 #include "scoped_guard.h"
 #include "memory.h"
+#include "salad/stailq.h"
 
 #include "port.h"
+#include "tuple.h"
 #include "iobuf.h"
 #include "box.h"
 #include "call.h"
@@ -57,11 +59,20 @@
 #include "replication.h" /* instance_uuid */
 #include "iproto_constants.h"
 #include "rmean.h"
+#include "histogram.h"
+#include "clock.h"
 #include "execute.h"
 
 /* The number of iproto messages in flight */
 enum { IPROTO_MSG_MAX = 768 };
 
+/**
+ * SELECT responses with at least this many bytes of tuples
+ * are sent without copying the tuples to the output buffer,
+ * @sa struct iproto_zc_reply.
+ */
+enum { IPROTO_ZC_REPLY_SIZE_MIN = 64 * 1024 };
+
 void
 iproto_reset_input(struct ibuf *ibuf)
 {
@@ -121,55 +132,112 @@ struct iproto_msg: public cmsg
 	 * and the connection must be closed.
 	 */
 	bool close_connection;
+	/** Tuples of a SELECT response sent without copying. */
+	struct iproto_zc_reply *zc_reply;
+	/**
+	 * Request timeline for latency statistics, clock_monotonic():
+	 * when the request was read from the socket, when tx thread
+	 * started and finished it, and how long tx waited for WAL.
+	 */
+	double read_time;
+	double tx_begin_time;
+	double tx_end_time;
+	double wal_wait;
 };
 
-static struct mempool iproto_msg_pool;
+/* }}} */
 
-static struct iproto_msg *
-iproto_msg_new(struct iproto_connection *con)
-{
-	struct iproto_msg *msg =
-		(struct iproto_msg *) mempool_alloc_xc(&iproto_msg_pool);
-	msg->connection = con;
-	return msg;
-}
+/* {{{ iproto_zc_reply - zero-copy SELECT responses */
 
 /**
- * Resume stopped connections, if any.
+ * Tuples of a large SELECT response, sent to the client right
+ * from tuple memory. The tx thread references the tuples and
+ * writes only the response header to the output buffer. The
+ * network thread sends the tuples after the header, then
+ * returns the reply to tx, since tuple reference counters
+ * may only be changed there.
  */
-static void
-iproto_resume();
+struct iproto_zc_reply {
+	/** A message to release the tuples in tx. */
+	struct cmsg base;
+	/** Position in the output buffer to send the tuples at. */
+	struct obuf_svp svp;
+	/** Tuple data, one iovec per tuple. */
+	struct iovec *iov;
+	/** Referenced tuples. */
+	struct tuple **tuples;
+	/** The number of tuples. */
+	int count;
+	/** The number of iovecs sent so far. */
+	int iov_pos;
+	/** Link in iproto_connection::zc_replies. */
+	struct stailq_entry in_connection;
+};
 
+/**
+ * Reference tuples of a port for a zero-copy reply.
+ * Return NULL and set diag on error.
+ */
+static struct iproto_zc_reply *
+iproto_zc_reply_new(struct port *port)
+{
+	size_t size = sizeof(struct iproto_zc_reply) +
+		      port->size * (sizeof(struct iovec) +
+				    sizeof(struct tuple *));
+	struct iproto_zc_reply *reply =
+		(struct iproto_zc_reply *) malloc(size);
+	if (reply == NULL) {
+		diag_set(OutOfMemory, size, "malloc",
+			 "struct iproto_zc_reply");
+		return NULL;
+	}
+	reply->iov = (struct iovec *) (reply + 1);
+	reply->tuples = (struct tuple **) (reply->iov + port->size);
+	reply->count = 0;
+	reply->iov_pos = 0;
+	for (struct port_entry *pe = port->first; pe != NULL; pe = pe->next) {
+		if (tuple_ref(pe->tuple) != 0)
+			goto error;
+		uint32_t bsize;
+		struct iovec *iov = &reply->iov[reply->count];
+		iov->iov_base = (void *) tuple_data_range(pe->tuple, &bsize);
+		iov->iov_len = bsize;
+		reply->tuples[reply->count++] = pe->tuple;
+	}
+	return reply;
+error:
+	for (int i = 0; i < reply->count; i++)
+		tuple_unref(reply->tuples[i]);
+	free(reply);
+	return NULL;
+}
 
-static inline void
-iproto_msg_delete(struct cmsg *msg)
+/** Release tuples of a zero-copy reply. Must be called in tx. */
+static void
+iproto_zc_reply_delete(struct iproto_zc_reply *reply)
+{
+	for (int i = 0; i < reply->count; i++)
+		tuple_unref(reply->tuples[i]);
+	free(reply);
+}
+
+static void
+tx_release_zc_reply(struct cmsg *m)
 {
-	mempool_free(&iproto_msg_pool, msg);
-	iproto_resume();
+	iproto_zc_reply_delete((struct iproto_zc_reply *) m);
 }
 
+static const struct cmsg_hop zc_release_route[] = {
+	{ tx_release_zc_reply, NULL },
+};
+
 /* }}} */
 
 /* {{{ iproto connection and requests */
 
-/**
- * A single global queue for all requests in all connections. All
- * requests from all connections are processed concurrently.
- * Is also used as a queue for just established connections and to
- * execute disconnect triggers. A few notes about these triggers:
- * - they need to be run in a fiber
- * - unlike an ordinary request failure, on_connect trigger
- *   failure must lead to connection close.
- * - on_connect trigger must be processed before any other
- *   request on this connection.
- */
-static struct cpipe tx_pipe;
-static struct cpipe net_pipe;
 /* A pointer to the transaction processor cord. */
 struct cord *tx_cord;
 
-struct rmean *rmean_net;
-
 enum rmean_net_name {
 	IPROTO_SENT,
 	IPROTO_RECEIVED,
@@ -178,6 +246,141 @@ enum rmean_net_name {
 
 const char *rmean_net_strings[IPROTO_LAST] = { "SENT", "RECEIVED" };
 
+/** Request processing stages, see box.stat.net.LATENCY. */
+enum iproto_latency_stage {
+	/** From reading a request to the start of its execution. */
+	IPROTO_LATENCY_QUEUE,
+	/** Execution in tx thread, including the WAL wait. */
+	IPROTO_LATENCY_TX,
+	/** Waiting for WAL writes, a part of the execution. */
+	IPROTO_LATENCY_WAL,
+	/** From reading a request to having its reply to send. */
+	IPROTO_LATENCY_TOTAL,
+	IPROTO_LATENCY_STAGE_MAX,
+};
+
+static const char *iproto_latency_stage_strs[IPROTO_LATENCY_STAGE_MAX] = {
+	"queue", "tx", "wal", "total"
+};
+
+/**
+ * Latency histogram buckets, in microseconds: 1, 2, 5 and
+ * then ten buckets per decade up to 10 seconds.
+ */
+enum { IPROTO_LATENCY_BUCKET_COUNT = 3 + 6 * 10 + 1 };
+static int64_t iproto_latency_buckets[IPROTO_LATENCY_BUCKET_COUNT];
+
+static void
+iproto_latency_buckets_init(void)
+{
+	static const int64_t steps[] = {10, 12, 15, 20, 25, 30, 40, 50, 60, 80};
+	int64_t *bucket = iproto_latency_buckets;
+	*bucket++ = 1;
+	*bucket++ = 2;
+	*bucket++ = 5;
+	for (int64_t decade = 1; decade <= 100000; decade *= 10) {
+		for (unsigned i = 0; i < lengthof(steps); i++)
+			*bucket++ = steps[i] * decade;
+	}
+	*bucket++ = 10 * 1000 * 1000;
+	assert(bucket == iproto_latency_buckets + IPROTO_LATENCY_BUCKET_COUNT);
+}
+
+static struct histogram *
+iproto_latency_histogram_new(void)
+{
+	struct histogram *hist = histogram_new(iproto_latency_buckets,
+					       IPROTO_LATENCY_BUCKET_COUNT);
+	if (hist == NULL) {
+		tnt_raise(OutOfMemory, sizeof(*hist), "malloc",
+			  "struct histogram");
+	}
+	return hist;
+}
+
+/**
+ * Context of a single network thread. Every thread runs its own
+ * event loop. Only the first thread listens: it accepts
+ * connections and hands them out to all threads round-robin,
+ * see iproto_on_accept(). A connection is served by the thread
+ * it was handed to for the whole connection lifetime.
+ */
+struct iproto_thread {
+	/** Thread number, 0 .. iproto_threads_count - 1. */
+	int id;
+	/** The network thread. */
+	struct cord net_cord;
+	/**
+	 * A single queue for all requests in all connections
+	 * of this thread. All requests from all connections are
+	 * processed concurrently. Is also used as a queue for
+	 * just established connections and to execute disconnect
+	 * triggers. A few notes about these triggers:
+	 * - they need to be run in a fiber
+	 * - unlike an ordinary request failure, on_connect trigger
+	 *   failure must lead to connection close.
+	 * - on_connect trigger must be processed before any other
+	 *   request on this connection.
+	 */
+	struct cpipe tx_pipe;
+	/** A pipe from the tx thread to this thread. */
+	struct cpipe net_pipe;
+	/**
+	 * A pipe from the first network thread to this thread,
+	 * to pass accepted connections. Unused in the first
+	 * thread itself.
+	 */
+	struct cpipe accept_pipe;
+	/** Memory pool of iproto_msg objects of this thread. */
+	struct mempool iproto_msg_pool;
+	/** Memory pool of connections of this thread. */
+	struct mempool iproto_connection_pool;
+	/** Connections stopped due to too many requests in flight. */
+	struct rlist stopped_connections;
+	/**
+	 * Binary protocol listener. Only the one of the first
+	 * thread is bound.
+	 */
+	struct evio_service binary;
+	/** Network statistics of this thread. */
+	struct rmean *rmean;
+	/**
+	 * Request latency histograms of this thread, in
+	 * microseconds, per request type and processing stage.
+	 * Updated in the network thread only.
+	 */
+	struct histogram *latency[IPROTO_TYPE_STAT_MAX]
+				 [IPROTO_LATENCY_STAGE_MAX];
+	/**
+	 * Latency of output flush, in microseconds: how long
+	 * the oldest reply waited in an output buffer until the
+	 * buffer was completely written to the socket.
+	 */
+	struct histogram *flush_latency;
+	/*
+	 * Message routes. Every hop which returns to the network
+	 * thread must refer to net_pipe of this thread, hence the
+	 * routes are per thread.
+	 */
+	struct cmsg_hop disconnect_route[2];
+	struct cmsg_hop misc_route[2];
+	struct cmsg_hop select_route[2];
+	struct cmsg_hop process1_route[2];
+	struct cmsg_hop sql_route[2];
+	struct cmsg_hop sync_route[2];
+	struct cmsg_hop connect_route[2];
+	const struct cmsg_hop *dml_route[IPROTO_TYPE_STAT_MAX];
+};
+
+/** Network threads, iproto_threads_count in total. */
+static struct iproto_thread *iproto_threads;
+static int iproto_threads_count;
+/**
+ * The thread to hand the next accepted connection to. Used
+ * by the first network thread only.
+ */
+static int iproto_accept_next;
+
 /**
  * Context of a single client connection.
  * Interaction scheme:
@@ -249,10 +452,45 @@ struct iproto_connection
 	/* Pre-allocated disconnect msg. */
 	struct iproto_msg *disconnect;
 	struct rlist in_stop_list;
+	/** The network thread serving this connection. */
+	struct iproto_thread *iproto_thread;
+	/**
+	 * Zero-copy replies not sent yet, one queue per
+	 * output buffer, in the order of their positions.
+	 */
+	struct stailq zc_replies[2];
+	/**
+	 * For each output buffer, the time the oldest unsent
+	 * reply was put to it, or 0 if all replies are sent.
+	 */
+	double flush_start[2];
 };
 
-static struct mempool iproto_connection_pool;
-static RLIST_HEAD(stopped_connections);
+static struct iproto_msg *
+iproto_msg_new(struct iproto_connection *con)
+{
+	struct mempool *pool = &con->iproto_thread->iproto_msg_pool;
+	struct iproto_msg *msg =
+		(struct iproto_msg *) mempool_alloc_xc(pool);
+	msg->connection = con;
+	msg->zc_reply = NULL;
+	return msg;
+}
+
+/**
+ * Resume stopped connections, if any.
+ */
+static void
+iproto_resume(struct iproto_thread *iproto_thread);
+
+static inline void
+iproto_msg_delete(struct cmsg *m)
+{
+	struct iproto_msg *msg = (struct iproto_msg *) m;
+	struct iproto_thread *iproto_thread = msg->connection->iproto_thread;
+	mempool_free(&iproto_thread->iproto_msg_pool, msg);
+	iproto_resume(iproto_thread);
+}
 
 /**
  * Return true if we have not enough spare messages
@@ -260,10 +498,11 @@ static RLIST_HEAD(stopped_connections);
  * discounted: they are mostly reserved and idle.
  */
 static inline bool
-iproto_must_stop_input()
+iproto_must_stop_input(struct iproto_thread *iproto_thread)
 {
-	size_t connection_count = mempool_count(&iproto_connection_pool);
-	size_t request_count = mempool_count(&iproto_msg_pool);
+	size_t connection_count =
+		mempool_count(&iproto_thread->iproto_connection_pool);
+	size_t request_count = mempool_count(&iproto_thread->iproto_msg_pool);
 	return request_count > connection_count + IPROTO_MSG_MAX;
 }
 
@@ -274,20 +513,20 @@ iproto_must_stop_input()
  * object in the message pool.
  */
 static void
-iproto_resume()
+iproto_resume(struct iproto_thread *iproto_thread)
 {
 	/*
 	 * Most of the time we have nothing to do here: throttling
 	 * is not active.
 	 */
-	if (rlist_empty(&stopped_connections))
+	if (rlist_empty(&iproto_thread->stopped_connections))
 		return;
-	if (iproto_must_stop_input())
+	if (iproto_must_stop_input(iproto_thread))
 		return;
 
 	struct iproto_connection *con;
-	con = rlist_first_entry(&stopped_connections, struct iproto_connection,
-				in_stop_list);
+	con = rlist_first_entry(&iproto_thread->stopped_connections,
+				struct iproto_connection, in_stop_list);
 	ev_feed_event(con->loop, &con->input, EV_READ);
 }
 
@@ -318,7 +557,8 @@ iproto_connection_stop(struct iproto_connection *con)
 {
 	assert(rlist_empty(&con->in_stop_list));
 	ev_io_stop(con->loop, &con->input);
-	rlist_add_tail(&stopped_connections, &con->in_stop_list);
+	rlist_add_tail(&con->iproto_thread->stopped_connections,
+		       &con->in_stop_list);
 }
 
 /**
@@ -369,7 +609,7 @@ iproto_connection_delete(struct iproto_connection *con)
 	       con->obuf[1].iov[0].iov_base == NULL);
 	if (con->disconnect)
 		iproto_msg_delete(con->disconnect);
-	mempool_free(&iproto_connection_pool, con);
+	mempool_free(&con->iproto_thread->iproto_connection_pool, con);
 }
 
 static void
@@ -404,6 +644,32 @@ tx_fiber_init(struct session *session, uint64_t sync)
 	 */
 	fiber_set_session(fiber(), session);
 	fiber_set_user(fiber(), &session->credentials);
+	fiber_set_key(fiber(), FIBER_KEY_WAL_WAIT, NULL);
+}
+
+/**
+ * Prepare a fiber to execute a request and start
+ * timing the execution.
+ */
+static void
+tx_msg_begin(struct iproto_msg *msg)
+{
+	tx_fiber_init(msg->connection->session, msg->header.sync);
+	msg->tx_begin_time = clock_monotonic();
+	msg->wal_wait = 0;
+	fiber_set_key(fiber(), FIBER_KEY_WAL_WAIT, &msg->wal_wait);
+}
+
+/**
+ * Finish a request: fix the end of its reply in the
+ * output buffer and stop timing the execution.
+ */
+static void
+tx_msg_end(struct iproto_msg *msg)
+{
+	msg->write_end = obuf_create_svp(msg->p_obuf);
+	msg->tx_end_time = clock_monotonic();
+	fiber_set_key(fiber(), FIBER_KEY_WAL_WAIT, NULL);
 }
 
 /**
@@ -423,6 +689,17 @@ tx_process_disconnect(struct cmsg *m)
 		session_destroy(con->session);
 		con->session = NULL; /* safety */
 	}
+	/*
+	 * The connection is idle, so the network thread
+	 * doesn't touch its zero-copy replies any more.
+	 */
+	for (int i = 0; i < 2; i++) {
+		while (!stailq_empty(&con->zc_replies[i])) {
+			iproto_zc_reply_delete(stailq_shift_entry(
+				&con->zc_replies[i], struct iproto_zc_reply,
+				in_connection));
+		}
+	}
 	/*
 	 * Got to be done in iproto thread since
 	 * that's where the memory is allocated.
@@ -439,62 +716,22 @@ static void
 net_finish_disconnect(struct cmsg *m)
 {
 	struct iproto_msg *msg = (struct iproto_msg *) m;
+	struct iproto_thread *iproto_thread = msg->connection->iproto_thread;
 	/* Runs the trigger, which may yield. */
 	iproto_connection_delete(msg->connection);
-	iproto_msg_delete(msg);
+	/* The connection is gone, can't use iproto_msg_delete(). */
+	mempool_free(&iproto_thread->iproto_msg_pool, msg);
+	iproto_resume(iproto_thread);
 }
 
-static const struct cmsg_hop disconnect_route[] = {
-	{ tx_process_disconnect, &net_pipe },
-	{ net_finish_disconnect, NULL },
-};
-
-static const struct cmsg_hop misc_route[] = {
-	{ tx_process_misc, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop select_route[] = {
-	{ tx_process_select, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop process1_route[] = {
-	{ tx_process1, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop sql_route[] = {
-	{ tx_process_sql, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop *dml_route[IPROTO_TYPE_STAT_MAX] = {
-	NULL,                                   /* IPROTO_OK */
-	select_route,                           /* IPROTO_SELECT */
-	process1_route,                         /* IPROTO_INSERT */
-	process1_route,                         /* IPROTO_REPLACE */
-	process1_route,                         /* IPROTO_UPDATE */
-	process1_route,                         /* IPROTO_DELETE */
-	misc_route,                             /* IPROTO_CALL_16 */
-	misc_route,                             /* IPROTO_AUTH */
-	misc_route,                             /* IPROTO_EVAL */
-	process1_route,                         /* IPROTO_UPSERT */
-	misc_route,                             /* IPROTO_CALL */
-	sql_route,                              /* IPROTO_EXECUTE */
-};
-
-static const struct cmsg_hop sync_route[] = {
-	{ tx_process_join_subscribe, &net_pipe },
-	{ net_end_join_subscribe, NULL },
-};
-
 static struct iproto_connection *
-iproto_connection_new(const char *name, int fd)
+iproto_connection_new(struct iproto_thread *iproto_thread,
+		      const char *name, int fd)
 {
 	(void) name;
 	struct iproto_connection *con = (struct iproto_connection *)
-		mempool_alloc_xc(&iproto_connection_pool);
+		mempool_alloc_xc(&iproto_thread->iproto_connection_pool);
+	con->iproto_thread = iproto_thread;
 	con->input.data = con->output.data = con;
 	con->loop = loop();
 	ev_io_init(&con->input, iproto_connection_on_input, fd, EV_READ);
@@ -506,10 +743,13 @@ iproto_connection_new(const char *name, int fd)
 	con->p_ibuf = &con->ibuf[0];
 	con->parse_size = 0;
 	con->session = NULL;
+	stailq_create(&con->zc_replies[0]);
+	stailq_create(&con->zc_replies[1]);
+	con->flush_start[0] = con->flush_start[1] = 0;
 	rlist_create(&con->in_stop_list);
 	/* It may be very awkward to allocate at close. */
 	con->disconnect = iproto_msg_new(con);
-	cmsg_init(con->disconnect, disconnect_route);
+	cmsg_init(con->disconnect, iproto_thread->disconnect_route);
 	return con;
 }
 
@@ -554,7 +794,7 @@ iproto_connection_close(struct iproto_connection *con)
 		assert(con->disconnect != NULL);
 		struct iproto_msg *msg = con->disconnect;
 		con->disconnect = NULL;
-		cpipe_push(&tx_pipe, msg);
+		cpipe_push(&con->iproto_thread->tx_pipe, msg);
 	}
 	rlist_del(&con->in_stop_list);
 }
@@ -579,6 +819,26 @@ iproto_connection_output_by_input(struct iproto_connection *con,
 	return &con->obuf[ibuf != &con->ibuf[0]];
 }
 
+/** Zero-copy replies queued after an output buffer. */
+static inline struct stailq *
+iproto_connection_zc_replies(struct iproto_connection *con,
+			     struct obuf *obuf)
+{
+	return &con->zc_replies[obuf != &con->obuf[0]];
+}
+
+/**
+ * Return true if an output buffer has nothing to send,
+ * including tuples of zero-copy replies.
+ */
+static inline bool
+iproto_connection_output_is_empty(struct iproto_connection *con,
+				  struct obuf *obuf)
+{
+	return obuf_used(obuf) == 0 &&
+	       stailq_empty(iproto_connection_zc_replies(con, obuf));
+}
+
 /**
  * If there is no space for reading input, we can do one of the
  * following:
@@ -640,7 +900,8 @@ iproto_connection_input_buffer(struct iproto_connection *con)
 
 	struct ibuf *new_ibuf = iproto_connection_next_input(con);
 	struct obuf *new_obuf = iproto_connection_output_by_input(con, new_ibuf);
-	if (ibuf_used(new_ibuf) != 0 || obuf_used(new_obuf) != 0) {
+	if (ibuf_used(new_ibuf) != 0 ||
+	    !iproto_connection_output_is_empty(con, new_obuf)) {
 		/*
 		 * Wait until the second buffer is flushed
 		 * and becomes available for reuse.
@@ -663,7 +924,8 @@ iproto_connection_input_buffer(struct iproto_connection *con)
 		 * makes the both ibuf and obuf idle, time to trim
 		 * them.
 		 */
-		if (ibuf_used(old_ibuf) == 0 && obuf_used(old_obuf) == 0) {
+		if (ibuf_used(old_ibuf) == 0 &&
+		    iproto_connection_output_is_empty(con, old_obuf)) {
 			obuf_reset(old_obuf);
 			iproto_reset_input(old_ibuf);
 		}
@@ -680,6 +942,7 @@ static void
 iproto_decode_msg(struct iproto_msg *msg, const char **pos, const char *reqend,
 		  bool *stop_input)
 {
+	struct iproto_thread *iproto_thread = msg->connection->iproto_thread;
 	xrow_header_decode_xc(&msg->header, pos, reqend);
 	assert(*pos == reqend);
 	uint8_t type = msg->header.type;
@@ -698,31 +961,33 @@ iproto_decode_msg(struct iproto_msg *msg, const char **pos, const char *reqend,
 	case IPROTO_UPSERT:
 		xrow_decode_dml_xc(&msg->header, &msg->dml_request,
 				   dml_request_key_map(type));
-		assert(type < sizeof(dml_route)/sizeof(*dml_route));
-		cmsg_init(msg, dml_route[type]);
+		assert(type < sizeof(iproto_thread->dml_route) /
+			      sizeof(*iproto_thread->dml_route));
+		cmsg_init(msg, iproto_thread->dml_route[type]);
 		break;
 	case IPROTO_CALL_16:
 	case IPROTO_CALL:
 	case IPROTO_EVAL:
 		xrow_decode_call_xc(&msg->header, &msg->call_request);
-		cmsg_init(msg, misc_route);
+		cmsg_init(msg, iproto_thread->misc_route);
 		break;
 	case IPROTO_PING:
-		cmsg_init(msg, misc_route);
+		cmsg_init(msg, iproto_thread->misc_route);
 		break;
 	case IPROTO_JOIN:
 	case IPROTO_SUBSCRIBE:
-		cmsg_init(msg, sync_route);
+		cmsg_init(msg, iproto_thread->sync_route);
 		*stop_input = true;
 		break;
 	case IPROTO_EXECUTE:
+	case IPROTO_PREPARE:
 		xrow_decode_sql_xc(&msg->header, &msg->sql_request,
 				   &fiber()->gc);
-		cmsg_init(msg, sql_route);
+		cmsg_init(msg, iproto_thread->sql_route);
 		break;
 	case IPROTO_AUTH:
 		xrow_decode_auth_xc(&msg->header, &msg->auth_request);
-		cmsg_init(msg, misc_route);
+		cmsg_init(msg, iproto_thread->misc_route);
 		break;
 	default:
 		tnt_raise(ClientError, ER_UNKNOWN_REQUEST_TYPE,
@@ -739,6 +1004,7 @@ iproto_enqueue_batch(struct iproto_connection *con, struct ibuf *in)
 	struct obuf *p_obuf = iproto_connection_output_by_input(con, con->p_ibuf);
 	int n_requests = 0;
 	bool stop_input = false;
+	double now = clock_monotonic();
 	while (con->parse_size && stop_input == false) {
 		const char *reqstart = in->wpos - con->parse_size;
 		const char *pos = reqstart;
@@ -756,6 +1022,7 @@ iproto_enqueue_batch(struct iproto_connection *con, struct ibuf *in)
 		struct iproto_msg *msg = iproto_msg_new(con);
 		msg->p_ibuf = con->p_ibuf;
 		msg->p_obuf = p_obuf;
+		msg->read_time = now;
 		auto guard = make_scoped_guard([=] { iproto_msg_delete(msg); });
 
 		msg->len = reqend - reqstart; /* total request length */
@@ -766,7 +1033,7 @@ iproto_enqueue_batch(struct iproto_connection *con, struct ibuf *in)
 			 * This can't throw, but should not be
 			 * done in case of exception.
 			 */
-			cpipe_push_input(&tx_pipe, msg);
+			cpipe_push_input(&con->iproto_thread->tx_pipe, msg);
 			guard.is_active = false;
 			n_requests++;
 		} catch (Exception *e) {
@@ -832,7 +1099,7 @@ iproto_enqueue_batch(struct iproto_connection *con, struct ibuf *in)
 		 */
 		ev_feed_event(con->loop, &con->input, EV_READ);
 	}
-	cpipe_flush_input(&tx_pipe);
+	cpipe_flush_input(&con->iproto_thread->tx_pipe);
 }
 
 static void
@@ -851,7 +1118,7 @@ iproto_connection_on_input(ev_loop *loop, struct ev_io *watcher,
 		 * resume one more connection which might have
 		 * input.
 		 */
-		iproto_resume();
+		iproto_resume(con->iproto_thread);
 	}
 	/*
 	 * Throttle if there are too many pending requests,
@@ -860,7 +1127,7 @@ iproto_connection_on_input(ev_loop *loop, struct ev_io *watcher,
 	 * another fiber waiting for write to complete).
 	 * Ignore iproto_connection->disconnect messages.
 	 */
-	if (iproto_must_stop_input()) {
+	if (iproto_must_stop_input(con->iproto_thread)) {
 		iproto_connection_stop(con);
 		return;
 	}
@@ -883,7 +1150,7 @@ iproto_connection_on_input(ev_loop *loop, struct ev_io *watcher,
 			return;
 		}
 		/* Count statistics */
-		rmean_collect(rmean_net, IPROTO_RECEIVED, nrd);
+		rmean_collect(con->iproto_thread->rmean, IPROTO_RECEIVED, nrd);
 
 		/* Update the read position and connection state. */
 		in->wpos += nrd;
@@ -898,6 +1165,62 @@ iproto_connection_on_input(ev_loop *loop, struct ev_io *watcher,
 	}
 }
 
+/**
+ * Account the output flush latency if an output buffer
+ * has been completely written to the socket.
+ */
+static inline void
+iproto_connection_collect_flush(struct iproto_connection *con,
+				struct obuf *obuf)
+{
+	double *flush_start = &con->flush_start[obuf != &con->obuf[0]];
+	if (*flush_start == 0 || obuf->wpos.used != obuf->wend.used ||
+	    !stailq_empty(iproto_connection_zc_replies(con, obuf)))
+		return;
+	histogram_collect(con->iproto_thread->flush_latency,
+			  (clock_monotonic() - *flush_start) * 1e6);
+	*flush_start = 0;
+}
+
+/**
+ * Send tuples of a zero-copy reply, which is next to send
+ * in an output buffer, and release the reply once it's sent.
+ */
+static int
+iproto_flush_zc_reply(struct iproto_connection *con, struct ibuf *ibuf,
+		      struct obuf *obuf, struct iproto_zc_reply *reply)
+{
+	struct iovec *iov = reply->iov + reply->iov_pos;
+	ssize_t nwr = sio_writev(con->output.fd, iov,
+				 reply->count - reply->iov_pos);
+
+	/* Count statistics */
+	rmean_collect(con->iproto_thread->rmean, IPROTO_SENT, nwr);
+	if (nwr <= 0)
+		return -1;
+	size_t offset = 0;
+	reply->iov_pos += sio_move_iov(iov, nwr, &offset);
+	if (reply->iov_pos < reply->count) {
+		/* Partial write, adjust the first unsent iovec. */
+		iov = &reply->iov[reply->iov_pos];
+		iov->iov_base = (char *) iov->iov_base + offset;
+		iov->iov_len -= offset;
+		return 0;
+	}
+	struct stailq *replies = iproto_connection_zc_replies(con, obuf);
+	stailq_shift(replies);
+	cmsg_init(&reply->base, zc_release_route);
+	cpipe_push(&con->iproto_thread->tx_pipe, &reply->base);
+	if (ibuf_used(ibuf) == 0 &&
+	    iproto_connection_output_is_empty(con, obuf)) {
+		/* Quickly recycle the buffer if it's idle. */
+		obuf_reset(obuf);
+		iproto_reset_input(ibuf);
+	}
+	iproto_connection_collect_flush(con, obuf);
+	return 0;
+}
+
 /** writev() to the socket and handle the result. */
 
 static int
@@ -905,7 +1228,7 @@ iproto_flush(struct iproto_connection *con)
 {
 	struct ibuf *ibuf = iproto_connection_prev_input(con);
 	struct obuf *obuf = iproto_connection_output_by_input(con, ibuf);
-	if (obuf_used(obuf) == 0) {
+	if (iproto_connection_output_is_empty(con, obuf)) {
 		obuf = iproto_connection_output_by_input(con, con->p_ibuf);
 		/*
 		 * Don't try to write from a newer buffer if an
@@ -914,7 +1237,8 @@ iproto_flush(struct iproto_connection *con)
 		 * salad of different pieces of replies from both
 		 * buffers.
 		 */
-		if (ibuf_used(ibuf) > 0 || obuf_used(obuf) == 0)
+		if (ibuf_used(ibuf) > 0 ||
+		    iproto_connection_output_is_empty(con, obuf))
 			return 1;
 		ibuf = con->p_ibuf;
 	}
@@ -922,6 +1246,16 @@ iproto_flush(struct iproto_connection *con)
 	int fd = con->output.fd;
 	struct obuf_svp *begin = &obuf->wpos;
 	struct obuf_svp *end = &obuf->wend;
+	struct stailq *replies = iproto_connection_zc_replies(con, obuf);
+	struct iproto_zc_reply *reply = NULL;
+	if (!stailq_empty(replies)) {
+		reply = stailq_first_entry(replies, struct iproto_zc_reply,
+					   in_connection);
+		if (reply->svp.used == begin->used)
+			return iproto_flush_zc_reply(con, ibuf, obuf, reply);
+		/* Write the buffer up to the reply tuples. */
+		end = &reply->svp;
+	}
 	assert(begin->used < end->used);
 	struct iovec iov[SMALL_OBUF_IOV_MAX+1];
 	struct iovec *src = obuf->iov;
@@ -938,10 +1272,10 @@ iproto_flush(struct iproto_connection *con)
 	ssize_t nwr = sio_writev(fd, iov, iovcnt);
 
 	/* Count statistics */
-	rmean_collect(rmean_net, IPROTO_SENT, nwr);
+	rmean_collect(con->iproto_thread->rmean, IPROTO_SENT, nwr);
 	if (nwr > 0) {
 		if (begin->used + nwr == end->used) {
-			if (ibuf_used(ibuf) == 0) {
+			if (ibuf_used(ibuf) == 0 && reply == NULL) {
 				/* Quickly recycle the buffer if it's idle. */
 				assert(end->used == obuf_size(obuf));
 				/* resets wpos and wpend to zero pos */
@@ -951,6 +1285,7 @@ iproto_flush(struct iproto_connection *con)
 				/* Advance write position. */
 				*begin = *end;
 			}
+			iproto_connection_collect_flush(con, obuf);
 			return 0;
 		}
 		size_t offset = 0;
@@ -1007,7 +1342,7 @@ tx_process1(struct cmsg *m)
 	struct iproto_msg *msg = (struct iproto_msg *) m;
 	struct obuf *out = msg->p_obuf;
 
-	tx_fiber_init(msg->connection->session, msg->header.sync);
+	tx_msg_begin(msg);
 	if (tx_check_schema(msg->header.schema_version))
 		goto error;
 
@@ -1020,12 +1355,22 @@ tx_process1(struct cmsg *m)
 		goto error;
 	iproto_reply_select(out, &svp, msg->header.sync, ::schema_version,
 			    tuple != 0);
-	msg->write_end = obuf_create_svp(out);
+	tx_msg_end(msg);
 	return;
 error:
 	iproto_reply_error(out, diag_last_error(&fiber()->diag),
 			   msg->header.sync, ::schema_version);
-	msg->write_end = obuf_create_svp(out);
+	tx_msg_end(msg);
+}
+
+/** The size of tuples in a port, in bytes. */
+static size_t
+tx_port_size(struct port *port)
+{
+	size_t size = 0;
+	for (struct port_entry *pe = port->first; pe != NULL; pe = pe->next)
+		size += pe->tuple->bsize;
+	return size;
 }
 
 static void
@@ -1038,7 +1383,7 @@ tx_process_select(struct cmsg *m)
 	int rc;
 	struct request *req = &msg->dml_request;
 
-	tx_fiber_init(msg->connection->session, msg->header.sync);
+	tx_msg_begin(msg);
 
 	port_create(&port);
 	auto port_guard = make_scoped_guard([&](){ port_destroy(&port); });
@@ -1052,6 +1397,19 @@ tx_process_select(struct cmsg *m)
 			req->key, req->key_end);
 	if (rc < 0 || iproto_prepare_select(out, &svp) != 0)
 		goto error;
+	if (tx_port_size(&port) >= IPROTO_ZC_REPLY_SIZE_MIN) {
+		msg->zc_reply = iproto_zc_reply_new(&port);
+		if (msg->zc_reply == NULL) {
+			obuf_rollback_to_svp(out, &svp);
+			goto error;
+		}
+		msg->zc_reply->svp = obuf_create_svp(out);
+		iproto_reply_select_zc(out, &svp, msg->header.sync,
+				       ::schema_version, port.size,
+				       tx_port_size(&port));
+		tx_msg_end(msg);
+		return;
+	}
 	if (port_dump(&port, out) != 0) {
 		/* Discard the prepared select. */
 		obuf_rollback_to_svp(out, &svp);
@@ -1059,12 +1417,12 @@ tx_process_select(struct cmsg *m)
 	}
 	iproto_reply_select(out, &svp, msg->header.sync, ::schema_version,
 			    port.size);
-	msg->write_end = obuf_create_svp(out);
+	tx_msg_end(msg);
 	return;
 error:
 	iproto_reply_error(out, diag_last_error(&fiber()->diag),
 			   msg->header.sync, ::schema_version);
-	msg->write_end = obuf_create_svp(out);
+	tx_msg_end(msg);
 }
 
 static void
@@ -1073,7 +1431,7 @@ tx_process_misc(struct cmsg *m)
 	struct iproto_msg *msg = (struct iproto_msg *) m;
 	struct obuf *out = msg->p_obuf;
 
-	tx_fiber_init(msg->connection->session, msg->header.sync);
+	tx_msg_begin(msg);
 
 	if (tx_check_schema(msg->header.schema_version))
 		goto error;
@@ -1101,12 +1459,12 @@ tx_process_misc(struct cmsg *m)
 		iproto_reply_error(out, diag_last_error(&fiber()->diag),
 				   msg->header.sync, ::schema_version);
 	}
-	msg->write_end = obuf_create_svp(out);
+	tx_msg_end(msg);
 	return;
 error:
 	iproto_reply_error(out, diag_last_error(&fiber()->diag),
 			   msg->header.sync, ::schema_version);
-	msg->write_end = obuf_create_svp(out);
+	tx_msg_end(msg);
 }
 
 static void
@@ -1116,20 +1474,25 @@ tx_process_sql(struct cmsg *m)
 	struct obuf *out = msg->p_obuf;
 	uint64_t sync = msg->header.sync;
 
-	tx_fiber_init(msg->connection->session, sync);
+	tx_msg_begin(msg);
 
 	if (tx_check_schema(msg->header.schema_version))
 		goto error;
-	assert(msg->header.type == IPROTO_EXECUTE);
-	if (sql_prepare_and_execute(&msg->sql_request, out,
-				    &fiber()->gc) == 0) {
-		msg->write_end = obuf_create_svp(out);
+	int rc;
+	if (msg->header.type == IPROTO_EXECUTE) {
+		rc = sql_prepare_and_execute(&msg->sql_request, out);
+	} else {
+		assert(msg->header.type == IPROTO_PREPARE);
+		rc = sql_prepare(&msg->sql_request, out);
+	}
+	if (rc == 0) {
+		tx_msg_end(msg);
 		return;
 	}
 error:
 	iproto_reply_error(out, diag_last_error(&fiber()->diag), sync,
 			   ::schema_version);
-	msg->write_end = obuf_create_svp(out);
+	tx_msg_end(msg);
 }
 
 static void
@@ -1169,14 +1532,47 @@ tx_process_join_subscribe(struct cmsg *m)
 	}
 }
 
+/**
+ * Account a request, which reply is ready to be sent,
+ * in the latency statistics of the network thread.
+ */
+static void
+net_collect_latency(struct iproto_msg *msg, double now)
+{
+	uint32_t type = msg->header.type;
+	if (type == IPROTO_CALL_16)
+		type = IPROTO_CALL;
+	if (type >= IPROTO_TYPE_STAT_MAX)
+		return;
+	struct histogram **latency =
+		msg->connection->iproto_thread->latency[type];
+	histogram_collect(latency[IPROTO_LATENCY_QUEUE],
+			  (msg->tx_begin_time - msg->read_time) * 1e6);
+	histogram_collect(latency[IPROTO_LATENCY_TX],
+			  (msg->tx_end_time - msg->tx_begin_time) * 1e6);
+	histogram_collect(latency[IPROTO_LATENCY_WAL], msg->wal_wait * 1e6);
+	histogram_collect(latency[IPROTO_LATENCY_TOTAL],
+			  (now - msg->read_time) * 1e6);
+}
+
 static void
 net_send_msg(struct cmsg *m)
 {
 	struct iproto_msg *msg = (struct iproto_msg *) m;
 	struct iproto_connection *con = msg->connection;
+	double now = clock_monotonic();
+	net_collect_latency(msg, now);
+	double *flush_start = &con->flush_start[msg->p_obuf != &con->obuf[0]];
+	if (*flush_start == 0)
+		*flush_start = now;
 	/* Discard request (see iproto_enqueue_batch()) */
 	msg->p_ibuf->rpos += msg->len;
 	msg->p_obuf->wend = msg->write_end;
+	if (msg->zc_reply != NULL) {
+		stailq_add_tail_entry(iproto_connection_zc_replies(con,
+							msg->p_obuf),
+				      msg->zc_reply, in_connection);
+	}
 
 	if (evio_has_fd(&con->output)) {
 		if (! ev_is_active(&con->output))
@@ -1254,7 +1650,7 @@ net_send_greeting(struct cmsg *m)
 						 obuf_iovcnt(out));
 
 			/* Count statistics */
-			rmean_collect(rmean_net, IPROTO_SENT, nwr);
+			rmean_collect(con->iproto_thread->rmean, IPROTO_SENT, nwr);
 		} catch (Exception *e) {
 			e->log();
 		}
@@ -1275,19 +1671,15 @@ net_send_greeting(struct cmsg *m)
 	iproto_msg_delete(msg);
 }
 
-static const struct cmsg_hop connect_route[] = {
-	{ tx_process_connect, &net_pipe },
-	{ net_send_greeting, NULL },
-};
-
 /** }}} */
 
 /**
- * Create a connection and start input.
+ * Create a connection in the current network thread and start
+ * input.
  */
 static void
-iproto_on_accept(struct evio_service * /* service */, int fd,
-		 struct sockaddr *addr, socklen_t addrlen)
+iproto_connection_start(struct iproto_thread *iproto_thread, int fd,
+			struct sockaddr *addr, socklen_t addrlen)
 {
 	char name[SERVICE_NAME_MAXLEN];
 	snprintf(name, sizeof(name), "%s/%s", "iobuf",
@@ -1295,83 +1687,245 @@ iproto_on_accept(struct evio_service * /* service */, int fd,
 
 	struct iproto_connection *con;
 
-	con = iproto_connection_new(name, fd);
+	con = iproto_connection_new(iproto_thread, name, fd);
 	/*
 	 * Ignore msg allocation failure - the queue size is
 	 * fixed so there is a limited number of msgs in
 	 * use, all stored in just a few blocks of the memory pool.
 	 */
 	struct iproto_msg *msg = iproto_msg_new(con);
-	cmsg_init(msg, connect_route);
+	cmsg_init(msg, iproto_thread->connect_route);
 	msg->p_ibuf = con->p_ibuf;
 	msg->p_obuf = iproto_connection_output_by_input(con, con->p_ibuf);
 	msg->close_connection = false;
-	cpipe_push(&tx_pipe, msg);
+	cpipe_push(&iproto_thread->tx_pipe, msg);
+}
+
+/**
+ * A connection accepted by the first network thread and
+ * passed to another network thread.
+ */
+struct iproto_accept_msg {
+	struct cmsg base;
+	/** The thread to serve the connection. */
+	struct iproto_thread *iproto_thread;
+	int fd;
+	struct sockaddr_storage addr;
+	socklen_t addrlen;
+};
+
+static void
+iproto_on_accept_msg(struct cmsg *m)
+{
+	struct iproto_accept_msg *msg = (struct iproto_accept_msg *) m;
+	try {
+		iproto_connection_start(msg->iproto_thread, msg->fd,
+					(struct sockaddr *) &msg->addr,
+					msg->addrlen);
+	} catch (Exception *e) {
+		close(msg->fd);
+		e->log();
+	}
+	free(msg);
+}
+
+static const struct cmsg_hop iproto_accept_route[] = {
+	{ iproto_on_accept_msg, NULL },
+};
+
+/**
+ * Hand an accepted connection out to the next network thread.
+ * Threads polling a shared listening socket would not balance
+ * the load: the first thread to wake up accepts all pending
+ * connections.
+ */
+static void
+iproto_on_accept(struct evio_service * /* service */, int fd,
+		 struct sockaddr *addr, socklen_t addrlen)
+{
+	struct iproto_thread *iproto_thread =
+		&iproto_threads[iproto_accept_next];
+	iproto_accept_next = (iproto_accept_next + 1) % iproto_threads_count;
+	if (iproto_thread->id == 0)
+		return iproto_connection_start(iproto_thread, fd,
+					       addr, addrlen);
+	struct iproto_accept_msg *msg =
+		(struct iproto_accept_msg *) malloc(sizeof(*msg));
+	if (msg == NULL) {
+		/*
+		 * Don't raise: the connection is lost anyway,
+		 * close the socket here so that it isn't leaked
+		 * and can't be closed twice.
+		 */
+		close(fd);
+		diag_set(OutOfMemory, sizeof(*msg), "malloc",
+			 "struct iproto_accept_msg");
+		diag_log();
+		return;
+	}
+	cmsg_init(&msg->base, iproto_accept_route);
+	msg->iproto_thread = iproto_thread;
+	msg->fd = fd;
+	memcpy(&msg->addr, addr, addrlen);
+	msg->addrlen = addrlen;
+	cpipe_push(&iproto_thread->accept_pipe, &msg->base);
 }
 
-static struct evio_service binary; /* iproto binary listener */
+/**
+ * Name of the cbus endpoint of a network thread, the tx thread
+ * pipe to the network thread connects to it.
+ */
+static const char *
+iproto_thread_endpoint_name(struct iproto_thread *iproto_thread)
+{
+	return tt_sprintf("net.%d", iproto_thread->id);
+}
 
 /**
  * The network io thread main function:
  * begin serving the message bus.
  */
 static int
-net_cord_f(va_list /* ap */)
+net_cord_f(va_list ap)
 {
+	struct iproto_thread *iproto_thread =
+		va_arg(ap, struct iproto_thread *);
 	/* Got to be called in every thread using iobuf */
 	iobuf_init();
-	mempool_create(&iproto_msg_pool, &cord()->slabc,
+	mempool_create(&iproto_thread->iproto_msg_pool, &cord()->slabc,
 		       sizeof(struct iproto_msg));
-	mempool_create(&iproto_connection_pool, &cord()->slabc,
+	mempool_create(&iproto_thread->iproto_connection_pool, &cord()->slabc,
 		       sizeof(struct iproto_connection));
 
-	evio_service_init(loop(), &binary, "binary",
-			  iproto_on_accept, NULL);
+	evio_service_init(loop(), &iproto_thread->binary, "binary",
+			  iproto_on_accept, iproto_thread);
 
 
 	/* Init statistics counter */
-	rmean_net = rmean_new(rmean_net_strings, IPROTO_LAST);
+	iproto_thread->rmean = rmean_new(rmean_net_strings, IPROTO_LAST);
 
-	if (rmean_net == NULL) {
+	if (iproto_thread->rmean == NULL) {
 		tnt_raise(OutOfMemory, sizeof(struct rmean),
 			  "rmean", "struct rmean");
 	}
+	for (int type = 0; type < IPROTO_TYPE_STAT_MAX; type++) {
+		for (int stage = 0; stage < IPROTO_LATENCY_STAGE_MAX; stage++) {
+			iproto_thread->latency[type][stage] =
+				iproto_latency_histogram_new();
+		}
+	}
+	iproto_thread->flush_latency = iproto_latency_histogram_new();
 
 	struct cbus_endpoint endpoint;
 	/* Create "net" endpoint. */
-	cbus_endpoint_create(&endpoint, "net", fiber_schedule_cb, fiber());
+	cbus_endpoint_create(&endpoint,
+			     iproto_thread_endpoint_name(iproto_thread),
+			     fiber_schedule_cb, fiber());
 	/* Create a pipe to "tx" thread. */
-	cpipe_create(&tx_pipe, "tx");
-	cpipe_set_max_input(&tx_pipe, IPROTO_MSG_MAX/2);
+	cpipe_create(&iproto_thread->tx_pipe, "tx");
+	cpipe_set_max_input(&iproto_thread->tx_pipe, IPROTO_MSG_MAX/2);
+	/* The first thread passes connections to the others. */
+	if (iproto_thread->id == 0) {
+		for (int i = 1; i < iproto_threads_count; i++) {
+			cpipe_create(&iproto_threads[i].accept_pipe,
+				     iproto_thread_endpoint_name(
+					&iproto_threads[i]));
+		}
+	}
 	/* Process incomming messages. */
 	cbus_loop(&endpoint);
 
-	cpipe_destroy(&tx_pipe);
+	if (iproto_thread->id == 0) {
+		for (int i = 1; i < iproto_threads_count; i++)
+			cpipe_destroy(&iproto_threads[i].accept_pipe);
+	}
+	cpipe_destroy(&iproto_thread->tx_pipe);
 	/*
 	 * Nothing to do in the fiber so far, the service
 	 * will take care of creating events for incoming
 	 * connections.
 	 */
-	if (evio_service_is_active(&binary))
-		evio_service_stop(&binary);
+	if (evio_service_is_active(&iproto_thread->binary))
+		evio_service_stop(&iproto_thread->binary);
 
-	rmean_delete(rmean_net);
+	rmean_delete(iproto_thread->rmean);
+	for (int type = 0; type < IPROTO_TYPE_STAT_MAX; type++) {
+		for (int stage = 0; stage < IPROTO_LATENCY_STAGE_MAX; stage++)
+			histogram_delete(iproto_thread->latency[type][stage]);
+	}
+	histogram_delete(iproto_thread->flush_latency);
 	return 0;
 }
 
-/** Initialize the iproto subsystem and start network io thread */
+/** Set up message routes of a network thread. */
+static void
+iproto_thread_init_routes(struct iproto_thread *iproto_thread)
+{
+	struct cpipe *net_pipe = &iproto_thread->net_pipe;
+
+	iproto_thread->disconnect_route[0] =
+		{ tx_process_disconnect, net_pipe };
+	iproto_thread->disconnect_route[1] = { net_finish_disconnect, NULL };
+	iproto_thread->misc_route[0] = { tx_process_misc, net_pipe };
+	iproto_thread->misc_route[1] = { net_send_msg, NULL };
+	iproto_thread->select_route[0] = { tx_process_select, net_pipe };
+	iproto_thread->select_route[1] = { net_send_msg, NULL };
+	iproto_thread->process1_route[0] = { tx_process1, net_pipe };
+	iproto_thread->process1_route[1] = { net_send_msg, NULL };
+	iproto_thread->sql_route[0] = { tx_process_sql, net_pipe };
+	iproto_thread->sql_route[1] = { net_send_msg, NULL };
+	iproto_thread->sync_route[0] = { tx_process_join_subscribe, net_pipe };
+	iproto_thread->sync_route[1] = { net_end_join_subscribe, NULL };
+	iproto_thread->connect_route[0] = { tx_process_connect, net_pipe };
+	iproto_thread->connect_route[1] = { net_send_greeting, NULL };
+
+	const struct cmsg_hop **dml_route = iproto_thread->dml_route;
+	dml_route[IPROTO_OK] = NULL;
+	dml_route[IPROTO_SELECT] = iproto_thread->select_route;
+	dml_route[IPROTO_INSERT] = iproto_thread->process1_route;
+	dml_route[IPROTO_REPLACE] = iproto_thread->process1_route;
+	dml_route[IPROTO_UPDATE] = iproto_thread->process1_route;
+	dml_route[IPROTO_DELETE] = iproto_thread->process1_route;
+	dml_route[IPROTO_CALL_16] = iproto_thread->misc_route;
+	dml_route[IPROTO_AUTH] = iproto_thread->misc_route;
+	dml_route[IPROTO_EVAL] = iproto_thread->misc_route;
+	dml_route[IPROTO_UPSERT] = iproto_thread->process1_route;
+	dml_route[IPROTO_CALL] = iproto_thread->misc_route;
+	dml_route[IPROTO_EXECUTE] = iproto_thread->sql_route;
+	dml_route[IPROTO_PREPARE] = iproto_thread->sql_route;
+}
+
+/** Initialize the iproto subsystem and start network io threads */
 void
-iproto_init()
+iproto_init(int threads_count)
 {
+	assert(threads_count > 0 && threads_count <= IPROTO_THREADS_MAX);
 	tx_cord = cord();
-
-	static struct cord net_cord;
-	if (cord_costart(&net_cord, "iproto", net_cord_f, NULL))
-		panic("failed to initialize iproto thread");
-
-	/* Create a pipe to "net" thread. */
-	cpipe_create(&net_pipe, "net");
-	cpipe_set_max_input(&net_pipe, IPROTO_MSG_MAX/2);
+	iproto_latency_buckets_init();
+
+	iproto_threads_count = threads_count;
+	iproto_threads = (struct iproto_thread *)
+		calloc(threads_count, sizeof(*iproto_threads));
+	if (iproto_threads == NULL)
+		panic("failed to allocate iproto threads");
+
+	for (int i = 0; i < threads_count; i++) {
+		struct iproto_thread *iproto_thread = &iproto_threads[i];
+		iproto_thread->id = i;
+		rlist_create(&iproto_thread->stopped_connections);
+		iproto_thread_init_routes(iproto_thread);
+
+		const char *name = i == 0 ? "iproto" : tt_sprintf("iproto.%d", i);
+		if (cord_costart(&iproto_thread->net_cord, name,
+				 net_cord_f, iproto_thread))
+			panic("failed to initialize iproto thread");
+
+		/* Create a pipe to "net" thread. */
+		cpipe_create(&iproto_thread->net_pipe,
+			     iproto_thread_endpoint_name(iproto_thread));
+		cpipe_set_max_input(&iproto_thread->net_pipe,
+				    IPROTO_MSG_MAX/2);
+	}
 }
 
 /**
@@ -1383,17 +1937,25 @@ iproto_init()
 struct iproto_bind_msg: public cbus_call_msg
 {
 	const char *uri;
+	/** The network thread to run the call in. */
+	struct iproto_thread *iproto_thread;
 };
 
+/**
+ * Bind the listening socket. Only the first network thread
+ * listens, see iproto_on_accept().
+ */
 static int
 iproto_do_bind(struct cbus_call_msg *m)
 {
 	const char *uri  = ((struct iproto_bind_msg *) m)->uri;
+	struct evio_service *binary =
+		&((struct iproto_bind_msg *) m)->iproto_thread->binary;
 	try {
-		if (evio_service_is_active(&binary))
-			evio_service_stop(&binary);
+		if (evio_service_is_active(binary))
+			evio_service_stop(binary);
 		if (uri != NULL)
-			evio_service_bind(&binary, uri);
+			evio_service_bind(binary, uri);
 	} catch (Exception *e) {
 		return -1;
 	}
@@ -1403,34 +1965,127 @@ iproto_do_bind(struct cbus_call_msg *m)
 static int
 iproto_do_listen(struct cbus_call_msg *m)
 {
-	(void) m;
+	struct evio_service *binary =
+		&((struct iproto_bind_msg *) m)->iproto_thread->binary;
 	try {
-		if (evio_service_is_active(&binary))
-			evio_service_listen(&binary);
+		if (evio_service_is_active(binary))
+			evio_service_listen(binary);
 	} catch (Exception *e) {
 		return -1;
 	}
 	return 0;
 }
 
-void
-iproto_bind(const char *uri)
+/** Run a function in a network thread and wait for the result. */
+static void
+iproto_thread_call(struct iproto_thread *iproto_thread,
+		   cbus_call_f func, const char *uri)
 {
+	/* Declare static to avoid stack corruption on fiber cancel. */
 	static struct iproto_bind_msg m;
 	m.uri = uri;
-	if (cbus_call(&net_pipe, &tx_pipe, &m, iproto_do_bind,
-		      NULL, TIMEOUT_INFINITY))
+	m.iproto_thread = iproto_thread;
+	if (cbus_call(&iproto_thread->net_pipe, &iproto_thread->tx_pipe,
+		      &m, func, NULL, TIMEOUT_INFINITY))
 		diag_raise();
 }
 
+void
+iproto_bind(const char *uri)
+{
+	iproto_thread_call(&iproto_threads[0], iproto_do_bind, uri);
+}
+
 void
 iproto_listen()
 {
-	/* Declare static to avoid stack corruption on fiber cancel. */
-	static struct cbus_call_msg m;
-	if (cbus_call(&net_pipe, &tx_pipe, &m, iproto_do_listen,
-		      NULL, TIMEOUT_INFINITY))
-		diag_raise();
+	iproto_thread_call(&iproto_threads[0], iproto_do_listen, NULL);
+}
+
+/**
+ * Aggregate a latency histogram over all network threads and
+ * pass its percentiles to a callback. @a type is -1 for the
+ * output flush latency. Histograms without observations are
+ * skipped.
+ */
+static int
+iproto_latency_report(int type, int stage, iproto_latency_cb cb,
+		      void *cb_ctx)
+{
+	struct histogram *hist = histogram_new(iproto_latency_buckets,
+					       IPROTO_LATENCY_BUCKET_COUNT);
+	if (hist == NULL) {
+		diag_set(OutOfMemory, sizeof(*hist), "malloc",
+			 "struct histogram");
+		return -1;
+	}
+	for (int i = 0; i < iproto_threads_count; i++) {
+		struct iproto_thread *iproto_thread = &iproto_threads[i];
+		struct histogram *src = type < 0 ?
+			iproto_thread->flush_latency :
+			iproto_thread->latency[type][stage];
+		if (src != NULL)
+			histogram_merge(hist, src);
+	}
+	int rc = 0;
+	if (hist->total > 0) {
+		rc = cb(type < 0 ? "FLUSH" : iproto_type_strs[type],
+			type < 0 ? NULL : iproto_latency_stage_strs[stage],
+			histogram_percentile(hist, 50) / 1e6,
+			histogram_percentile(hist, 99) / 1e6,
+			histogram_percentile(hist, 99.9) / 1e6, cb_ctx);
+	}
+	histogram_delete(hist);
+	return rc;
+}
+
+extern "C" int
+iproto_latency_foreach(iproto_latency_cb cb, void *cb_ctx)
+{
+	for (int type = 0; type < IPROTO_TYPE_STAT_MAX; type++) {
+		if (iproto_type_strs[type] == NULL)
+			continue;
+		for (int stage = 0; stage < IPROTO_LATENCY_STAGE_MAX; stage++) {
+			int rc = iproto_latency_report(type, stage, cb, cb_ctx);
+			if (rc != 0)
+				return rc;
+		}
+	}
+	return iproto_latency_report(-1, 0, cb, cb_ctx);
+}
+
+extern "C" int
+iproto_thread_count(void)
+{
+	return iproto_threads_count;
+}
+
+extern "C" size_t
+iproto_thread_connection_count(int id)
+{
+	assert(id >= 0 && id < iproto_threads_count);
+	/*
+	 * The pool is updated by the network thread, the value
+	 * may be a bit stale, which is fine for statistics.
+	 */
+	return mempool_count(&iproto_threads[id].iproto_connection_pool);
+}
+
+extern "C" int
+iproto_rmean_foreach(rmean_cb cb, void *cb_ctx)
+{
+	for (int name = 0; name < IPROTO_LAST; name++) {
+		int64_t rps = 0, total = 0;
+		for (int i = 0; i < iproto_threads_count; i++) {
+			struct rmean *rmean = iproto_threads[i].rmean;
+			rps += rmean_mean(rmean, name);
+			total += rmean_total(rmean, name);
+		}
+		int rc = cb(rmean_net_strings[name], rps, total, cb_ctx);
+		if (rc != 0)
+			return rc;
+	}
+	return 0;
 }
 
 /* vim: set foldmethod=marker */
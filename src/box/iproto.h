@@ -30,8 +30,61 @@
  * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
  * SUCH DAMAGE.
  */
+#include "rmean.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/** Max number of network threads, box.cfg.iproto_threads. */
+enum { IPROTO_THREADS_MAX = 1000 };
+
+/**
+ * Invoke a callback for each network statistics counter,
+ * aggregated over all network threads.
+ */
+int
+iproto_rmean_foreach(rmean_cb cb, void *cb_ctx);
+
+/**
+ * A callback invoked with request latency percentiles, in
+ * seconds, for a request @a type and processing @a stage.
+ * @a stage is NULL for the output flush latency, which is
+ * not split by request type ("FLUSH").
+ */
+typedef int
+(*iproto_latency_cb)(const char *type, const char *stage, double p50,
+		     double p99, double p999, void *cb_ctx);
+
+/**
+ * Invoke a callback for each request type and processing
+ * stage having latency observations, aggregated over all
+ * network threads. Return -1 and set diag on memory error,
+ * the callback return code if it's not 0, or 0.
+ */
+int
+iproto_latency_foreach(iproto_latency_cb cb, void *cb_ctx);
+
+/** Number of network threads, box.cfg.iproto_threads. */
+int
+iproto_thread_count(void);
+
+/**
+ * Number of client connections served by network thread
+ * @a id, 0 .. iproto_thread_count() - 1.
+ */
+size_t
+iproto_thread_connection_count(int id);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+
+/**
+ * Start @a threads_count network threads. Client connections
+ * are spread across the threads.
+ */
 void
-iproto_init();
+iproto_init(int threads_count);
 
 void
 iproto_bind(const char *uri);
@@ -39,4 +92,6 @@ iproto_bind(const char *uri);
 void
 iproto_listen();
 
+#endif /* defined(__cplusplus) */
+
 #endif
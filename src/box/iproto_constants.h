@@ -112,6 +112,8 @@ enum iproto_key {
 	 */
 	IPROTO_SQL_INFO = 0x43,
 	IPROTO_SQL_ROW_COUNT = 0x44,
+	/** Id of a prepared SQL statement, see IPROTO_PREPARE. */
+	IPROTO_SQL_STMT_ID = 0x45,
 	IPROTO_KEY_MAX
 };
 
@@ -176,6 +178,8 @@ enum iproto_type {
 	IPROTO_CALL = 10,
 	/** Execute an SQL statement. */
 	IPROTO_EXECUTE = 11,
+	/** Prepare an SQL statement for execution by id. */
+	IPROTO_PREPARE = 12,
 	/** The maximum typecode used for box.stat() */
 	IPROTO_TYPE_STAT_MAX,
 
@@ -192,6 +196,8 @@ enum iproto_type {
 	VY_INDEX_PAGE_INFO = 101,
 	/** Vinyl row index stored in .run file */
 	VY_RUN_ROW_INDEX = 102,
+	/** Vinyl page bloom filter stored in .run file */
+	VY_RUN_PAGE_BLOOM = 103,
 
 	/**
 	 * Error codes = (IPROTO_TYPE_ERROR | ER_XXX from errcode.h)
@@ -219,6 +225,8 @@ iproto_type_name(uint32_t type)
 		return "PAGEINFO";
 	case VY_RUN_ROW_INDEX:
 		return "ROWINDEX";
+	case VY_RUN_PAGE_BLOOM:
+		return "PAGEBLOOM";
 	default:
 		return NULL;
 	}
@@ -320,6 +328,12 @@ enum vy_run_info_key {
 	VY_RUN_INFO_PAGE_COUNT = 5,
 	/** Bloom filter for keys. */
 	VY_RUN_INFO_BLOOM = 6,
+	/**
+	 * Zstd dictionary trained on the run data and the run
+	 * file offset from which transactions are compressed
+	 * with it. Optional.
+	 */
+	VY_RUN_INFO_DICT = 7,
 	/** The last key in this enum + 1 */
 	VY_RUN_INFO_KEY_MAX
 };
@@ -354,6 +368,11 @@ enum vy_page_info_key {
 	VY_PAGE_INFO_MIN_KEY = 5,
 	/** Offset of the row index in the page. */
 	VY_PAGE_INFO_ROW_INDEX_OFFSET = 6,
+	/**
+	 * Offset, size and unpacked size of the page bloom
+	 * filter in the run file. Optional.
+	 */
+	VY_PAGE_INFO_BLOOM = 7,
 	/** The last key in this enum + 1 */
 	VY_PAGE_INFO_KEY_MAX
 };
@@ -395,6 +414,30 @@ vy_row_index_key_name(enum vy_row_index_key key)
 	return vy_row_index_key_strs[key];
 }
 
+/**
+ * Xrow keys for Vinyl page bloom filter.
+ * @sa struct vy_page_info.
+ */
+enum vy_page_bloom_key {
+	/** Bloom filter of keys stored in the page. */
+	VY_PAGE_BLOOM_DATA = 1,
+	/** The last key in this enum + 1 */
+	VY_PAGE_BLOOM_KEY_MAX
+};
+
+/**
+ * Return vy_page_bloom key name by @a key code.
+ * @param key key
+ */
+static inline const char *
+vy_page_bloom_key_name(enum vy_page_bloom_key key)
+{
+	if (key <= 0 || key >= VY_PAGE_BLOOM_KEY_MAX)
+		return NULL;
+	extern const char *vy_page_bloom_key_strs[];
+	return vy_page_bloom_key_strs[key];
+}
+
 #if defined(__cplusplus)
 } /* extern "C" */
 #endif
@@ -218,6 +218,72 @@ lbox_cfg_set_replication_timeout(struct lua_State *L)
 	return 0;
 }
 
+static int
+lbox_cfg_set_replication_apply_batch(struct lua_State *L)
+{
+	try {
+		box_set_replication_apply_batch();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
+static int
+lbox_cfg_set_snap_write_threads(struct lua_State *L)
+{
+	try {
+		box_set_snap_write_threads();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
+static int
+lbox_cfg_set_hotspot_sample_rate(struct lua_State *L)
+{
+	try {
+		box_set_hotspot_sample_rate();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
+static int
+lbox_cfg_set_wal_commit_delay(struct lua_State *L)
+{
+	try {
+		box_set_wal_commit_delay();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
+static int
+lbox_cfg_set_wal_max_batch_rows(struct lua_State *L)
+{
+	try {
+		box_set_wal_max_batch_rows();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
+static int
+lbox_cfg_set_wal_max_batch_bytes(struct lua_State *L)
+{
+	try {
+		box_set_wal_max_batch_bytes();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
 void
 box_lua_cfg_init(struct lua_State *L)
 {
@@ -238,6 +304,12 @@ box_lua_cfg_init(struct lua_State *L)
 		{"cfg_set_vinyl_max_tuple_size", lbox_cfg_set_vinyl_max_tuple_size},
 		{"cfg_set_vinyl_timeout", lbox_cfg_set_vinyl_timeout},
 		{"cfg_set_replication_timeout", lbox_cfg_set_replication_timeout},
+		{"cfg_set_replication_apply_batch", lbox_cfg_set_replication_apply_batch},
+		{"cfg_set_snap_write_threads", lbox_cfg_set_snap_write_threads},
+		{"cfg_set_hotspot_sample_rate", lbox_cfg_set_hotspot_sample_rate},
+		{"cfg_set_wal_commit_delay", lbox_cfg_set_wal_commit_delay},
+		{"cfg_set_wal_max_batch_rows", lbox_cfg_set_wal_max_batch_rows},
+		{"cfg_set_wal_max_batch_bytes", lbox_cfg_set_wal_max_batch_bytes},
 		{NULL, NULL}
 	};
 
@@ -12,6 +12,7 @@ local default_cfg = {
     memtx_memory        = 256 * 1024 *1024,
     memtx_min_tuple_size = 16,
     memtx_max_tuple_size = 1024 * 1024,
+    memtx_use_mvcc_engine = false,
     slab_alloc_factor   = 1.05,
     work_dir            = nil,
     memtx_dir           = ".",
@@ -20,6 +21,7 @@ local default_cfg = {
     vinyl_dir           = '.',
     vinyl_memory        = 128 * 1024 * 1024,
     vinyl_cache         = 128 * 1024 * 1024,
+    vinyl_page_cache    = 64 * 1024 * 1024,
     vinyl_max_tuple_size = 1024 * 1024,
     vinyl_read_threads  = 1,
     vinyl_write_threads = 2,
@@ -29,16 +31,29 @@ local default_cfg = {
     vinyl_range_size          = 1024 * 1024 * 1024,
     vinyl_page_size           = 8 * 1024,
     vinyl_bloom_fpr           = 0.05,
+    vinyl_compression_level   = 3,
     log                 = nil,
     log_nonblock        = true,
     log_level           = 5,
+    log_async           = false,
     io_collect_interval = nil,
     readahead           = 16320,
+    iproto_threads      = 1,
     snap_io_rate_limit  = nil, -- no limit
+    snap_compression_level = 3,
+    snap_write_threads  = 1,
+    snap_read_threads   = 1,
     too_long_threshold  = 0.5,
+    hotspot_sample_rate = 0,
     wal_mode            = "write",
     rows_per_wal        = 500000,
     wal_max_size        = 256 * 1024 * 1024,
+    wal_preallocate     = false,
+    wal_commit_delay    = 0,
+    wal_max_batch_rows  = 4096,
+    wal_max_batch_bytes = 4 * 1024 * 1024,
+    wal_relay_buffer_size = 16 * 1024 * 1024,
+    wal_compression_level = 3,
     wal_dir_rescan_delay= 2,
     force_recovery      = false,
     replication         = nil,
@@ -53,6 +68,7 @@ local default_cfg = {
     checkpoint_count    = 2,
     worker_pool_threads = 4,
     replication_timeout = 1,
+    replication_apply_batch = 1,
 }
 
 -- types of available options
@@ -62,6 +78,7 @@ local template_cfg = {
     memtx_memory        = 'number',
     memtx_min_tuple_size  = 'number',
     memtx_max_tuple_size  = 'number',
+    memtx_use_mvcc_engine = 'boolean',
     slab_alloc_factor   = 'number',
     work_dir            = 'string',
     memtx_dir            = 'string',
@@ -69,6 +86,7 @@ local template_cfg = {
     vinyl_dir           = 'string',
     vinyl_memory        = 'number',
     vinyl_cache               = 'number',
+    vinyl_page_cache          = 'number',
     vinyl_max_tuple_size      = 'number',
     vinyl_read_threads        = 'number',
     vinyl_write_threads       = 'number',
@@ -78,17 +96,30 @@ local template_cfg = {
     vinyl_range_size          = 'number',
     vinyl_page_size           = 'number',
     vinyl_bloom_fpr           = 'number',
+    vinyl_compression_level   = 'number',
 
     log              = 'string',
     log_nonblock     = 'boolean',
     log_level           = 'number',
+    log_async           = 'boolean',
     io_collect_interval = 'number',
     readahead           = 'number',
+    iproto_threads      = 'number',
     snap_io_rate_limit  = 'number',
+    snap_compression_level = 'number',
+    snap_write_threads  = 'number',
+    snap_read_threads   = 'number',
     too_long_threshold  = 'number',
+    hotspot_sample_rate = 'number',
     wal_mode            = 'string',
     rows_per_wal        = 'number',
     wal_max_size        = 'number',
+    wal_preallocate     = 'boolean',
+    wal_commit_delay    = 'number',
+    wal_max_batch_rows  = 'number',
+    wal_max_batch_bytes = 'number',
+    wal_relay_buffer_size = 'number',
+    wal_compression_level = 'number',
     wal_dir_rescan_delay= 'number',
     force_recovery      = 'boolean',
     replication         = 'string, number, table',
@@ -103,6 +134,7 @@ local template_cfg = {
     hot_standby         = 'boolean',
     worker_pool_threads = 'number',
     replication_timeout = 'number',
+    replication_apply_batch = 'number',
 }
 
 local function normalize_uri(port)
@@ -153,6 +185,7 @@ local dynamic_cfg = {
     io_collect_interval     = private.cfg_set_io_collect_interval,
     readahead               = private.cfg_set_readahead,
     too_long_threshold      = private.cfg_set_too_long_threshold,
+    hotspot_sample_rate     = private.cfg_set_hotspot_sample_rate,
     snap_io_rate_limit      = private.cfg_set_snap_io_rate_limit,
     read_only               = private.cfg_set_read_only,
     memtx_max_tuple_size    = private.cfg_set_memtx_max_tuple_size,
@@ -168,6 +201,11 @@ local dynamic_cfg = {
     end,
     force_recovery          = function() end,
     replication_timeout     = private.cfg_set_replication_timeout,
+    replication_apply_batch = private.cfg_set_replication_apply_batch,
+    snap_write_threads      = private.cfg_set_snap_write_threads,
+    wal_commit_delay        = private.cfg_set_wal_commit_delay,
+    wal_max_batch_rows      = private.cfg_set_wal_max_batch_rows,
+    wal_max_batch_bytes     = private.cfg_set_wal_max_batch_bytes,
 }
 
 local dynamic_cfg_skip_at_load = {
@@ -479,13 +479,17 @@ end
 -- This is the map.
 local index_options = {
     unique = 'boolean',
+    hint = 'boolean',
     dimension = 'number',
     distance = 'string',
+    coord_type = 'string',
     run_count_per_level = 'number',
     run_size_ratio = 'number',
     range_size = 'number',
     page_size = 'number',
     bloom_fpr = 'number',
+    bloom_per_page = 'boolean',
+    compression_dict_size = 'number',
 }
 
 --
@@ -576,12 +580,16 @@ box.schema.index.create = function(space_id, name, options)
     local index_opts = {
             dimension = options.dimension,
             unique = options.unique,
+            hint = options.hint,
             distance = options.distance,
+            coord_type = options.coord_type,
             page_size = options.page_size,
             range_size = options.range_size,
             run_count_per_level = options.run_count_per_level,
             run_size_ratio = options.run_size_ratio,
             bloom_fpr = options.bloom_fpr,
+            bloom_per_page = options.bloom_per_page,
+            compression_dict_size = options.compression_dict_size,
     }
     local field_type_aliases = {
         num = 'unsigned'; -- Deprecated since 1.7.2
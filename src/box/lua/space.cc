@@ -231,6 +231,12 @@ lbox_fillspace(struct lua_State *L, struct space *space, int i)
 			lua_pushnumber(L, index_opts->bloom_fpr);
 			lua_setfield(L, -2, "bloom_fpr");
 
+			lua_pushboolean(L, index_opts->bloom_per_page);
+			lua_setfield(L, -2, "bloom_per_page");
+
+			lua_pushnumber(L, index_opts->compression_dict_size);
+			lua_setfield(L, -2, "compression_dict_size");
+
 			lua_settable(L, -3);
 		}
 
@@ -39,11 +39,12 @@
 #include <lualib.h>
 
 #include "lua/utils.h"
+#include "lua/msgpack.h"
+#include "box/iproto.h"
+#include "box/hotspot.h"
 
 extern struct rmean *rmean_box;
 extern struct rmean *rmean_error;
-/** network statistics (iproto & cbus) */
-extern struct rmean *rmean_net;
 extern struct rmean *rmean_tx_wal_bus;
 
 static void
@@ -109,21 +110,149 @@ lbox_stat_call(struct lua_State *L)
 	return 1;
 }
 
+/**
+ * An iproto_latency_foreach() callback, which fills the table
+ * on top of the stack: LATENCY.<type>.<stage>.{p50,p99,p999}
+ * for request types and LATENCY.FLUSH.{p50,p99,p999} for the
+ * output flush.
+ */
+static int
+set_latency_item(const char *type, const char *stage, double p50,
+		 double p99, double p999, void *cb_ctx)
+{
+	struct lua_State *L = (struct lua_State *) cb_ctx;
+	if (stage != NULL) {
+		lua_getfield(L, -1, type);
+		if (lua_isnil(L, -1)) {
+			lua_pop(L, 1);
+			lua_newtable(L);
+			lua_pushvalue(L, -1);
+			lua_setfield(L, -3, type);
+		}
+	}
+	lua_newtable(L);
+	lua_pushnumber(L, p50);
+	lua_setfield(L, -2, "p50");
+	lua_pushnumber(L, p99);
+	lua_setfield(L, -2, "p99");
+	lua_pushnumber(L, p999);
+	lua_setfield(L, -2, "p999");
+	if (stage != NULL) {
+		lua_setfield(L, -2, stage);
+		lua_pop(L, 1);
+	} else {
+		lua_setfield(L, -2, type);
+	}
+	return 0;
+}
+
+/** Push box.stat.net.LATENCY table. */
+static void
+push_latency(struct lua_State *L)
+{
+	lua_newtable(L);
+	if (iproto_latency_foreach(set_latency_item, L) != 0)
+		luaT_error(L);
+}
+
+/**
+ * Push box.stat.net.THREADS table: statistics of every network
+ * thread.
+ */
+static void
+push_threads(struct lua_State *L)
+{
+	int count = iproto_thread_count();
+	lua_createtable(L, count, 0);
+	for (int i = 0; i < count; i++) {
+		lua_newtable(L);
+		lua_pushnumber(L, iproto_thread_connection_count(i));
+		lua_setfield(L, -2, "CONNECTIONS");
+		lua_rawseti(L, -2, i + 1);
+	}
+}
+
 static int
 lbox_stat_net_index(struct lua_State *L)
 {
-	luaL_checkstring(L, -1);
-	return rmean_foreach(rmean_net, seek_stat_item, L);
+	const char *key = luaL_checkstring(L, -1);
+	if (strcmp(key, "LATENCY") == 0) {
+		push_latency(L);
+		return 1;
+	}
+	if (strcmp(key, "THREADS") == 0) {
+		push_threads(L);
+		return 1;
+	}
+	return iproto_rmean_foreach(seek_stat_item, L);
 }
 
 static int
 lbox_stat_net_call(struct lua_State *L)
 {
 	lua_newtable(L);
-	rmean_foreach(rmean_net, set_stat_item, L);
+	iproto_rmean_foreach(set_stat_item, L);
+	push_latency(L);
+	lua_setfield(L, -2, "LATENCY");
+	push_threads(L);
+	lua_setfield(L, -2, "THREADS");
+	return 1;
+}
+
+/**
+ * Push items tracked by a heavy hitter sketch as an array,
+ * most frequent first.
+ */
+static void
+push_hotspot_top(struct lua_State *L, const struct hotspot_top *top,
+		 bool is_key)
+{
+	struct hotspot_item items[HOTSPOT_TOP_SIZE];
+	int count = hotspot_top_get(top, items);
+	lua_createtable(L, count, 0);
+	for (int i = 0; i < count; i++) {
+		struct hotspot_item *item = &items[i];
+		lua_newtable(L);
+		lua_pushnumber(L, item->space_id);
+		lua_setfield(L, -2, "space_id");
+		if (is_key) {
+			lua_pushnumber(L, item->index_id);
+			lua_setfield(L, -2, "index_id");
+			lua_pushnumber(L, item->hash);
+			lua_setfield(L, -2, "hash");
+			if (item->key_size > 0) {
+				const char *key = item->key;
+				luamp_decode(L, luaL_msgpack_default, &key);
+				lua_setfield(L, -2, "key");
+			}
+		}
+		lua_pushnumber(L, item->count);
+		lua_setfield(L, -2, "count");
+		lua_pushnumber(L, item->error);
+		lua_setfield(L, -2, "error");
+		lua_rawseti(L, -2, i + 1);
+	}
+}
+
+static int
+lbox_stat_hot_call(struct lua_State *L)
+{
+	lua_newtable(L);
+	push_hotspot_top(L, &hotspot_spaces, false);
+	lua_setfield(L, -2, "spaces");
+	push_hotspot_top(L, &hotspot_keys, true);
+	lua_setfield(L, -2, "keys");
 	return 1;
 }
 
+static int
+lbox_stat_hot_reset(struct lua_State *L)
+{
+	(void) L;
+	hotspot_reset();
+	return 0;
+}
+
 static const struct luaL_Reg lbox_stat_meta [] = {
 	{"__index", lbox_stat_index},
 	{"__call",  lbox_stat_call},
@@ -136,6 +265,11 @@ static const struct luaL_Reg lbox_stat_net_meta [] = {
 	{NULL, NULL}
 };
 
+static const struct luaL_Reg lbox_stat_hot_meta [] = {
+	{"__call",  lbox_stat_hot_call},
+	{NULL, NULL}
+};
+
 /** Initialize box.stat package. */
 void
 box_lua_stat_init(struct lua_State *L)
@@ -158,5 +292,17 @@ box_lua_stat_init(struct lua_State *L)
 	luaL_register(L, NULL, lbox_stat_net_meta);
 	lua_setmetatable(L, -2);
 	lua_pop(L, 1); /* stat net module */
+
+	static const struct luaL_Reg hotlib [] = {
+		{"reset", lbox_stat_hot_reset},
+		{NULL, NULL}
+	};
+
+	luaL_register_module(L, "box.stat.hot", hotlib);
+
+	lua_newtable(L);
+	luaL_register(L, NULL, lbox_stat_hot_meta);
+	lua_setmetatable(L, -2);
+	lua_pop(L, 1); /* stat hot module */
 }
 
@@ -39,6 +39,7 @@
 
 #ifndef OLD_GOOD_BITSET
 #include "memtx_engine.h"
+#include "memtx_tx.h"
 #include "small/matras.h"
 
 struct bitset_hash_entry {
@@ -251,7 +252,7 @@ MemtxBitset::allocIterator() const
 	it->bitset_index = this;
 #endif
 
-	return (struct iterator *) it;
+	return memtx_tx_iterator_wrap(this, (struct iterator *) it);
 }
 
 static inline const char *
@@ -327,6 +328,7 @@ void
 MemtxBitset::initIterator(struct iterator *iterator, enum iterator_type type,
 			  const char *key, uint32_t part_count) const
 {
+	iterator = memtx_tx_iterator_unwrap(iterator);
 	assert(iterator->free == bitset_index_iterator_free);
 	assert(part_count == 0 || key != NULL);
 	(void) part_count;
@@ -31,9 +31,15 @@
 #include "memtx_engine.h"
 #include "memtx_space.h"
 #include "memtx_tuple.h"
+#include "memtx_tx.h"
 
 #include "coio_file.h"
+#include "coio_task.h"
+#include "cbus.h"
+#include "fiber_cond.h"
 #include "scoped_guard.h"
+#include "tt_pthread.h"
+#include "salad/stailq.h"
 
 #include "tuple.h"
 #include "txn.h"
@@ -86,52 +92,256 @@ memtx_end_build_primary_key(struct space *space, void *param)
 	handler->replace = memtx_replace_primary_key;
 }
 
+/** A tree index to be built in bulk. */
+struct memtx_build_tree {
+	MemtxTree *tree;
+	/**
+	 * The primary key to fill the tree from. NULL for a
+	 * tree primary key, which is filled at recovery: it is
+	 * only sorted here and built by
+	 * memtx_end_build_primary_key().
+	 */
+	MemtxIndex *pk;
+};
+
+/**
+ * Context of the bulk build of tree indexes of all spaces.
+ */
+struct memtx_build_ctx {
+	MemtxEngine *engine;
+	/** Tree indexes to build. */
+	struct memtx_build_tree *trees;
+	uint32_t tree_count;
+	uint32_t tree_alloc_count;
+	/** The next tree to build, shared by all build fibers. */
+	uint32_t next_tree;
+};
+
+/**
+ * The max number of fibers building tree indexes. It bounds
+ * the number of build arrays which exist at the same time.
+ * Actual parallelism is bounded by the coio thread pool size,
+ * box.cfg.worker_pool_threads.
+ */
+enum { MEMTX_BUILD_FIBERS_MAX = 16 };
+
+static inline bool
+memtx_space_needs_secondary_keys(struct space *space, MemtxEngine *engine)
+{
+	struct MemtxSpace *handler = (struct MemtxSpace *) space->handler;
+	return handler->engine == engine && space_index(space, 0) != NULL &&
+	       handler->replace != memtx_replace_all_keys;
+}
+
+static void
+memtx_build_ctx_add_tree(struct memtx_build_ctx *ctx, MemtxTree *tree,
+			 MemtxIndex *pk)
+{
+	if (ctx->tree_count == ctx->tree_alloc_count) {
+		uint32_t count = MAX(ctx->tree_alloc_count * 2, 16U);
+		struct memtx_build_tree *trees = (struct memtx_build_tree *)
+			realloc(ctx->trees, count * sizeof(*trees));
+		if (trees == NULL) {
+			tnt_raise(OutOfMemory, count * sizeof(*trees),
+				  "realloc", "memtx_build_ctx");
+		}
+		ctx->trees = trees;
+		ctx->tree_alloc_count = count;
+	}
+	struct memtx_build_tree *entry = &ctx->trees[ctx->tree_count++];
+	entry->tree = tree;
+	entry->pk = pk;
+}
+
+/**
+ * Free build arrays left by a failed bulk build. Trees which
+ * are already built have none.
+ */
+static void
+memtx_build_ctx_destroy(struct memtx_build_ctx *ctx)
+{
+	for (uint32_t i = 0; i < ctx->tree_count; i++)
+		ctx->trees[i].tree->freeBuildArray();
+	free(ctx->trees);
+}
+
 /**
  * Secondary indexes are built in bulk after all data is
- * recovered. This function enables secondary keys on a space.
- * Data dictionary spaces are an exception, they are fully
- * built right from the start.
+ * recovered. This function schedules the build of secondary
+ * keys of a space. Tree indexes are filled, sorted and built
+ * later by a few fibers at a time, see memtx_build_trees().
+ * Other index types allocate memory from
+ * memtx_index_extent_pool, which is not thread-safe, so they
+ * are built right away. Data dictionary spaces are an
+ * exception, they are fully built right from the start.
  */
-void
-memtx_build_secondary_keys(struct space *space, void *param)
+static void
+memtx_add_secondary_keys(struct space *space, void *param)
 {
+	struct memtx_build_ctx *ctx = (struct memtx_build_ctx *) param;
+	if (!memtx_space_needs_secondary_keys(space, ctx->engine) ||
+	    space->index_id_max == 0)
+		return;
+
+	MemtxIndex *pk = (MemtxIndex *) space->index[0];
+	if (pk->size() > 0) {
+		say_info("Building secondary indexes in space '%s'...",
+			 space_name(space));
+	}
+	for (uint32_t j = 1; j < space->index_count; j++) {
+		MemtxIndex *index = (MemtxIndex *) space->index[j];
+		if (index->index_def->type != TREE) {
+			index_build(index, pk);
+			continue;
+		}
+		memtx_build_ctx_add_tree(ctx, (MemtxTree *) index, pk);
+	}
+}
+
+/**
+ * Add the tree primary key of a space being recovered from
+ * a snapshot to the bulk build context, so that it is sorted
+ * along with the others.
+ */
+static void
+memtx_add_primary_key_tree(struct space *space, void *param)
+{
+	struct memtx_build_ctx *ctx = (struct memtx_build_ctx *) param;
 	struct MemtxSpace *handler = (struct MemtxSpace *) space->handler;
-	if (handler->engine != param || space_index(space, 0) == NULL ||
-	    handler->replace == memtx_replace_all_keys)
+	if (handler->engine != ctx->engine ||
+	    space_index(space, 0) == NULL ||
+	    handler->replace != memtx_replace_build_next)
 		return;
+	MemtxIndex *pk = (MemtxIndex *) space->index[0];
+	if (pk->index_def->type == TREE)
+		memtx_build_ctx_add_tree(ctx, (MemtxTree *) pk, NULL);
+}
 
-	if (space->index_id_max > 0) {
-		MemtxIndex *pk = (MemtxIndex *) space->index[0];
-		uint32_t n_tuples = pk->size();
+/** Enable secondary keys of a space, once they are built. */
+static void
+memtx_enable_secondary_keys(struct space *space, void *param)
+{
+	if (!memtx_space_needs_secondary_keys(space, (MemtxEngine *) param))
+		return;
+	struct MemtxSpace *handler = (struct MemtxSpace *) space->handler;
+	if (space->index_id_max > 0 && space->index[0]->size() > 0)
+		say_info("Space '%s': done", space_name(space));
+	handler->replace = memtx_replace_all_keys;
+}
 
-		if (n_tuples > 0) {
-			say_info("Building secondary indexes in space '%s'...",
-				 space_name(space));
-		}
+static ssize_t
+memtx_sort_build_array_f(va_list ap)
+{
+	MemtxTree *tree = va_arg(ap, MemtxTree *);
+	tree->sortBuildArray();
+	return 0;
+}
 
-		for (uint32_t j = 1; j < space->index_count; j++)
-			index_build((MemtxIndex *) space->index[j], pk);
+/**
+ * Fill a tree index, sort its build array in a coio thread
+ * and build the tree, so that the array is freed as soon as
+ * possible.
+ */
+static void
+memtx_build_tree(struct memtx_build_tree *entry, bool use_coio)
+{
+	if (entry->pk != NULL)
+		index_build_fill(entry->tree, entry->pk);
+	/* Sort in place if the task can't be allocated. */
+	if (!use_coio ||
+	    coio_call(memtx_sort_build_array_f, entry->tree) != 0)
+		entry->tree->sortBuildArray();
+	if (entry->pk != NULL)
+		entry->tree->endBuild();
+}
 
-		if (n_tuples > 0) {
-			say_info("Space '%s': done", space_name(space));
+static int
+memtx_build_trees_f(va_list ap)
+{
+	struct memtx_build_ctx *ctx = va_arg(ap, struct memtx_build_ctx *);
+	try {
+		while (ctx->next_tree < ctx->tree_count)
+			memtx_build_tree(&ctx->trees[ctx->next_tree++], true);
+	} catch (Exception *) {
+		/* Stop the other fibers. */
+		ctx->next_tree = ctx->tree_count;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Build tree indexes in coio threads, several indexes at a
+ * time, and wait for completion. Build arrays are freed by
+ * memtx_build_ctx_destroy() on failure.
+ */
+static void
+memtx_build_trees(struct memtx_build_ctx *ctx)
+{
+	struct fiber *fibers[MEMTX_BUILD_FIBERS_MAX];
+	uint32_t fiber_count = 0;
+	while (fiber_count < MIN(ctx->tree_count,
+				 (uint32_t) MEMTX_BUILD_FIBERS_MAX)) {
+		struct fiber *f = fiber_new("index_build",
+					    memtx_build_trees_f);
+		if (f == NULL) {
+			/* Do with fewer fibers. */
+			diag_clear(diag_get());
+			break;
 		}
+		fiber_set_joinable(f, true);
+		fiber_start(f, ctx);
+		fibers[fiber_count++] = f;
 	}
-	handler->replace = memtx_replace_all_keys;
+	/* Wait for all workers even if one of them failed. */
+	bool is_failed = false;
+	for (uint32_t i = 0; i < fiber_count; i++) {
+		if (fiber_join(fibers[i]) != 0)
+			is_failed = true;
+	}
+	if (is_failed)
+		diag_raise();
+	/* Finish what the workers left, if any. */
+	while (ctx->next_tree < ctx->tree_count)
+		memtx_build_tree(&ctx->trees[ctx->next_tree++], false);
+}
+
+/**
+ * Build secondary keys of all memtx spaces after recovery.
+ * Sorting, the most CPU-intensive part of building a tree
+ * index, runs in parallel for independent indexes; large
+ * arrays are in addition sorted by multi-threaded qsort_arg().
+ */
+static void
+memtx_build_all_secondary_keys(MemtxEngine *engine)
+{
+	struct memtx_build_ctx ctx;
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.engine = engine;
+	auto guard = make_scoped_guard([&]{ memtx_build_ctx_destroy(&ctx); });
+
+	space_foreach_xc(memtx_add_secondary_keys, &ctx);
+	memtx_build_trees(&ctx);
+	space_foreach_xc(memtx_enable_secondary_keys, engine);
 }
 
 MemtxEngine::MemtxEngine(const char *snap_dirname, bool force_recovery,
 			 uint64_t tuple_arena_max_size, uint32_t objsize_min,
-			 float alloc_factor)
+			 float alloc_factor, int snap_compression_level)
 	:Engine("memtx"),
 	m_state(MEMTX_INITIALIZED),
 	m_checkpoint(0),
 	m_snap_io_rate_limit(0),
+	m_snap_write_threads(1),
+	m_snap_read_threads(1),
 	m_force_recovery(force_recovery)
 {
 	memtx_tuple_init(tuple_arena_max_size, objsize_min, alloc_factor);
+	memtx_tx_manager_init(this);
 
 	xdir_create(&m_snap_dir, snap_dirname, SNAP, &INSTANCE_UUID);
 	m_snap_dir.force_recovery = force_recovery;
+	m_snap_dir.compression_level = snap_compression_level;
 	xdir_scan_xc(&m_snap_dir);
 }
 
@@ -139,15 +349,301 @@ MemtxEngine::~MemtxEngine()
 {
 	xdir_destroy(&m_snap_dir);
 
+	memtx_tx_manager_free();
 	memtx_tuple_free();
 }
 
+void
+MemtxEngine::setUseMvccEngine(bool use_mvcc_engine)
+{
+	memtx_tx_manager.is_enabled = use_mvcc_engine;
+}
+
 void
 MemtxEngine::setMaxTupleSize(size_t max_size)
 {
 	memtx_max_tuple_size = max_size;
 }
 
+/**
+ * A thread decoding and decompressing snapshot transactions
+ * at recovery, @sa MemtxEngine::recoverSnapshotParallel().
+ */
+struct memtx_snap_reader {
+	struct cord cord;
+	/** Pipe from tx to the reader thread. */
+	struct cpipe reader_pipe;
+	/** Pipe from the reader thread to tx. */
+	struct cpipe tx_pipe;
+};
+
+/** Snapshot reader thread function. */
+static int
+memtx_snap_reader_f(va_list ap)
+{
+	struct memtx_snap_reader *reader =
+		va_arg(ap, struct memtx_snap_reader *);
+	struct cbus_endpoint endpoint;
+
+	cpipe_create(&reader->tx_pipe, "tx_prio");
+	cbus_endpoint_create(&endpoint, cord_name(cord()),
+			     fiber_schedule_cb, fiber());
+	cbus_loop(&endpoint);
+	cbus_endpoint_destroy(&endpoint, cbus_process);
+	cpipe_destroy(&reader->tx_pipe);
+	return 0;
+}
+
+/** A snapshot transaction sent to a reader thread. */
+struct memtx_snap_read_task {
+	struct cmsg base;
+	struct cmsg_hop route[2];
+	struct memtx_snap_reader *reader;
+	/** Signalled when the task returns to tx. */
+	struct fiber_cond *cond;
+	/** A copy of the raw transaction, including fixheader. */
+	char *data;
+	size_t data_size;
+	size_t data_capacity;
+	/**
+	 * Decoded rows. The buffer belongs to the slab cache
+	 * of the reader thread, so it is destroyed there too.
+	 */
+	struct xlog_tx_cursor tx_cursor;
+	bool has_tx_cursor;
+	/** Zstd context of the task, used in the reader thread. */
+	ZSTD_DStream *zdctx;
+	bool is_complete;
+	int rc;
+	struct diag diag;
+	/** Link in the queue of tasks in the file order. */
+	struct stailq_entry in_queue;
+};
+
+static void
+memtx_snap_read_task_release(struct memtx_snap_read_task *task)
+{
+	if (task->has_tx_cursor) {
+		xlog_tx_cursor_destroy(&task->tx_cursor);
+		task->has_tx_cursor = false;
+	}
+}
+
+/** Decode a task in a reader thread. */
+static void
+memtx_snap_read_task_decode(struct cmsg *base)
+{
+	struct memtx_snap_read_task *task =
+		(struct memtx_snap_read_task *) base;
+	memtx_snap_read_task_release(task);
+	if (task->data_size == 0)
+		return; /* release only */
+	if (task->zdctx == NULL) {
+		task->zdctx = ZSTD_createDStream();
+		if (task->zdctx == NULL) {
+			diag_set(ClientError, ER_DECOMPRESSION,
+				 "failed to create context");
+			goto error;
+		}
+	}
+	const char *data;
+	data = task->data;
+	ssize_t rc;
+	rc = xlog_tx_cursor_create(&task->tx_cursor, &data,
+				   task->data + task->data_size, task->zdctx);
+	/* The transaction is read in full. */
+	assert(rc <= 0);
+	if (rc != 0)
+		goto error;
+	task->has_tx_cursor = true;
+	return;
+error:
+	task->rc = -1;
+	diag_move(diag_get(), &task->diag);
+}
+
+/** Deliver a task back to tx. */
+static void
+memtx_snap_read_task_complete(struct cmsg *base)
+{
+	struct memtx_snap_read_task *task =
+		(struct memtx_snap_read_task *) base;
+	task->is_complete = true;
+	fiber_cond_signal(task->cond);
+}
+
+/**
+ * Send a raw transaction to a reader thread to decode.
+ * Pass an empty transaction to release the task memory.
+ */
+static void
+memtx_snap_read_task_post(struct memtx_snap_read_task *task,
+			  const char *data, const char *data_end)
+{
+	size_t size = data_end - data;
+	if (size > task->data_capacity) {
+		char *buf = (char *) realloc(task->data, size);
+		if (buf == NULL) {
+			tnt_raise(OutOfMemory, size, "realloc",
+				  "snapshot transaction");
+		}
+		task->data = buf;
+		task->data_capacity = size;
+	}
+	if (size > 0)
+		memcpy(task->data, data, size);
+	task->data_size = size;
+	task->is_complete = false;
+	task->rc = 0;
+	task->route[0].f = memtx_snap_read_task_decode;
+	task->route[0].pipe = &task->reader->tx_pipe;
+	task->route[1].f = memtx_snap_read_task_complete;
+	task->route[1].pipe = NULL;
+	cmsg_init(&task->base, task->route);
+	cpipe_push(&task->reader->reader_pipe, &task->base);
+}
+
+/**
+ * Recover a snapshot decoding and decompressing its
+ * transactions in reader threads while tx applies rows
+ * of the transactions decoded earlier. Rows are applied
+ * in the file order, exactly as by the serial recovery.
+ * Tuples are allocated from the memtx arena, which isn't
+ * thread-safe, so rows are still applied in tx.
+ */
+void
+MemtxEngine::recoverSnapshotParallel(struct xlog_cursor *cursor,
+				     int64_t signature)
+{
+	int reader_count = m_snap_read_threads;
+	struct memtx_snap_reader *readers = (struct memtx_snap_reader *)
+		calloc(reader_count, sizeof(*readers));
+	if (readers == NULL) {
+		tnt_raise(OutOfMemory, reader_count * sizeof(*readers),
+			  "calloc", "struct memtx_snap_reader");
+	}
+	/* Keep a couple of transactions in flight per thread. */
+	int task_count = reader_count * 2;
+	struct memtx_snap_read_task *tasks = (struct memtx_snap_read_task *)
+		calloc(task_count, sizeof(*tasks));
+	if (tasks == NULL) {
+		free(readers);
+		tnt_raise(OutOfMemory, task_count * sizeof(*tasks),
+			  "calloc", "struct memtx_snap_read_task");
+	}
+	struct fiber_cond cond;
+	fiber_cond_create(&cond);
+	struct stailq queue;
+	stailq_create(&queue);
+
+	int started = 0;
+	auto guard = make_scoped_guard([&]{
+		/*
+		 * Wait for tasks in flight, then let the reader
+		 * threads free decoded rows, and stop them.
+		 */
+		for (int i = 0; i < task_count; i++) {
+			struct memtx_snap_read_task *task = &tasks[i];
+			while (!task->is_complete)
+				fiber_cond_wait(&cond);
+			if (task->has_tx_cursor && task->reader != NULL)
+				memtx_snap_read_task_post(task, NULL, NULL);
+		}
+		for (int i = 0; i < task_count; i++) {
+			struct memtx_snap_read_task *task = &tasks[i];
+			while (!task->is_complete)
+				fiber_cond_wait(&cond);
+			diag_destroy(&task->diag);
+			free(task->data);
+		}
+		for (int i = 0; i < started; i++) {
+			struct memtx_snap_reader *reader = &readers[i];
+			cbus_stop_loop(&reader->reader_pipe);
+			cpipe_destroy(&reader->reader_pipe);
+			if (cord_join(&reader->cord) != 0)
+				panic("failed to join snapshot reader thread");
+		}
+		/* Decompression contexts aren't bound to a thread. */
+		for (int i = 0; i < task_count; i++)
+			ZSTD_freeDStream(tasks[i].zdctx);
+		fiber_cond_destroy(&cond);
+		free(tasks);
+		free(readers);
+	});
+
+	for (int i = 0; i < task_count; i++) {
+		struct memtx_snap_read_task *task = &tasks[i];
+		task->cond = &cond;
+		task->is_complete = true;
+		diag_create(&task->diag);
+	}
+	for (; started < reader_count; started++) {
+		struct memtx_snap_reader *reader = &readers[started];
+		char name[FIBER_NAME_MAX];
+		snprintf(name, sizeof(name), "snapshot.reader.%d", started);
+		if (cord_costart(&reader->cord, name,
+				 memtx_snap_reader_f, reader) != 0)
+			diag_raise();
+		cpipe_create(&reader->reader_pipe, name);
+	}
+	for (int i = 0; i < task_count; i++)
+		tasks[i].reader = &readers[i % reader_count];
+
+	/* Fill the pipeline. */
+	const char *data, *data_end;
+	bool is_eof = false;
+	for (int i = 0; i < task_count && !is_eof; i++) {
+		int rc = xlog_cursor_next_tx_raw(cursor, &data, &data_end);
+		if (rc < 0)
+			diag_raise();
+		if (rc > 0) {
+			is_eof = true;
+			break;
+		}
+		memtx_snap_read_task_post(&tasks[i], data, data_end);
+		stailq_add_tail_entry(&queue, &tasks[i], in_queue);
+	}
+
+	struct xrow_header row;
+	uint64_t row_count = 0;
+	while (!stailq_empty(&queue)) {
+		struct memtx_snap_read_task *task =
+			stailq_shift_entry(&queue, struct memtx_snap_read_task,
+					   in_queue);
+		while (!task->is_complete)
+			fiber_cond_wait(&cond);
+		if (task->rc != 0) {
+			diag_move(&task->diag, diag_get());
+			diag_raise();
+		}
+		int rc;
+		while ((rc = xlog_tx_cursor_next_row(&task->tx_cursor,
+						     &row)) == 0) {
+			row.lsn = signature;
+			recoverSnapshotRow(&row);
+			++row_count;
+			if (row_count % 100000 == 0) {
+				say_info("%.1fM rows processed",
+					 row_count / 1000000.);
+				fiber_yield_timeout(0);
+			}
+		}
+		if (rc < 0)
+			diag_raise();
+		if (is_eof)
+			continue;
+		rc = xlog_cursor_next_tx_raw(cursor, &data, &data_end);
+		if (rc < 0)
+			diag_raise();
+		if (rc > 0) {
+			is_eof = true;
+			continue;
+		}
+		memtx_snap_read_task_post(task, data, data_end);
+		stailq_add_tail_entry(&queue, task, in_queue);
+	}
+}
+
 void
 MemtxEngine::recoverSnapshot(const struct vclock *vclock)
 {
@@ -165,23 +661,32 @@ MemtxEngine::recoverSnapshot(const struct vclock *vclock)
 		xlog_cursor_close(&cursor, false);
 	});
 
-	struct xrow_header row;
-	uint64_t row_count = 0;
-	while (xlog_cursor_next_xc(&cursor, &row, m_force_recovery) == 0) {
-		row.lsn = signature;
-		try {
-			recoverSnapshotRow(&row);
-		} catch (ClientError *e) {
-			if (!m_force_recovery)
-				throw;
-			say_error("can't apply row: ");
-			e->log();
-		}
-		++row_count;
-		if (row_count % 100000 == 0) {
-			say_info("%.1fM rows processed",
-				 row_count / 1000000.);
-			fiber_yield_timeout(0);
+	if (m_snap_read_threads > 1 && !m_force_recovery) {
+		/*
+		 * Disaster recovery skips broken transactions
+		 * and rows, which only the serial path can do.
+		 */
+		recoverSnapshotParallel(&cursor, signature);
+	} else {
+		struct xrow_header row;
+		uint64_t row_count = 0;
+		while (xlog_cursor_next_xc(&cursor, &row,
+					   m_force_recovery) == 0) {
+			row.lsn = signature;
+			try {
+				recoverSnapshotRow(&row);
+			} catch (ClientError *e) {
+				if (!m_force_recovery)
+					throw;
+				say_error("can't apply row: ");
+				e->log();
+			}
+			++row_count;
+			if (row_count % 100000 == 0) {
+				say_info("%.1fM rows processed",
+					 row_count / 1000000.);
+				fiber_yield_timeout(0);
+			}
 		}
 	}
 
@@ -243,7 +748,17 @@ MemtxEngine::beginFinalRecovery()
 		return;
 
 	assert(m_state == MEMTX_INITIAL_RECOVERY);
-	/* End of the fast path: loaded the primary key. */
+	/*
+	 * End of the fast path: loaded the primary key.
+	 * Sort build arrays of tree primary keys of all
+	 * spaces concurrently before building the trees.
+	 */
+	struct memtx_build_ctx ctx;
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.engine = this;
+	auto guard = make_scoped_guard([&]{ memtx_build_ctx_destroy(&ctx); });
+	space_foreach_xc(memtx_add_primary_key_tree, &ctx);
+	memtx_build_trees(&ctx);
 	space_foreach_xc(memtx_end_build_primary_key, this);
 
 	if (!m_force_recovery) {
@@ -262,7 +777,7 @@ MemtxEngine::beginFinalRecovery()
 		 * unique keys.
 		 */
 		m_state = MEMTX_OK;
-		space_foreach_xc(memtx_build_secondary_keys, this);
+		memtx_build_all_secondary_keys(this);
 	}
 }
 
@@ -278,7 +793,7 @@ MemtxEngine::endRecovery()
 	if (m_state != MEMTX_OK) {
 		assert(m_state == MEMTX_FINAL_RECOVERY);
 		m_state = MEMTX_OK;
-		space_foreach_xc(memtx_build_secondary_keys, this);
+		memtx_build_all_secondary_keys(this);
 	}
 }
 
@@ -307,8 +822,9 @@ Handler *MemtxEngine::createSpace(struct rlist *key_list,
 	return new MemtxSpace(this, format);
 }
 
-void
-MemtxEngine::prepare(struct txn *txn)
+/** Remove the triggers set in MemtxEngine::begin(). */
+static void
+memtx_txn_clear_triggers(struct txn *txn)
 {
 	if (txn->is_autocommit)
 		return;
@@ -321,6 +837,14 @@ MemtxEngine::prepare(struct txn *txn)
 	trigger_clear(&txn->fiber_on_stop);
 }
 
+void
+MemtxEngine::prepare(struct txn *txn)
+{
+	if (memtx_tx_manager.is_enabled)
+		memtx_tx_prepare(txn);
+	memtx_txn_clear_triggers(txn);
+}
+
 void
 MemtxEngine::begin(struct txn *txn)
 {
@@ -340,12 +864,33 @@ MemtxEngine::begin(struct txn *txn)
 		 * Memtx doesn't allow yields between statements of
 		 * a transaction. Set a trigger which would roll
 		 * back the transaction if there is a yield.
+		 * In the multi-version mode the transaction gets
+		 * a read view instead, and the trigger is only
+		 * set if it changes a system space, see
+		 * beginStatement().
 		 */
-		trigger_add(&fiber()->on_yield, &txn->fiber_on_yield);
+		if (memtx_tx_manager.is_enabled)
+			memtx_tx_begin(txn);
+		else
+			trigger_add(&fiber()->on_yield, &txn->fiber_on_yield);
 		trigger_add(&fiber()->on_stop, &txn->fiber_on_stop);
 	}
 }
 
+void
+MemtxEngine::beginStatement(struct txn *txn)
+{
+	struct memtx_tx *tx = (struct memtx_tx *) txn->engine_tx;
+	if (tx == NULL || tx->is_yield_forbidden)
+		return;
+	struct txn_stmt *stmt = txn_current_stmt(txn);
+	if (memtx_tx_space_is_versioned(stmt->space))
+		return;
+	/* Changes of system spaces are not versioned. */
+	trigger_add(&fiber()->on_yield, &txn->fiber_on_yield);
+	tx->is_yield_forbidden = true;
+}
+
 void
 MemtxEngine::rollbackStatement(struct txn *, struct txn_stmt *stmt)
 {
@@ -358,7 +903,10 @@ MemtxEngine::rollbackStatement(struct txn *, struct txn_stmt *stmt)
 	/* Only roll back the changes if they were made. */
 	if (stmt->engine_savepoint == NULL)
 		index_count = 0;
-	else if (handler->replace == memtx_replace_all_keys)
+	else if (memtx_tx_stmt_is_versioned(stmt)) {
+		memtx_tx_rollback_statement(stmt);
+		index_count = 0;
+	} else if (handler->replace == memtx_replace_all_keys)
 		index_count = space->index_count;
 	else if (handler->replace == memtx_replace_primary_key)
 		index_count = 1;
@@ -383,11 +931,13 @@ MemtxEngine::rollbackStatement(struct txn *, struct txn_stmt *stmt)
 void
 MemtxEngine::rollback(struct txn *txn)
 {
-	prepare(txn);
+	memtx_txn_clear_triggers(txn);
 	struct txn_stmt *stmt;
 	stailq_reverse(&txn->stmts);
 	stailq_foreach_entry(stmt, &txn->stmts, next)
 		rollbackStatement(txn, stmt);
+	if (memtx_tx_manager.is_enabled)
+		memtx_tx_rollback(txn);
 }
 
 void
@@ -395,9 +945,12 @@ MemtxEngine::commit(struct txn *txn)
 {
 	struct txn_stmt *stmt;
 	stailq_foreach_entry(stmt, &txn->stmts, next) {
-		if (stmt->old_tuple)
+		/* Replaced versions are freed by memtx_tx_commit(). */
+		if (stmt->old_tuple && !memtx_tx_stmt_is_versioned(stmt))
 			tuple_unref(stmt->old_tuple);
 	}
+	if (memtx_tx_manager.is_enabled)
+		memtx_tx_commit(txn);
 }
 
 void
@@ -441,7 +994,9 @@ checkpoint_write_row(struct xlog *l, struct xrow_header *row)
 	 * This makes streaming such rows to a replica or
 	 * to recovery look similar to streaming a normal
 	 * WAL. @sa the place which skips old rows in
-	 * recovery_apply_row().
+	 * recovery_apply_row(). Rows of user spaces written
+	 * by worker threads continue the numbering, but
+	 * may skip some numbers, @sa checkpoint_write_parallel().
 	 */
 	row->lsn = l->rows + l->tx_rows;
 	row->sync = 0; /* don't write sync to wal */
@@ -493,6 +1048,11 @@ struct checkpoint {
 	 */
 	struct rlist entries;
 	uint64_t snap_io_rate_limit;
+	/**
+	 * The number of threads encoding and compressing
+	 * rows of user spaces, @sa checkpoint_write_parallel().
+	 */
+	int snap_write_threads;
 	struct cord cord;
 	bool waiting_for_snap_thread;
 	/** The vclock of the snapshot file. */
@@ -507,12 +1067,15 @@ struct checkpoint {
 
 static void
 checkpoint_init(struct checkpoint *ckpt, const char *snap_dirname,
-		uint64_t snap_io_rate_limit)
+		uint64_t snap_io_rate_limit, int snap_compression_level,
+		int snap_write_threads)
 {
 	ckpt->entries = RLIST_HEAD_INITIALIZER(ckpt->entries);
 	ckpt->waiting_for_snap_thread = false;
 	xdir_create(&ckpt->dir, snap_dirname, SNAP, &INSTANCE_UUID);
+	ckpt->dir.compression_level = snap_compression_level;
 	ckpt->snap_io_rate_limit = snap_io_rate_limit;
+	ckpt->snap_write_threads = snap_write_threads;
 	/* May be used in abortCheckpoint() */
 	ckpt->vclock = (struct vclock *) malloc(sizeof(*ckpt->vclock));
 	if (ckpt->vclock == NULL)
@@ -534,6 +1097,11 @@ checkpoint_destroy(struct checkpoint *ckpt)
 	free(ckpt->vclock);
 }
 
+/**
+ * The minimal number of tuples in a key range of a space
+ * written by a separate thread.
+ */
+enum { CHECKPOINT_RANGE_MIN_SIZE = 100000 };
 
 static void
 checkpoint_add_space(struct space *sp, void *data)
@@ -542,18 +1110,357 @@ checkpoint_add_space(struct space *sp, void *data)
 		return;
 	if (!space_is_memtx(sp))
 		return;
-	Index *pk = space_index(sp, 0);
+	MemtxIndex *pk = (MemtxIndex *) space_index(sp, 0);
 	if (!pk)
 		return;
 	struct checkpoint *ckpt = (struct checkpoint *)data;
-	struct checkpoint_entry *entry;
-	entry = region_alloc_object_xc(&fiber()->gc, struct checkpoint_entry);
-	rlist_add_tail_entry(&ckpt->entries, entry, link);
+	/*
+	 * Split big user spaces into key ranges, so that they
+	 * are written by several threads.
+	 */
+	struct snapshot_iterator *its[MEMTX_SNAP_THREADS_MAX];
+	int count = 1;
+	if (ckpt->snap_write_threads > 1 && !space_is_system(sp) &&
+	    pk->index_def->type == TREE) {
+		count = MIN((size_t) ckpt->snap_write_threads,
+			    pk->size() / CHECKPOINT_RANGE_MIN_SIZE);
+	}
+	if (count > 1) {
+		count = ((MemtxTree *) pk)->createSnapshotIterators(its, count);
+		say_info("writing space '%s' in %d key ranges",
+			 space_name(sp), count);
+	} else {
+		count = 1;
+		its[0] = pk->createSnapshotIterator();
+	}
+	int i = 0;
+	auto its_guard = make_scoped_guard([&]{
+		for (; i < count; i++)
+			its[i]->free(its[i]);
+	});
+	while (i < count) {
+		struct checkpoint_entry *entry;
+		entry = region_alloc_object_xc(&fiber()->gc,
+					       struct checkpoint_entry);
+		entry->space = sp;
+		/* The wrapper frees the iterator on failure. */
+		struct snapshot_iterator *it = its[i++];
+		entry->iterator = memtx_tx_snapshot_iterator_wrap(sp, it);
+		rlist_add_tail_entry(&ckpt->entries, entry, link);
+	}
+};
 
-	entry->space = sp;
-	entry->iterator = pk->createSnapshotIterator();
+enum {
+	/**
+	 * The amount of encoded rows a checkpoint worker
+	 * accumulates before handing them over to the
+	 * snapshot thread.
+	 */
+	CHECKPOINT_BATCH_SIZE = 1024 * 1024,
+	/** The number of LSNs reserved for a batch. */
+	CHECKPOINT_BATCH_ROWS = 64 * 1024,
 };
 
+/**
+ * State shared by the snapshot thread and the threads
+ * encoding rows of user spaces in parallel. Each worker
+ * takes spaces or key ranges of big spaces from the list,
+ * packs their tuples into compressed xlog tx blocks and
+ * queues them for the snapshot thread. A batch of blocks
+ * reserves CHECKPOINT_BATCH_ROWS LSNs for its rows when
+ * it's started, and the snapshot thread appends batches to
+ * the file in the order of the reservations, so row LSNs
+ * grow across the file.
+ */
+struct checkpoint_writer {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	/** The head of the list of spaces to write. */
+	struct rlist *entries;
+	/** The next space to be taken by a worker. */
+	struct checkpoint_entry *next_entry;
+	/** The first LSN of the next batch to be started. */
+	int64_t next_lsn;
+	/** The first LSN of the next batch to be written. */
+	int64_t write_lsn;
+	/** The number of workers still running. */
+	int active_workers;
+	/** Set on error, makes the workers stop. */
+	bool is_aborted;
+	/** Compression level of the snapshot file. */
+	int compression_level;
+	/** The timestamp of snapshot rows. */
+	double tm;
+};
+
+/** A thread encoding and compressing snapshot rows. */
+struct checkpoint_worker {
+	struct cord cord;
+	struct checkpoint_writer *writer;
+	/** Rows waiting to be written to the snapshot file. */
+	struct xlog_batch batch;
+	/** The first LSN reserved for the batch. */
+	int64_t batch_lsn;
+	/** The number of rows in the batch. */
+	int64_t batch_rows;
+	/**
+	 * Set while the batch is waiting for the snapshot
+	 * thread to write it.
+	 */
+	bool is_submitted;
+};
+
+/**
+ * Take the next space to write.
+ * Return NULL if there are no spaces left or
+ * the checkpoint was aborted.
+ */
+static struct checkpoint_entry *
+checkpoint_writer_next(struct checkpoint_writer *writer)
+{
+	struct checkpoint_entry *entry = NULL;
+	tt_pthread_mutex_lock(&writer->mutex);
+	if (!writer->is_aborted &&
+	    &writer->next_entry->link != writer->entries) {
+		entry = writer->next_entry;
+		writer->next_entry = rlist_next_entry(entry, link);
+	}
+	tt_pthread_mutex_unlock(&writer->mutex);
+	return entry;
+}
+
+/** Reserve LSNs for the rows of a new batch of a worker. */
+static void
+checkpoint_worker_start_batch(struct checkpoint_worker *worker)
+{
+	struct checkpoint_writer *writer = worker->writer;
+	tt_pthread_mutex_lock(&writer->mutex);
+	worker->batch_lsn = writer->next_lsn;
+	writer->next_lsn += CHECKPOINT_BATCH_ROWS;
+	tt_pthread_mutex_unlock(&writer->mutex);
+}
+
+/**
+ * Complete the batch of a worker, queue it for writing and
+ * wait until the snapshot thread is done with it.
+ * Return 1 if the checkpoint was aborted, -1 on error.
+ */
+static int
+checkpoint_worker_submit(struct checkpoint_worker *worker)
+{
+	/*
+	 * All rows of the batch must be written along with it,
+	 * since the next batch reserves other LSNs.
+	 */
+	if (xlog_batch_flush(&worker->batch) != 0)
+		return -1;
+	struct checkpoint_writer *writer = worker->writer;
+	tt_pthread_mutex_lock(&writer->mutex);
+	worker->is_submitted = true;
+	tt_pthread_cond_broadcast(&writer->cond);
+	while (worker->is_submitted)
+		tt_pthread_cond_wait(&writer->cond, &writer->mutex);
+	bool is_aborted = writer->is_aborted;
+	tt_pthread_mutex_unlock(&writer->mutex);
+	xlog_batch_reset(&worker->batch);
+	worker->batch_rows = 0;
+	return is_aborted ? 1 : 0;
+}
+
+static int
+checkpoint_worker_write_tuple(struct checkpoint_worker *worker,
+			      uint32_t space_id, const char *data,
+			      uint32_t size)
+{
+	struct request_replace_body body;
+	body.m_body = 0x82; /* map of two elements. */
+	body.k_space_id = IPROTO_SPACE_ID;
+	body.m_space_id = 0xce; /* uint32 */
+	body.v_space_id = mp_bswap_u32(space_id);
+	body.k_tuple = IPROTO_TUPLE;
+
+	struct xrow_header row;
+	memset(&row, 0, sizeof(struct xrow_header));
+	row.type = IPROTO_INSERT;
+	row.tm = worker->writer->tm;
+	if (worker->batch_rows == 0)
+		checkpoint_worker_start_batch(worker);
+	row.lsn = worker->batch_lsn + worker->batch_rows++;
+
+	row.bodycnt = 2;
+	row.body[0].iov_base = &body;
+	row.body[0].iov_len = sizeof(body);
+	row.body[1].iov_base = (char *)data;
+	row.body[1].iov_len = size;
+	ssize_t written = xlog_batch_write_row(&worker->batch, &row);
+	fiber_gc();
+	return written < 0 ? -1 : 0;
+}
+
+static int
+checkpoint_worker_write(struct checkpoint_worker *worker)
+{
+	struct checkpoint_entry *entry;
+	while ((entry = checkpoint_writer_next(worker->writer)) != NULL) {
+		uint32_t size;
+		const char *data;
+		struct snapshot_iterator *it = entry->iterator;
+		for (data = it->next(it, &size); data != NULL;
+		     data = it->next(it, &size)) {
+			if (checkpoint_worker_write_tuple(worker,
+					space_id(entry->space),
+					data, size) != 0)
+				return -1;
+			if (xlog_batch_size(&worker->batch) <
+			    CHECKPOINT_BATCH_SIZE &&
+			    worker->batch_rows < CHECKPOINT_BATCH_ROWS)
+				continue;
+			int rc = checkpoint_worker_submit(worker);
+			if (rc != 0)
+				return rc < 0 ? -1 : 0;
+		}
+	}
+	if (worker->batch_rows > 0 &&
+	    checkpoint_worker_submit(worker) < 0)
+		return -1;
+	return 0;
+}
+
+static int
+checkpoint_worker_f(va_list ap)
+{
+	struct checkpoint_worker *worker =
+		va_arg(ap, struct checkpoint_worker *);
+	struct checkpoint_writer *writer = worker->writer;
+	int rc = xlog_batch_create(&worker->batch, writer->compression_level);
+	if (rc == 0) {
+		rc = checkpoint_worker_write(worker);
+		xlog_batch_destroy(&worker->batch);
+	}
+	tt_pthread_mutex_lock(&writer->mutex);
+	if (rc != 0)
+		writer->is_aborted = true;
+	writer->active_workers--;
+	tt_pthread_cond_broadcast(&writer->cond);
+	tt_pthread_mutex_unlock(&writer->mutex);
+	return rc;
+}
+
+/**
+ * Return a worker with a batch to be written next, if any.
+ * Once the checkpoint is aborted, batches are not written,
+ * so any worker with a batch is returned to release it.
+ */
+static struct checkpoint_worker *
+checkpoint_writer_next_batch(struct checkpoint_writer *writer,
+			     struct checkpoint_worker *workers, int count)
+{
+	for (int i = 0; i < count; i++) {
+		struct checkpoint_worker *worker = &workers[i];
+		if (worker->is_submitted &&
+		    (writer->is_aborted ||
+		     worker->batch_lsn == writer->write_lsn))
+			return worker;
+	}
+	return NULL;
+}
+
+/**
+ * Write spaces starting from @a first to the snapshot file,
+ * using worker threads to encode and compress their rows.
+ *
+ * The file keeps the format of a snapshot written by one
+ * thread: rows of system spaces go first, in the order of
+ * their primary keys. They are followed by xlog tx blocks
+ * with rows of user spaces. Each block holds rows of one
+ * worker, but blocks of different spaces, and of different
+ * key ranges of the same space, interleave in the file.
+ * Rows of each key range keep their order. Row LSNs
+ * grow strictly across the file but may skip numbers.
+ * Recovery doesn't need the rows of a user space
+ * to be sorted, since the primary key sorts them when
+ * it's built.
+ */
+static void
+checkpoint_write_parallel(struct checkpoint *ckpt, struct xlog *snap,
+			  struct checkpoint_entry *first)
+{
+	struct checkpoint_writer writer;
+	tt_pthread_mutex_init(&writer.mutex, NULL);
+	tt_pthread_cond_init(&writer.cond, NULL);
+	writer.entries = &ckpt->entries;
+	writer.next_entry = first;
+	writer.next_lsn = snap->rows + snap->tx_rows;
+	writer.write_lsn = writer.next_lsn;
+	writer.is_aborted = false;
+	writer.compression_level = snap->compression_level;
+	ev_now_update(loop());
+	writer.tm = ev_now(loop());
+	auto writer_guard = make_scoped_guard([&]{
+		tt_pthread_cond_destroy(&writer.cond);
+		tt_pthread_mutex_destroy(&writer.mutex);
+	});
+
+	int worker_count = ckpt->snap_write_threads;
+	struct checkpoint_worker *workers = (struct checkpoint_worker *)
+		calloc(worker_count, sizeof(*workers));
+	if (workers == NULL) {
+		tnt_raise(OutOfMemory, worker_count * sizeof(*workers),
+			  "malloc", "struct checkpoint_worker");
+	}
+	auto workers_guard = make_scoped_guard([&]{ free(workers); });
+
+	int rc = 0;
+	int started = 0;
+	writer.active_workers = worker_count;
+	for (; started < worker_count; started++) {
+		struct checkpoint_worker *worker = &workers[started];
+		worker->writer = &writer;
+		char name[FIBER_NAME_MAX];
+		snprintf(name, sizeof(name), "snapshot.%d", started);
+		if (cord_costart(&worker->cord, name, checkpoint_worker_f,
+				 worker) != 0) {
+			rc = -1;
+			break;
+		}
+	}
+	tt_pthread_mutex_lock(&writer.mutex);
+	if (rc != 0) {
+		writer.is_aborted = true;
+		writer.active_workers -= worker_count - started;
+	}
+	int64_t rows = snap->rows;
+	while (true) {
+		struct checkpoint_worker *worker;
+		while ((worker = checkpoint_writer_next_batch(&writer,
+						workers, started)) == NULL &&
+		       writer.active_workers > 0)
+			tt_pthread_cond_wait(&writer.cond, &writer.mutex);
+		if (worker == NULL)
+			break;
+		bool skip = writer.is_aborted;
+		tt_pthread_mutex_unlock(&writer.mutex);
+		if (!skip && xlog_write_batch(snap, &worker->batch) < 0)
+			rc = -1;
+		tt_pthread_mutex_lock(&writer.mutex);
+		if (rc != 0)
+			writer.is_aborted = true;
+		writer.write_lsn += CHECKPOINT_BATCH_ROWS;
+		worker->is_submitted = false;
+		tt_pthread_cond_broadcast(&writer.cond);
+		if (snap->rows / 100000 != rows / 100000)
+			say_crit("%.1fM rows written", snap->rows / 1000000.0);
+		rows = snap->rows;
+	}
+	tt_pthread_mutex_unlock(&writer.mutex);
+	for (int i = 0; i < started; i++) {
+		if (cord_join(&workers[i].cord) != 0)
+			rc = -1;
+	}
+	if (rc != 0)
+		diag_raise();
+}
+
 int
 checkpoint_f(va_list ap)
 {
@@ -579,6 +1486,16 @@ checkpoint_f(va_list ap)
 	say_info("saving snapshot `%s'", snap.filename);
 	struct checkpoint_entry *entry;
 	rlist_foreach_entry(entry, &ckpt->entries, link) {
+		/*
+		 * System spaces must precede user spaces in
+		 * the file, since recovery creates the latter
+		 * from the rows of the former.
+		 */
+		if (ckpt->snap_write_threads > 1 &&
+		    !space_is_system(entry->space)) {
+			checkpoint_write_parallel(ckpt, &snap, entry);
+			break;
+		}
 		uint32_t size;
 		const char *data;
 		struct snapshot_iterator *it = entry->iterator;
@@ -600,7 +1517,8 @@ MemtxEngine::beginCheckpoint()
 
 	m_checkpoint = region_alloc_object_xc(&fiber()->gc, struct checkpoint);
 
-	checkpoint_init(m_checkpoint, m_snap_dir.dirname, m_snap_io_rate_limit);
+	checkpoint_init(m_checkpoint, m_snap_dir.dirname, m_snap_io_rate_limit,
+			m_snap_dir.compression_level, m_snap_write_threads);
 	space_foreach_xc(checkpoint_add_space, m_checkpoint);
 
 	/* increment snapshot version; set tuple deletion to delayed mode */
@@ -73,13 +73,15 @@ extern struct mempool memtx_index_extent_pool;
 struct MemtxEngine: public Engine {
 	MemtxEngine(const char *snap_dirname, bool force_recovery,
 		    uint64_t tuple_arena_max_size,
-		    uint32_t objsize_min, float alloc_factor);
+		    uint32_t objsize_min, float alloc_factor,
+		    int snap_compression_level);
 	~MemtxEngine();
 	virtual Handler *createSpace(struct rlist *key_list,
 				     struct field_def *fields,
 				     uint32_t field_count, uint32_t index_count,
 				     uint32_t exact_field_count) override;
 	virtual void begin(struct txn *txn) override;
+	virtual void beginStatement(struct txn *txn) override;
 	virtual void rollbackStatement(struct txn *,
 				       struct txn_stmt *stmt) override;
 	virtual void rollback(struct txn *txn) override;
@@ -103,7 +105,23 @@ struct MemtxEngine: public Engine {
 	{
 		m_snap_io_rate_limit = new_limit * 1024 * 1024;
 	}
+	/* Update snap_write_threads. */
+	void setSnapWriteThreads(int snap_write_threads)
+	{
+		m_snap_write_threads = snap_write_threads;
+	}
+	/* Set the number of threads decoding the snapshot at recovery. */
+	void setSnapReadThreads(int snap_read_threads)
+	{
+		m_snap_read_threads = snap_read_threads;
+	}
 	void setMaxTupleSize(size_t max_size);
+	/**
+	 * Enable multi-version concurrency control of memtx
+	 * spaces, see memtx_tx.h. Must be called before
+	 * recovery.
+	 */
+	void setUseMvccEngine(bool use_mvcc_engine);
 	/**
 	 * Return LSN and vclock of the most recent snapshot
 	 * or -1 if there is no snapshot.
@@ -143,12 +161,18 @@ public:
 private:
 	void
 	recoverSnapshotRow(struct xrow_header *row);
+	void
+	recoverSnapshotParallel(struct xlog_cursor *cursor, int64_t signature);
 	/** Non-zero if there is a checkpoint (snapshot) in progress. */
 	struct checkpoint *m_checkpoint;
 	/** The directory where to store snapshots. */
 	struct xdir m_snap_dir;
 	/** Limit disk usage of checkpointing (bytes per second). */
 	uint64_t m_snap_io_rate_limit;
+	/** The number of threads encoding snapshot rows. */
+	int m_snap_write_threads;
+	/** The number of threads decoding the snapshot at recovery. */
+	int m_snap_read_threads;
 	bool m_force_recovery;
 };
 
@@ -157,6 +181,9 @@ enum {
 	MEMTX_SLAB_SIZE = 4 * 1024 * 1024
 };
 
+/** The max number of threads writing or reading a snapshot. */
+enum { MEMTX_SNAP_THREADS_MAX = 64 };
+
 /**
  * Initialize arena for indexes.
  * The arena is used for memtx_index_extent_alloc
@@ -34,6 +34,7 @@
 #include "tuple_compare.h"
 #include "tuple_hash.h"
 #include "memtx_engine.h"
+#include "memtx_tx.h"
 #include "space.h"
 #include "schema.h" /* space_cache_find() */
 #include "errinj.h"
@@ -170,7 +171,7 @@ MemtxHash::random(uint32_t rnd) const
 		rnd++;
 		rnd %= (hash_table->table_size);
 	}
-	return light_index_get(hash_table, rnd);
+	return memtx_tx_clarify_random(this, light_index_get(hash_table, rnd));
 }
 
 struct tuple *
@@ -184,7 +185,7 @@ MemtxHash::findByKey(const char *key, uint32_t part_count) const
 	uint32_t k = light_index_find_key(hash_table, h, key);
 	if (k != light_index_end)
 		ret = light_index_get(hash_table, k);
-	return ret;
+	return memtx_tx_clarify(this, ret);
 }
 
 struct tuple *
@@ -252,7 +253,7 @@ MemtxHash::allocIterator() const
 	it->base.free = hash_iterator_free;
 	it->hash_table = hash_table;
 	light_index_iterator_begin(it->hash_table, &it->iterator);
-	return (struct iterator *) it;
+	return memtx_tx_iterator_wrap(this, (struct iterator *) it);
 }
 
 void
@@ -261,6 +262,7 @@ MemtxHash::initIterator(struct iterator *ptr, enum iterator_type type,
 {
 	assert(part_count == 0 || key != NULL);
 	(void) part_count;
+	ptr = memtx_tx_iterator_unwrap(ptr);
 	assert(ptr->free == hash_iterator_free);
 
 	struct hash_iterator *it = (struct hash_iterator *) ptr;
@@ -31,6 +31,7 @@
  */
 #include "index.h"
 #include "memtx_index.h"
+#include "memtx_tx.h"
 #include "tuple.h"
 #include "say.h"
 #include "schema.h"
@@ -74,7 +75,8 @@ size_t
 MemtxIndex::count(enum iterator_type type, const char *key,
 		  uint32_t part_count) const
 {
-	if (type == ITER_ALL)
+	/* Indexes may store versions invisible to the reader. */
+	if (type == ITER_ALL && memtx_tx_manager.story_count == 0)
 		return size(); /* optimization */
 	struct iterator *it = position();
 	initIterator(it, type, key, part_count);
@@ -86,7 +88,7 @@ MemtxIndex::count(enum iterator_type type, const char *key,
 }
 
 void
-index_build(MemtxIndex *index, MemtxIndex *pk)
+index_build_fill(MemtxIndex *index, MemtxIndex *pk)
 {
 	uint32_t n_tuples = pk->size();
 	uint32_t estimated_tuples = n_tuples * 1.2;
@@ -105,6 +107,11 @@ index_build(MemtxIndex *index, MemtxIndex *pk)
 	struct tuple *tuple;
 	while ((tuple = it->next(it)))
 		index->buildNext(tuple);
+}
 
+void
+index_build(MemtxIndex *index, MemtxIndex *pk)
+{
+	index_build_fill(index, pk);
 	index->endBuild();
 }
@@ -76,6 +76,13 @@ protected:
 	mutable struct iterator *m_position;
 };
 
+/**
+ * Begin building this index and add all tuples of another
+ * index to it. The build must be completed with endBuild().
+ */
+void
+index_build_fill(MemtxIndex *index, MemtxIndex *pk);
+
 /** Build this index based on the contents of another index. */
 void
 index_build(MemtxIndex *index, MemtxIndex *pk);
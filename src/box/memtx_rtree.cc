@@ -39,6 +39,7 @@
 #include "tuple.h"
 #include "space.h"
 #include "memtx_engine.h"
+#include "memtx_tx.h"
 
 /* {{{ Utilities. *************************************************/
 
@@ -126,11 +127,29 @@ extract_rectangle(struct rtree_rect *rect, const struct tuple *tuple,
 			  "Field", dimension, dimension * 2);
 	}
 }
+
+/**
+ * Check a tuple found by an R-tree search against the search
+ * rectangle. Unless coordinates are doubles, the tree stores
+ * rounded bounding boxes and finds a superset of matches.
+ */
+static inline bool
+rtree_tuple_matches(struct tuple *tuple, struct index_def *index_def,
+		    const struct rtree_rect *rect, enum spatial_search_op op)
+{
+	if (index_def->opts.coord_type == RTREE_INDEX_COORD_TYPE_DOUBLE)
+		return true;
+	struct rtree_rect tuple_rect;
+	extract_rectangle(&tuple_rect, tuple, index_def);
+	return rtree_rect_match(&tuple_rect, rect, op,
+				index_def->opts.dimension);
+}
 /* {{{ MemtxRTree Iterators ****************************************/
 
 struct index_rtree_iterator {
         struct iterator base;
         struct rtree_iterator impl;
+        struct index_def *index_def;
 };
 
 static void
@@ -146,7 +165,13 @@ static struct tuple *
 index_rtree_iterator_next(struct iterator *i)
 {
 	struct index_rtree_iterator *itr = (struct index_rtree_iterator *)i;
-	return (struct tuple *)rtree_iterator_next(&itr->impl);
+	struct tuple *tuple;
+	do {
+		tuple = (struct tuple *)rtree_iterator_next(&itr->impl);
+	} while (tuple != NULL &&
+		 !rtree_tuple_matches(tuple, itr->index_def,
+				      &itr->impl.rect, itr->impl.op));
+	return tuple;
 }
 
 /* }}} */
@@ -161,10 +186,14 @@ MemtxRTree::~MemtxRTree()
 		m_position = NULL;
 	}
 	rtree_destroy(&m_tree);
+	free(build_array);
 }
 
 MemtxRTree::MemtxRTree(struct index_def *index_def_arg)
-	: MemtxIndex(index_def_arg)
+	: MemtxIndex(index_def_arg),
+	build_array(NULL),
+	build_array_size(0),
+	build_array_alloc_size(0)
 {
 	assert(index_def->key_def->part_count == 1);
 	assert(index_def->key_def->parts[0].type == FIELD_TYPE_ARRAY);
@@ -183,9 +212,14 @@ MemtxRTree::MemtxRTree(struct index_def *index_def_arg)
 	assert((int)RTREE_MANHATTAN == (int)RTREE_INDEX_DISTANCE_TYPE_MANHATTAN);
 	enum rtree_distance_type distance_type =
 		(enum rtree_distance_type)(int)index_def->opts.distance;
+	assert((int)RTREE_COORD_DOUBLE == (int)RTREE_INDEX_COORD_TYPE_DOUBLE);
+	assert((int)RTREE_COORD_FLOAT == (int)RTREE_INDEX_COORD_TYPE_FLOAT);
+	assert((int)RTREE_COORD_INT32 == (int)RTREE_INDEX_COORD_TYPE_INT32);
+	enum rtree_coord_type coord_type =
+		(enum rtree_coord_type)(int)index_def->opts.coord_type;
 	rtree_init(&m_tree, m_dimension, MEMTX_EXTENT_SIZE,
 		   memtx_index_extent_alloc, memtx_index_extent_free, NULL,
-		   distance_type);
+		   distance_type, coord_type);
 }
 
 size_t
@@ -211,8 +245,14 @@ MemtxRTree::findByKey(const char *key, uint32_t part_count) const
 		unreachable();
 
 	struct tuple *result = NULL;
-	if (rtree_search(&m_tree, &rect, SOP_OVERLAPS, &iterator))
-		result = (struct tuple *)rtree_iterator_next(&iterator);
+	if (rtree_search(&m_tree, &rect, SOP_OVERLAPS, &iterator)) {
+		do {
+			result = (struct tuple *)rtree_iterator_next(&iterator);
+		} while (result != NULL &&
+			 (!rtree_tuple_matches(result, index_def, &rect,
+					       SOP_OVERLAPS) ||
+			  (result = memtx_tx_clarify(this, result)) == NULL));
+	}
 	rtree_iterator_destroy(&iterator);
 	return result;
 }
@@ -245,15 +285,17 @@ MemtxRTree::allocIterator() const
 	}
 	memset(it, 0, sizeof(*it));
 	rtree_iterator_init(&it->impl);
+	it->index_def = index_def;
 	it->base.next = index_rtree_iterator_next;
 	it->base.free = index_rtree_iterator_free;
-	return &it->base;
+	return memtx_tx_iterator_wrap(this, &it->base);
 }
 
 void
 MemtxRTree::initIterator(struct iterator *iterator, enum iterator_type type,
 			 const char *key, uint32_t part_count) const
 {
+	iterator = memtx_tx_iterator_unwrap(iterator);
 	index_rtree_iterator *it = (index_rtree_iterator *)iterator;
 
 	struct rtree_rect rect;
@@ -306,3 +348,59 @@ MemtxRTree::beginBuild()
 	rtree_purge(&m_tree);
 }
 
+void
+MemtxRTree::reserve(uint32_t size_hint)
+{
+	if (size_hint < build_array_alloc_size)
+		return;
+	size_t elem_size = rtree_bulk_elem_size(&m_tree);
+	char *tmp = (char *) realloc(build_array, size_hint * elem_size);
+	if (tmp == NULL)
+		tnt_raise(OutOfMemory, size_hint * elem_size,
+			  "MemtxRTree", "reserve");
+	build_array = tmp;
+	build_array_alloc_size = size_hint;
+}
+
+void
+MemtxRTree::buildNext(struct tuple *tuple)
+{
+	struct rtree_rect rect;
+	extract_rectangle(&rect, tuple, index_def);
+	size_t elem_size = rtree_bulk_elem_size(&m_tree);
+	if (build_array == NULL) {
+		build_array = (char *) malloc(MEMTX_EXTENT_SIZE);
+		if (build_array == NULL) {
+			tnt_raise(OutOfMemory, MEMTX_EXTENT_SIZE,
+				  "MemtxRTree", "buildNext");
+		}
+		build_array_alloc_size = MEMTX_EXTENT_SIZE / elem_size;
+	}
+	assert(build_array_size <= build_array_alloc_size);
+	if (build_array_size == build_array_alloc_size) {
+		build_array_alloc_size = build_array_alloc_size +
+					 build_array_alloc_size / 2;
+		char *tmp = (char *) realloc(build_array,
+					     build_array_alloc_size *
+					     elem_size);
+		if (tmp == NULL) {
+			tnt_raise(OutOfMemory, build_array_alloc_size *
+				  elem_size, "MemtxRTree", "buildNext");
+		}
+		build_array = tmp;
+	}
+	rtree_bulk_elem_set(&m_tree, build_array +
+			    build_array_size++ * elem_size, &rect, tuple);
+}
+
+void
+MemtxRTree::endBuild()
+{
+	rtree_bulk_load(&m_tree, build_array, build_array_size);
+
+	free(build_array);
+	build_array = NULL;
+	build_array_size = 0;
+	build_array_alloc_size = 0;
+}
+
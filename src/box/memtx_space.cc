@@ -40,6 +40,7 @@
 #include "memtx_bitset.h"
 #include "port.h"
 #include "memtx_tuple.h"
+#include "memtx_tx.h"
 #include "column_mask.h"
 #include "sequence.h"
 
@@ -198,6 +199,10 @@ void
 memtx_replace_all_keys(struct txn_stmt *stmt, struct space *space,
 		       enum dup_replace_mode mode)
 {
+	if (memtx_tx_space_is_versioned(space)) {
+		memtx_tx_replace(stmt, space, mode);
+		return;
+	}
 	struct tuple *old_tuple = stmt->old_tuple;
 	struct tuple *new_tuple = stmt->new_tuple;
 	/*
@@ -626,7 +631,7 @@ MemtxSpace::createIndex(struct space *space, struct index_def *index_def_arg)
 	case HASH:
 		return new MemtxHash(index_def_arg);
 	case TREE:
-		return new MemtxTree(index_def_arg);
+		return MemtxTree::create(index_def_arg);
 	case RTREE:
 		return new MemtxRTree(index_def_arg);
 	case BITSET:
@@ -750,11 +755,26 @@ MemtxSpace::buildSecondaryKey(struct space *old_space,
 	}
 }
 
+/**
+ * Versions of tuples, which are still in use by concurrent
+ * transactions, are linked to indexes of the space, so
+ * they must be gone before the space can be altered.
+ */
+static void
+memtx_check_space_history(struct space *space)
+{
+	if (memtx_tx_space_has_history(space)) {
+		tnt_raise(ClientError, ER_ALTER_SPACE, space_name(space),
+			  "the space is used by a concurrent transaction");
+	}
+}
+
 void
 MemtxSpace::prepareTruncateSpace(struct space *old_space,
 				 struct space *new_space)
 {
 	(void)new_space;
+	memtx_check_space_history(old_space);
 	MemtxSpace *handler = (MemtxSpace *) old_space->handler;
 	replace = handler->replace;
 }
@@ -795,6 +815,7 @@ void
 MemtxSpace::prepareAlterSpace(struct space *old_space, struct space *new_space)
 {
 	(void)new_space;
+	memtx_check_space_history(old_space);
 	MemtxSpace *handler = (MemtxSpace *) old_space->handler;
 	replace = handler->replace;
 }
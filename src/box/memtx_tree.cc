@@ -29,49 +29,268 @@
  * SUCH DAMAGE.
  */
 #include "memtx_tree.h"
+#include "memtx_tx.h"
 #include "space.h"
 #include "schema.h" /* space_cache_find() */
 #include "errinj.h"
 #include "memory.h"
 #include "fiber.h"
 #include <third_party/qsort_arg.h>
+#include <math.h>
 
 /* {{{ Utilities. *************************************************/
 
+template <class Data>
 static int
 memtx_tree_qcompare(const void* a, const void *b, void *c)
 {
-	return tuple_compare(*(struct tuple **)a,
-		*(struct tuple **)b, (struct key_def *)c);
+	return memtx_tree_compare(*(Data *)a, *(Data *)b,
+				  (struct key_def *)c);
 }
 
+/* }}} */
+
+/* {{{ Comparison hints *******************************************/
+
+/**
+ * Map a signed integer to an unsigned one preserving
+ * the order.
+ */
+static inline uint64_t
+memtx_tree_hint_int(int64_t val)
+{
+	return (uint64_t) val ^ (1ULL << 63);
+}
+
+/**
+ * Map a double to an unsigned integer preserving the order
+ * used by tuple comparators: NaN is less than any number,
+ * -0.0 equals 0.0.
+ */
+static inline uint64_t
+memtx_tree_hint_double(double val)
+{
+	if (isnan(val))
+		return 0;
+	if (val == 0)
+		val = 0;
+	uint64_t bits;
+	memcpy(&bits, &val, sizeof(bits));
+	return (bits & (1ULL << 63)) != 0 ? ~bits : bits | (1ULL << 63);
+}
+
+/** Calculate the comparison hint of a msgpack field. */
+static uint64_t
+memtx_tree_hint_field(const char *field, enum field_type type)
+{
+	switch (type) {
+	case FIELD_TYPE_UNSIGNED:
+		return mp_decode_uint(&field);
+	case FIELD_TYPE_INTEGER:
+		if (mp_typeof(*field) == MP_INT)
+			return memtx_tree_hint_int(mp_decode_int(&field));
+		return memtx_tree_hint_int(MIN(mp_decode_uint(&field),
+					       (uint64_t) INT64_MAX));
+	case FIELD_TYPE_NUMBER:
+		/*
+		 * Conversion of integers to double is not exact,
+		 * but it preserves the order, which is enough for
+		 * the hint.
+		 */
+		switch (mp_typeof(*field)) {
+		case MP_UINT:
+			return memtx_tree_hint_double(mp_decode_uint(&field));
+		case MP_INT:
+			return memtx_tree_hint_double(mp_decode_int(&field));
+		case MP_FLOAT:
+			return memtx_tree_hint_double(mp_decode_float(&field));
+		case MP_DOUBLE:
+			return memtx_tree_hint_double(mp_decode_double(&field));
+		default:
+			unreachable();
+			return 0;
+		}
+	case FIELD_TYPE_STRING: {
+		/*
+		 * Strings are compared with memcmp(), so the
+		 * hint is the first 8 bytes in big endian,
+		 * padded with zeros.
+		 */
+		uint32_t len;
+		const char *str = mp_decode_str(&field, &len);
+		uint64_t hint = 0;
+		for (uint32_t i = 0; i < sizeof(hint); i++) {
+			hint <<= 8;
+			if (i < len)
+				hint |= (unsigned char) str[i];
+		}
+		return hint;
+	}
+	default:
+		return 0;
+	}
+}
+
+uint64_t
+memtx_tree_hint(const struct tuple *tuple, const struct key_def *def)
+{
+	const struct key_part *part = &def->parts[0];
+	const char *field = tuple_field(tuple, part->fieldno);
+	assert(field != NULL);
+	return memtx_tree_hint_field(field, part->type);
+}
+
+uint64_t
+memtx_tree_key_hint(const char *key, uint32_t part_count,
+		    const struct key_def *def)
+{
+	if (part_count == 0)
+		return 0;
+	return memtx_tree_hint_field(key, def->parts[0].type);
+}
+
+
+static inline void
+memtx_tree_data_create(struct memtx_tree_data *data, struct tuple *tuple,
+		       const struct key_def *def)
+{
+	(void) def;
+	data->tuple = tuple;
+}
+
+static inline void
+memtx_tree_data_create(struct memtx_hint_tree_data *data,
+		       struct tuple *tuple, const struct key_def *def)
+{
+	data->tuple = tuple;
+	data->hint = memtx_tree_hint(tuple, def);
+}
+
+/* }}} */
+
+/* {{{ Tree traits ************************************************/
+
+/**
+ * Define a traits class binding MemtxTreeImpl to the BPS
+ * tree instance @a name, whose elements are struct
+ * name##_data.
+ */
+#define MEMTX_TREE_TRAITS(traits, name, has_hint_arg)			\
+struct traits {								\
+	typedef struct name tree_t;					\
+	typedef struct name##_iterator iterator_t;			\
+	typedef struct name##_data data_t;				\
+	/** Set if elements carry a comparison hint. */			\
+	static const bool has_hint = has_hint_arg;			\
+									\
+	static inline void						\
+	create(tree_t *tree, struct key_def *def)			\
+	{								\
+		name##_create(tree, def, memtx_index_extent_alloc,	\
+			      memtx_index_extent_free, NULL);		\
+	}								\
+	static inline void						\
+	destroy(tree_t *tree)						\
+	{ name##_destroy(tree); }					\
+	static inline int						\
+	build(tree_t *tree, data_t *array, size_t size)			\
+	{ return name##_build(tree, array, size); }			\
+	static inline size_t						\
+	size(const tree_t *tree)					\
+	{ return name##_size(tree); }					\
+	static inline size_t						\
+	mem_used(const tree_t *tree)					\
+	{ return name##_mem_used(tree); }				\
+	static inline data_t *						\
+	random(const tree_t *tree, size_t rnd)				\
+	{ return name##_random(tree, rnd); }				\
+	static inline data_t *						\
+	find(const tree_t *tree, struct memtx_tree_key_data *key)	\
+	{ return name##_find(tree, key); }				\
+	static inline int						\
+	insert(tree_t *tree, data_t data, data_t *replaced)		\
+	{ return name##_insert(tree, data, replaced); }			\
+	static inline int						\
+	remove(tree_t *tree, data_t data)				\
+	{ return name##_delete(tree, data); }				\
+	static inline iterator_t					\
+	invalid_iterator()						\
+	{ return name##_invalid_iterator(); }				\
+	static inline iterator_t					\
+	iterator_first(const tree_t *tree)				\
+	{ return name##_iterator_first(tree); }				\
+	static inline iterator_t					\
+	iterator_last(const tree_t *tree)				\
+	{ return name##_iterator_last(tree); }				\
+	static inline iterator_t					\
+	lower_bound(const tree_t *tree,					\
+		    struct memtx_tree_key_data *key, bool *exact)	\
+	{ return name##_lower_bound(tree, key, exact); }		\
+	static inline iterator_t					\
+	upper_bound(const tree_t *tree,					\
+		    struct memtx_tree_key_data *key, bool *exact)	\
+	{ return name##_upper_bound(tree, key, exact); }		\
+	static inline iterator_t					\
+	lower_bound_elem(const tree_t *tree, data_t data, bool *exact)	\
+	{ return name##_lower_bound_elem(tree, data, exact); }		\
+	static inline iterator_t					\
+	upper_bound_elem(const tree_t *tree, data_t data, bool *exact)	\
+	{ return name##_upper_bound_elem(tree, data, exact); }		\
+	static inline data_t *						\
+	iterator_get_elem(const tree_t *tree, iterator_t *itr)		\
+	{ return name##_iterator_get_elem(tree, itr); }			\
+	static inline bool						\
+	iterator_next(const tree_t *tree, iterator_t *itr)		\
+	{ return name##_iterator_next(tree, itr); }			\
+	static inline bool						\
+	iterator_prev(const tree_t *tree, iterator_t *itr)		\
+	{ return name##_iterator_prev(tree, itr); }			\
+	static inline void						\
+	iterator_freeze(tree_t *tree, iterator_t *itr)			\
+	{ name##_iterator_freeze(tree, itr); }				\
+	static inline void						\
+	iterator_destroy(tree_t *tree, iterator_t *itr)			\
+	{ name##_iterator_destroy(tree, itr); }				\
+}
+
+MEMTX_TREE_TRAITS(memtx_tree_traits, memtx_tree, false);
+MEMTX_TREE_TRAITS(memtx_hint_tree_traits, memtx_hint_tree, true);
+
+#undef MEMTX_TREE_TRAITS
+
+/* }}} */
+
 /* {{{ MemtxTree Iterators ****************************************/
+template <class Traits>
 struct tree_iterator {
 	struct iterator base;
-	const struct memtx_tree *tree;
+	const typename Traits::tree_t *tree;
 	struct index_def *index_def;
-	struct memtx_tree_iterator tree_iterator;
+	typename Traits::iterator_t tree_iterator;
 	enum iterator_type type;
 	struct memtx_tree_key_data key_data;
-	struct tuple *current_tuple;
+	typename Traits::data_t current;
 };
 
+template <class Traits>
 static void
 tree_iterator_free(struct iterator *iterator);
 
-static inline struct tree_iterator *
-tree_iterator(struct iterator *it)
+template <class Traits>
+static inline struct tree_iterator<Traits> *
+tree_iterator_cast(struct iterator *it)
 {
-	assert(it->free == tree_iterator_free);
-	return (struct tree_iterator *) it;
+	assert(it->free == tree_iterator_free<Traits>);
+	return (struct tree_iterator<Traits> *) it;
 }
 
+template <class Traits>
 static void
 tree_iterator_free(struct iterator *iterator)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	if (it->current_tuple != NULL)
-		tuple_unref(it->current_tuple);
+	struct tree_iterator<Traits> *it = tree_iterator_cast<Traits>(iterator);
+	if (it->current.tuple != NULL)
+		tuple_unref(it->current.tuple);
 	free(iterator);
 }
 
@@ -82,126 +301,134 @@ tree_iterator_dummie(struct iterator *iterator)
 	return 0;
 }
 
+template <class Traits>
 static struct tuple *
 tree_iterator_next(struct iterator *iterator)
 {
-	tuple **res;
-	struct tree_iterator *it = tree_iterator(iterator);
-	assert(it->current_tuple != NULL);
-	tuple **check = memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
-	if (check == NULL || *check != it->current_tuple)
+	typename Traits::data_t *res;
+	struct tree_iterator<Traits> *it = tree_iterator_cast<Traits>(iterator);
+	assert(it->current.tuple != NULL);
+	typename Traits::data_t *check =
+		Traits::iterator_get_elem(it->tree, &it->tree_iterator);
+	if (check == NULL || check->tuple != it->current.tuple)
 		it->tree_iterator =
-			memtx_tree_upper_bound_elem(it->tree, it->current_tuple,
-						    NULL);
+			Traits::upper_bound_elem(it->tree, it->current, NULL);
 	else
-		memtx_tree_iterator_next(it->tree, &it->tree_iterator);
-	tuple_unref(it->current_tuple);
-	it->current_tuple = NULL;
-	res = memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
+		Traits::iterator_next(it->tree, &it->tree_iterator);
+	tuple_unref(it->current.tuple);
+	it->current.tuple = NULL;
+	res = Traits::iterator_get_elem(it->tree, &it->tree_iterator);
 	if (res == NULL) {
 		iterator->next = tree_iterator_dummie;
 		return NULL;
 	}
-	it->current_tuple = *res;
-	tuple_ref(it->current_tuple);
-	return *res;
+	it->current = *res;
+	tuple_ref(it->current.tuple);
+	return res->tuple;
 }
 
+template <class Traits>
 static struct tuple *
 tree_iterator_prev(struct iterator *iterator)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	assert(it->current_tuple != NULL);
-	tuple **check = memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
-	if (check == NULL || *check != it->current_tuple)
+	struct tree_iterator<Traits> *it = tree_iterator_cast<Traits>(iterator);
+	assert(it->current.tuple != NULL);
+	typename Traits::data_t *check =
+		Traits::iterator_get_elem(it->tree, &it->tree_iterator);
+	if (check == NULL || check->tuple != it->current.tuple)
 		it->tree_iterator =
-			memtx_tree_lower_bound_elem(it->tree, it->current_tuple,
-						    NULL);
-	memtx_tree_iterator_prev(it->tree, &it->tree_iterator);
-	tuple_unref(it->current_tuple);
-	it->current_tuple = NULL;
-	tuple **res = memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
+			Traits::lower_bound_elem(it->tree, it->current, NULL);
+	Traits::iterator_prev(it->tree, &it->tree_iterator);
+	tuple_unref(it->current.tuple);
+	it->current.tuple = NULL;
+	typename Traits::data_t *res =
+		Traits::iterator_get_elem(it->tree, &it->tree_iterator);
 	if (!res) {
 		iterator->next = tree_iterator_dummie;
 		return NULL;
 	}
-	it->current_tuple = *res;
-	tuple_ref(it->current_tuple);
-	return *res;
+	it->current = *res;
+	tuple_ref(it->current.tuple);
+	return res->tuple;
 }
 
+template <class Traits>
 static struct tuple *
 tree_iterator_next_equal(struct iterator *iterator)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	assert(it->current_tuple != NULL);
-	tuple **check = memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
-	if (check == NULL || *check != it->current_tuple)
+	struct tree_iterator<Traits> *it = tree_iterator_cast<Traits>(iterator);
+	assert(it->current.tuple != NULL);
+	typename Traits::data_t *check =
+		Traits::iterator_get_elem(it->tree, &it->tree_iterator);
+	if (check == NULL || check->tuple != it->current.tuple)
 		it->tree_iterator =
-			memtx_tree_upper_bound_elem(it->tree, it->current_tuple,
-						    NULL);
+			Traits::upper_bound_elem(it->tree, it->current, NULL);
 	else
-		memtx_tree_iterator_next(it->tree, &it->tree_iterator);
-	tuple_unref(it->current_tuple);
-	it->current_tuple = NULL;
-	tuple **res = memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
+		Traits::iterator_next(it->tree, &it->tree_iterator);
+	tuple_unref(it->current.tuple);
+	it->current.tuple = NULL;
+	typename Traits::data_t *res =
+		Traits::iterator_get_elem(it->tree, &it->tree_iterator);
 	/* Use user key def to save a few loops. */
 	if (!res || memtx_tree_compare_key(*res, &it->key_data,
 					   it->index_def->key_def) != 0) {
 		iterator->next = tree_iterator_dummie;
 		return NULL;
 	}
-	it->current_tuple = *res;
-	tuple_ref(it->current_tuple);
-	return *res;
+	it->current = *res;
+	tuple_ref(it->current.tuple);
+	return res->tuple;
 }
 
+template <class Traits>
 static struct tuple *
 tree_iterator_prev_equal(struct iterator *iterator)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	assert(it->current_tuple != NULL);
-	tuple **check = memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
-	if (check == NULL || *check != it->current_tuple)
+	struct tree_iterator<Traits> *it = tree_iterator_cast<Traits>(iterator);
+	assert(it->current.tuple != NULL);
+	typename Traits::data_t *check =
+		Traits::iterator_get_elem(it->tree, &it->tree_iterator);
+	if (check == NULL || check->tuple != it->current.tuple)
 		it->tree_iterator =
-			memtx_tree_lower_bound_elem(it->tree, it->current_tuple,
-						    NULL);
-	memtx_tree_iterator_prev(it->tree, &it->tree_iterator);
-	tuple_unref(it->current_tuple);
-	it->current_tuple = NULL;
-	tuple **res = memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
+			Traits::lower_bound_elem(it->tree, it->current, NULL);
+	Traits::iterator_prev(it->tree, &it->tree_iterator);
+	tuple_unref(it->current.tuple);
+	it->current.tuple = NULL;
+	typename Traits::data_t *res =
+		Traits::iterator_get_elem(it->tree, &it->tree_iterator);
 	/* Use user key def to save a few loops. */
 	if (!res || memtx_tree_compare_key(*res, &it->key_data,
 					   it->index_def->key_def) != 0) {
 		iterator->next = tree_iterator_dummie;
 		return NULL;
 	}
-	it->current_tuple = *res;
-	tuple_ref(it->current_tuple);
-	return *res;
+	it->current = *res;
+	tuple_ref(it->current.tuple);
+	return res->tuple;
 }
 
+template <class Traits>
 static void
-tree_iterator_set_next_method(struct tree_iterator *it)
+tree_iterator_set_next_method(struct tree_iterator<Traits> *it)
 {
-	assert(it->current_tuple != NULL);
+	assert(it->current.tuple != NULL);
 	switch (it->type) {
 	case ITER_EQ:
-		it->base.next = tree_iterator_next_equal;
+		it->base.next = tree_iterator_next_equal<Traits>;
 		break;
 	case ITER_REQ:
-		it->base.next = tree_iterator_prev_equal;
+		it->base.next = tree_iterator_prev_equal<Traits>;
 		break;
 	case ITER_ALL:
-		it->base.next = tree_iterator_next;
+		it->base.next = tree_iterator_next<Traits>;
 		break;
 	case ITER_LT:
 	case ITER_LE:
-		it->base.next = tree_iterator_prev;
+		it->base.next = tree_iterator_prev<Traits>;
 		break;
 	case ITER_GE:
 	case ITER_GT:
-		it->base.next = tree_iterator_next;
+		it->base.next = tree_iterator_next<Traits>;
 		break;
 	default:
 		/* The type was checked in initIterator */
@@ -209,32 +436,33 @@ tree_iterator_set_next_method(struct tree_iterator *it)
 	}
 }
 
+template <class Traits>
 static struct tuple *
 tree_iterator_start(struct iterator *iterator)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
+	struct tree_iterator<Traits> *it = tree_iterator_cast<Traits>(iterator);
 	it->base.next = tree_iterator_dummie;
-	const memtx_tree *tree = it->tree;
+	const typename Traits::tree_t *tree = it->tree;
 	enum iterator_type type = it->type;
 	bool exact = false;
-	assert(it->current_tuple == NULL);
+	assert(it->current.tuple == NULL);
 	if (it->key_data.key == 0) {
 		if (iterator_type_is_reverse(it->type))
-			it->tree_iterator = memtx_tree_iterator_last(tree);
+			it->tree_iterator = Traits::iterator_last(tree);
 		else
-			it->tree_iterator = memtx_tree_iterator_first(tree);
+			it->tree_iterator = Traits::iterator_first(tree);
 	} else {
 		if (type == ITER_ALL || type == ITER_EQ ||
 		    type == ITER_GE || type == ITER_LT) {
 			it->tree_iterator =
-				memtx_tree_lower_bound(tree, &it->key_data,
-						       &exact);
+				Traits::lower_bound(tree, &it->key_data,
+						    &exact);
 			if (type == ITER_EQ && !exact)
 				return NULL;
 		} else { // ITER_GT, ITER_REQ, ITER_LE
 			it->tree_iterator =
-				memtx_tree_upper_bound(tree, &it->key_data,
-						       &exact);
+				Traits::upper_bound(tree, &it->key_data,
+						    &exact);
 			if (type == ITER_REQ && !exact)
 				return NULL;
 		}
@@ -250,135 +478,198 @@ tree_iterator_start(struct iterator *iterator)
 			 * iterator_next call will convert the iterator to the
 			 * last position in the tree, that's what we need.
 			 */
-			memtx_tree_iterator_prev(it->tree, &it->tree_iterator);
+			Traits::iterator_prev(it->tree, &it->tree_iterator);
 		}
 	}
 
-	tuple **res = memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
+	typename Traits::data_t *res =
+		Traits::iterator_get_elem(it->tree, &it->tree_iterator);
 	if (!res)
 		return NULL;
-	it->current_tuple = *res;
-	tuple_ref(it->current_tuple);
+	it->current = *res;
+	tuple_ref(it->current.tuple);
 	tree_iterator_set_next_method(it);
-	return *res;
+	return res->tuple;
 }
 
 /* }}} */
 
 /* {{{ MemtxTree  **********************************************************/
 
-MemtxTree::MemtxTree(struct index_def *index_def_arg)
-	: MemtxIndex(index_def_arg),
+/**
+ * MemtxTree implementation over the BPS tree instance
+ * described by Traits, @sa MEMTX_TREE_TRAITS.
+ */
+template <class Traits>
+class MemtxTreeImpl: public MemtxTree {
+	typedef typename Traits::tree_t tree_t;
+	typedef typename Traits::data_t data_t;
+public:
+	MemtxTreeImpl(struct index_def *index_def);
+	virtual ~MemtxTreeImpl() override;
+
+	virtual void beginBuild() override;
+	virtual void reserve(uint32_t size_hint) override;
+	virtual void buildNext(struct tuple *tuple) override;
+	virtual void endBuild() override;
+	virtual void sortBuildArray() override;
+	virtual void freeBuildArray() override;
+	virtual size_t size() const override;
+	virtual struct tuple *random(uint32_t rnd) const override;
+	virtual struct tuple *findByKey(const char *key,
+					uint32_t part_count) const override;
+	virtual struct tuple *replace(struct tuple *old_tuple,
+				      struct tuple *new_tuple,
+				      enum dup_replace_mode mode) override;
+
+	virtual size_t bsize() const override;
+	virtual struct iterator *allocIterator() const override;
+	virtual void initIterator(struct iterator *iterator,
+				  enum iterator_type type,
+				  const char *key,
+				  uint32_t part_count) const override;
+	virtual struct snapshot_iterator *createSnapshotIterator() override;
+	virtual int createSnapshotIterators(struct snapshot_iterator **its,
+					    int count) override;
+
+private:
+	tree_t tree;
+	data_t *build_array;
+	size_t build_array_size, build_array_alloc_size;
+	/** Set if sortBuildArray() was called since beginBuild(). */
+	bool build_array_is_sorted;
+};
+
+template <class Traits>
+MemtxTreeImpl<Traits>::MemtxTreeImpl(struct index_def *index_def_arg)
+	: MemtxTree(index_def_arg),
 	build_array(0),
 	build_array_size(0),
-	build_array_alloc_size(0)
+	build_array_alloc_size(0),
+	build_array_is_sorted(false)
 {
 	memtx_index_arena_init();
 	/** Use extended key def only for non-unique indexes. */
 	struct key_def *cmp_def = index_def->opts.is_unique ?
 		index_def->key_def : index_def->cmp_def;
-	memtx_tree_create(&tree, cmp_def,
-			  memtx_index_extent_alloc,
-			  memtx_index_extent_free, NULL);
+	Traits::create(&tree, cmp_def);
 }
 
-MemtxTree::~MemtxTree()
+template <class Traits>
+MemtxTreeImpl<Traits>::~MemtxTreeImpl()
 {
-	memtx_tree_destroy(&tree);
+	Traits::destroy(&tree);
 	free(build_array);
 }
 
+template <class Traits>
 size_t
-MemtxTree::size() const
+MemtxTreeImpl<Traits>::size() const
 {
-	return memtx_tree_size(&tree);
+	return Traits::size(&tree);
 }
 
+template <class Traits>
 size_t
-MemtxTree::bsize() const
+MemtxTreeImpl<Traits>::bsize() const
 {
-	return memtx_tree_mem_used(&tree);
+	return Traits::mem_used(&tree);
 }
 
+template <class Traits>
 struct tuple *
-MemtxTree::random(uint32_t rnd) const
+MemtxTreeImpl<Traits>::random(uint32_t rnd) const
 {
-	struct tuple **res = memtx_tree_random(&tree, rnd);
-	return res ? *res : 0;
+	data_t *res = Traits::random(&tree, rnd);
+	return memtx_tx_clarify_random(this, res ? res->tuple : NULL);
 }
 
+template <class Traits>
 struct tuple *
-MemtxTree::findByKey(const char *key, uint32_t part_count) const
+MemtxTreeImpl<Traits>::findByKey(const char *key, uint32_t part_count) const
 {
 	assert(index_def->opts.is_unique && part_count == index_def->key_def->part_count);
 
 	struct memtx_tree_key_data key_data;
 	key_data.key = key;
 	key_data.part_count = part_count;
-	struct tuple **res = memtx_tree_find(&tree, &key_data);
-	return res ? *res : 0;
+	key_data.hint = Traits::has_hint ?
+		memtx_tree_key_hint(key, part_count, tree.arg) : 0;
+	data_t *res = Traits::find(&tree, &key_data);
+	return memtx_tx_clarify(this, res ? res->tuple : NULL);
 }
 
+template <class Traits>
 struct tuple *
-MemtxTree::replace(struct tuple *old_tuple, struct tuple *new_tuple,
-		   enum dup_replace_mode mode)
+MemtxTreeImpl<Traits>::replace(struct tuple *old_tuple,
+			       struct tuple *new_tuple,
+			       enum dup_replace_mode mode)
 {
 	uint32_t errcode;
 
 	if (new_tuple) {
-		struct tuple *dup_tuple = NULL;
+		data_t new_data;
+		memtx_tree_data_create(&new_data, new_tuple, tree.arg);
+		data_t dup_data;
+		dup_data.tuple = NULL;
 
 		/* Try to optimistically replace the new_tuple. */
 		int tree_res =
-		memtx_tree_insert(&tree, new_tuple, &dup_tuple);
+		Traits::insert(&tree, new_data, &dup_data);
 		if (tree_res) {
 			tnt_raise(OutOfMemory, MEMTX_EXTENT_SIZE,
 				  "MemtxTree", "replace");
 		}
 
-		errcode = replace_check_dup(old_tuple, dup_tuple, mode);
+		errcode = replace_check_dup(old_tuple, dup_data.tuple, mode);
 
 		if (errcode) {
-			memtx_tree_delete(&tree, new_tuple);
-			if (dup_tuple)
-				memtx_tree_insert(&tree, dup_tuple, 0);
+			Traits::remove(&tree, new_data);
+			if (dup_data.tuple)
+				Traits::insert(&tree, dup_data, 0);
 			struct space *sp = space_cache_find(index_def->space_id);
 			tnt_raise(ClientError, errcode, index_name(this),
 				  space_name(sp));
 		}
-		if (dup_tuple)
-			return dup_tuple;
+		if (dup_data.tuple)
+			return dup_data.tuple;
 	}
 	if (old_tuple) {
-		memtx_tree_delete(&tree, old_tuple);
+		data_t old_data;
+		memtx_tree_data_create(&old_data, old_tuple, tree.arg);
+		Traits::remove(&tree, old_data);
 	}
 	return old_tuple;
 }
 
+template <class Traits>
 struct iterator *
-MemtxTree::allocIterator() const
+MemtxTreeImpl<Traits>::allocIterator() const
 {
-	struct tree_iterator *it = (struct tree_iterator *)
+	struct tree_iterator<Traits> *it = (struct tree_iterator<Traits> *)
 			calloc(1, sizeof(*it));
 	if (it == NULL) {
-		tnt_raise(OutOfMemory, sizeof(struct tree_iterator),
+		tnt_raise(OutOfMemory, sizeof(struct tree_iterator<Traits>),
 			  "MemtxTree", "iterator");
 	}
 
 	it->index_def = index_def;
 	it->tree = &tree;
-	it->base.free = tree_iterator_free;
-	it->current_tuple = NULL;
-	it->tree_iterator = memtx_tree_invalid_iterator();
-	return (struct iterator *) it;
+	it->base.free = tree_iterator_free<Traits>;
+	it->current.tuple = NULL;
+	it->tree_iterator = Traits::invalid_iterator();
+	return memtx_tx_iterator_wrap(this, (struct iterator *) it);
 }
 
+template <class Traits>
 void
-MemtxTree::initIterator(struct iterator *iterator, enum iterator_type type,
-			const char *key, uint32_t part_count) const
+MemtxTreeImpl<Traits>::initIterator(struct iterator *iterator,
+				    enum iterator_type type,
+				    const char *key, uint32_t part_count) const
 {
 	assert(part_count == 0 || key != NULL);
-	struct tree_iterator *it = tree_iterator(iterator);
+	iterator = memtx_tx_iterator_unwrap(iterator);
+	struct tree_iterator<Traits> *it = tree_iterator_cast<Traits>(iterator);
 
 	if (type < 0 || type > ITER_GT) /* Unsupported type */
 		return Index::initIterator(iterator, type, key, part_count);
@@ -391,33 +682,37 @@ MemtxTree::initIterator(struct iterator *iterator, enum iterator_type type,
 		type = iterator_type_is_reverse(type) ? ITER_LE : ITER_GE;
 		key = NULL;
 	}
-	if (it->current_tuple) {
+	if (it->current.tuple) {
 		/*
 		 * Free possible leftover tuple if the iterator
 		 * is reused.
 		 */
-		tuple_unref(it->current_tuple);
-		it->current_tuple = NULL;
+		tuple_unref(it->current.tuple);
+		it->current.tuple = NULL;
 	}
 	it->type = type;
 	it->key_data.key = key;
 	it->key_data.part_count = part_count;
-	it->base.next = tree_iterator_start;
-	it->tree_iterator = memtx_tree_invalid_iterator();
+	it->key_data.hint = Traits::has_hint ?
+		memtx_tree_key_hint(key, part_count, it->tree->arg) : 0;
+	it->base.next = tree_iterator_start<Traits>;
+	it->tree_iterator = Traits::invalid_iterator();
 }
 
+template <class Traits>
 void
-MemtxTree::beginBuild()
+MemtxTreeImpl<Traits>::beginBuild()
 {
-	assert(memtx_tree_size(&tree) == 0);
+	assert(Traits::size(&tree) == 0);
 }
 
+template <class Traits>
 void
-MemtxTree::reserve(uint32_t size_hint)
+MemtxTreeImpl<Traits>::reserve(uint32_t size_hint)
 {
 	if (size_hint < build_array_alloc_size)
 		return;
-	struct tuple **tmp = (struct tuple**)
+	data_t *tmp = (data_t *)
 		realloc(build_array, size_hint * sizeof(*tmp));
 	if (tmp == NULL)
 		tnt_raise(OutOfMemory, size_hint * sizeof(*tmp),
@@ -426,23 +721,24 @@ MemtxTree::reserve(uint32_t size_hint)
 	build_array_alloc_size = size_hint;
 }
 
+template <class Traits>
 void
-MemtxTree::buildNext(struct tuple *tuple)
+MemtxTreeImpl<Traits>::buildNext(struct tuple *tuple)
 {
 	if (build_array == NULL) {
-		build_array = (struct tuple**) malloc(MEMTX_EXTENT_SIZE);
+		build_array = (data_t *) malloc(MEMTX_EXTENT_SIZE);
 		if (build_array == NULL) {
 			tnt_raise(OutOfMemory, MEMTX_EXTENT_SIZE,
 				"MemtxTree", "buildNext");
 		}
 		build_array_alloc_size =
-			MEMTX_EXTENT_SIZE / sizeof(struct tuple*);
+			MEMTX_EXTENT_SIZE / sizeof(data_t);
 	}
 	assert(build_array_size <= build_array_alloc_size);
 	if (build_array_size == build_array_alloc_size) {
 		build_array_alloc_size = build_array_alloc_size +
 					 build_array_alloc_size / 2;
-		struct tuple **tmp = (struct tuple **)
+		data_t *tmp = (data_t *)
 			realloc(build_array, build_array_alloc_size *
 				sizeof(*tmp));
 		if (tmp == NULL) {
@@ -451,74 +747,183 @@ MemtxTree::buildNext(struct tuple *tuple)
 		}
 		build_array = tmp;
 	}
-	build_array[build_array_size++] = tuple;
+	data_t *elem = &build_array[build_array_size++];
+	memtx_tree_data_create(elem, tuple, tree.arg);
 }
 
+template <class Traits>
 void
-MemtxTree::endBuild()
+MemtxTreeImpl<Traits>::sortBuildArray()
 {
+	assert(!build_array_is_sorted);
 	/** Use extended key def only for non-unique indexes. */
 	struct key_def *cmp_def = index_def->opts.is_unique ?
 		index_def->key_def : index_def->cmp_def;
-	qsort_arg(build_array, build_array_size,
-		  sizeof(struct tuple *),
-		  memtx_tree_qcompare, cmp_def);
-	memtx_tree_build(&tree, build_array, build_array_size);
+	qsort_arg(build_array, build_array_size, sizeof(data_t),
+		  memtx_tree_qcompare<data_t>, cmp_def);
+	build_array_is_sorted = true;
+}
+
+template <class Traits>
+void
+MemtxTreeImpl<Traits>::endBuild()
+{
+	if (!build_array_is_sorted)
+		sortBuildArray();
+	Traits::build(&tree, build_array, build_array_size);
+	freeBuildArray();
+}
 
+template <class Traits>
+void
+MemtxTreeImpl<Traits>::freeBuildArray()
+{
 	free(build_array);
 	build_array = 0;
 	build_array_size = 0;
 	build_array_alloc_size = 0;
+	build_array_is_sorted = false;
 }
 
+template <class Traits>
 struct tree_snapshot_iterator {
 	struct snapshot_iterator base;
-	struct memtx_tree *tree;
-	struct memtx_tree_iterator tree_iterator;
+	typename Traits::tree_t *tree;
+	typename Traits::iterator_t tree_iterator;
+	/**
+	 * The tuple the iteration stops at, i.e. the first tuple
+	 * of the next key range, or NULL to iterate to the end.
+	 */
+	struct tuple *end;
 };
 
+template <class Traits>
 static void
 tree_snapshot_iterator_free(struct snapshot_iterator *iterator)
 {
-	assert(iterator->free == tree_snapshot_iterator_free);
-	struct tree_snapshot_iterator *it =
-		(struct tree_snapshot_iterator *)iterator;
-	struct memtx_tree *tree = (struct memtx_tree *)it->tree;
-	memtx_tree_iterator_destroy(tree, &it->tree_iterator);
+	assert(iterator->free == tree_snapshot_iterator_free<Traits>);
+	struct tree_snapshot_iterator<Traits> *it =
+		(struct tree_snapshot_iterator<Traits> *)iterator;
+	Traits::iterator_destroy(it->tree, &it->tree_iterator);
 	free(iterator);
 }
 
+template <class Traits>
 static const char *
 tree_snapshot_iterator_next(struct snapshot_iterator *iterator, uint32_t *size)
 {
-	assert(iterator->free == tree_snapshot_iterator_free);
-	struct tree_snapshot_iterator *it =
-		(struct tree_snapshot_iterator *)iterator;
-	tuple **res = memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
-	if (res == NULL)
+	assert(iterator->free == tree_snapshot_iterator_free<Traits>);
+	struct tree_snapshot_iterator<Traits> *it =
+		(struct tree_snapshot_iterator<Traits> *)iterator;
+	typename Traits::data_t *res =
+		Traits::iterator_get_elem(it->tree, &it->tree_iterator);
+	if (res == NULL || res->tuple == it->end)
 		return NULL;
-	memtx_tree_iterator_next(it->tree, &it->tree_iterator);
-	return tuple_data_range(*res, size);
+	Traits::iterator_next(it->tree, &it->tree_iterator);
+	return tuple_data_range(res->tuple, size);
 }
 
 /**
- * Create an ALL iterator with personal read view so further
- * index modifications will not affect the iteration results.
- * Must be destroyed by iterator->free after usage.
+ * Create a snapshot iterator over tuples starting from the
+ * position of @a begin up to, not including, @a end.
  */
-struct snapshot_iterator *
-MemtxTree::createSnapshotIterator()
+template <class Traits>
+static struct snapshot_iterator *
+tree_snapshot_iterator_new(typename Traits::tree_t *tree,
+			   typename Traits::iterator_t begin,
+			   struct tuple *end)
 {
-	struct tree_snapshot_iterator *it = (struct tree_snapshot_iterator *)
+	struct tree_snapshot_iterator<Traits> *it =
+		(struct tree_snapshot_iterator<Traits> *)
 		calloc(1, sizeof(*it));
 	if (it == NULL)
-		tnt_raise(OutOfMemory, sizeof(struct tree_snapshot_iterator),
+		tnt_raise(OutOfMemory,
+			  sizeof(struct tree_snapshot_iterator<Traits>),
 			  "MemtxTree", "iterator");
 
-	it->base.free = tree_snapshot_iterator_free;
-	it->base.next = tree_snapshot_iterator_next;
-	it->tree = &tree;
-	it->tree_iterator = memtx_tree_iterator_first(&tree);
-	memtx_tree_iterator_freeze(&tree, &it->tree_iterator);
+	it->base.free = tree_snapshot_iterator_free<Traits>;
+	it->base.next = tree_snapshot_iterator_next<Traits>;
+	it->tree = tree;
+	it->tree_iterator = begin;
+	it->end = end;
+	Traits::iterator_freeze(tree, &it->tree_iterator);
 	return (struct snapshot_iterator *) it;
 }
+
+/**
+ * Create an ALL iterator with personal read view so further
+ * index modifications will not affect the iteration results.
+ * Must be destroyed by iterator->free after usage.
+ */
+template <class Traits>
+struct snapshot_iterator *
+MemtxTreeImpl<Traits>::createSnapshotIterator()
+{
+	return tree_snapshot_iterator_new<Traits>(&tree,
+			Traits::iterator_first(&tree), NULL);
+}
+
+/**
+ * The number of tuples sampled per key range to pick range
+ * bounds, @sa MemtxTree::createSnapshotIterators().
+ */
+enum { MEMTX_TREE_RANGE_SAMPLES = 16 };
+
+template <class Traits>
+int
+MemtxTreeImpl<Traits>::createSnapshotIterators(struct snapshot_iterator **its,
+					       int count)
+{
+	assert(count > 0);
+	int sample_count = count * MEMTX_TREE_RANGE_SAMPLES;
+	if (count == 1 || Traits::size(&tree) < (size_t) sample_count) {
+		its[0] = createSnapshotIterator();
+		return 1;
+	}
+	data_t *samples = (data_t *) malloc(sample_count * sizeof(*samples));
+	if (samples == NULL)
+		tnt_raise(OutOfMemory, sample_count * sizeof(*samples),
+			  "malloc", "samples");
+	for (int i = 0; i < sample_count; i++)
+		samples[i] = *Traits::random(&tree, rand());
+	qsort_arg(samples, sample_count, sizeof(*samples),
+		  memtx_tree_qcompare<data_t>, tree.arg);
+
+	typename Traits::iterator_t begin = Traits::iterator_first(&tree);
+	struct tuple *begin_tuple =
+		Traits::iterator_get_elem(&tree, &begin)->tuple;
+	int range_count = 0;
+	try {
+		for (int i = 1; i < count; i++) {
+			data_t bound = samples[i * MEMTX_TREE_RANGE_SAMPLES];
+			/* Skip empty ranges. */
+			if (bound.tuple == begin_tuple)
+				continue;
+			its[range_count] = tree_snapshot_iterator_new<Traits>(
+					&tree, begin, bound.tuple);
+			range_count++;
+			begin = Traits::lower_bound_elem(&tree, bound, NULL);
+			begin_tuple = bound.tuple;
+		}
+		its[range_count] = tree_snapshot_iterator_new<Traits>(
+				&tree, begin, NULL);
+		range_count++;
+	} catch (Exception *) {
+		for (int i = 0; i < range_count; i++)
+			its[i]->free(its[i]);
+		free(samples);
+		throw;
+	}
+	free(samples);
+	return range_count;
+}
+
+MemtxTree *
+MemtxTree::create(struct index_def *index_def)
+{
+	if (index_def->opts.hint)
+		return new MemtxTreeImpl<memtx_hint_tree_traits>(index_def);
+	return new MemtxTreeImpl<memtx_tree_traits>(index_def);
+}
+
+/* }}} */
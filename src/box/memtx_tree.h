@@ -35,6 +35,31 @@
 #include "memtx_engine.h"
 #include "tuple_compare.h"
 
+/**
+ * Struct that is used as an element in BPS tree definition.
+ */
+struct memtx_tree_data
+{
+	/** Indexed tuple. */
+	struct tuple *tuple;
+};
+
+/**
+ * Element of a tree index with the hint option set.
+ */
+struct memtx_hint_tree_data
+{
+	/** Indexed tuple. */
+	struct tuple *tuple;
+	/**
+	 * Comparison hint of the tuple, @sa memtx_tree_hint().
+	 * Tuples with different hints compare in the order
+	 * of the hints, so most comparisons done while
+	 * descending the tree don't touch tuple data.
+	 */
+	uint64_t hint;
+};
+
 /**
  * Struct that is used as a key in BPS tree definition.
  */
@@ -44,12 +69,53 @@ struct memtx_tree_key_data
 	const char *key;
 	/** Number of msgpacked search fields */
 	uint32_t part_count;
+	/**
+	 * Comparison hint of the key, @sa memtx_tree_key_hint().
+	 * Used only by trees with the hint option set.
+	 */
+	uint64_t hint;
 };
 
+/**
+ * Calculate the comparison hint of a tuple: an unsigned
+ * integer, which doesn't decrease as the tuple grows in
+ * terms of the given key definition, i.e. if the hint of
+ * tuple A is less than the hint of tuple B then A < B.
+ * Equal hints tell nothing. The hint is a prefix of the
+ * first key part for unsigned, integer, number and string
+ * fields, and 0 for other field types.
+ */
+uint64_t
+memtx_tree_hint(const struct tuple *tuple, const struct key_def *def);
+
+/**
+ * Calculate the comparison hint of a key consistent with
+ * memtx_tree_hint().
+ */
+uint64_t
+memtx_tree_key_hint(const char *key, uint32_t part_count,
+		    const struct key_def *def);
+
+/**
+ * BPS tree element comparator.
+ * Defined in header in order to allow compiler to inline it.
+ * @param a, b - elements to compare.
+ * @param def - key definition.
+ * @retval 0  if a == b in terms of def.
+ * @retval <0 if a < b in terms of def.
+ * @retval >0 if a > b in terms of def.
+ */
+static inline int
+memtx_tree_compare(struct memtx_tree_data a, struct memtx_tree_data b,
+		   struct key_def *def)
+{
+	return tuple_compare(a.tuple, b.tuple, def);
+}
+
 /**
  * BPS tree element vs key comparator.
  * Defined in header in order to allow compiler to inline it.
- * @param tuple - tuple to compare.
+ * @param data - tree element to compare.
  * @param key_data - key to compare with.
  * @param def - key definition.
  * @retval 0  if tuple == key in terms of def.
@@ -57,20 +123,49 @@ struct memtx_tree_key_data
  * @retval >0 if tuple > key in terms of def.
  */
 static inline int
-memtx_tree_compare_key(const tuple *tuple,
+memtx_tree_compare_key(struct memtx_tree_data data,
+		       const struct memtx_tree_key_data *key_data,
+		       struct key_def *def)
+{
+	return tuple_compare_with_key(data.tuple, key_data->key,
+				      key_data->part_count, def);
+}
+
+/**
+ * Hinted BPS tree element comparator, compares the hints
+ * first, @sa memtx_tree_compare().
+ */
+static inline int
+memtx_tree_compare(struct memtx_hint_tree_data a,
+		   struct memtx_hint_tree_data b, struct key_def *def)
+{
+	if (a.hint != b.hint)
+		return a.hint < b.hint ? -1 : 1;
+	return tuple_compare(a.tuple, b.tuple, def);
+}
+
+/**
+ * Hinted BPS tree element vs key comparator, compares the
+ * hints first, @sa memtx_tree_compare_key().
+ */
+static inline int
+memtx_tree_compare_key(struct memtx_hint_tree_data data,
 		       const struct memtx_tree_key_data *key_data,
 		       struct key_def *def)
 {
-	return tuple_compare_with_key(tuple, key_data->key,
+	if (key_data->part_count > 0 && data.hint != key_data->hint)
+		return data.hint < key_data->hint ? -1 : 1;
+	return tuple_compare_with_key(data.tuple, key_data->key,
 				      key_data->part_count, def);
 }
 
 #define BPS_TREE_NAME memtx_tree
 #define BPS_TREE_BLOCK_SIZE (512)
 #define BPS_TREE_EXTENT_SIZE MEMTX_EXTENT_SIZE
-#define BPS_TREE_COMPARE(a, b, arg) tuple_compare(a, b, arg)
+#define BPS_TREE_COMPARE(a, b, arg) memtx_tree_compare(a, b, arg)
 #define BPS_TREE_COMPARE_KEY(a, b, arg) memtx_tree_compare_key(a, b, arg)
-#define bps_tree_elem_t struct tuple *
+#define BPS_TREE_IS_IDENTICAL(a, b) ((a).tuple == (b).tuple)
+#define bps_tree_elem_t struct memtx_tree_data
 #define bps_tree_key_t struct memtx_tree_key_data *
 #define bps_tree_arg_t struct key_def *
 
@@ -81,45 +176,70 @@ memtx_tree_compare_key(const tuple *tuple,
 #undef BPS_TREE_EXTENT_SIZE
 #undef BPS_TREE_COMPARE
 #undef BPS_TREE_COMPARE_KEY
+#undef BPS_TREE_IS_IDENTICAL
 #undef bps_tree_elem_t
 #undef bps_tree_key_t
 #undef bps_tree_arg_t
 
+#define BPS_TREE_NAME memtx_hint_tree
+#define BPS_TREE_BLOCK_SIZE (512)
+#define BPS_TREE_EXTENT_SIZE MEMTX_EXTENT_SIZE
+#define BPS_TREE_COMPARE(a, b, arg) memtx_tree_compare(a, b, arg)
+#define BPS_TREE_COMPARE_KEY(a, b, arg) memtx_tree_compare_key(a, b, arg)
+#define BPS_TREE_IS_IDENTICAL(a, b) ((a).tuple == (b).tuple)
+#define bps_tree_elem_t struct memtx_hint_tree_data
+#define bps_tree_key_t struct memtx_tree_key_data *
+#define bps_tree_arg_t struct key_def *
+
+#include "salad/bps_tree.h"
+
+#undef BPS_TREE_NAME
+#undef BPS_TREE_BLOCK_SIZE
+#undef BPS_TREE_EXTENT_SIZE
+#undef BPS_TREE_COMPARE
+#undef BPS_TREE_COMPARE_KEY
+#undef BPS_TREE_IS_IDENTICAL
+#undef bps_tree_elem_t
+#undef bps_tree_key_t
+#undef bps_tree_arg_t
+
+/**
+ * Memtx TREE index. The implementation is a template over
+ * the BPS tree instance, @sa MemtxTreeImpl in memtx_tree.cc:
+ * elements of an index with the hint option set carry a
+ * comparison hint and take 16 bytes instead of 8.
+ */
 class MemtxTree: public MemtxIndex {
 public:
-	MemtxTree(struct index_def *index_def);
-	virtual ~MemtxTree() override;
-
-	virtual void beginBuild() override;
-	virtual void reserve(uint32_t size_hint) override;
-	virtual void buildNext(struct tuple *tuple) override;
-	virtual void endBuild() override;
-	virtual size_t size() const override;
-	virtual struct tuple *random(uint32_t rnd) const override;
-	virtual struct tuple *findByKey(const char *key,
-					uint32_t part_count) const override;
-	virtual struct tuple *replace(struct tuple *old_tuple,
-				      struct tuple *new_tuple,
-				      enum dup_replace_mode mode) override;
-
-	virtual size_t bsize() const override;
-	virtual struct iterator *allocIterator() const override;
-	virtual void initIterator(struct iterator *iterator,
-				  enum iterator_type type,
-				  const char *key,
-				  uint32_t part_count) const override;
+	/**
+	 * Create a tree index, hinted or not depending on
+	 * index_def->opts.hint.
+	 */
+	static MemtxTree *create(struct index_def *index_def);
 
 	/**
-	 * Create an ALL iterator with personal read view so further
-	 * index modifications will not affect the iteration results.
-	 * Must be destroyed by iterator->free after usage.
+	 * Sort tuples accumulated by buildNext(). Called by
+	 * endBuild() unless done beforehand. Touches nothing but
+	 * the build array and tuple data, so may be called from
+	 * a worker thread.
+	 */
+	virtual void sortBuildArray() = 0;
+	/** Free tuples accumulated by buildNext() if any. */
+	virtual void freeBuildArray() = 0;
+	/**
+	 * Split the index into at most @a count key ranges of
+	 * about the same size and create a snapshot iterator,
+	 * @sa createSnapshotIterator(), over each of them. The
+	 * bounds are picked by sampling random tuples. Iterators
+	 * are stored in @a its in the order of the ranges.
+	 * @return the number of created iterators.
 	 */
-	struct snapshot_iterator *createSnapshotIterator() override;
+	virtual int createSnapshotIterators(struct snapshot_iterator **its,
+					    int count) = 0;
 
-private:
-	struct memtx_tree tree;
-	struct tuple **build_array;
-	size_t build_array_size, build_array_alloc_size;
+protected:
+	MemtxTree(struct index_def *index_def_arg)
+		: MemtxIndex(index_def_arg) {}
 };
 
 #endif /* TARANTOOL_BOX_MEMTX_TREE_H_INCLUDED */
@@ -0,0 +1,853 @@
+/*
+ * Copyright 2010-2017, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "memtx_tx.h"
+
+#include "assoc.h"
+#include "fiber.h"
+#include "memtx_engine.h"
+#include "memtx_index.h"
+#include "memtx_space.h"
+#include "schema.h"
+#include "space.h"
+#include "tuple.h"
+#include "txn.h"
+
+struct memtx_tx_manager memtx_tx_manager;
+
+enum {
+	/**
+	 * The number of stories looked at by the garbage
+	 * collector when a transaction ends.
+	 */
+	MEMTX_TX_GC_STEPS = 16,
+	/**
+	 * Slack memory extents needed to remove a version
+	 * from all indexes, @sa RESERVE_EXTENTS_BEFORE_DELETE.
+	 */
+	MEMTX_TX_GC_RESERVE_EXTENTS = 8,
+	/**
+	 * Slack memory extents needed to insert a new version
+	 * into all indexes and roll the insertion back,
+	 * @sa RESERVE_EXTENTS_BEFORE_REPLACE.
+	 */
+	MEMTX_TX_REPLACE_RESERVE_EXTENTS = 16,
+};
+
+/** A link of a story in a chain of versions of an index key. */
+struct memtx_story_link {
+	/**
+	 * The version, which replaced this one at the same key,
+	 * or NULL if this version is stored in the index.
+	 */
+	struct memtx_story *newer;
+	/** The version replaced by this one or NULL. */
+	struct memtx_story *older;
+};
+
+/** The story of a tuple: who inserted and deleted it. */
+struct memtx_story {
+	/** The tuple. The story owns its index reference. */
+	struct tuple *tuple;
+	/** The space of the tuple. */
+	struct space *space;
+	/**
+	 * The transaction which inserted the tuple, NULL once
+	 * it's committed or if the tuple had been committed
+	 * before the story was created.
+	 */
+	struct txn *add_txn;
+	/**
+	 * PSN of the transaction which inserted the tuple,
+	 * 0 until it's prepared or if the tuple had been
+	 * committed before the story was created.
+	 */
+	int64_t add_psn;
+	/**
+	 * The transaction which deleted the tuple, NULL once
+	 * it's committed or if the tuple is not deleted.
+	 */
+	struct txn *del_txn;
+	/**
+	 * PSN of the transaction which deleted the tuple, 0
+	 * until it's prepared or if the tuple is not deleted.
+	 */
+	int64_t del_psn;
+	/** Link in memtx_tx_manager::stories. */
+	struct rlist in_stories;
+	/** Links in version chains, by index position in the space. */
+	struct memtx_story_link link[0];
+};
+
+void
+memtx_tx_manager_init(Engine *engine)
+{
+	memtx_tx_manager.is_enabled = false;
+	memtx_tx_manager.engine = engine;
+	memtx_tx_manager.psn = 0;
+	memtx_tx_manager.history = mh_i64ptr_new();
+	if (memtx_tx_manager.history == NULL)
+		panic("failed to allocate memtx tuple history");
+	rlist_create(&memtx_tx_manager.stories);
+	memtx_tx_manager.story_count = 0;
+	rlist_create(&memtx_tx_manager.read_views);
+}
+
+void
+memtx_tx_manager_free()
+{
+	/* Tuples are freed along with the memtx arena. */
+	struct memtx_story *story, *tmp;
+	rlist_foreach_entry_safe(story, &memtx_tx_manager.stories,
+				 in_stories, tmp)
+		free(story);
+	mh_i64ptr_delete(memtx_tx_manager.history);
+}
+
+/** @sa memtx_tx_space_is_versioned(). */
+static inline bool
+memtx_tx_space_id_is_versioned(uint32_t space_id)
+{
+	return memtx_tx_manager.is_enabled &&
+	       !(space_id > BOX_SYSTEM_ID_MIN && space_id < BOX_SYSTEM_ID_MAX);
+}
+
+bool
+memtx_tx_space_is_versioned(struct space *space)
+{
+	return memtx_tx_space_id_is_versioned(space_id(space));
+}
+
+bool
+memtx_tx_stmt_is_versioned(struct txn_stmt *stmt)
+{
+	if (stmt->space == NULL || stmt->engine_savepoint == NULL)
+		return false;
+	MemtxSpace *handler = (MemtxSpace *) stmt->space->handler;
+	return handler->replace == memtx_replace_all_keys &&
+	       memtx_tx_space_is_versioned(stmt->space);
+}
+
+/** Return memtx state of a transaction or NULL. */
+static inline struct memtx_tx *
+memtx_tx_get(struct txn *txn)
+{
+	if (txn == NULL || txn->engine != memtx_tx_manager.engine)
+		return NULL;
+	return (struct memtx_tx *) txn->engine_tx;
+}
+
+/**
+ * Return the read view of a transaction. Autocommit
+ * statements and requests outside transactions don't
+ * yield, so they read the latest prepared versions.
+ */
+static inline int64_t
+memtx_tx_read_view(struct txn *txn)
+{
+	struct memtx_tx *tx = memtx_tx_get(txn);
+	return tx != NULL ? tx->read_view : INT64_MAX;
+}
+
+/** Return the oldest read view in use. */
+static inline int64_t
+memtx_tx_oldest_read_view()
+{
+	if (rlist_empty(&memtx_tx_manager.read_views))
+		return memtx_tx_manager.psn;
+	return rlist_first_entry(&memtx_tx_manager.read_views,
+				 struct memtx_tx, in_read_views)->read_view;
+}
+
+void
+memtx_tx_begin(struct txn *txn)
+{
+	struct memtx_tx *tx = region_alloc_object_xc(&fiber()->gc,
+						     struct memtx_tx);
+	tx->read_view = memtx_tx_manager.psn;
+	tx->is_yield_forbidden = false;
+	/* PSN only grows, so the list stays sorted. */
+	rlist_add_tail_entry(&memtx_tx_manager.read_views, tx, in_read_views);
+	txn->engine_tx = tx;
+}
+
+/** {{{ Stories */
+
+static inline struct memtx_story *
+memtx_story_find(struct tuple *tuple)
+{
+	struct mh_i64ptr_t *history = memtx_tx_manager.history;
+	mh_int_t k = mh_i64ptr_find(history, (uint64_t) (uintptr_t) tuple,
+				    NULL);
+	if (k == mh_end(history))
+		return NULL;
+	return (struct memtx_story *) mh_i64ptr_node(history, k)->val;
+}
+
+/** Create a story of a tuple, which is committed by default. */
+static struct memtx_story *
+memtx_story_new(struct space *space, struct tuple *tuple)
+{
+	assert(memtx_story_find(tuple) == NULL);
+	size_t size = sizeof(struct memtx_story) +
+		      space->index_count * sizeof(struct memtx_story_link);
+	struct memtx_story *story = (struct memtx_story *) calloc(1, size);
+	if (story == NULL)
+		tnt_raise(OutOfMemory, size, "malloc", "struct memtx_story");
+	struct mh_i64ptr_t *history = memtx_tx_manager.history;
+	struct mh_i64ptr_node_t node = { (uint64_t) (uintptr_t) tuple, story };
+	if (mh_i64ptr_put(history, &node, NULL, NULL) == mh_end(history)) {
+		free(story);
+		tnt_raise(OutOfMemory, 0, "mh_i64ptr_put", "mh_i64ptr_node_t");
+	}
+	story->tuple = tuple;
+	story->space = space;
+	rlist_add_tail_entry(&memtx_tx_manager.stories, story, in_stories);
+	memtx_tx_manager.story_count++;
+	return story;
+}
+
+/** Find the story of a tuple or create it. */
+static struct memtx_story *
+memtx_story_get(struct space *space, struct tuple *tuple)
+{
+	struct memtx_story *story = memtx_story_find(tuple);
+	if (story == NULL)
+		story = memtx_story_new(space, tuple);
+	return story;
+}
+
+static void
+memtx_story_delete(struct memtx_story *story)
+{
+	struct mh_i64ptr_t *history = memtx_tx_manager.history;
+	mh_int_t k = mh_i64ptr_find(history,
+				    (uint64_t) (uintptr_t) story->tuple, NULL);
+	assert(k != mh_end(history));
+	mh_i64ptr_del(history, k, NULL);
+	rlist_del_entry(story, in_stories);
+	assert(memtx_tx_manager.story_count > 0);
+	memtx_tx_manager.story_count--;
+	free(story);
+}
+
+/** Return the position of an index in the space of a story. */
+static inline uint32_t
+memtx_story_index_pos(struct memtx_story *story, const MemtxIndex *index)
+{
+	struct space *space = story->space;
+	for (uint32_t i = 0; i < space->index_count; i++) {
+		if (space->index[i] == index)
+			return i;
+	}
+	return UINT32_MAX;
+}
+
+/** Return true if the tuple is inserted in a read view. */
+static inline bool
+memtx_story_is_added(struct memtx_story *story, struct txn *txn,
+		     int64_t read_view)
+{
+	if (story->add_txn != NULL && story->add_txn == txn)
+		return true;
+	if (story->add_txn != NULL && story->add_psn == 0)
+		return false; /* Not prepared yet. */
+	return story->add_psn <= read_view;
+}
+
+/** Return true if the tuple is deleted in a read view. */
+static inline bool
+memtx_story_is_deleted(struct memtx_story *story, struct txn *txn,
+		       int64_t read_view)
+{
+	if (story->del_txn != NULL && story->del_txn == txn)
+		return true;
+	if (story->del_txn != NULL && story->del_psn == 0)
+		return false; /* Not prepared yet. */
+	return story->del_psn != 0 && story->del_psn <= read_view;
+}
+
+/**
+ * Return true if the tuple was inserted or deleted by a
+ * transaction concurrent to the given one, so the latter
+ * can't overwrite it. A change of another transaction
+ * is concurrent until it's committed, even if it's prepared:
+ * a failed WAL write rolls it back, which is impossible
+ * once a newer version is linked on top of it.
+ */
+static inline bool
+memtx_story_is_concurrent(struct memtx_story *story, struct txn *txn,
+			  int64_t read_view)
+{
+	if (story->add_txn != NULL && story->add_txn != txn)
+		return true;
+	if (story->del_txn != NULL && story->del_txn != txn)
+		return true;
+	return story->add_psn > read_view || story->del_psn > read_view;
+}
+
+/**
+ * Walk the chain of versions of an index key starting from
+ * a story and return the tuple visible in a read view.
+ */
+static struct tuple *
+memtx_story_visible_tuple(struct memtx_story *story, uint32_t pos,
+			  struct txn *txn, int64_t read_view)
+{
+	for (; story != NULL; story = story->link[pos].older) {
+		if (!memtx_story_is_added(story, txn, read_view))
+			continue;
+		if (memtx_story_is_deleted(story, txn, read_view))
+			return NULL;
+		return story->tuple;
+	}
+	return NULL;
+}
+
+/**
+ * Remove a version, which is invisible in all read views,
+ * from indexes, or delete the story of a version, which is
+ * visible in all of them. Return true if the story is deleted.
+ */
+static bool
+memtx_story_gc(struct memtx_story *story)
+{
+	if (story->add_txn != NULL || story->del_txn != NULL)
+		return false;
+	struct space *space = story->space;
+	int64_t oldest_read_view = memtx_tx_oldest_read_view();
+	if (story->del_psn == 0) {
+		if (story->add_psn > oldest_read_view)
+			return false;
+		/* Older versions must be collected first. */
+		for (uint32_t i = 0; i < space->index_count; i++) {
+			if (story->link[i].older != NULL ||
+			    story->link[i].newer != NULL)
+				return false;
+		}
+		memtx_story_delete(story);
+		return true;
+	}
+	if (story->del_psn > oldest_read_view)
+		return false;
+	try {
+		memtx_index_extent_reserve(MEMTX_TX_GC_RESERVE_EXTENTS);
+	} catch (Exception *) {
+		/* Try again when a transaction ends. */
+		return false;
+	}
+	for (uint32_t i = 0; i < space->index_count; i++) {
+		struct memtx_story_link *link = &story->link[i];
+		struct memtx_story *older = link->older;
+		if (link->newer == NULL) {
+			/*
+			 * The version is stored in the index,
+			 * replace it with the older one, which
+			 * is also garbage and will be collected
+			 * later.
+			 */
+			space->index[i]->replace(story->tuple, older != NULL ?
+						 older->tuple : NULL,
+						 DUP_INSERT);
+			if (older != NULL)
+				older->link[i].newer = NULL;
+		} else {
+			link->newer->link[i].older = older;
+			if (older != NULL)
+				older->link[i].newer = link->newer;
+		}
+	}
+	struct tuple *tuple = story->tuple;
+	memtx_story_delete(story);
+	tuple_unref(tuple);
+	return true;
+}
+
+/** Look at a few stories and collect the garbage. */
+static void
+memtx_tx_gc(int steps)
+{
+	struct rlist *stories = &memtx_tx_manager.stories;
+	for (int i = 0; i < steps && !rlist_empty(stories); i++) {
+		struct memtx_story *story =
+			rlist_first_entry(stories, struct memtx_story,
+					  in_stories);
+		if (!memtx_story_gc(story))
+			rlist_move_tail_entry(stories, story, in_stories);
+	}
+}
+
+bool
+memtx_tx_space_has_history(struct space *space)
+{
+	if (memtx_tx_manager.story_count == 0)
+		return false;
+	/*
+	 * Collect all garbage of the space. Removal of a version
+	 * can make the story of a newer one unnecessary, so
+	 * repeat until there is no progress.
+	 */
+	bool has_history;
+	bool is_progress;
+	do {
+		has_history = false;
+		is_progress = false;
+		struct memtx_story *story, *tmp;
+		rlist_foreach_entry_safe(story, &memtx_tx_manager.stories,
+					 in_stories, tmp) {
+			if (story->space != space)
+				continue;
+			if (memtx_story_gc(story))
+				is_progress = true;
+			else
+				has_history = true;
+		}
+	} while (has_history && is_progress);
+	return has_history;
+}
+
+/** }}} Stories */
+
+/** {{{ Statements */
+
+void
+memtx_tx_replace(struct txn_stmt *stmt, struct space *space,
+		 enum dup_replace_mode mode)
+{
+	struct txn *txn = in_txn();
+	int64_t read_view = memtx_tx_read_view(txn);
+	struct tuple *old_tuple = stmt->old_tuple;
+	struct tuple *new_tuple = stmt->new_tuple;
+	MemtxSpace *handler = (MemtxSpace *) space->handler;
+	assert(old_tuple != NULL || new_tuple != NULL);
+
+	if (new_tuple == NULL) {
+		/*
+		 * DELETE doesn't change indexes: the tuple is
+		 * only marked as deleted and stays visible in
+		 * older read views.
+		 */
+		struct memtx_story *story = memtx_story_get(space, old_tuple);
+		assert(story->del_txn != txn);
+		if (story->link[0].newer != NULL ||
+		    memtx_story_is_concurrent(story, txn, read_view))
+			tnt_raise(ClientError, ER_TRANSACTION_CONFLICT);
+		story->del_txn = txn;
+		stmt->engine_savepoint = stmt;
+		handler->updateBsize(old_tuple, NULL);
+		return;
+	}
+	/*
+	 * Ensure we have enough slack memory to guarantee
+	 * successful statement-level rollback.
+	 */
+	memtx_index_extent_reserve(MEMTX_TX_REPLACE_RESERVE_EXTENTS);
+	struct memtx_story *new_story = memtx_story_new(space, new_tuple);
+	new_story->add_txn = txn;
+	/*
+	 * Insert the new tuple into all indexes. Tuples it
+	 * displaces at the same keys become its older versions.
+	 */
+	struct tuple *displaced[BOX_INDEX_MAX];
+	struct tuple *visible_tuple = NULL;
+	uint32_t i = 0;
+	try {
+		for (; i < space->index_count; i++) {
+			displaced[i] = space->index[i]->replace(NULL,
+					new_tuple, DUP_REPLACE_OR_INSERT);
+		}
+		/*
+		 * The newest version of the primary key must be
+		 * either visible in the read view or deleted,
+		 * otherwise the transaction would overwrite
+		 * a change it can't see.
+		 */
+		struct tuple *top = displaced[0];
+		struct memtx_story *top_story = top != NULL ?
+						memtx_story_find(top) : NULL;
+		if (top_story != NULL &&
+		    memtx_story_is_concurrent(top_story, txn, read_view))
+			tnt_raise(ClientError, ER_TRANSACTION_CONFLICT);
+		visible_tuple = top;
+		if (top_story != NULL &&
+		    memtx_story_is_deleted(top_story, txn, read_view))
+			visible_tuple = NULL;
+		uint32_t errcode = replace_check_dup(old_tuple, visible_tuple,
+						     mode);
+		if (errcode != 0) {
+			tnt_raise(ClientError, errcode,
+				  index_name(space->index[0]),
+				  space_name(space));
+		}
+		if (old_tuple != NULL && old_tuple != visible_tuple)
+			tnt_raise(ClientError, ER_TRANSACTION_CONFLICT);
+		/*
+		 * A tuple displaced from a unique secondary key
+		 * must be either the old version of the same
+		 * tuple or a deleted one.
+		 */
+		for (uint32_t j = 1; j < space->index_count; j++) {
+			struct tuple *dup = displaced[j];
+			if (dup == NULL || dup == top ||
+			    !space->index[j]->index_def->opts.is_unique)
+				continue;
+			struct memtx_story *dup_story = memtx_story_find(dup);
+			if (dup_story != NULL &&
+			    memtx_story_is_concurrent(dup_story, txn,
+						      read_view))
+				tnt_raise(ClientError, ER_TRANSACTION_CONFLICT);
+			if (dup_story == NULL ||
+			    !memtx_story_is_deleted(dup_story, txn,
+						    read_view)) {
+				tnt_raise(ClientError, ER_TUPLE_FOUND,
+					  index_name(space->index[j]),
+					  space_name(space));
+			}
+		}
+		for (uint32_t j = 0; j < space->index_count; j++) {
+			if (displaced[j] != NULL)
+				memtx_story_get(space, displaced[j]);
+		}
+	} catch (Exception *e) {
+		/* Rollback all changes */
+		for (; i > 0; i--) {
+			Index *index = space->index[i - 1];
+			index->replace(new_tuple, displaced[i - 1], DUP_INSERT);
+		}
+		memtx_story_delete(new_story);
+		throw;
+	}
+	/* Link the new version to the chains. Can't fail. */
+	for (uint32_t j = 0; j < space->index_count; j++) {
+		if (displaced[j] == NULL)
+			continue;
+		struct memtx_story *older = memtx_story_find(displaced[j]);
+		assert(older != NULL && older->link[j].newer == NULL);
+		older->link[j].newer = new_story;
+		new_story->link[j].older = older;
+	}
+	if (visible_tuple != NULL)
+		memtx_story_find(visible_tuple)->del_txn = txn;
+	stmt->old_tuple = visible_tuple;
+	stmt->engine_savepoint = stmt;
+	handler->updateBsize(visible_tuple, new_tuple);
+}
+
+void
+memtx_tx_rollback_statement(struct txn_stmt *stmt)
+{
+	struct space *space = stmt->space;
+	if (stmt->new_tuple != NULL) {
+		struct memtx_story *story = memtx_story_find(stmt->new_tuple);
+		assert(story != NULL);
+		/*
+		 * Statements are rolled back in the reverse
+		 * order, and other transactions can't overwrite
+		 * an uncommitted version, even a prepared one,
+		 * so it is stored in all indexes.
+		 */
+		for (uint32_t i = 0; i < space->index_count; i++) {
+			struct memtx_story *older = story->link[i].older;
+			assert(story->link[i].newer == NULL);
+			space->index[i]->replace(stmt->new_tuple,
+						 older != NULL ?
+						 older->tuple : NULL,
+						 DUP_INSERT);
+			if (older != NULL)
+				older->link[i].newer = NULL;
+		}
+		memtx_story_delete(story);
+	}
+	if (stmt->old_tuple != NULL) {
+		struct memtx_story *story = memtx_story_find(stmt->old_tuple);
+		assert(story != NULL);
+		story->del_txn = NULL;
+		story->del_psn = 0;
+	}
+}
+
+/** }}} Statements */
+
+/** {{{ Transactions */
+
+void
+memtx_tx_prepare(struct txn *txn)
+{
+	int64_t psn = ++memtx_tx_manager.psn;
+	struct txn_stmt *stmt;
+	stailq_foreach_entry(stmt, &txn->stmts, next) {
+		if (!memtx_tx_stmt_is_versioned(stmt))
+			continue;
+		if (stmt->new_tuple != NULL)
+			memtx_story_find(stmt->new_tuple)->add_psn = psn;
+		if (stmt->old_tuple != NULL)
+			memtx_story_find(stmt->old_tuple)->del_psn = psn;
+	}
+}
+
+/** Close the read view of a transaction, if any. */
+static void
+memtx_tx_close_read_view(struct txn *txn)
+{
+	struct memtx_tx *tx = memtx_tx_get(txn);
+	if (tx != NULL)
+		rlist_del_entry(tx, in_read_views);
+}
+
+void
+memtx_tx_commit(struct txn *txn)
+{
+	memtx_tx_close_read_view(txn);
+	struct txn_stmt *stmt;
+	stailq_foreach_entry(stmt, &txn->stmts, next) {
+		if (!memtx_tx_stmt_is_versioned(stmt))
+			continue;
+		if (stmt->new_tuple != NULL)
+			memtx_story_find(stmt->new_tuple)->add_txn = NULL;
+		if (stmt->old_tuple != NULL)
+			memtx_story_find(stmt->old_tuple)->del_txn = NULL;
+	}
+	/*
+	 * Most often there are no concurrent read views, so
+	 * replaced tuples can be freed right away. A tuple can
+	 * be freed here, so look it up before getting its story.
+	 */
+	stailq_foreach_entry(stmt, &txn->stmts, next) {
+		if (!memtx_tx_stmt_is_versioned(stmt))
+			continue;
+		struct memtx_story *story;
+		if (stmt->old_tuple != NULL &&
+		    (story = memtx_story_find(stmt->old_tuple)) != NULL)
+			memtx_story_gc(story);
+		if (stmt->new_tuple != NULL &&
+		    (story = memtx_story_find(stmt->new_tuple)) != NULL)
+			memtx_story_gc(story);
+	}
+	memtx_tx_gc(MEMTX_TX_GC_STEPS);
+}
+
+void
+memtx_tx_rollback(struct txn *txn)
+{
+	memtx_tx_close_read_view(txn);
+	memtx_tx_gc(MEMTX_TX_GC_STEPS);
+}
+
+/** }}} Transactions */
+
+/** {{{ Reads */
+
+struct tuple *
+memtx_tx_clarify_slow(const MemtxIndex *index, struct tuple *tuple)
+{
+	struct memtx_story *story = memtx_story_find(tuple);
+	if (story == NULL)
+		return tuple;
+	uint32_t pos = memtx_story_index_pos(story, index);
+	if (pos == UINT32_MAX)
+		return tuple;
+	struct txn *txn = in_txn();
+	return memtx_story_visible_tuple(story, pos, txn,
+					 memtx_tx_read_view(txn));
+}
+
+struct tuple *
+memtx_tx_clarify_random(const MemtxIndex *index, struct tuple *tuple)
+{
+	struct tuple *result = memtx_tx_clarify(index, tuple);
+	if (result != NULL || tuple == NULL)
+		return result;
+	/* The version is invisible, return the first visible one. */
+	struct iterator *it = index->position();
+	index->initIterator(it, ITER_ALL, NULL, 0);
+	it = memtx_tx_iterator_unwrap(it);
+	while ((tuple = it->next(it)) != NULL) {
+		result = memtx_tx_clarify(index, tuple);
+		if (result != NULL)
+			break;
+	}
+	return result;
+}
+
+/** An iterator skipping versions invisible to the reader. */
+struct memtx_tx_iterator {
+	struct iterator base;
+	/** The iterator over all versions stored in the index. */
+	struct iterator *it;
+	const MemtxIndex *index;
+};
+
+static struct tuple *
+memtx_tx_iterator_next(struct iterator *base)
+{
+	struct memtx_tx_iterator *it = (struct memtx_tx_iterator *) base;
+	struct tuple *tuple;
+	while ((tuple = it->it->next(it->it)) != NULL) {
+		tuple = memtx_tx_clarify(it->index, tuple);
+		if (tuple != NULL)
+			break;
+	}
+	return tuple;
+}
+
+static void
+memtx_tx_iterator_free(struct iterator *base)
+{
+	struct memtx_tx_iterator *it = (struct memtx_tx_iterator *) base;
+	it->it->free(it->it);
+	free(it);
+}
+
+struct iterator *
+memtx_tx_iterator_wrap(const MemtxIndex *index, struct iterator *it)
+{
+	if (!memtx_tx_space_id_is_versioned(index->index_def->space_id))
+		return it;
+	struct memtx_tx_iterator *wrapper = (struct memtx_tx_iterator *)
+		calloc(1, sizeof(*wrapper));
+	if (wrapper == NULL) {
+		it->free(it);
+		tnt_raise(OutOfMemory, sizeof(*wrapper),
+			  "MemtxIndex", "iterator");
+	}
+	wrapper->base.next = memtx_tx_iterator_next;
+	wrapper->base.free = memtx_tx_iterator_free;
+	wrapper->it = it;
+	wrapper->index = index;
+	return &wrapper->base;
+}
+
+struct iterator *
+memtx_tx_iterator_unwrap(struct iterator *it)
+{
+	if (it->free != memtx_tx_iterator_free)
+		return it;
+	return ((struct memtx_tx_iterator *) it)->it;
+}
+
+/**
+ * A snapshot iterator replacing versions, which were not
+ * prepared at the moment of its creation, with older ones.
+ */
+struct memtx_tx_snapshot_iterator {
+	struct snapshot_iterator base;
+	/** The iterator over the frozen primary key. */
+	struct snapshot_iterator *it;
+	/**
+	 * Tuple data -> the tuple to write instead or NULL
+	 * if none. Read-only, so it can be used in any thread.
+	 * Replaced tuples are not freed while a snapshot is
+	 * in progress, see memtx_tuple_begin_snapshot().
+	 */
+	struct mh_i64ptr_t *versions;
+};
+
+static const char *
+memtx_tx_snapshot_iterator_next(struct snapshot_iterator *base,
+				uint32_t *size)
+{
+	struct memtx_tx_snapshot_iterator *it =
+		(struct memtx_tx_snapshot_iterator *) base;
+	const char *data;
+	while ((data = it->it->next(it->it, size)) != NULL) {
+		mh_int_t k = mh_i64ptr_find(it->versions,
+					    (uint64_t) (uintptr_t) data, NULL);
+		if (k == mh_end(it->versions))
+			return data;
+		struct tuple *tuple = (struct tuple *)
+			mh_i64ptr_node(it->versions, k)->val;
+		if (tuple != NULL)
+			return tuple_data_range(tuple, size);
+	}
+	return NULL;
+}
+
+static void
+memtx_tx_snapshot_iterator_free(struct snapshot_iterator *base)
+{
+	struct memtx_tx_snapshot_iterator *it =
+		(struct memtx_tx_snapshot_iterator *) base;
+	it->it->free(it->it);
+	if (it->versions != NULL)
+		mh_i64ptr_delete(it->versions);
+	free(it);
+}
+
+struct snapshot_iterator *
+memtx_tx_snapshot_iterator_wrap(struct space *space,
+				struct snapshot_iterator *it)
+{
+	if (memtx_tx_manager.story_count == 0 ||
+	    !memtx_tx_space_is_versioned(space))
+		return it;
+	struct memtx_tx_snapshot_iterator *wrapper =
+		(struct memtx_tx_snapshot_iterator *)
+		calloc(1, sizeof(*wrapper));
+	if (wrapper == NULL) {
+		it->free(it);
+		tnt_raise(OutOfMemory, sizeof(*wrapper),
+			  "malloc", "struct memtx_tx_snapshot_iterator");
+	}
+	wrapper->base.next = memtx_tx_snapshot_iterator_next;
+	wrapper->base.free = memtx_tx_snapshot_iterator_free;
+	wrapper->it = it;
+	wrapper->versions = mh_i64ptr_new();
+	if (wrapper->versions == NULL) {
+		memtx_tx_snapshot_iterator_free(&wrapper->base);
+		tnt_raise(OutOfMemory, sizeof(struct mh_i64ptr_t),
+			  "mh_i64ptr_new", "versions");
+	}
+	/*
+	 * Remember the version of every primary key entry,
+	 * which is visible to a reader without a transaction.
+	 */
+	int64_t read_view = memtx_tx_manager.psn;
+	struct memtx_story *story;
+	rlist_foreach_entry(story, &memtx_tx_manager.stories, in_stories) {
+		if (story->space != space || story->link[0].newer != NULL)
+			continue;
+		struct tuple *tuple = memtx_story_visible_tuple(story, 0,
+							NULL, read_view);
+		if (tuple == story->tuple)
+			continue;
+		struct mh_i64ptr_node_t node = {
+			(uint64_t) (uintptr_t) tuple_data(story->tuple), tuple
+		};
+		if (mh_i64ptr_put(wrapper->versions, &node, NULL, NULL) ==
+		    mh_end(wrapper->versions)) {
+			memtx_tx_snapshot_iterator_free(&wrapper->base);
+			tnt_raise(OutOfMemory, 0, "mh_i64ptr_put",
+				  "mh_i64ptr_node_t");
+		}
+	}
+	return &wrapper->base;
+}
+
+/** }}} Reads */
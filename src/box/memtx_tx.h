@@ -0,0 +1,243 @@
+#ifndef TARANTOOL_BOX_MEMTX_TX_H_INCLUDED
+#define TARANTOOL_BOX_MEMTX_TX_H_INCLUDED
+/*
+ * Copyright 2010-2017, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * Multi-version concurrency control for memtx spaces.
+ *
+ * Without it, memtx changes are applied to indexes in place,
+ * so a transaction which yields has to be aborted: other
+ * fibers would see its uncommitted changes, and the
+ * transaction itself would see theirs.
+ *
+ * In the multi-version mode (box.cfg.memtx_use_mvcc_engine)
+ * a statement still inserts a new tuple into indexes in place,
+ * but the tuple it replaces or deletes is not removed: it is
+ * kept as an older version of the same key, along with the
+ * information which transaction inserted and deleted each
+ * version. This information is called a tuple story. Stories
+ * of tuples stored at the same key of an index are linked in
+ * a chain, from the newest one, which is stored in the index,
+ * to the oldest one.
+ *
+ * Each transaction is assigned a prepare sequence number
+ * (PSN) when it is prepared for commit, and each multi-
+ * statement transaction gets a read view, which is the PSN
+ * of the last prepared transaction at the time it started.
+ * Readers walk the story chain of every tuple they find in
+ * an index and return the newest version which is visible
+ * in their read view, so a transaction sees a consistent
+ * snapshot of the database and can yield.
+ *
+ * Write conflicts are resolved eagerly: a statement fails
+ * with ER_TRANSACTION_CONFLICT if it overwrites a version
+ * which is not yet prepared by another transaction, or which
+ * was prepared after the read view of this transaction was
+ * created. This gives snapshot isolation.
+ *
+ * Versions which are invisible to all read views are garbage
+ * collected: they are removed from indexes and unreferenced.
+ * A tuple without a story is visible to everyone, so once
+ * there are no concurrent transactions, memtx works with
+ * plain tuples and the only overhead is a check of the
+ * story count.
+ *
+ * System spaces are never versioned: a transaction which
+ * writes to them is still aborted on yield.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "small/rlist.h"
+#include "index.h"
+
+struct space;
+struct tuple;
+struct txn;
+struct txn_stmt;
+struct mh_i64ptr_t;
+class Engine;
+class MemtxIndex;
+
+/** Multi-version transaction manager of memtx. */
+struct memtx_tx_manager {
+	/** True if box.cfg.memtx_use_mvcc_engine is set. */
+	bool is_enabled;
+	/** The memtx engine, owning memtx transactions. */
+	Engine *engine;
+	/** PSN of the last prepared transaction. */
+	int64_t psn;
+	/** Tuple -> memtx_story. */
+	struct mh_i64ptr_t *history;
+	/**
+	 * All stories, for garbage collection. A story, which
+	 * can't be collected yet, is moved to the tail.
+	 */
+	struct rlist stories;
+	/** The number of stories, 0 if memtx is not versioned. */
+	uint32_t story_count;
+	/** Read views of active transactions, oldest first. */
+	struct rlist read_views;
+};
+
+extern struct memtx_tx_manager memtx_tx_manager;
+
+/** Memtx state of a multi-statement transaction. */
+struct memtx_tx {
+	/**
+	 * The read view of the transaction: versions prepared
+	 * with a greater PSN are invisible to it.
+	 */
+	int64_t read_view;
+	/** Link in memtx_tx_manager::read_views. */
+	struct rlist in_read_views;
+	/** Set if the transaction must be aborted on yield. */
+	bool is_yield_forbidden;
+};
+
+/**
+ * Initialize the transaction manager.
+ * @param engine The memtx engine.
+ */
+void
+memtx_tx_manager_init(Engine *engine);
+
+/** Free the transaction manager. */
+void
+memtx_tx_manager_free();
+
+/** Return true if the indexes of a space are versioned. */
+bool
+memtx_tx_space_is_versioned(struct space *space);
+
+/**
+ * Start a multi-statement transaction in the multi-version
+ * mode: create its read view.
+ */
+void
+memtx_tx_begin(struct txn *txn);
+
+/**
+ * Return true if a statement changed a versioned space,
+ * i.e. was executed by memtx_tx_replace().
+ */
+bool
+memtx_tx_stmt_is_versioned(struct txn_stmt *stmt);
+
+/**
+ * Replace a tuple in all indexes of a versioned space.
+ * @sa memtx_replace_all_keys().
+ */
+void
+memtx_tx_replace(struct txn_stmt *stmt, struct space *space,
+		 enum dup_replace_mode mode);
+
+/** Undo a statement done by memtx_tx_replace(). */
+void
+memtx_tx_rollback_statement(struct txn_stmt *stmt);
+
+/** Assign a PSN to all changes of a transaction. */
+void
+memtx_tx_prepare(struct txn *txn);
+
+/**
+ * Make all changes of a transaction committed, close its
+ * read view and collect the garbage.
+ */
+void
+memtx_tx_commit(struct txn *txn);
+
+/**
+ * Close the read view of a rolled back transaction and
+ * collect the garbage. Statements of the transaction must
+ * be rolled back already.
+ */
+void
+memtx_tx_rollback(struct txn *txn);
+
+/**
+ * Return true if a space has stories, i.e. its indexes can
+ * contain versions invisible to somebody, so it can't be
+ * altered.
+ */
+bool
+memtx_tx_space_has_history(struct space *space);
+
+/** @sa memtx_tx_clarify(). */
+struct tuple *
+memtx_tx_clarify_slow(const MemtxIndex *index, struct tuple *tuple);
+
+/**
+ * Given a tuple stored in an index, return its version,
+ * which is visible to the current transaction, or NULL if
+ * there is none.
+ */
+static inline struct tuple *
+memtx_tx_clarify(const MemtxIndex *index, struct tuple *tuple)
+{
+	if (memtx_tx_manager.story_count == 0 || tuple == NULL)
+		return tuple;
+	return memtx_tx_clarify_slow(index, tuple);
+}
+
+/**
+ * Return a random tuple visible to the current transaction,
+ * given a random tuple stored in an index.
+ */
+struct tuple *
+memtx_tx_clarify_random(const MemtxIndex *index, struct tuple *tuple);
+
+/**
+ * Wrap an iterator over an index into an iterator, which
+ * skips versions invisible to the current transaction, if
+ * the index is versioned. The wrapper owns the iterator.
+ */
+struct iterator *
+memtx_tx_iterator_wrap(const MemtxIndex *index, struct iterator *it);
+
+/**
+ * Return the wrapped iterator if the iterator is created
+ * by memtx_tx_iterator_wrap() or the iterator itself.
+ */
+struct iterator *
+memtx_tx_iterator_unwrap(struct iterator *it);
+
+/**
+ * Wrap a snapshot iterator of the primary key of a space
+ * to make it return versions visible at the moment of the
+ * call. The returned iterator can be used in any thread.
+ */
+struct snapshot_iterator *
+memtx_tx_snapshot_iterator_wrap(struct space *space,
+				struct snapshot_iterator *it);
+
+#endif /* TARANTOOL_BOX_MEMTX_TX_H_INCLUDED */
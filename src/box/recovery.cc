@@ -151,6 +151,15 @@ recovery_close_log(struct recovery *r)
 	trigger_run(&r->on_close_log, NULL);
 }
 
+void
+recovery_release_log(struct recovery *r)
+{
+	if (r->cursor.state == XLOG_CURSOR_CLOSED)
+		return;
+	xlog_cursor_close(&r->cursor, false);
+	trigger_run(&r->on_close_log, NULL);
+}
+
 void
 recovery_delete(struct recovery *r)
 {
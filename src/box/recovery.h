@@ -100,4 +100,13 @@ void
 recover_remaining_wals(struct recovery *r, struct xstream *stream,
 		       struct vclock *stop_vclock, bool scan_dir);
 
+/**
+ * Close the WAL the recovery is currently reading, if any,
+ * without reading it till the end. The caller must have got
+ * the remaining rows from elsewhere, e.g. from the WAL tail
+ * buffer. Runs on_close_log triggers.
+ */
+void
+recovery_release_log(struct recovery *r);
+
 #endif /* TARANTOOL_RECOVERY_H_INCLUDED */
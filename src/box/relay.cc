@@ -37,6 +37,7 @@
 #include "errinj.h"
 #include "fiber.h"
 #include "say.h"
+#include "small/ibuf.h"
 
 #include "coio.h"
 #include "coio_task.h"
@@ -98,6 +99,13 @@ struct relay {
 	struct replica *replica;
 	/** WAL event watcher. */
 	struct wal_watcher wal_watcher;
+	/** Rows copied from the WAL tail buffer. */
+	struct ibuf tail_buf;
+	/**
+	 * Position in the WAL tail buffer or -1 if the relay
+	 * is reading xlog files.
+	 */
+	int64_t tail_offset;
 	/** Set before exiting the relay loop. */
 	bool exiting;
 	/** Relay reader cond. */
@@ -251,13 +259,16 @@ tx_gc_advance(struct cmsg *msg)
 	free(m);
 }
 
+/**
+ * Let the tx thread know that xlogs preceding the relay
+ * vclock are not needed by the replica anymore.
+ */
 static void
-relay_on_close_log_f(struct trigger *trigger, void * /* event */)
+relay_schedule_gc(struct relay *relay)
 {
 	static const struct cmsg_hop route[] = {
 		{tx_gc_advance, NULL}
 	};
-	struct relay *relay = (struct relay *)trigger->data;
 	struct relay_gc_msg *m = (struct relay_gc_msg *)malloc(sizeof(*m));
 	if (m == NULL) {
 		say_warn("failed to allocate relay gc message");
@@ -269,6 +280,42 @@ relay_on_close_log_f(struct trigger *trigger, void * /* event */)
 	cpipe_push(&relay->tx_pipe, &m->msg);
 }
 
+static void
+relay_on_close_log_f(struct trigger *trigger, void * /* event */)
+{
+	struct relay *relay = (struct relay *)trigger->data;
+	relay_schedule_gc(relay);
+}
+
+/**
+ * Send rows from the in-memory WAL tail buffer.
+ *
+ * @retval  0 the replica has received all written rows
+ * @retval -1 the replica lags behind the buffer, the rows
+ *            must be read from xlog files
+ */
+static int
+relay_send_wal_tail(struct relay *relay)
+{
+	struct recovery *r = relay->r;
+	struct ibuf *ibuf = &relay->tail_buf;
+	ibuf_reset(ibuf);
+	if (wal_tail_read(&relay->tail_offset, &r->vclock, ibuf) != 0)
+		return -1;
+	const char *pos = ibuf->rpos;
+	const char *end = ibuf->wpos;
+	while (pos < end) {
+		struct xrow_header row;
+		if (wal_tail_next_row(&pos, end, &row) != 0)
+			diag_raise();
+		if (row.lsn <= vclock_get(&r->vclock, row.replica_id))
+			continue; /* already sent, skip */
+		vclock_follow(&r->vclock, row.replica_id, row.lsn);
+		xstream_write_xc(&relay->stream, &row);
+	}
+	return 0;
+}
+
 static void
 relay_process_wal_event(struct wal_watcher *watcher, unsigned events)
 {
@@ -280,9 +327,34 @@ relay_process_wal_event(struct wal_watcher *watcher, unsigned events)
 		 */
 		return;
 	}
+	ERROR_INJECT(ERRINJ_RELAY_DROP_EVENTS, { return; });
+	struct recovery *r = relay->r;
+	/*
+	 * Rotation events are not tracked while the relay
+	 * is using the WAL tail buffer, so rescan the WAL
+	 * directory when falling back on files.
+	 */
+	bool is_tail = relay->tail_offset >= 0;
+	bool scan_dir = (events & WAL_EVENT_ROTATE) != 0 || is_tail;
 	try {
-		recover_remaining_wals(relay->r, &relay->stream, NULL,
-				       (events & WAL_EVENT_ROTATE) != 0);
+		if (relay_send_wal_tail(relay) == 0) {
+			if (!is_tail)
+				say_info("reading rows from the WAL tail buffer");
+			/*
+			 * The xlog the relay might have been
+			 * reading is of no use anymore, close it
+			 * to let garbage collection proceed.
+			 */
+			if (r->cursor.state != XLOG_CURSOR_CLOSED)
+				recovery_release_log(r);
+			else if ((events & WAL_EVENT_ROTATE) != 0)
+				relay_schedule_gc(relay);
+			return;
+		}
+		if (is_tail)
+			say_info("fell behind the WAL tail buffer, "
+				 "reading xlog files");
+		recover_remaining_wals(r, &relay->stream, NULL, scan_dir);
 	} catch (Exception *e) {
 		e->log();
 		diag_move(diag_get(), &relay->diag);
@@ -355,6 +427,8 @@ relay_subscribe_f(va_list ap)
 		RLIST_LINK_INITIALIZER, relay_on_close_log_f, relay, NULL
 	};
 	trigger_add(&r->on_close_log, &on_close_log);
+	ibuf_create(&relay->tail_buf, &cord()->slabc, 16 * 1024);
+	relay->tail_offset = -1;
 	wal_set_watcher(&relay->wal_watcher, cord_name(cord()),
 			relay_process_wal_event, cbus_process);
 
@@ -410,6 +484,7 @@ relay_subscribe_f(va_list ap)
 	relay->exiting = true;
 	trigger_clear(&on_close_log);
 	wal_clear_watcher(&relay->wal_watcher, cbus_process);
+	ibuf_destroy(&relay->tail_buf);
 	cbus_unpair(&relay->tx_pipe, &relay->relay_pipe,
 		    NULL, NULL, cbus_process);
 	cbus_endpoint_destroy(&relay->endpoint, cbus_process);
@@ -209,6 +209,11 @@ txn_write_to_wal(struct txn *txn)
 	ev_tstamp stop = ev_monotonic_now(loop());
 	if (stop - start > too_long_threshold)
 		say_warn("too long WAL write: %.3f sec", stop - start);
+	/* Account the wait to the request being served, if any. */
+	double *wal_wait = (double *) fiber_get_key(fiber(),
+						    FIBER_KEY_WAL_WAIT);
+	if (wal_wait != NULL)
+		*wal_wait += stop - start;
 	if (res < 0) {
 		/* Cascading rollback. */
 		txn_rollback(); /* Perform our part of cascading rollback. */
@@ -105,6 +105,11 @@ struct vy_env {
 	struct vy_quota     quota;
 	/** Timer for updating quota watermark. */
 	ev_timer            quota_timer;
+	/**
+	 * Dump bandwidth estimate used by write throttling,
+	 * updated by quota_timer.
+	 */
+	int64_t             dump_bandwidth;
 	/** Common index environment. */
 	struct vy_index_env index_env;
 	/** Environment for cache subsystem */
@@ -128,6 +133,8 @@ struct vy_env {
 	int read_threads;
 	/** Max number of threads used for writing. */
 	int write_threads;
+	/** Zstd compression level of run files. */
+	int compression_level;
 };
 
 /** Mask passed to vy_gc(). */
@@ -175,6 +182,10 @@ struct vy_stat {
 	 * best result among 10% worst measurements.
 	 */
 	struct histogram *dump_bw;
+	/** Number of transactions paced by write throttling. */
+	int64_t throttle_count;
+	/** Total time transactions were paced, in seconds. */
+	double throttle_time;
 };
 
 static struct vy_stat *
@@ -551,6 +562,61 @@ struct vy_task_ops {
 		      bool in_shutdown);
 };
 
+enum {
+	/**
+	 * Compaction of a range is split in parts of at least
+	 * range_size / VY_COMPACT_PART_SIZE_RATIO bytes, see
+	 * vy_task_compact_new(). Smaller parts aren't worth
+	 * the extra slices they add to the range.
+	 */
+	VY_COMPACT_PART_SIZE_RATIO = 8,
+};
+
+/**
+ * A key interval of a range compacted by a separate worker
+ * to a separate run.
+ */
+struct vy_compact_part {
+	/** Part boundaries, NULL stands for infinity. */
+	struct tuple *begin, *end;
+	/** Run written for the part. */
+	struct vy_run *new_run;
+	/** Write iterator producing statements for the run. */
+	struct vy_stmt_stream *wi;
+	/**
+	 * Slices of the compacted runs cut to the part
+	 * boundaries, linked by vy_slice::in_range. Empty
+	 * if the range is compacted in one part, in which
+	 * case the range slices are read directly.
+	 */
+	struct rlist cut_slices;
+};
+
+/**
+ * Compaction of a range. Each part of the compaction is
+ * processed by its own task, the range is updated when
+ * the last part is done.
+ */
+struct vy_compact_job {
+	/** Range to compact. */
+	struct vy_range *range;
+	/**
+	 * First (newest) and last (oldest) slices to compact.
+	 *
+	 * While a compaction task is in progress, a new slice
+	 * can be added to a range by concurrent dump, so we
+	 * need to remember the slices we are compacting.
+	 */
+	struct vy_slice *first_slice, *last_slice;
+	/** Number of parts that are not completed yet. */
+	int pending_count;
+	/** Set if any part failed. */
+	bool is_failed;
+	/** Number of parts, ordered by key. */
+	int part_count;
+	struct vy_compact_part parts[0];
+};
+
 struct vy_task {
 	const struct vy_task_ops *ops;
 	/** Return code of ->execute. */
@@ -559,20 +625,12 @@ struct vy_task {
 	struct diag diag;
 	/** Index this task is for. */
 	struct vy_index *index;
-	/** Range to compact. */
-	struct vy_range *range;
+	/** Compaction this task is a part of. */
+	struct vy_compact_job *job;
 	/** Run written by this task. */
 	struct vy_run *new_run;
 	/** Write iterator producing statements for the new run. */
 	struct vy_stmt_stream *wi;
-	/**
-	 * First (newest) and last (oldest) slices to compact.
-	 *
-	 * While a compaction task is in progress, a new slice
-	 * can be added to a range by concurrent dump, so we
-	 * need to remember the slices we are compacting.
-	 */
-	struct vy_slice *first_slice, *last_slice;
 	/**
 	 * A link in the list of all pending tasks, generated by
 	 * task scheduler.
@@ -586,7 +644,12 @@ struct vy_task {
 	 * an index:alter() call.
 	 */
 	double bloom_fpr;
+	bool bloom_per_page;
 	int64_t page_size;
+	/** Zstd compression level of the new run file. */
+	int compression_level;
+	/** Size of the zstd dictionary of the new run file. */
+	uint32_t compression_dict_size;
 };
 
 /**
@@ -632,7 +695,9 @@ vy_task_dump_execute(struct vy_task *task)
 			    index->space_id, index->id, task->wi,
 			    task->page_size, index->cmp_def,
 			    index->key_def, task->max_output_count,
-			    task->bloom_fpr);
+			    task->bloom_fpr, task->bloom_per_page,
+			    task->compression_level,
+			    task->compression_dict_size);
 }
 
 static int
@@ -946,7 +1011,10 @@ vy_task_dump_new(struct vy_scheduler *scheduler, struct vy_index *index,
 	task->wi = wi;
 	task->max_output_count = max_output_count;
 	task->bloom_fpr = index->opts.bloom_fpr;
+	task->bloom_per_page = index->opts.bloom_per_page;
 	task->page_size = index->opts.page_size;
+	task->compression_level = scheduler->env->compression_level;
+	task->compression_dict_size = index->opts.compression_dict_size;
 
 	index->is_dumping = true;
 	vy_scheduler_update_index(scheduler, index);
@@ -986,36 +1054,193 @@ vy_task_compact_execute(struct vy_task *task)
 {
 	struct vy_index *index = task->index;
 
+	struct errinj *inj = errinj(ERRINJ_VY_COMPACT_PART, ERRINJ_INT);
+	if (inj != NULL && inj->iparam >= 0 &&
+	    inj->iparam < task->job->part_count &&
+	    task->job->parts[inj->iparam].new_run == task->new_run) {
+		diag_set(ClientError, ER_INJECTION, "vinyl compaction part");
+		return -1;
+	}
+
 	return vy_run_write(task->new_run, index->env->path,
 			    index->space_id, index->id, task->wi,
 			    task->page_size, index->cmp_def,
 			    index->key_def, task->max_output_count,
-			    task->bloom_fpr);
+			    task->bloom_fpr, task->bloom_per_page,
+			    task->compression_level,
+			    task->compression_dict_size);
+}
+
+/**
+ * Close the write iterator of a compaction part and delete
+ * the slices cut for it.
+ */
+static void
+vy_compact_part_release(struct vy_compact_part *part)
+{
+	if (part->wi != NULL) {
+		/* The iterator has been cleaned up in worker. */
+		part->wi->iface->close(part->wi);
+		part->wi = NULL;
+	}
+	struct vy_slice *slice, *next_slice;
+	rlist_foreach_entry_safe(slice, &part->cut_slices,
+				 in_range, next_slice)
+		vy_slice_delete(slice);
+	rlist_create(&part->cut_slices);
+}
+
+/** Free a compaction job allocated with vy_compact_job_new(). */
+static void
+vy_compact_job_delete(struct vy_compact_job *job)
+{
+	for (int i = 0; i < job->part_count; i++) {
+		struct vy_compact_part *part = &job->parts[i];
+		vy_compact_part_release(part);
+		if (part->begin != NULL)
+			tuple_unref(part->begin);
+		if (part->end != NULL)
+			tuple_unref(part->end);
+	}
+	TRASH(job);
+	free(job);
+}
+
+/**
+ * Allocate a compaction job for a range, splitting it in at
+ * most @part_count parts. Part boundaries are taken from min
+ * keys of pages of @slice, so that each part gets about the
+ * same number of pages of the slice.
+ */
+static struct vy_compact_job *
+vy_compact_job_new(struct vy_index *index, struct vy_range *range,
+		   struct vy_slice *slice, int part_count)
+{
+	struct tuple_format *key_format = index->env->key_format;
+
+	if (part_count > (int)slice->count.pages)
+		part_count = MAX((int)slice->count.pages, 1);
+
+	struct vy_compact_job *job;
+	size_t size = sizeof(*job) + part_count * sizeof(job->parts[0]);
+	job = calloc(1, size);
+	if (job == NULL) {
+		diag_set(OutOfMemory, size, "calloc", "struct vy_compact_job");
+		return NULL;
+	}
+	job->range = range;
+	for (int i = 0; i < part_count; i++)
+		rlist_create(&job->parts[i].cut_slices);
+	job->part_count = 1;
+
+	/* Boundaries must be ascending and lie inside the slice. */
+	const char *prev_key = NULL;
+	if (slice->begin != NULL)
+		prev_key = tuple_data(slice->begin);
+	else if (range->begin != NULL)
+		prev_key = tuple_data(range->begin);
+	for (int i = 1; i < part_count; i++) {
+		struct vy_page_info *page = vy_run_page_info(slice->run,
+				slice->first_page_no +
+				i * slice->count.pages / part_count);
+		const char *key = page->min_key;
+		if (prev_key != NULL &&
+		    key_compare(key, prev_key, index->cmp_def) <= 0)
+			continue;
+		if (range->end != NULL &&
+		    key_compare(key, tuple_data(range->end),
+				index->cmp_def) >= 0)
+			break;
+		struct tuple *boundary = vy_key_from_msgpack(key_format, key);
+		if (boundary == NULL) {
+			vy_compact_job_delete(job);
+			return NULL;
+		}
+		job->parts[job->part_count - 1].end = boundary;
+		tuple_ref(boundary);
+		job->parts[job->part_count].begin = boundary;
+		job->part_count++;
+		prev_key = key;
+	}
+	job->pending_count = job->part_count;
+	return job;
+}
+
+/**
+ * Undo a compaction job after all its parts have been either
+ * completed or aborted and at least one of them failed.
+ */
+static void
+vy_compact_job_abort(struct vy_scheduler *scheduler, struct vy_index *index,
+		     struct vy_compact_job *job, bool in_shutdown)
+{
+	struct vy_range *range = job->range;
+
+	for (int i = 0; i < job->part_count; i++) {
+		struct vy_compact_part *part = &job->parts[i];
+		vy_compact_part_release(part);
+		/* The metadata log is unavailable on shutdown. */
+		if (!in_shutdown)
+			vy_run_discard(part->new_run);
+		else
+			vy_run_unref(part->new_run);
+	}
+	vy_compact_job_delete(job);
+
+	assert(range->heap_node.pos == UINT32_MAX);
+	vy_range_heap_insert(&index->range_heap, &range->heap_node);
+	vy_scheduler_update_index(scheduler, index);
 }
 
 static int
 vy_task_compact_complete(struct vy_scheduler *scheduler, struct vy_task *task)
 {
 	struct vy_index *index = task->index;
-	struct vy_range *range = task->range;
-	struct vy_run *new_run = task->new_run;
-	struct vy_slice *first_slice = task->first_slice;
-	struct vy_slice *last_slice = task->last_slice;
-	struct vy_slice *slice, *next_slice, *new_slice = NULL;
+	struct vy_compact_job *job = task->job;
+	struct vy_range *range = job->range;
+	struct vy_slice *first_slice = job->first_slice;
+	struct vy_slice *last_slice = job->last_slice;
+	struct vy_slice *slice, *next_slice;
 	struct vy_run *run;
+	int i;
+
+	assert(job->pending_count > 0);
+	if (job->pending_count > 1) {
+		/* Wait for the remaining parts. */
+		job->pending_count--;
+		return 0;
+	}
+	if (job->is_failed) {
+		/* Another part failed, the error has been logged. */
+		job->pending_count--;
+		vy_compact_job_abort(scheduler, index, job, false);
+		return 0;
+	}
+
+	/*
+	 * Drop the slices cut for parts first: they hold
+	 * references to the compacted runs.
+	 */
+	for (i = 0; i < job->part_count; i++)
+		vy_compact_part_release(&job->parts[i]);
 
 	/*
-	 * Allocate a slice of the new run.
+	 * Allocate a slice for each new run.
 	 *
-	 * If the run is empty, we don't need to allocate a new slice
+	 * If a run is empty, we don't need to allocate a new slice
 	 * and insert it into the range, but we still need to delete
 	 * compacted runs.
 	 */
-	if (!vy_run_is_empty(new_run)) {
-		new_slice = vy_slice_new(vy_log_next_id(), new_run, NULL, NULL,
-					 index->cmp_def);
-		if (new_slice == NULL)
-			return -1;
+	RLIST_HEAD(new_slices);
+	for (i = 0; i < job->part_count; i++) {
+		struct vy_compact_part *part = &job->parts[i];
+		if (vy_run_is_empty(part->new_run))
+			continue;
+		slice = vy_slice_new(vy_log_next_id(), part->new_run,
+				     part->begin, part->end, index->cmp_def);
+		if (slice == NULL)
+			goto fail;
+		rlist_add_tail_entry(&new_slices, slice, in_range);
 	}
 
 	/*
@@ -1038,7 +1263,9 @@ vy_task_compact_complete(struct vy_scheduler *scheduler, struct vy_task *task)
 	}
 
 	/*
-	 * Log change in metadata.
+	 * Log change in metadata. Slices of the new runs share
+	 * dump LSN, so they must be logged in the key order to
+	 * be recovered in the same order, see vy_log.c.
 	 */
 	vy_log_tx_begin();
 	for (slice = first_slice; ; slice = rlist_next_entry(slice, in_range)) {
@@ -1049,44 +1276,44 @@ vy_task_compact_complete(struct vy_scheduler *scheduler, struct vy_task *task)
 	int64_t gc_lsn = checkpoint_last(NULL);
 	rlist_foreach_entry(run, &unused_runs, in_unused)
 		vy_log_drop_run(run->id, gc_lsn);
-	if (new_slice != NULL) {
-		vy_log_create_run(index->commit_lsn, new_run->id,
-				  new_run->dump_lsn);
-		vy_log_insert_slice(range->id, new_run->id, new_slice->id,
-				    tuple_data_or_null(new_slice->begin),
-				    tuple_data_or_null(new_slice->end));
-	}
-	if (vy_log_tx_commit() < 0) {
-		if (new_slice != NULL)
-			vy_slice_delete(new_slice);
-		return -1;
+	rlist_foreach_entry(slice, &new_slices, in_range) {
+		vy_log_create_run(index->commit_lsn, slice->run->id,
+				  slice->run->dump_lsn);
+		vy_log_insert_slice(range->id, slice->run->id, slice->id,
+				    tuple_data_or_null(slice->begin),
+				    tuple_data_or_null(slice->end));
 	}
+	if (vy_log_tx_commit() < 0)
+		goto fail;
 
 	/*
-	 * Account the new run if it is not empty,
-	 * otherwise discard it.
+	 * Account the new runs that are not empty,
+	 * discard the rest.
 	 */
-	if (new_slice != NULL) {
-		vy_index_add_run(index, new_run);
-		vy_stmt_counter_add_disk(&index->stat.disk.compact.out,
-					 &new_run->count);
-		/* Drop the reference held by the task. */
-		vy_run_unref(new_run);
-	} else
-		vy_run_discard(new_run);
+	for (i = 0; i < job->part_count; i++) {
+		run = job->parts[i].new_run;
+		if (!vy_run_is_empty(run)) {
+			vy_index_add_run(index, run);
+			vy_stmt_counter_add_disk(&index->stat.disk.compact.out,
+						 &run->count);
+			/* Drop the reference held by the task. */
+			vy_run_unref(run);
+		} else
+			vy_run_discard(run);
+	}
 
 	/*
-	 * Replace compacted slices with the resulting slice.
+	 * Replace compacted slices with the resulting slices.
 	 *
 	 * Note, since a slice might have been added to the range
 	 * by a concurrent dump while compaction was in progress,
-	 * we must insert the new slice at the same position where
+	 * we must insert the new slices at the same position where
 	 * the compacted slices were.
 	 */
 	RLIST_HEAD(compacted_slices);
 	vy_index_unacct_range(index, range);
-	if (new_slice != NULL)
-		vy_range_add_slice_before(range, new_slice, first_slice);
+	rlist_foreach_entry_safe(slice, &new_slices, in_range, next_slice)
+		vy_range_add_slice_before(range, slice, first_slice);
 	for (slice = first_slice; ; slice = next_slice) {
 		next_slice = rlist_next_entry(slice, in_range);
 		vy_range_remove_slice(range, slice);
@@ -1113,16 +1340,20 @@ vy_task_compact_complete(struct vy_scheduler *scheduler, struct vy_task *task)
 		vy_slice_delete(slice);
 	}
 
-	/* The iterator has been cleaned up in worker. */
-	task->wi->iface->close(task->wi);
+	say_info("%s: completed compacting range %s",
+		 vy_index_name(index), vy_range_str(range));
+
+	job->pending_count--;
+	vy_compact_job_delete(job);
 
 	assert(range->heap_node.pos == UINT32_MAX);
 	vy_range_heap_insert(&index->range_heap, &range->heap_node);
 	vy_scheduler_update_index(scheduler, index);
-
-	say_info("%s: completed compacting range %s",
-		 vy_index_name(index), vy_range_str(range));
 	return 0;
+fail:
+	rlist_foreach_entry_safe(slice, &new_slices, in_range, next_slice)
+		vy_slice_delete(slice);
+	return -1;
 }
 
 static void
@@ -1130,10 +1361,7 @@ vy_task_compact_abort(struct vy_scheduler *scheduler, struct vy_task *task,
 		      bool in_shutdown)
 {
 	struct vy_index *index = task->index;
-	struct vy_range *range = task->range;
-
-	/* The iterator has been cleaned up in worker. */
-	task->wi->iface->close(task->wi);
+	struct vy_compact_job *job = task->job;
 
 	/*
 	 * It's no use alerting the user if the server is
@@ -1141,24 +1369,27 @@ vy_task_compact_abort(struct vy_scheduler *scheduler, struct vy_task *task,
 	 */
 	if (!in_shutdown && !index->is_dropped) {
 		say_error("%s: failed to compact range %s: %s",
-			  vy_index_name(index), vy_range_str(range),
+			  vy_index_name(index), vy_range_str(job->range),
 			  diag_last_error(&task->diag)->errmsg);
 	}
 
-	/* The metadata log is unavailable on shutdown. */
-	if (!in_shutdown)
-		vy_run_discard(task->new_run);
-	else
-		vy_run_unref(task->new_run);
-
-	assert(range->heap_node.pos == UINT32_MAX);
-	vy_range_heap_insert(&index->range_heap, &range->heap_node);
-	vy_scheduler_update_index(scheduler, index);
+	job->is_failed = true;
+	assert(job->pending_count > 0);
+	if (--job->pending_count > 0)
+		return; /* wait for the remaining parts */
+	vy_compact_job_abort(scheduler, index, job, in_shutdown);
 }
 
+/**
+ * Create tasks for compacting a range and append them to
+ * @tasks. If the range is big, its compaction is split in
+ * key intervals, each written to a separate run by its own
+ * worker, so that compaction of a single range scales with
+ * the number of worker threads.
+ */
 static int
 vy_task_compact_new(struct vy_scheduler *scheduler, struct vy_index *index,
-		    struct vy_task **p_task)
+		    struct stailq *tasks)
 {
 	static struct vy_task_ops compact_ops = {
 		.execute = vy_task_compact_execute,
@@ -1183,50 +1414,110 @@ vy_task_compact_new(struct vy_scheduler *scheduler, struct vy_index *index,
 		return 0;
 	}
 
-	struct vy_task *task = vy_task_new(&scheduler->task_pool,
-					   index, &compact_ops);
-	if (task == NULL)
-		goto err_task;
-
-	struct vy_run *new_run = vy_run_prepare(index);
-	if (new_run == NULL)
-		goto err_run;
-
-	struct vy_stmt_stream *wi;
-	bool is_last_level = (range->compact_priority == range->slice_count);
-	wi = vy_write_iterator_new(index->cmp_def, index->disk_format,
-				   index->upsert_format, index->id == 0,
-				   is_last_level, &xm->read_views);
-	if (wi == NULL)
-		goto err_wi;
-
-	struct vy_slice *slice;
+	/*
+	 * Find the slices to compact, the total size of
+	 * compaction input and the biggest slice, which is
+	 * used to split the compaction in parts.
+	 */
+	struct vy_slice *slice, *first_slice = NULL, *last_slice = NULL;
+	struct vy_slice *max_slice = NULL;
+	uint64_t compact_size = 0;
+	int64_t dump_lsn = -1;
 	int n = range->compact_priority;
 	rlist_foreach_entry(slice, &range->slices, in_range) {
-		if (vy_write_iterator_new_slice(wi, slice,
-						&scheduler->env->run_env) != 0)
-			goto err_wi_sub;
-
-		task->max_output_count += slice->count.rows;
-		new_run->dump_lsn = MAX(new_run->dump_lsn,
-					slice->run->dump_lsn);
-
-		/* Remember the slices we are compacting. */
-		if (task->first_slice == NULL)
-			task->first_slice = slice;
-		task->last_slice = slice;
-
+		if (first_slice == NULL)
+			first_slice = slice;
+		last_slice = slice;
+		compact_size += slice->count.bytes_compressed;
+		dump_lsn = MAX(dump_lsn, slice->run->dump_lsn);
+		if (max_slice == NULL || slice->count.bytes_compressed >
+					 max_slice->count.bytes_compressed)
+			max_slice = slice;
 		if (--n == 0)
 			break;
 	}
 	assert(n == 0);
-	assert(new_run->dump_lsn >= 0);
+	assert(dump_lsn >= 0);
 
-	task->range = range;
-	task->new_run = new_run;
-	task->wi = wi;
-	task->bloom_fpr = index->opts.bloom_fpr;
-	task->page_size = index->opts.page_size;
+	/*
+	 * Split the compaction in parts of at least
+	 * range_size / VY_COMPACT_PART_SIZE_RATIO bytes,
+	 * one part per idle worker. Keep one worker
+	 * reserved for dumps, see vy_schedule().
+	 */
+	uint64_t part_size = MAX(index->opts.range_size /
+				 VY_COMPACT_PART_SIZE_RATIO, 1);
+	int part_count = MIN((uint64_t)scheduler->workers_available - 1,
+			     compact_size / part_size);
+	part_count = MAX(part_count, 1);
+
+	struct stailq new_tasks;
+	stailq_create(&new_tasks);
+	struct vy_task *task, *next_task;
+	struct vy_compact_job *job = vy_compact_job_new(index, range,
+							max_slice, part_count);
+	if (job == NULL)
+		goto err;
+	job->first_slice = first_slice;
+	job->last_slice = last_slice;
+
+	bool is_last_level = (range->compact_priority == range->slice_count);
+	for (int i = 0; i < job->part_count; i++) {
+		struct vy_compact_part *part = &job->parts[i];
+		task = vy_task_new(&scheduler->task_pool, index, &compact_ops);
+		if (task == NULL)
+			goto err_part;
+		stailq_add_tail_entry(&new_tasks, task, link);
+
+		part->new_run = vy_run_prepare(index);
+		if (part->new_run == NULL)
+			goto err_part;
+		part->new_run->dump_lsn = dump_lsn;
+
+		part->wi = vy_write_iterator_new(index->cmp_def,
+						 index->disk_format,
+						 index->upsert_format,
+						 index->id == 0, is_last_level,
+						 &xm->read_views);
+		if (part->wi == NULL)
+			goto err_part;
+
+		for (slice = first_slice; ;
+		     slice = rlist_next_entry(slice, in_range)) {
+			struct vy_slice *src = slice;
+			if (job->part_count > 1) {
+				/*
+				 * The cut slice is never logged
+				 * so it may reuse the slice id.
+				 */
+				if (vy_slice_cut(slice, slice->id,
+						 part->begin, part->end,
+						 index->cmp_def, &src) != 0)
+					goto err_part;
+				if (src != NULL)
+					rlist_add_tail_entry(&part->cut_slices,
+							     src, in_range);
+			}
+			if (src != NULL) {
+				if (vy_write_iterator_new_slice(part->wi, src,
+						&scheduler->env->run_env) != 0)
+					goto err_part;
+				task->max_output_count += src->count.rows;
+			}
+			if (slice == last_slice)
+				break;
+		}
+
+		task->job = job;
+		task->new_run = part->new_run;
+		task->wi = part->wi;
+		task->bloom_fpr = index->opts.bloom_fpr;
+		task->bloom_per_page = index->opts.bloom_per_page;
+		task->page_size = index->opts.page_size;
+		task->compression_level = scheduler->env->compression_level;
+		task->compression_dict_size =
+			index->opts.compression_dict_size;
+	}
 
 	/*
 	 * Remove the range we are going to compact from the heap
@@ -1236,19 +1527,30 @@ vy_task_compact_new(struct vy_scheduler *scheduler, struct vy_index *index,
 	range_node->pos = UINT32_MAX;
 	vy_scheduler_update_index(scheduler, index);
 
-	say_info("%s: started compacting range %s, runs %d/%d",
-		 vy_index_name(index), vy_range_str(range),
-                 range->compact_priority, range->slice_count);
-	*p_task = task;
+	if (job->part_count > 1) {
+		say_info("%s: started compacting range %s, runs %d/%d, "
+			 "parts %d", vy_index_name(index), vy_range_str(range),
+			 range->compact_priority, range->slice_count,
+			 job->part_count);
+	} else {
+		say_info("%s: started compacting range %s, runs %d/%d",
+			 vy_index_name(index), vy_range_str(range),
+			 range->compact_priority, range->slice_count);
+	}
+	stailq_concat(tasks, &new_tasks);
 	return 0;
 
-err_wi_sub:
-	task->wi->iface->close(wi);
-err_wi:
-	vy_run_discard(new_run);
-err_run:
-	vy_task_delete(&scheduler->task_pool, task);
-err_task:
+err_part:
+	for (int i = 0; i < job->part_count; i++) {
+		struct vy_compact_part *part = &job->parts[i];
+		vy_compact_part_release(part);
+		if (part->new_run != NULL)
+			vy_run_discard(part->new_run);
+	}
+	vy_compact_job_delete(job);
+	stailq_foreach_entry_safe(task, next_task, &new_tasks, link)
+		vy_task_delete(&scheduler->task_pool, task);
+err:
 	say_error("%s: could not start compacting range %s: %s",
 		  vy_index_name(index), vy_range_str(range),
 		  diag_last_error(diag_get())->errmsg);
@@ -1270,10 +1572,44 @@ vy_scheduler_stop_workers(struct vy_scheduler *scheduler);
 static int
 vy_scheduler_f(va_list va);
 
+/**
+ * Write throttling controller.
+ *
+ * Once memory usage exceeds the watermark, a dump is in
+ * progress and it is going to take about used / dump_bandwidth
+ * seconds. To avoid hitting the hard limit, which stalls all
+ * writers until the dump is over, limit the rate at which
+ * transactions consume memory so that the memory left lasts
+ * until then:
+ *
+ *   rate = (limit - used) * dump_bandwidth / used
+ *
+ * The closer memory usage gets to the limit, the slower
+ * transactions go. The rate is never set below a fraction
+ * of the dump bandwidth so as not to delay transactions for
+ * longer than the hard limit would.
+ */
+static void
+vy_env_update_throttle_rate(struct vy_env *env)
+{
+	enum { VY_THROTTLE_MIN_RATE_RATIO = 100 };
+	struct vy_quota *q = &env->quota;
+	double rate = 0;
+	if (q->used > q->watermark && q->used < q->limit &&
+	    env->dump_bandwidth > 0) {
+		rate = (double)(q->limit - q->used) *
+			env->dump_bandwidth / q->used;
+		rate = MAX(rate, (double)env->dump_bandwidth /
+			   VY_THROTTLE_MIN_RATE_RATIO);
+	}
+	vy_quota_set_rate_limit(q, rate);
+}
+
 static void
 vy_scheduler_quota_exceeded_cb(struct vy_quota *quota)
 {
 	struct vy_env *env = container_of(quota, struct vy_env, quota);
+	vy_env_update_throttle_rate(env);
 	fiber_cond_signal(&env->scheduler->scheduler_cond);
 }
 
@@ -1292,6 +1628,7 @@ static void
 vy_scheduler_quota_released_cb(struct vy_quota *quota)
 {
 	struct vy_env *env = container_of(quota, struct vy_env, quota);
+	vy_env_update_throttle_rate(env);
 	fiber_cond_broadcast(&env->scheduler->quota_cond);
 }
 
@@ -1509,9 +1846,9 @@ retry:
 }
 
 /**
- * Create a task for compacting a range. The new task is returned
- * in @ptask. If there's no range that needs to be compacted @ptask
- * is set to NULL.
+ * Create tasks for compacting a range. The new tasks are appended
+ * to @tasks. If there's no range that needs to be compacted @tasks
+ * is left empty.
  *
  * We compact ranges that have more runs in a level than specified
  * by run_count_per_level configuration option. Among those runs we
@@ -1522,32 +1859,38 @@ retry:
  */
 static int
 vy_scheduler_peek_compact(struct vy_scheduler *scheduler,
-			  struct vy_task **ptask)
+			  struct stailq *tasks)
 {
 retry:
-	*ptask = NULL;
+	assert(stailq_empty(tasks));
 	struct heap_node *pn = vy_compact_heap_top(&scheduler->compact_heap);
 	if (pn == NULL)
 		return 0; /* nothing to do */
 	struct vy_index *index = container_of(pn, struct vy_index, in_compact);
 	if (vy_index_compact_priority(index) <= 1)
 		return 0; /* nothing to do */
-	if (vy_task_compact_new(scheduler, index, ptask) != 0)
+	if (vy_task_compact_new(scheduler, index, tasks) != 0)
 		return -1;
-	if (*ptask == NULL)
+	if (stailq_empty(tasks))
 		goto retry; /* index dropped or range split/coalesced */
-	return 0; /* new task */
+	return 0; /* new tasks */
 }
 
+/**
+ * Create tasks to schedule and append them to @tasks.
+ * A compaction may be split in several tasks.
+ */
 static int
-vy_schedule(struct vy_scheduler *scheduler, struct vy_task **ptask)
+vy_schedule(struct vy_scheduler *scheduler, struct stailq *tasks)
 {
-	*ptask = NULL;
+	struct vy_task *task;
 
-	if (vy_scheduler_peek_dump(scheduler, ptask) != 0)
+	if (vy_scheduler_peek_dump(scheduler, &task) != 0)
 		goto fail;
-	if (*ptask != NULL)
+	if (task != NULL) {
+		stailq_add_tail_entry(tasks, task, link);
 		return 0;
+	}
 
 	if (scheduler->workers_available <= 1) {
 		/*
@@ -1561,12 +1904,9 @@ vy_schedule(struct vy_scheduler *scheduler, struct vy_task **ptask)
 		return 0;
 	}
 
-	if (vy_scheduler_peek_compact(scheduler, ptask) != 0)
+	if (vy_scheduler_peek_compact(scheduler, tasks) != 0)
 		goto fail;
-	if (*ptask != NULL)
-		return 0;
 
-	/* no task to run */
 	return 0;
 fail:
 	assert(!diag_is_empty(diag_get()));
@@ -1645,9 +1985,9 @@ vy_scheduler_f(va_list va)
 	vy_scheduler_start_workers(scheduler);
 
 	while (scheduler->scheduler != NULL) {
-		struct stailq output_queue;
+		struct stailq output_queue, new_tasks;
 		struct vy_task *task, *next;
-		int tasks_failed = 0, tasks_done = 0;
+		int tasks_failed = 0, tasks_done = 0, task_count = 0;
 		bool was_empty;
 
 		/* Get the list of processed tasks. */
@@ -1689,22 +2029,28 @@ vy_scheduler_f(va_list va)
 		/* All worker threads are busy. */
 		if (scheduler->workers_available == 0)
 			goto wait;
-		/* Get a task to schedule. */
-		if (vy_schedule(scheduler, &task) != 0)
+		/* Get tasks to schedule. */
+		stailq_create(&new_tasks);
+		if (vy_schedule(scheduler, &new_tasks) != 0)
 			goto error;
 		/* Nothing to do. */
-		if (task == NULL)
+		if (stailq_empty(&new_tasks))
 			goto wait;
+		stailq_foreach_entry(task, &new_tasks, link)
+			task_count++;
 
-		/* Queue the task and notify workers if necessary. */
+		/* Queue the tasks and notify workers if necessary. */
 		tt_pthread_mutex_lock(&scheduler->mutex);
 		was_empty = stailq_empty(&scheduler->input_queue);
-		stailq_add_tail_entry(&scheduler->input_queue, task, link);
-		if (was_empty)
+		stailq_concat(&scheduler->input_queue, &new_tasks);
+		if (task_count > 1)
+			tt_pthread_cond_broadcast(&scheduler->worker_cond);
+		else if (was_empty)
 			tt_pthread_cond_signal(&scheduler->worker_cond);
 		tt_pthread_mutex_unlock(&scheduler->mutex);
 
-		scheduler->workers_available--;
+		scheduler->workers_available -= task_count;
+		assert(scheduler->workers_available >= 0);
 		fiber_reschedule();
 		continue;
 error:
@@ -2014,6 +2360,16 @@ vy_info_append_memory(struct vy_env *env, struct info_handler *h)
 	info_table_end(h);
 }
 
+static void
+vy_info_append_throttle(struct vy_env *env, struct info_handler *h)
+{
+	info_table_begin(h, "throttle");
+	info_append_int(h, "rate", env->quota.rate_limit);
+	info_append_int(h, "count", env->stat->throttle_count);
+	info_append_double(h, "time", env->stat->throttle_time);
+	info_table_end(h);
+}
+
 static int
 vy_info_append_stat_rmean(const char *name, int rps, int64_t total, void *ctx)
 {
@@ -2052,6 +2408,16 @@ vy_info_append_performance(struct vy_env *env, struct info_handler *h)
 	info_append_int(h, "used", ce->mem_used);
 	info_table_end(h);
 
+	struct vy_page_cache *pc = &env->run_env.page_cache;
+	info_table_begin(h, "page_cache");
+	info_append_int(h, "count", pc->count);
+	info_append_int(h, "used", pc->mem_used);
+	info_append_int(h, "limit", pc->mem_quota);
+	info_append_int(h, "hit", pc->hit);
+	info_append_int(h, "miss", pc->miss);
+	info_append_int(h, "blooms", pc->bloom_count);
+	info_table_end(h);
+
 	info_table_end(h);
 }
 
@@ -2061,6 +2427,7 @@ vy_info(struct vy_env *env, struct info_handler *h)
 	info_begin(h);
 
 	vy_info_append_memory(env, h);
+	vy_info_append_throttle(env, h);
 	vy_info_append_performance(env, h);
 	info_append_int(h, "lsn", env->xm->lsn);
 
@@ -2153,6 +2520,7 @@ vy_index_info(struct vy_index *index, struct info_handler *h)
 	info_append_int(h, "hit", stat->disk.iterator.bloom_hit);
 	info_append_int(h, "miss", stat->disk.iterator.bloom_miss);
 	info_table_end(h);
+	info_append_int(h, "readahead", stat->disk.iterator.readahead);
 	info_table_end(h);
 	vy_info_append_compact_stat(h, "dump", &stat->disk.dump);
 	vy_info_append_compact_stat(h, "compact", &stat->disk.compact);
@@ -3713,8 +4081,22 @@ vy_prepare(struct vy_env *env, struct vy_tx *tx)
 	 * the transaction to be sent to read view or aborted, we call
 	 * it before checking for conflicts.
 	 */
-	if (vy_quota_use(&env->quota, tx->write_size,
-			 env->timeout) != 0) {
+	ev_tstamp timeout = env->timeout;
+	ev_tstamp delay = vy_quota_pace(&env->quota, tx->write_size,
+					ev_monotonic_now(loop()));
+	if (delay > 0) {
+		/*
+		 * Memory is being consumed faster than it can
+		 * be dumped. Slow down to avoid a stall on the
+		 * hard limit.
+		 */
+		delay = MIN(delay, timeout);
+		env->stat->throttle_count++;
+		env->stat->throttle_time += delay;
+		timeout -= delay;
+		fiber_sleep(delay);
+	}
+	if (vy_quota_use(&env->quota, tx->write_size, timeout) != 0) {
 		diag_set(ClientError, ER_VY_QUOTA_TIMEOUT);
 		return -1;
 	}
@@ -3822,6 +4204,7 @@ vy_env_quota_timer_cb(ev_loop *loop, ev_timer *timer, int events)
 
 	int64_t tx_write_rate = vy_stat_tx_write_rate(e->stat);
 	int64_t dump_bandwidth = vy_stat_dump_bandwidth(e->stat);
+	e->dump_bandwidth = dump_bandwidth;
 
 	/*
 	 * Due to log structured nature of the lsregion allocator,
@@ -3838,6 +4221,7 @@ vy_env_quota_timer_cb(ev_loop *loop, ev_timer *timer, int events)
 			    (dump_bandwidth + tx_write_rate + 1));
 
 	vy_quota_set_watermark(&e->quota, watermark);
+	vy_env_update_throttle_rate(e);
 }
 
 static struct vy_squash_queue *
@@ -3849,8 +4233,9 @@ vy_squash_schedule(struct vy_index *index, struct tuple *stmt,
 		   void /* struct vy_env */ *arg);
 
 struct vy_env *
-vy_env_new(const char *path, size_t memory, size_t cache, int read_threads,
-	   int write_threads, double timeout)
+vy_env_new(const char *path, size_t memory, size_t cache, size_t page_cache,
+	   int read_threads, int write_threads, double timeout,
+	   int compression_level)
 {
 	struct vy_env *e = malloc(sizeof(*e));
 	if (unlikely(e == NULL)) {
@@ -3863,6 +4248,7 @@ vy_env_new(const char *path, size_t memory, size_t cache, int read_threads,
 	e->timeout = timeout;
 	e->read_threads = read_threads;
 	e->write_threads = write_threads;
+	e->compression_level = compression_level;
 	e->path = strdup(path);
 	if (e->path == NULL) {
 		diag_set(OutOfMemory, strlen(path),
@@ -3900,9 +4286,15 @@ vy_env_new(const char *path, size_t memory, size_t cache, int read_threads,
 	e->quota_timer.data = e;
 	ev_timer_start(loop(), &e->quota_timer);
 	vy_cache_env_create(&e->cache_env, slab_cache, cache);
-	vy_run_env_create(&e->run_env);
+	if (vy_run_env_create(&e->run_env, page_cache) != 0)
+		goto error_run_env;
 	vy_log_init(e->path);
 	return e;
+error_run_env:
+	vy_cache_env_destroy(&e->cache_env);
+	ev_timer_stop(loop(), &e->quota_timer);
+	mempool_destroy(&e->cursor_pool);
+	vy_index_env_destroy(&e->index_env);
 error_index_env:
 	vy_stmt_env_destroy(&e->stmt_env);
 	vy_squash_queue_delete(e->squash_queue);
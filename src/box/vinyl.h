@@ -59,8 +59,9 @@ enum iterator_type;
  */
 
 struct vy_env *
-vy_env_new(const char *path, size_t memory, size_t cache, int read_threads,
-	   int write_threads, double timeout);
+vy_env_new(const char *path, size_t memory, size_t cache, size_t page_cache,
+	   int read_threads, int write_threads, double timeout,
+	   int compression_level);
 
 void
 vy_env_delete(struct vy_env *e);
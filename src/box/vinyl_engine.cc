@@ -75,9 +75,11 @@ VinylEngine::init()
 	env = vy_env_new(cfg_gets("vinyl_dir"),
 			 cfg_geti64("vinyl_memory"),
 			 cfg_geti64("vinyl_cache"),
+			 cfg_geti64("vinyl_page_cache"),
 			 cfg_geti("vinyl_read_threads"),
 			 cfg_geti("vinyl_write_threads"),
-			 cfg_getd("vinyl_timeout"));
+			 cfg_getd("vinyl_timeout"),
+			 cfg_geti("vinyl_compression_level"));
 	if (env == NULL)
 		panic("failed to create vinyl environment");
 }
@@ -184,6 +184,12 @@ VinylSpace::checkIndexDef(struct space *space, struct index_def *index_def)
 					     field_type_strs[part->type]));
 		}
 	}
+	if (index_def->opts.compression_dict_size < 0 ||
+	    index_def->opts.compression_dict_size > UINT32_MAX) {
+		tnt_raise(ClientError, ER_MODIFY_INDEX,
+			  index_def->name, space_name(space),
+			  "compression_dict_size is out of range");
+	}
 }
 
 Index *
@@ -992,7 +992,12 @@ vy_index_split_range(struct vy_index *index, struct vy_range *range)
 			if (new_slice != NULL)
 				vy_range_add_slice(part, new_slice);
 		}
-		part->compact_priority = range->compact_priority;
+		/*
+		 * Slices of a run written by a compaction split
+		 * in parts may not intersect the new range, so
+		 * the priority must be recomputed.
+		 */
+		vy_range_update_compact_priority(part, &index->opts);
 	}
 	tuple_unref(split_key);
 	split_key = NULL;
@@ -83,6 +83,21 @@ struct vy_quota {
 	size_t watermark;
 	/** Current memory consumption. */
 	size_t used;
+	/**
+	 * Max rate at which memory may be consumed, in bytes
+	 * per second, or 0 if the rate is not limited. Unlike
+	 * the hard limit, it paces consumers smoothly, see
+	 * vy_quota_pace().
+	 */
+	double rate_limit;
+	/**
+	 * Number of bytes that may be consumed right now
+	 * without exceeding the rate limit. Negative if
+	 * consumers are in debt and must wait.
+	 */
+	double rate_budget;
+	/** Time when @rate_budget was last updated. */
+	ev_tstamp rate_budget_ts;
 	/** Used-defined callbacks. */
 	vy_quota_exceeded_f quota_exceeded_cb;
 	vy_quota_throttled_f quota_throttled_cb;
@@ -98,6 +113,9 @@ vy_quota_init(struct vy_quota *q,
 	q->limit = SIZE_MAX;
 	q->watermark = SIZE_MAX;
 	q->used = 0;
+	q->rate_limit = 0;
+	q->rate_budget = 0;
+	q->rate_budget_ts = 0;
 	q->quota_exceeded_cb = quota_exceeded_cb;
 	q->quota_throttled_cb = quota_throttled_cb;
 	q->quota_released_cb = quota_released_cb;
@@ -136,6 +154,47 @@ vy_quota_set_watermark(struct vy_quota *q, size_t watermark)
 		q->quota_exceeded_cb(q);
 }
 
+/**
+ * Set the max rate of memory consumption, in bytes per second.
+ * 0 disables rate limiting.
+ */
+static inline void
+vy_quota_set_rate_limit(struct vy_quota *q, double rate_limit)
+{
+	if (q->rate_limit == 0) {
+		/* Start with a full budget. */
+		q->rate_budget = rate_limit;
+	}
+	q->rate_limit = rate_limit;
+}
+
+/**
+ * Charge @size bytes consumed at time @now against the rate
+ * limit. Return the time the caller should wait to conform
+ * to the limit, or 0 if it may proceed right away.
+ *
+ * The budget is refilled at the rate limit and may accumulate
+ * up to one second worth of consumption, which allows short
+ * bursts. Consumers that exceed it drive the budget negative,
+ * so that each of them waits for its turn.
+ */
+static inline ev_tstamp
+vy_quota_pace(struct vy_quota *q, size_t size, ev_tstamp now)
+{
+	if (q->rate_limit == 0)
+		return 0;
+	if (q->rate_budget_ts < now) {
+		q->rate_budget += (now - q->rate_budget_ts) * q->rate_limit;
+		if (q->rate_budget > q->rate_limit)
+			q->rate_budget = q->rate_limit;
+	}
+	q->rate_budget_ts = now;
+	q->rate_budget -= size;
+	if (q->rate_budget >= 0)
+		return 0;
+	return -q->rate_budget / q->rate_limit;
+}
+
 /**
  * Consume @size bytes of memory. In contrast to vy_quota_use()
  * this function does not throttle the caller.
@@ -285,8 +285,8 @@ vy_range_remove_slice(struct vy_range *range, struct vy_slice *slice)
  * ratio.
  *
  * Given a range, this function computes the maximal level that needs
- * to be compacted and sets @compact_priority to the number of runs in
- * this level and all preceding levels.
+ * to be compacted and sets @compact_priority to the number of run
+ * slices in this level and all preceding levels.
  */
 void
 vy_range_update_compact_priority(struct vy_range *range,
@@ -297,8 +297,8 @@ vy_range_update_compact_priority(struct vy_range *range,
 
 	range->compact_priority = 0;
 
-	/* Total number of checked runs. */
-	uint32_t total_run_count = 0;
+	/* Total number of checked slices. */
+	uint32_t total_slice_count = 0;
 	/* The total size of runs checked so far. */
 	uint64_t total_size = 0;
 	/* Estimated size of a compacted run, if compaction is scheduled. */
@@ -313,9 +313,23 @@ vy_range_update_compact_priority(struct vy_range *range,
 	 */
 	uint64_t target_run_size = 0;
 
-	struct vy_slice *slice;
+	/* Size of the current run. */
+	uint64_t size = 0;
+	struct vy_slice *slice, *last_slice;
+	last_slice = rlist_last_entry(&range->slices, struct vy_slice, in_range);
 	rlist_foreach_entry(slice, &range->slices, in_range) {
-		uint64_t size = slice->count.bytes_compressed;
+		size += slice->count.bytes_compressed;
+		total_slice_count++;
+		/*
+		 * A compaction split in parts writes a run per part,
+		 * all with the same dump LSN and disjoint key ranges.
+		 * Together they make up a single level, so account
+		 * adjacent slices with the same dump LSN as one run.
+		 */
+		if (slice != last_slice &&
+		    rlist_next_entry(slice, in_range)->run->dump_lsn ==
+		    slice->run->dump_lsn)
+			continue;
 		/*
 		 * The size of the first level is defined by
 		 * the size of the most recent run.
@@ -324,7 +338,6 @@ vy_range_update_compact_priority(struct vy_range *range,
 			target_run_size = size;
 		total_size += size;
 		level_run_count++;
-		total_run_count++;
 		while (size > target_run_size) {
 			/*
 			 * The run size exceeds the threshold
@@ -361,9 +374,10 @@ vy_range_update_compact_priority(struct vy_range *range,
 			 * for compaction. We compact all runs at
 			 * this level and upper levels.
 			 */
-			range->compact_priority = total_run_count;
+			range->compact_priority = total_slice_count;
 			est_new_run_size = total_size;
 		}
+		size = 0;
 	}
 }
 
@@ -394,10 +408,43 @@ vy_range_needs_split(struct vy_range *range, const struct index_opts *opts,
 	assert(!rlist_empty(&range->slices));
 	slice = rlist_last_entry(&range->slices, struct vy_slice, in_range);
 
+	/*
+	 * The oldest run may have been written by a compaction
+	 * split in parts, in which case it consists of several
+	 * slices with the same dump LSN, see
+	 * vy_range_update_compact_priority().
+	 */
+	struct vy_slice *first_part = slice;
+	uint64_t size = slice->count.bytes_compressed;
+	int part_count = 1;
+	while (first_part != rlist_first_entry(&range->slices,
+					       struct vy_slice, in_range)) {
+		struct vy_slice *prev = rlist_prev_entry(first_part, in_range);
+		if (prev->run->dump_lsn != slice->run->dump_lsn)
+			break;
+		first_part = prev;
+		size += prev->count.bytes_compressed;
+		part_count++;
+	}
+
 	/* The range is too small to be split. */
-	if (slice->count.bytes_compressed < opts->range_size * 4 / 3)
+	if (size < opts->range_size * 4 / 3)
 		return false;
 
+	if (part_count > 1) {
+		/* Split at the beginning of the middle part. */
+		struct vy_slice *mid_part = first_part;
+		for (int i = 0; i < part_count / 2; i++)
+			mid_part = rlist_next_entry(mid_part, in_range);
+		if (mid_part->begin != NULL &&
+		    (range->begin == NULL ||
+		     vy_key_compare(mid_part->begin, range->begin,
+				    range->cmp_def) > 0)) {
+			*p_split_key = tuple_data(mid_part->begin);
+			return true;
+		}
+	}
+
 	/* Find the median key in the oldest run (approximately). */
 	struct vy_page_info *mid_page;
 	mid_page = vy_run_page_info(slice->run, slice->first_page_no +
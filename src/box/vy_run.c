@@ -31,6 +31,8 @@
 #include "vy_run.h"
 
 #include <zstd.h>
+#include <zdict.h>
+#include <fcntl.h>
 
 #include "fiber.h"
 #include "fiber_cond.h"
@@ -58,6 +60,25 @@ static const uint64_t vy_run_info_key_map = (1 << VY_RUN_INFO_MIN_KEY) |
 
 enum { VY_BLOOM_VERSION = 0 };
 
+enum {
+	/**
+	 * The number of pages a run iterator has to load one
+	 * after another before it's considered to be scanning
+	 * the run and read ahead is started.
+	 */
+	VY_RUN_READAHEAD_THRESHOLD = 3,
+	/**
+	 * How many pages following the one being loaded
+	 * are read ahead by a scanning run iterator.
+	 */
+	VY_RUN_READAHEAD_PAGES = 16,
+	/**
+	 * How many times the size of the zstd dictionary the
+	 * run page data sampled to train it must be.
+	 */
+	VY_RUN_DICT_SAMPLE_RATIO = 16,
+};
+
 /** xlog meta type for .run files */
 #define XLOG_META_TYPE_RUN "RUN"
 
@@ -94,8 +115,110 @@ struct vy_page_read_task {
 	struct vy_run_env *run_env;
 	/** [out] resulting vinyl page */
 	struct vy_page *page;
+	/** [out] page bloom filter, set if the filter is read */
+	struct vy_page_bloom *bloom;
+	/** Offset of the file range to read ahead. */
+	off_t readahead_offset;
+	/** Size of the file range to read ahead, 0 if none. */
+	size_t readahead_len;
+};
+
+/** Key of a page in vy_page_cache. */
+struct vy_page_key {
+	int64_t run_id;
+	uint32_t page_no;
+};
+
+static inline uint32_t
+vy_page_hash(int64_t run_id, uint32_t page_no)
+{
+	uint64_t h = (uint64_t)run_id * 0x9E3779B97F4A7C15ULL ^ page_no;
+	return (uint32_t)(h ^ (h >> 32));
+}
+
+/** Node of vy_page_cache::pages. */
+struct vy_page_node {
+	struct vy_page *page;
 };
 
+#define mh_name _vy_page
+#define mh_key_t struct vy_page_key
+#define mh_node_t struct vy_page_node
+#define mh_arg_t void *
+#define mh_hash(a, arg) vy_page_hash((a)->page->run_id, (a)->page->page_no)
+#define mh_hash_key(a, arg) vy_page_hash((a).run_id, (a).page_no)
+#define mh_cmp(a, b, arg) ((a)->page->run_id != (b)->page->run_id || \
+			   (a)->page->page_no != (b)->page->page_no)
+#define mh_cmp_key(a, b, arg) ((a).run_id != (b)->page->run_id || \
+			       (a).page_no != (b)->page->page_no)
+#define MH_SOURCE 1
+#include "salad/mhash.h"
+
+static void
+vy_page_delete(struct vy_page *page);
+
+/** Memory used by a page bloom filter, as accounted by vy_page_cache. */
+static inline size_t
+vy_page_bloom_mem_used(struct vy_page_bloom *bloom)
+{
+	return sizeof(*bloom) + bloom_store_size(&bloom->bloom);
+}
+
+/**
+ * Free a page bloom filter, removing it from the page cache
+ * if it's there.
+ */
+static void
+vy_page_bloom_delete(struct vy_page_bloom *bloom)
+{
+	if (bloom->page_info != NULL) {
+		struct vy_page_cache *cache = bloom->cache;
+		assert(bloom->page_info->bloom == bloom);
+		bloom->page_info->bloom = NULL;
+		rlist_del_entry(bloom, in_lru);
+		cache->bloom_count--;
+		cache->mem_used -= vy_page_bloom_mem_used(bloom);
+	}
+	if (bloom->bloom.table != NULL)
+		bloom_destroy(&bloom->bloom, runtime.quota);
+	free(bloom);
+}
+
+static int
+vy_page_cache_create(struct vy_page_cache *cache, size_t mem_quota)
+{
+	cache->pages = mh_vy_page_new();
+	if (cache->pages == NULL) {
+		diag_set(OutOfMemory, sizeof(*cache->pages),
+			 "mh_vy_page_new", "page cache");
+		return -1;
+	}
+	rlist_create(&cache->lru);
+	cache->count = 0;
+	rlist_create(&cache->bloom_lru);
+	cache->bloom_count = 0;
+	cache->clock = 0;
+	cache->mem_used = 0;
+	cache->mem_quota = mem_quota;
+	cache->hit = cache->miss = 0;
+	return 0;
+}
+
+static void
+vy_page_cache_destroy(struct vy_page_cache *cache)
+{
+	struct vy_page *page, *tmp;
+	rlist_foreach_entry_safe(page, &cache->lru, in_lru, tmp) {
+		page->in_cache = false;
+		if (--page->refs == 0)
+			vy_page_delete(page);
+	}
+	struct vy_page_bloom *bloom, *next_bloom;
+	rlist_foreach_entry_safe(bloom, &cache->bloom_lru, in_lru, next_bloom)
+		vy_page_bloom_delete(bloom);
+	mh_vy_page_delete(cache->pages);
+}
+
 /** Destructor for env->zdctx_key thread-local variable */
 static void
 vy_free_zdctx(void *arg)
@@ -164,13 +287,16 @@ vy_run_env_stop_readers(struct vy_run_env *env)
 /**
  * Initialize vinyl run environment
  */
-void
-vy_run_env_create(struct vy_run_env *env)
+int
+vy_run_env_create(struct vy_run_env *env, size_t page_cache)
 {
 	memset(env, 0, sizeof(*env));
+	if (vy_page_cache_create(&env->page_cache, page_cache) != 0)
+		return -1;
 	tt_pthread_key_create(&env->zdctx_key, vy_free_zdctx);
 	mempool_create(&env->read_task_pool, cord_slab_cache(),
 		       sizeof(struct vy_page_read_task));
+	return 0;
 }
 
 /**
@@ -183,6 +309,7 @@ vy_run_env_destroy(struct vy_run_env *env)
 		vy_run_env_stop_readers(env);
 	mempool_destroy(&env->read_task_pool);
 	tt_pthread_key_delete(env->zdctx_key);
+	vy_page_cache_destroy(&env->page_cache);
 }
 
 /**
@@ -221,6 +348,8 @@ vy_page_info_destroy(struct vy_page_info *page_info)
 {
 	if (page_info->min_key != NULL)
 		free(page_info->min_key);
+	if (page_info->bloom != NULL)
+		vy_page_bloom_delete(page_info->bloom);
 }
 
 struct vy_run *
@@ -260,6 +389,27 @@ vy_run_clear(struct vy_run *run)
 	run->info.min_key = NULL;
 	free(run->info.max_key);
 	run->info.max_key = NULL;
+	ZSTD_freeDDict(run->zddict);
+	run->zddict = NULL;
+	free(run->info.dict);
+	run->info.dict = NULL;
+}
+
+/**
+ * Remember the path to the run data file for error reporting.
+ */
+static int
+vy_run_set_path(struct vy_run *run, const char *path)
+{
+	char *copy = strdup(path);
+	if (copy == NULL) {
+		diag_set(OutOfMemory, strlen(path) + 1, "strdup",
+			 "run path");
+		return -1;
+	}
+	free(run->path);
+	run->path = copy;
+	return 0;
 }
 
 void
@@ -268,11 +418,46 @@ vy_run_delete(struct vy_run *run)
 	assert(run->refs == 0);
 	if (run->fd >= 0 && close(run->fd) < 0)
 		say_syserror("close failed");
+	free(run->path);
 	vy_run_clear(run);
 	TRASH(run);
 	free(run);
 }
 
+/**
+ * Digest the run zstd dictionary, if any, for decompression.
+ *
+ * @retval 0 success
+ * @retval -1 memory error, check diag
+ */
+static int
+vy_run_create_zddict(struct vy_run *run)
+{
+	assert(run->zddict == NULL);
+	if (run->info.dict == NULL)
+		return 0;
+	run->zddict = ZSTD_createDDict(run->info.dict, run->info.dict_size);
+	if (run->zddict == NULL) {
+		diag_set(OutOfMemory, run->info.dict_size,
+			 "ZSTD_createDDict", "run dictionary");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Return the zstd dictionary needed to decompress the run
+ * file tx starting at @a offset, NULL if the tx is compressed
+ * without a dictionary.
+ */
+static inline const ZSTD_DDict *
+vy_run_zddict(const struct vy_run *run, uint64_t offset)
+{
+	if (run->zddict == NULL || offset < run->info.dict_offset)
+		return NULL;
+	return run->zddict;
+}
+
 /**
  * Find a page from which the iteration of a given key must be started.
  * LE and LT: the found page definitely contains the position
@@ -513,6 +698,17 @@ vy_page_info_decode(struct vy_page_info *page, const struct xrow_header *xrow,
 		case VY_PAGE_INFO_ROW_INDEX_OFFSET:
 			page->row_index_offset = mp_decode_uint(&pos);
 			break;
+		case VY_PAGE_INFO_BLOOM:
+			if (mp_decode_array(&pos) != 3) {
+				diag_set(ClientError, ER_INVALID_INDEX_FILE,
+					 filename, "Can't decode page info: "
+					 "wrong bloom location");
+				return -1;
+			}
+			page->bloom_offset = mp_decode_uint(&pos);
+			page->bloom_size = mp_decode_uint(&pos);
+			page->bloom_unpacked_size = mp_decode_uint(&pos);
+			break;
 		default:
 			diag_set(ClientError, ER_INVALID_INDEX_FILE, filename,
 				 tt_sprintf("Can't decode page info: "
@@ -579,6 +775,40 @@ vy_run_bloom_decode(struct bloom *bloom, const char **buffer,
 	return 0;
 }
 
+/**
+ * Decode the run zstd dictionary.
+ * @param run_info - the run information to store the dictionary in.
+ * @param buffer[in/out] - a buffer to read from.
+ *  The pointer is incremented on the number of bytes read.
+ * @param filename Filename for error reporting.
+ * @return - 0 on success or -1 on format/memory error
+ */
+static int
+vy_run_dict_decode(struct vy_run_info *run_info, const char **buffer,
+		   const char *filename)
+{
+	const char **pos = buffer;
+	uint32_t array_size = mp_decode_array(pos);
+	if (array_size != 2) {
+		diag_set(ClientError, ER_INVALID_INDEX_FILE, filename,
+			 tt_sprintf("Can't decode run dictionary: "
+				    "wrong array size (expected %d, got %u)",
+				    2, (unsigned)array_size));
+		return -1;
+	}
+	run_info->dict_offset = mp_decode_uint(pos);
+	uint32_t dict_size;
+	const char *dict = mp_decode_bin(pos, &dict_size);
+	run_info->dict = malloc(dict_size);
+	if (run_info->dict == NULL) {
+		diag_set(OutOfMemory, dict_size, "malloc", "run dictionary");
+		return -1;
+	}
+	memcpy(run_info->dict, dict, dict_size);
+	run_info->dict_size = dict_size;
+	return 0;
+}
+
 /**
  * Decode the run metadata from xrow.
  *
@@ -637,6 +867,10 @@ vy_run_info_decode(struct vy_run_info *run_info,
 			else
 				return -1;
 			break;
+		case VY_RUN_INFO_DICT:
+			if (vy_run_dict_decode(run_info, &pos, filename) != 0)
+				return -1;
+			break;
 		default:
 			diag_set(ClientError, ER_INVALID_INDEX_FILE, filename,
 				"Can't decode run info: unknown key %u",
@@ -664,8 +898,13 @@ vy_page_new(const struct vy_page_info *page_info)
 			 "load_page", "page cache");
 		return NULL;
 	}
+	page->run_id = -1;
+	page->page_no = UINT32_MAX;
 	page->unpacked_size = page_info->unpacked_size;
 	page->row_count = page_info->row_count;
+	page->refs = 1;
+	page->in_cache = false;
+	rlist_create(&page->in_lru);
 	page->row_index = calloc(page_info->row_count, sizeof(uint32_t));
 	if (page->row_index == NULL) {
 		diag_set(OutOfMemory, page_info->row_count * sizeof(uint32_t),
@@ -700,6 +939,159 @@ vy_page_delete(struct vy_page *page)
 	free(page);
 }
 
+static inline void
+vy_page_ref(struct vy_page *page)
+{
+	page->refs++;
+}
+
+static inline void
+vy_page_unref(struct vy_page *page)
+{
+	assert(page->refs > 0);
+	if (--page->refs == 0)
+		vy_page_delete(page);
+}
+
+/** Memory used by a page, as accounted by vy_page_cache. */
+static inline size_t
+vy_page_mem_used(struct vy_page *page)
+{
+	return sizeof(*page) + page->unpacked_size +
+	       page->row_count * sizeof(*page->row_index);
+}
+
+static void
+vy_page_cache_remove(struct vy_page_cache *cache, struct vy_page *page)
+{
+	assert(page->in_cache);
+	struct vy_page_key key = { page->run_id, page->page_no };
+	mh_int_t k = mh_vy_page_find(cache->pages, key, NULL);
+	assert(k != mh_end(cache->pages));
+	mh_vy_page_del(cache->pages, k, NULL);
+	rlist_del_entry(page, in_lru);
+	page->in_cache = false;
+	cache->count--;
+	cache->mem_used -= vy_page_mem_used(page);
+	vy_page_unref(page);
+}
+
+/**
+ * Look up a page in the cache.
+ * @retval page with an extra reference if found
+ * @retval NULL otherwise
+ */
+static struct vy_page *
+vy_page_cache_get(struct vy_page_cache *cache, int64_t run_id,
+		  uint32_t page_no)
+{
+	if (cache->mem_quota == 0)
+		return NULL;
+	struct vy_page_key key = { run_id, page_no };
+	mh_int_t k = mh_vy_page_find(cache->pages, key, NULL);
+	if (k == mh_end(cache->pages)) {
+		cache->miss++;
+		return NULL;
+	}
+	struct vy_page *page = mh_vy_page_node(cache->pages, k)->page;
+	rlist_move_entry(&cache->lru, page, in_lru);
+	page->last_used = ++cache->clock;
+	vy_page_ref(page);
+	cache->hit++;
+	return page;
+}
+
+/**
+ * Evict least recently used pages and page bloom filters
+ * until @size more bytes fit in the cache quota.
+ */
+static void
+vy_page_cache_evict(struct vy_page_cache *cache, size_t size)
+{
+	while (cache->mem_used + size > cache->mem_quota) {
+		struct vy_page *page = NULL;
+		struct vy_page_bloom *bloom = NULL;
+		if (!rlist_empty(&cache->lru))
+			page = rlist_last_entry(&cache->lru, struct vy_page,
+						in_lru);
+		if (!rlist_empty(&cache->bloom_lru))
+			bloom = rlist_last_entry(&cache->bloom_lru,
+						 struct vy_page_bloom, in_lru);
+		assert(page != NULL || bloom != NULL);
+		if (bloom == NULL ||
+		    (page != NULL && page->last_used < bloom->last_used))
+			vy_page_cache_remove(cache, page);
+		else
+			vy_page_bloom_delete(bloom);
+	}
+}
+
+/**
+ * Add a page read from disk to the cache, evicting least
+ * recently used pages if the cache is over its quota.
+ * Failure to add a page is not an error: the page stays
+ * private to the caller then.
+ */
+static void
+vy_page_cache_put(struct vy_page_cache *cache, struct vy_page *page)
+{
+	assert(!page->in_cache);
+	size_t size = vy_page_mem_used(page);
+	if (size > cache->mem_quota)
+		return;
+	struct vy_page_key key = { page->run_id, page->page_no };
+	if (mh_vy_page_find(cache->pages, key, NULL) != mh_end(cache->pages)) {
+		/* Loaded by another fiber while we were reading. */
+		return;
+	}
+	vy_page_cache_evict(cache, size);
+	const struct vy_page_node node = { page };
+	if (mh_vy_page_put(cache->pages, &node, NULL,
+			   NULL) == mh_end(cache->pages))
+		return;
+	rlist_add_entry(&cache->lru, page, in_lru);
+	page->in_cache = true;
+	page->last_used = ++cache->clock;
+	vy_page_ref(page);
+	cache->count++;
+	cache->mem_used += size;
+}
+
+/**
+ * Keep a page bloom filter loaded from disk in the cache,
+ * evicting least recently used pages and filters if the cache
+ * is over its quota. A filter which doesn't fit stays private
+ * to the caller, which must free it after use.
+ */
+static void
+vy_page_cache_put_bloom(struct vy_page_cache *cache,
+			struct vy_page_info *page_info,
+			struct vy_page_bloom *bloom)
+{
+	assert(page_info->bloom == NULL && bloom->page_info == NULL);
+	size_t size = vy_page_bloom_mem_used(bloom);
+	if (size > cache->mem_quota)
+		return;
+	vy_page_cache_evict(cache, size);
+	bloom->page_info = page_info;
+	bloom->cache = cache;
+	bloom->last_used = ++cache->clock;
+	rlist_add_entry(&cache->bloom_lru, bloom, in_lru);
+	page_info->bloom = bloom;
+	cache->bloom_count++;
+	cache->mem_used += size;
+}
+
+/** Mark a page bloom filter kept in the cache as recently used. */
+static void
+vy_page_cache_touch_bloom(struct vy_page_cache *cache,
+			  struct vy_page_bloom *bloom)
+{
+	assert(bloom->cache == cache);
+	rlist_move_entry(&cache->bloom_lru, bloom, in_lru);
+	bloom->last_used = ++cache->clock;
+}
+
 static int
 vy_page_xrow(struct vy_page *page, uint32_t stmt_no,
 	     struct xrow_header *xrow)
@@ -781,11 +1173,12 @@ static void
 vy_run_iterator_cache_put(struct vy_run_iterator *itr, struct vy_page *page,
 			  uint32_t page_no)
 {
+	assert(page->page_no == page_no);
+	(void) page_no;
 	if (itr->prev_page != NULL)
-		vy_page_delete(itr->prev_page);
+		vy_page_unref(itr->prev_page);
 	itr->prev_page = itr->curr_page;
 	itr->curr_page = page;
-	page->page_no = page_no;
 }
 
 /**
@@ -800,9 +1193,9 @@ vy_run_iterator_cache_clean(struct vy_run_iterator *itr)
 		itr->curr_stmt_pos.page_no = UINT32_MAX;
 	}
 	if (itr->curr_page != NULL) {
-		vy_page_delete(itr->curr_page);
+		vy_page_unref(itr->curr_page);
 		if (itr->prev_page != NULL)
-			vy_page_delete(itr->prev_page);
+			vy_page_unref(itr->prev_page);
 		itr->curr_page = itr->prev_page = NULL;
 	}
 }
@@ -847,8 +1240,8 @@ vy_row_index_decode(uint32_t *row_index, uint32_t row_count,
  * @retval -1 on error, check diag
  */
 static int
-vy_page_read(struct vy_page *page, const struct vy_page_info *page_info, int fd,
-	     ZSTD_DStream *zdctx)
+vy_page_read(struct vy_page *page, const struct vy_page_info *page_info,
+	     const struct vy_run *run, ZSTD_DStream *zdctx)
 {
 	/* read xlog tx from xlog file */
 	size_t region_svp = region_used(&fiber()->gc);
@@ -857,7 +1250,7 @@ vy_page_read(struct vy_page *page, const struct vy_page_info *page_info, int fd,
 		diag_set(OutOfMemory, page_info->size, "region gc", "page");
 		return -1;
 	}
-	ssize_t readen = fio_pread(fd, data, page_info->size,
+	ssize_t readen = fio_pread(run->fd, data, page_info->size,
 				   page_info->offset);
 	ERROR_INJECT(ERRINJ_VYRUN_DATA_READ, {
 		readen = -1;
@@ -880,7 +1273,8 @@ vy_page_read(struct vy_page *page, const struct vy_page_info *page_info, int fd,
 	const char *data_end = data + readen;
 	char *rows = page->data;
 	char *rows_end = rows + page_info->unpacked_size;
-	if (xlog_tx_decode(data, data_end, rows, rows_end, zdctx) != 0)
+	if (xlog_tx_decode(data, data_end, rows, rows_end, zdctx,
+			   vy_run_zddict(run, page_info->offset)) != 0)
 		goto error;
 
 	struct xrow_header xrow;
@@ -908,6 +1302,96 @@ vy_page_read(struct vy_page *page, const struct vy_page_info *page_info, int fd,
 	return -1;
 }
 
+/**
+ * Decode a page bloom filter from xrow.
+ * @param filename File name for error reporting.
+ *
+ * @retval 0 on success
+ * @retval -1 on error, check diag
+ */
+static int
+vy_page_bloom_decode(struct bloom *bloom, const struct xrow_header *xrow,
+		     const char *filename)
+{
+	assert(xrow->type == VY_RUN_PAGE_BLOOM);
+	const char *pos = xrow->body->iov_base;
+	uint32_t map_size = mp_decode_map(&pos);
+	for (uint32_t map_item = 0; map_item < map_size; ++map_item) {
+		uint32_t key = mp_decode_uint(&pos);
+		switch (key) {
+		case VY_PAGE_BLOOM_DATA:
+			return vy_run_bloom_decode(bloom, &pos, filename);
+		default:
+			mp_next(&pos);
+			break;
+		}
+	}
+	diag_set(ClientError, ER_INVALID_RUN_FILE,
+		 tt_sprintf("%s: Can't decode page bloom: "
+			    "missing bloom data", filename));
+	return -1;
+}
+
+/**
+ * Read a page bloom filter from vinyl xlog data file.
+ *
+ * @retval 0 on success
+ * @retval -1 on error, check diag
+ */
+static int
+vy_page_bloom_read(struct bloom *bloom, const struct vy_page_info *page_info,
+		   const struct vy_run *run, ZSTD_DStream *zdctx)
+{
+	const char *filename = run->path;
+	/* read xlog tx from xlog file */
+	size_t region_svp = region_used(&fiber()->gc);
+	size_t size = page_info->bloom_size + page_info->bloom_unpacked_size;
+	char *data = (char *)region_alloc(&fiber()->gc, size);
+	if (data == NULL) {
+		diag_set(OutOfMemory, size, "region gc", "page bloom");
+		return -1;
+	}
+	ssize_t readen = fio_pread(run->fd, data, page_info->bloom_size,
+				   page_info->bloom_offset);
+	if (readen < 0) {
+		diag_set(SystemError, "failed to read page bloom from "
+			 "file '%s'", filename);
+		goto error;
+	}
+	if (readen != (ssize_t)page_info->bloom_size) {
+		diag_set(ClientError, ER_INVALID_RUN_FILE,
+			 tt_sprintf("%s: Unexpected end of file reading "
+				    "page bloom", filename));
+		goto error;
+	}
+
+	/* decode xlog tx */
+	char *rows = data + page_info->bloom_size;
+	char *rows_end = rows + page_info->bloom_unpacked_size;
+	if (xlog_tx_decode(data, data + readen, rows, rows_end, zdctx,
+			   vy_run_zddict(run, page_info->bloom_offset)) != 0)
+		goto error;
+
+	struct xrow_header xrow;
+	const char *pos = rows;
+	if (xrow_header_decode(&xrow, &pos, rows_end) == -1)
+		goto error;
+	if (xrow.type != VY_RUN_PAGE_BLOOM) {
+		diag_set(ClientError, ER_INVALID_RUN_FILE,
+			 tt_sprintf("%s: Wrong page bloom type "
+				    "(expected %d, got %u)", filename,
+				    VY_RUN_PAGE_BLOOM, (unsigned)xrow.type));
+		goto error;
+	}
+	if (vy_page_bloom_decode(bloom, &xrow, filename) != 0)
+		goto error;
+	region_truncate(&fiber()->gc, region_svp);
+	return 0;
+	error:
+	region_truncate(&fiber()->gc, region_svp);
+	return -1;
+}
+
 /**
  * Get thread local zstd decompression context
  */
@@ -927,6 +1411,24 @@ vy_env_get_zdctx(struct vy_run_env *env)
 	return zdctx;
 }
 
+/**
+ * Advise the kernel to start reading the given range of
+ * a run file, so that it's in the page cache by the time
+ * it's requested. Does not block.
+ */
+static void
+vy_run_readahead(int fd, off_t offset, size_t len)
+{
+#ifdef HAVE_POSIX_FADVISE
+	if (len > 0)
+		(void) posix_fadvise(fd, offset, len, POSIX_FADV_WILLNEED);
+#else
+	(void) fd;
+	(void) offset;
+	(void) len;
+#endif /* HAVE_POSIX_FADVISE */
+}
+
 /**
  * vinyl read task callback
  */
@@ -937,8 +1439,12 @@ vy_page_read_cb(struct cbus_call_msg *base)
 	ZSTD_DStream *zdctx = vy_env_get_zdctx(task->run_env);
 	if (zdctx == NULL)
 		return -1;
-	return vy_page_read(task->page, &task->page_info,
-			    task->slice->run->fd, zdctx);
+	if (vy_page_read(task->page, &task->page_info,
+			 task->slice->run, zdctx) != 0)
+		return -1;
+	vy_run_readahead(task->slice->run->fd, task->readahead_offset,
+			 task->readahead_len);
+	return 0;
 }
 
 /**
@@ -954,6 +1460,100 @@ vy_page_read_cb_free(struct cbus_call_msg *base)
 	return 0;
 }
 
+/**
+ * vinyl page bloom filter read task callback
+ */
+static int
+vy_page_bloom_read_cb(struct cbus_call_msg *base)
+{
+	struct vy_page_read_task *task = (struct vy_page_read_task *)base;
+	ZSTD_DStream *zdctx = vy_env_get_zdctx(task->run_env);
+	if (zdctx == NULL)
+		return -1;
+	return vy_page_bloom_read(&task->bloom->bloom, &task->page_info,
+				  task->slice->run, zdctx);
+}
+
+/**
+ * vinyl page bloom filter read task cleanup callback
+ */
+static int
+vy_page_bloom_read_cb_free(struct cbus_call_msg *base)
+{
+	struct vy_page_read_task *task = (struct vy_page_read_task *)base;
+	vy_page_bloom_delete(task->bloom);
+	vy_slice_unpin(task->slice);
+	mempool_free(&task->run_env->read_task_pool, task);
+	return 0;
+}
+
+/**
+ * Account a page load in the sequential access detector
+ * of a run iterator.
+ */
+static void
+vy_run_iterator_track_seq(struct vy_run_iterator *itr, uint32_t page_no)
+{
+	int64_t step = (itr->iterator_type == ITER_LE ||
+			itr->iterator_type == ITER_LT) ? -1 : 1;
+	if (itr->seq_page_count > 0 &&
+	    itr->last_page_no + step == page_no) {
+		itr->seq_page_count++;
+	} else {
+		itr->seq_page_count = 1;
+		itr->readahead_page_no = page_no + step;
+	}
+	itr->last_page_no = page_no;
+}
+
+/**
+ * If a run iterator is scanning the run, return the range of
+ * the run file to read ahead along with the page @a page_no,
+ * which must be the page last accounted by the sequential
+ * access detector. The range is empty (@a len is 0) if there
+ * is no need to read ahead.
+ */
+static void
+vy_run_iterator_readahead_range(struct vy_run_iterator *itr,
+				uint32_t page_no, off_t *offset, size_t *len)
+{
+	struct vy_run *run = itr->slice->run;
+	*offset = 0;
+	*len = 0;
+	if (itr->seq_page_count < VY_RUN_READAHEAD_THRESHOLD)
+		return;
+	assert(itr->last_page_no == page_no);
+	/*
+	 * Advise read ahead in chunks of pages: don't do it
+	 * until less than half of a chunk is left advised
+	 * past the current page.
+	 */
+	int64_t first, last;
+	if (itr->iterator_type == ITER_LE || itr->iterator_type == ITER_LT) {
+		last = MIN(itr->readahead_page_no, (int64_t) page_no - 1);
+		if ((int64_t) page_no - 1 - last >= VY_RUN_READAHEAD_PAGES / 2)
+			return;
+		first = MAX((int64_t) page_no - VY_RUN_READAHEAD_PAGES, 0);
+		if (first > last)
+			return;
+		itr->readahead_page_no = first - 1;
+	} else {
+		first = MAX(itr->readahead_page_no, (int64_t) page_no + 1);
+		if (first - 1 - (int64_t) page_no >= VY_RUN_READAHEAD_PAGES / 2)
+			return;
+		last = MIN((int64_t) page_no + VY_RUN_READAHEAD_PAGES,
+			   (int64_t) run->info.page_count - 1);
+		if (first > last)
+			return;
+		itr->readahead_page_no = last + 1;
+	}
+	struct vy_page_info *first_info = vy_run_page_info(run, first);
+	struct vy_page_info *last_info = vy_run_page_info(run, last);
+	*offset = first_info->offset;
+	*len = last_info->offset + last_info->size - first_info->offset;
+	itr->stat->readahead += last - first + 1;
+}
+
 /**
  * Get a page by the given number the cache or load it from the disk.
  *
@@ -972,11 +1572,35 @@ vy_run_iterator_load_page(struct vy_run_iterator *itr, uint32_t page_no,
 	if (*result != NULL)
 		return 0;
 
+	vy_run_iterator_track_seq(itr, page_no);
+
+	/* Check the page cache shared by all iterators */
+	struct vy_page *page = vy_page_cache_get(&env->page_cache,
+						 slice->run->id, page_no);
+	if (page != NULL) {
+		vy_run_iterator_cache_put(itr, page, page_no);
+		*result = page;
+		return 0;
+	}
+
 	/* Allocate buffers */
 	struct vy_page_info *page_info = vy_run_page_info(slice->run, page_no);
-	struct vy_page *page = vy_page_new(page_info);
+	page = vy_page_new(page_info);
 	if (page == NULL)
 		return -1;
+	page->run_id = slice->run->id;
+	page->page_no = page_no;
+
+	/*
+	 * If the iterator is scanning the run, have the next
+	 * pages read by the kernel in background while they
+	 * are being processed, so that a scan over cold data
+	 * doesn't wait for a disk round trip per page.
+	 */
+	off_t readahead_offset;
+	size_t readahead_len;
+	vy_run_iterator_readahead_range(itr, page_no, &readahead_offset,
+					&readahead_len);
 
 	/* Read page data from the disk */
 	int rc;
@@ -1007,6 +1631,9 @@ vy_run_iterator_load_page(struct vy_run_iterator *itr, uint32_t page_no,
 		task->page_info = *page_info;
 		task->run_env = env;
 		task->page = page;
+		task->bloom = NULL;
+		task->readahead_offset = readahead_offset;
+		task->readahead_len = readahead_len;
 
 		/* Post task to the reader thread. */
 		rc = cbus_call(&reader->reader_pipe, &reader->tx_pipe,
@@ -1033,10 +1660,12 @@ vy_run_iterator_load_page(struct vy_run_iterator *itr, uint32_t page_no,
 			vy_page_delete(page);
 			return -1;
 		}
-		if (vy_page_read(page, page_info, slice->run->fd, zdctx) != 0) {
+		if (vy_page_read(page, page_info, slice->run, zdctx) != 0) {
 			vy_page_delete(page);
 			return -1;
 		}
+		vy_run_readahead(slice->run->fd, readahead_offset,
+				 readahead_len);
 	}
 
 	/* Iterator is never used from multiple fibers */
@@ -1044,6 +1673,8 @@ vy_run_iterator_load_page(struct vy_run_iterator *itr, uint32_t page_no,
 
 	/* Update cache */
 	vy_run_iterator_cache_put(itr, page, page_no);
+	if (env->page_cache.mem_quota > 0)
+		vy_page_cache_put(&env->page_cache, page);
 
 	/* Update read statistics. */
 	itr->stat->read.rows += page_info->row_count;
@@ -1055,6 +1686,141 @@ vy_run_iterator_load_page(struct vy_run_iterator *itr, uint32_t page_no,
 	return 0;
 }
 
+/**
+ * Load the bloom filter of a given page from the disk and keep
+ * it in the page cache if it fits.
+ *
+ * @param[out] result the filter; it's private to the caller,
+ *             who must free it after use, if its page_info
+ *             is NULL
+ *
+ * @retval 0 success
+ * @retval -1 critical error
+ */
+static NODISCARD int
+vy_run_iterator_load_page_bloom(struct vy_run_iterator *itr, uint32_t page_no,
+				struct vy_page_bloom **result)
+{
+	struct vy_run_env *env = itr->run_env;
+	struct vy_slice *slice = itr->slice;
+	struct vy_page_info *page_info = vy_run_page_info(slice->run, page_no);
+	assert(page_info->bloom_offset != 0);
+
+	struct vy_page_bloom *bloom = calloc(1, sizeof(*bloom));
+	if (bloom == NULL) {
+		diag_set(OutOfMemory, sizeof(*bloom), "malloc",
+			 "struct vy_page_bloom");
+		return -1;
+	}
+
+	/* Read the filter from the disk */
+	int rc;
+	if (env->reader_pool != NULL) {
+		/* Allocate a cbus task. */
+		struct vy_page_read_task *task;
+		task = mempool_alloc(&env->read_task_pool);
+		if (task == NULL) {
+			diag_set(OutOfMemory, sizeof(*task), "mempool",
+				 "vy_page_read_task");
+			vy_page_bloom_delete(bloom);
+			return -1;
+		}
+
+		/* Pick a reader thread. */
+		struct vy_run_reader *reader;
+		reader = &env->reader_pool[env->next_reader++];
+		env->next_reader %= env->reader_pool_size;
+
+		/* See the comment in vy_run_iterator_load_page(). */
+		vy_slice_pin(slice);
+
+		task->slice = slice;
+		task->page_info = *page_info;
+		task->run_env = env;
+		task->page = NULL;
+		task->bloom = bloom;
+		task->readahead_offset = 0;
+		task->readahead_len = 0;
+
+		/* Post task to the reader thread. */
+		rc = cbus_call(&reader->reader_pipe, &reader->tx_pipe,
+			       &task->base, vy_page_bloom_read_cb,
+			       vy_page_bloom_read_cb_free, TIMEOUT_INFINITY);
+		if (!task->base.complete)
+			return -1; /* timed out or cancelled */
+
+		mempool_free(&env->read_task_pool, task);
+		vy_slice_unpin(slice);
+	} else {
+		ZSTD_DStream *zdctx = vy_env_get_zdctx(env);
+		if (zdctx == NULL) {
+			vy_page_bloom_delete(bloom);
+			return -1;
+		}
+		rc = vy_page_bloom_read(&bloom->bloom, page_info, slice->run,
+					zdctx);
+	}
+	if (rc != 0) {
+		vy_page_bloom_delete(bloom);
+		return -1;
+	}
+	if (page_info->bloom != NULL) {
+		/* Loaded by another fiber while we were reading. */
+		vy_page_bloom_delete(bloom);
+		*result = page_info->bloom;
+		return 0;
+	}
+	vy_page_cache_put_bloom(&env->page_cache, page_info, bloom);
+	*result = bloom;
+	return 0;
+}
+
+/**
+ * Check if a full key may be stored in the run by looking up
+ * the bloom filter of the only page that can contain it. The
+ * filter is loaded from the disk if this is the first lookup
+ * that needs it.
+ *
+ * @retval 0 success, *is_absent is set if the key is
+ *         definitely not stored in the run
+ * @retval -1 read or memory error
+ */
+static NODISCARD int
+vy_run_iterator_check_page_bloom(struct vy_run_iterator *itr,
+				 const struct tuple *key, uint32_t hash,
+				 bool *is_absent)
+{
+	struct vy_run *run = itr->slice->run;
+	*is_absent = false;
+	if (!vy_run_has_page_bloom(run))
+		return 0;
+	/*
+	 * If the key is the min key of a page, it is stored in
+	 * the run and may span several pages, nothing to check.
+	 */
+	bool equal_key;
+	uint32_t page_no = vy_page_index_find_page(run, key, itr->cmp_def,
+						   ITER_EQ, &equal_key);
+	if (equal_key || page_no >= run->info.page_count)
+		return 0;
+	struct vy_page_info *page_info = vy_run_page_info(run, page_no);
+	if (page_info->bloom_offset == 0)
+		return 0;
+	struct vy_page_bloom *bloom = page_info->bloom;
+	if (bloom != NULL) {
+		vy_page_cache_touch_bloom(&itr->run_env->page_cache, bloom);
+	} else if (vy_run_iterator_load_page_bloom(itr, page_no,
+						   &bloom) != 0) {
+		return -1;
+	}
+	*is_absent = !bloom_possible_has(&bloom->bloom, hash);
+	if (bloom->page_info == NULL) {
+		/* Didn't fit in the page cache. */
+		vy_page_bloom_delete(bloom);
+	}
+	return 0;
+}
+
 /**
  * Read key and lsn by a given wide position.
  * For the first record in a page reads the result from the page
@@ -1340,7 +2106,8 @@ vy_run_iterator_start_from(struct vy_run_iterator *itr,
 
 	const struct key_def *key_def = itr->key_def;
 	bool is_full_key = (tuple_field_count(key) >= key_def->part_count);
-	if (run->info.has_bloom && iterator_type == ITER_EQ && is_full_key) {
+	bool has_bloom = run->info.has_bloom || vy_run_has_page_bloom(run);
+	if (has_bloom && iterator_type == ITER_EQ && is_full_key) {
 		uint32_t hash;
 		if (vy_stmt_type(key) == IPROTO_SELECT) {
 			const char *data = tuple_data(key);
@@ -1349,7 +2116,13 @@ vy_run_iterator_start_from(struct vy_run_iterator *itr,
 		} else {
 			hash = tuple_hash(key, key_def);
 		}
-		if (!bloom_possible_has(&run->info.bloom, hash)) {
+		bool is_absent = (run->info.has_bloom &&
+				  !bloom_possible_has(&run->info.bloom, hash));
+		if (!is_absent &&
+		    vy_run_iterator_check_page_bloom(itr, key, hash,
+						     &is_absent) != 0)
+			return -1;
+		if (is_absent) {
 			itr->search_ended = true;
 			itr->stat->bloom_hit++;
 			return 0;
@@ -1395,7 +2168,7 @@ vy_run_iterator_start_from(struct vy_run_iterator *itr,
 	if (iterator_type == ITER_EQ && !equal_found) {
 		vy_run_iterator_cache_clean(itr);
 		itr->search_ended = true;
-		if (run->info.has_bloom && is_full_key)
+		if (has_bloom && is_full_key)
 			itr->stat->bloom_miss++;
 		return 0;
 	}
@@ -1535,6 +2308,9 @@ vy_run_iterator_open(struct vy_run_iterator *itr,
 	itr->curr_stmt_pos.page_no = UINT32_MAX;
 	itr->curr_page = NULL;
 	itr->prev_page = NULL;
+	itr->last_page_no = 0;
+	itr->seq_page_count = 0;
+	itr->readahead_page_no = 0;
 
 	itr->search_started = false;
 	itr->search_ended = false;
@@ -1837,7 +2613,8 @@ vy_run_recover(struct vy_run *run, const char *dir,
 		goto fail_close;
 	}
 
-	if (vy_run_info_decode(&run->info, &xrow, path) != 0)
+	if (vy_run_info_decode(&run->info, &xrow, path) != 0 ||
+	    vy_run_create_zddict(run) != 0)
 		goto fail_close;
 
 	/* Allocate buffer for page info. */
@@ -1899,6 +2676,8 @@ vy_run_recover(struct vy_run *run, const char *dir,
 			 XLOG_META_TYPE_RUN, meta->filetype);
 		goto fail_close;
 	}
+	if (vy_run_set_path(run, path) != 0)
+		goto fail_close;
 	run->fd = cursor.fd;
 	xlog_cursor_close(&cursor, true);
 	return 0;
@@ -1993,6 +2772,160 @@ vy_run_alloc_page_info(struct vy_run *run, uint32_t *page_info_capacity)
 	return 0;
 }
 
+static int
+vy_page_bloom_encode(const struct bloom *bloom, struct xrow_header *xrow);
+
+/**
+ * Build a bloom filter of keys stored in a page, write it to
+ * the run file right after the page and remember its location
+ * in the page info.
+ *
+ * @retval  0 success
+ * @retval -1 error occurred
+ */
+static int
+vy_run_write_page_bloom(struct xlog *data_xlog, struct vy_page_info *page,
+			const uint32_t *hashes, double bloom_fpr)
+{
+	struct bloom bloom;
+	if (bloom_create(&bloom, page->row_count, bloom_fpr,
+			 runtime.quota) != 0) {
+		diag_set(OutOfMemory, 0, "bloom_create", "bloom");
+		return -1;
+	}
+	for (uint32_t i = 0; i < page->row_count; i++)
+		bloom_add(&bloom, hashes[i]);
+
+	struct xrow_header xrow;
+	int rc = vy_page_bloom_encode(&bloom, &xrow);
+	bloom_destroy(&bloom, runtime.quota);
+	if (rc != 0)
+		return -1;
+
+	uint64_t offset = data_xlog->offset;
+	xlog_tx_begin(data_xlog);
+	ssize_t unpacked_size = xlog_write_row(data_xlog, &xrow);
+	if (unpacked_size < 0) {
+		xlog_tx_rollback(data_xlog);
+		return -1;
+	}
+	ssize_t written = xlog_tx_commit(data_xlog);
+	if (written == 0)
+		written = xlog_flush(data_xlog);
+	if (written < 0)
+		return -1;
+
+	page->bloom_offset = offset;
+	page->bloom_size = written;
+	page->bloom_unpacked_size = unpacked_size;
+	return 0;
+}
+
+/**
+ * Page data sampled by the run writer to train a zstd
+ * dictionary for the rest of the run.
+ */
+struct vy_run_dict_samples {
+	/** Data of the sampled pages, one after another. */
+	struct ibuf data;
+	/** Sizes of the sampled pages, size_t each. */
+	struct ibuf sizes;
+};
+
+static void
+vy_run_dict_samples_create(struct vy_run_dict_samples *samples)
+{
+	ibuf_create(&samples->data, &cord()->slabc, 16 * 1024);
+	ibuf_create(&samples->sizes, &cord()->slabc, 16 * sizeof(size_t));
+}
+
+static void
+vy_run_dict_samples_destroy(struct vy_run_dict_samples *samples)
+{
+	ibuf_destroy(&samples->data);
+	ibuf_destroy(&samples->sizes);
+}
+
+/**
+ * Add the rows of the tx being written to @a obuf to the samples.
+ *
+ * @retval 0 success
+ * @retval -1 memory error, check diag
+ */
+static int
+vy_run_dict_samples_add(struct vy_run_dict_samples *samples,
+			struct obuf *obuf)
+{
+	size_t size = obuf_size(obuf) - XLOG_FIXHEADER_SIZE;
+	char *pos = (char *) ibuf_alloc(&samples->data, size);
+	size_t *sample_size = (size_t *) ibuf_alloc(&samples->sizes,
+						    sizeof(size_t));
+	if (pos == NULL || sample_size == NULL) {
+		diag_set(OutOfMemory, size, "ibuf", "dictionary samples");
+		return -1;
+	}
+	*sample_size = size;
+	size_t offset = XLOG_FIXHEADER_SIZE;
+	for (struct iovec *iov = obuf->iov; iov->iov_len; ++iov) {
+		memcpy(pos, (char *) iov->iov_base + offset,
+		       iov->iov_len - offset);
+		pos += iov->iov_len - offset;
+		offset = 0;
+		if (iov == obuf->iov + obuf->pos)
+			break;
+	}
+	return 0;
+}
+
+/**
+ * Train a zstd dictionary of up to @a dict_size bytes on
+ * the sampled pages and store it in the run info. Failure
+ * to train a dictionary is not an error: the run is written
+ * without a dictionary then.
+ */
+static void
+vy_run_train_dict(struct vy_run *run, struct vy_run_dict_samples *samples,
+		  uint32_t dict_size)
+{
+	assert(run->info.dict == NULL);
+	char *dict = malloc(dict_size);
+	if (dict == NULL) {
+		say_warn("failed to allocate %u bytes for run dictionary",
+			 (unsigned) dict_size);
+		return;
+	}
+	size_t rc = ZDICT_trainFromBuffer(dict, dict_size,
+					  samples->data.rpos,
+					  (const size_t *) samples->sizes.rpos,
+					  ibuf_used(&samples->sizes) /
+					  sizeof(size_t));
+	if (ZDICT_isError(rc)) {
+		say_warn("failed to train run dictionary: %s",
+			 ZDICT_getErrorName(rc));
+		free(dict);
+		return;
+	}
+	run->info.dict = dict;
+	run->info.dict_size = rc;
+}
+
+/**
+ * Digest the run zstd dictionary for compression.
+ */
+static int
+vy_run_create_zcdict(struct vy_run *run, int compression_level,
+		     ZSTD_CDict **zcdict)
+{
+	*zcdict = ZSTD_createCDict(run->info.dict, run->info.dict_size,
+				   compression_level);
+	if (*zcdict == NULL) {
+		diag_set(OutOfMemory, run->info.dict_size,
+			 "ZSTD_createCDict", "run dictionary");
+		return -1;
+	}
+	return 0;
+}
+
 /**
  * Write statements from the iterator to a new page in the run,
  * update page and run statistics.
@@ -2005,8 +2938,9 @@ static int
 vy_run_write_page(struct vy_run *run, struct xlog *data_xlog,
 		  struct vy_stmt_stream *wi, struct tuple **curr_stmt,
 		  uint64_t page_size, struct bloom_spectrum *bs,
-		  const struct key_def *cmp_def,
+		  double page_bloom_fpr, const struct key_def *cmp_def,
 		  const struct key_def *key_def, bool is_primary,
+		  struct vy_run_dict_samples *dict_samples,
 		  uint32_t *page_info_capacity)
 {
 	assert(curr_stmt != NULL);
@@ -2021,6 +2955,9 @@ vy_run_write_page(struct vy_run *run, struct xlog *data_xlog,
 	/* row offsets accumulator */
 	struct ibuf row_index_buf;
 	ibuf_create(&row_index_buf, &cord()->slabc, sizeof(uint32_t) * 4096);
+	/* key hashes accumulator, used if bs == NULL */
+	struct ibuf bloom_buf;
+	ibuf_create(&bloom_buf, &cord()->slabc, sizeof(uint32_t) * 4096);
 
 	if (run->info.page_count >= *page_info_capacity &&
 	    vy_run_alloc_page_info(run, page_info_capacity) != 0)
@@ -2058,7 +2995,19 @@ vy_run_write_page(struct vy_run *run, struct xlog *data_xlog,
 				     cmp_def, is_primary) != 0)
 			goto error_rollback;
 
-		bloom_spectrum_add(bs, tuple_hash(*curr_stmt, key_def));
+		uint32_t hash = tuple_hash(*curr_stmt, key_def);
+		if (bs != NULL) {
+			bloom_spectrum_add(bs, hash);
+		} else {
+			uint32_t *h = (uint32_t *) ibuf_alloc(&bloom_buf,
+							      sizeof(uint32_t));
+			if (h == NULL) {
+				diag_set(OutOfMemory, sizeof(uint32_t),
+					 "ibuf", "page bloom");
+				goto error_rollback;
+			}
+			*h = hash;
+		}
 
 		int64_t lsn = vy_stmt_lsn(*curr_stmt);
 		run->info.min_lsn = MIN(run->info.min_lsn, lsn);
@@ -2115,6 +3064,10 @@ vy_run_write_page(struct vy_run *run, struct xlog *data_xlog,
 
 	page->unpacked_size += written;
 
+	if (dict_samples != NULL &&
+	    vy_run_dict_samples_add(dict_samples, &data_xlog->obuf) != 0)
+		goto error_rollback;
+
 	written = xlog_tx_commit(data_xlog);
 	if (written == 0)
 		written = xlog_flush(data_xlog);
@@ -2125,16 +3078,27 @@ vy_run_write_page(struct vy_run *run, struct xlog *data_xlog,
 
 	assert(page->row_count > 0);
 
+	if (bs == NULL) {
+		assert(ibuf_used(&bloom_buf) ==
+		       sizeof(uint32_t) * page->row_count);
+		if (vy_run_write_page_bloom(data_xlog, page,
+					    (const uint32_t *) bloom_buf.rpos,
+					    page_bloom_fpr) != 0)
+			goto error_row_index;
+	}
+
 	run->info.page_count++;
 	vy_run_acct_page(run, page);
 
 	ibuf_destroy(&row_index_buf);
+	ibuf_destroy(&bloom_buf);
 	return !end_of_run ? 0: 1;
 
 error_rollback:
 	xlog_tx_rollback(data_xlog);
 error_row_index:
 	ibuf_destroy(&row_index_buf);
+	ibuf_destroy(&bloom_buf);
 	if (last_stmt != NULL)
 		vy_stmt_unref_if_possible(last_stmt);
 	return -1;
@@ -2152,7 +3116,9 @@ vy_run_write_data(struct vy_run *run, const char *dirpath,
 		  struct vy_stmt_stream *wi, uint64_t page_size,
 		  const struct key_def *cmp_def,
 		  const struct key_def *key_def,
-		  size_t max_output_count, double bloom_fpr)
+		  size_t max_output_count, double bloom_fpr,
+		  bool bloom_per_page, int compression_level,
+		  uint32_t compression_dict_size)
 {
 	struct tuple *stmt;
 
@@ -2166,8 +3132,14 @@ vy_run_write_data(struct vy_run *run, const char *dirpath,
 	if (stmt == NULL)
 		goto done;
 
+	/*
+	 * With per-page bloom filters, the run doesn't have
+	 * a bloom filter of its own.
+	 */
 	struct bloom_spectrum bs;
-	if (bloom_spectrum_create(&bs, max_output_count,
+	struct bloom_spectrum *run_bs = bloom_per_page ? NULL : &bs;
+	if (run_bs != NULL &&
+	    bloom_spectrum_create(run_bs, max_output_count,
 				  bloom_fpr, runtime.quota) != 0) {
 		diag_set(OutOfMemory, 0,
 			 "bloom_spectrum_create", "bloom_spectrum");
@@ -2184,6 +3156,22 @@ vy_run_write_data(struct vy_run *run, const char *dirpath,
 	};
 	if (xlog_create(&data_xlog, path, 0, &meta) < 0)
 		goto err_free_bloom;
+	data_xlog.compression_level = compression_level;
+
+	/*
+	 * Pages are compressed one by one, so compression of
+	 * small pages benefits from a dictionary a lot. Sample
+	 * the first pages of the run, then train a dictionary
+	 * on them and compress the rest of the run with it.
+	 */
+	struct vy_run_dict_samples dict_samples;
+	struct vy_run_dict_samples *run_dict_samples = NULL;
+	/* The dictionary digested once for all pages. */
+	ZSTD_CDict *zcdict = NULL;
+	if (compression_level > 0 && compression_dict_size > 0) {
+		vy_run_dict_samples_create(&dict_samples);
+		run_dict_samples = &dict_samples;
+	}
 
 	run->info.min_lsn = INT64_MAX;
 	run->info.max_lsn = -1;
@@ -2193,34 +3181,66 @@ vy_run_write_data(struct vy_run *run, const char *dirpath,
 	int rc;
 	do {
 		rc = vy_run_write_page(run, &data_xlog, wi, &stmt,
-				       page_size, &bs, cmp_def, key_def,
-				       iid == 0, &page_info_capacity);
+				       page_size, run_bs, bloom_fpr,
+				       cmp_def, key_def, iid == 0,
+				       run_dict_samples, &page_info_capacity);
 		if (rc < 0)
 			goto err_close_xlog;
+		if (run_dict_samples != NULL &&
+		    ibuf_used(&run_dict_samples->data) >=
+		    (size_t) compression_dict_size * VY_RUN_DICT_SAMPLE_RATIO) {
+			vy_run_train_dict(run, run_dict_samples,
+					  compression_dict_size);
+			vy_run_dict_samples_destroy(run_dict_samples);
+			run_dict_samples = NULL;
+			if (run->info.dict != NULL &&
+			    vy_run_create_zcdict(run, compression_level,
+						 &zcdict) != 0)
+				goto err_close_xlog;
+			run->info.dict_offset = data_xlog.offset;
+			data_xlog.zcdict = zcdict;
+		}
 		fiber_gc();
 	} while (rc == 0);
 
+	if (run_dict_samples != NULL) {
+		/* The run is too small to need a dictionary. */
+		vy_run_dict_samples_destroy(run_dict_samples);
+		run_dict_samples = NULL;
+	}
+	if (vy_run_create_zddict(run) != 0)
+		goto err_close_xlog;
+
 	/* Sync data and link the file to the final name. */
 	if (xlog_sync(&data_xlog) < 0 ||
 	    xlog_rename(&data_xlog) < 0)
 		goto err_close_xlog;
 
+	if (vy_run_set_path(run, path) != 0)
+		goto err_close_xlog;
 	run->fd = data_xlog.fd;
 	xlog_close(&data_xlog, true);
+	ZSTD_freeCDict(zcdict);
 	fiber_gc();
 
-	bloom_spectrum_choose(&bs, &run->info.bloom);
-	run->info.has_bloom = true;
-	bloom_spectrum_destroy(&bs, runtime.quota);
+	if (run_bs != NULL) {
+		bloom_spectrum_choose(run_bs, &run->info.bloom);
+		run->info.has_bloom = true;
+		bloom_spectrum_destroy(run_bs, runtime.quota);
+	}
 	done:
 	wi->iface->stop(wi);
 	return 0;
 
 	err_close_xlog:
+	if (run_dict_samples != NULL)
+		vy_run_dict_samples_destroy(run_dict_samples);
 	xlog_close(&data_xlog, false);
+	ZSTD_freeCDict(zcdict);
 	fiber_gc();
 	err_free_bloom:
-	bloom_spectrum_destroy(&bs, runtime.quota);
+	if (run_bs != NULL)
+		bloom_spectrum_destroy(run_bs, runtime.quota);
 	err:
 	wi->iface->stop(wi);
 	return -1;
@@ -2250,10 +3270,14 @@ vy_page_info_encode(const struct vy_page_info *page_info,
 	mp_next(&tmp);
 	min_key_size = tmp - page_info->min_key;
 
+	/* The page bloom filter location is optional */
+	bool has_bloom = page_info->bloom_offset != 0;
+	uint32_t map_size = has_bloom ? 7 : 6;
+
 	/* calc tuple size */
 	uint32_t size;
 	/* 3 items: page offset, size, and map */
-	size = mp_sizeof_map(6) +
+	size = mp_sizeof_map(map_size) +
 	       mp_sizeof_uint(VY_PAGE_INFO_OFFSET) +
 	       mp_sizeof_uint(page_info->offset) +
 	       mp_sizeof_uint(VY_PAGE_INFO_SIZE) +
@@ -2266,6 +3290,13 @@ vy_page_info_encode(const struct vy_page_info *page_info,
 	       mp_sizeof_uint(page_info->unpacked_size) +
 	       mp_sizeof_uint(VY_PAGE_INFO_ROW_INDEX_OFFSET) +
 	       mp_sizeof_uint(page_info->row_index_offset);
+	if (has_bloom) {
+		size += mp_sizeof_uint(VY_PAGE_INFO_BLOOM) +
+			mp_sizeof_array(3) +
+			mp_sizeof_uint(page_info->bloom_offset) +
+			mp_sizeof_uint(page_info->bloom_size) +
+			mp_sizeof_uint(page_info->bloom_unpacked_size);
+	}
 
 	char *pos = region_alloc(region, size);
 	if (pos == NULL) {
@@ -2276,7 +3307,7 @@ vy_page_info_encode(const struct vy_page_info *page_info,
 	memset(xrow, 0, sizeof(*xrow));
 	/* encode page */
 	xrow->body->iov_base = pos;
-	pos = mp_encode_map(pos, 6);
+	pos = mp_encode_map(pos, map_size);
 	pos = mp_encode_uint(pos, VY_PAGE_INFO_OFFSET);
 	pos = mp_encode_uint(pos, page_info->offset);
 	pos = mp_encode_uint(pos, VY_PAGE_INFO_SIZE);
@@ -2290,6 +3321,13 @@ vy_page_info_encode(const struct vy_page_info *page_info,
 	pos = mp_encode_uint(pos, page_info->unpacked_size);
 	pos = mp_encode_uint(pos, VY_PAGE_INFO_ROW_INDEX_OFFSET);
 	pos = mp_encode_uint(pos, page_info->row_index_offset);
+	if (has_bloom) {
+		pos = mp_encode_uint(pos, VY_PAGE_INFO_BLOOM);
+		pos = mp_encode_array(pos, 3);
+		pos = mp_encode_uint(pos, page_info->bloom_offset);
+		pos = mp_encode_uint(pos, page_info->bloom_size);
+		pos = mp_encode_uint(pos, page_info->bloom_unpacked_size);
+	}
 	xrow->body->iov_len = (void *)pos - xrow->body->iov_base;
 	xrow->bodycnt = 1;
 
@@ -2337,6 +3375,38 @@ vy_run_bloom_encode(const struct bloom *bloom, char *buffer)
 	return pos;
 }
 
+/**
+ * Encode a page bloom filter as xrow.
+ * Allocates using region_alloc.
+ *
+ * @param bloom bloom filter to encode
+ * @param[out] xrow xrow to fill
+ *
+ * @retval  0 success
+ * @retval -1 error, check diag
+ */
+static int
+vy_page_bloom_encode(const struct bloom *bloom, struct xrow_header *xrow)
+{
+	size_t size = mp_sizeof_map(1) +
+		      mp_sizeof_uint(VY_PAGE_BLOOM_DATA) +
+		      vy_run_bloom_encode_size(bloom);
+	char *pos = region_alloc(&fiber()->gc, size);
+	if (pos == NULL) {
+		diag_set(OutOfMemory, size, "region", "page bloom");
+		return -1;
+	}
+	memset(xrow, 0, sizeof(*xrow));
+	xrow->body->iov_base = pos;
+	pos = mp_encode_map(pos, 1);
+	pos = mp_encode_uint(pos, VY_PAGE_BLOOM_DATA);
+	pos = vy_run_bloom_encode(bloom, pos);
+	xrow->body->iov_len = (void *)pos - xrow->body->iov_base;
+	xrow->bodycnt = 1;
+	xrow->type = VY_RUN_PAGE_BLOOM;
+	return 0;
+}
+
 /**
  * Encode vy_run_info as xrow
  * Allocates using region alloc
@@ -2359,8 +3429,11 @@ vy_run_info_encode(const struct vy_run_info *run_info,
 	mp_next(&tmp);
 	size_t max_key_size = tmp - run_info->max_key;
 
-	assert(run_info->has_bloom);
-	size_t size = mp_sizeof_map(6);
+	/* Runs with per-page bloom filters have no run filter */
+	uint32_t map_size = run_info->has_bloom ? 6 : 5;
+	if (run_info->dict != NULL)
+		map_size++;
+	size_t size = mp_sizeof_map(map_size);
 	size += mp_sizeof_uint(VY_RUN_INFO_MIN_KEY) + min_key_size;
 	size += mp_sizeof_uint(VY_RUN_INFO_MAX_KEY) + max_key_size;
 	size += mp_sizeof_uint(VY_RUN_INFO_MIN_LSN) +
@@ -2369,8 +3442,13 @@ vy_run_info_encode(const struct vy_run_info *run_info,
 		mp_sizeof_uint(run_info->max_lsn);
 	size += mp_sizeof_uint(VY_RUN_INFO_PAGE_COUNT) +
 		mp_sizeof_uint(run_info->page_count);
-	size += mp_sizeof_uint(VY_RUN_INFO_BLOOM) +
-		vy_run_bloom_encode_size(&run_info->bloom);
+	if (run_info->has_bloom)
+		size += mp_sizeof_uint(VY_RUN_INFO_BLOOM) +
+			vy_run_bloom_encode_size(&run_info->bloom);
+	if (run_info->dict != NULL)
+		size += mp_sizeof_uint(VY_RUN_INFO_DICT) + mp_sizeof_array(2) +
+			mp_sizeof_uint(run_info->dict_offset) +
+			mp_sizeof_bin(run_info->dict_size);
 
 	char *pos = region_alloc(&fiber()->gc, size);
 	if (pos == NULL) {
@@ -2380,7 +3458,7 @@ vy_run_info_encode(const struct vy_run_info *run_info,
 	memset(xrow, 0, sizeof(*xrow));
 	xrow->body->iov_base = pos;
 	/* encode values */
-	pos = mp_encode_map(pos, 6);
+	pos = mp_encode_map(pos, map_size);
 	pos = mp_encode_uint(pos, VY_RUN_INFO_MIN_KEY);
 	memcpy(pos, run_info->min_key, min_key_size);
 	pos += min_key_size;
@@ -2393,8 +3471,16 @@ vy_run_info_encode(const struct vy_run_info *run_info,
 	pos = mp_encode_uint(pos, run_info->max_lsn);
 	pos = mp_encode_uint(pos, VY_RUN_INFO_PAGE_COUNT);
 	pos = mp_encode_uint(pos, run_info->page_count);
-	pos = mp_encode_uint(pos, VY_RUN_INFO_BLOOM);
-	pos = vy_run_bloom_encode(&run_info->bloom, pos);
+	if (run_info->has_bloom) {
+		pos = mp_encode_uint(pos, VY_RUN_INFO_BLOOM);
+		pos = vy_run_bloom_encode(&run_info->bloom, pos);
+	}
+	if (run_info->dict != NULL) {
+		pos = mp_encode_uint(pos, VY_RUN_INFO_DICT);
+		pos = mp_encode_array(pos, 2);
+		pos = mp_encode_uint(pos, run_info->dict_offset);
+		pos = mp_encode_bin(pos, run_info->dict, run_info->dict_size);
+	}
 	xrow->body->iov_len = (void *)pos - xrow->body->iov_base;
 	xrow->bodycnt = 1;
 	xrow->type = VY_INDEX_RUN_INFO;
@@ -2466,7 +3552,9 @@ vy_run_write(struct vy_run *run, const char *dirpath,
 	     struct vy_stmt_stream *wi, uint64_t page_size,
 	     const struct key_def *cmp_def,
 	     const struct key_def *key_def,
-	     size_t max_output_count, double bloom_fpr)
+	     size_t max_output_count, double bloom_fpr,
+	     bool bloom_per_page, int compression_level,
+	     uint32_t compression_dict_size)
 {
 	ERROR_INJECT(ERRINJ_VY_RUN_WRITE,
 		     {diag_set(ClientError, ER_INJECTION,
@@ -2478,7 +3566,9 @@ vy_run_write(struct vy_run *run, const char *dirpath,
 
 	if (vy_run_write_data(run, dirpath, space_id, iid,
 			      wi, page_size, cmp_def, key_def,
-			      max_output_count, bloom_fpr) != 0)
+			      max_output_count, bloom_fpr,
+			      bloom_per_page, compression_level,
+			      compression_dict_size) != 0)
 		return -1;
 
 	if (vy_run_is_empty(run))
@@ -2510,6 +3600,11 @@ vy_run_rebuild_index(struct vy_run *run, const char *dir,
 			    space_id, iid, run->id, VY_FILE_RUN);
 
 	say_warn("rebuilding run index from %s data file", path);
+	/*
+	 * The compression dictionary is stored in the index
+	 * file, so a run compressed with one can't be rebuilt:
+	 * its first data page fails with ER_DECOMPRESSION.
+	 */
 	if (xlog_cursor_open(&cursor, path))
 		return -1;
 
@@ -2533,9 +3628,14 @@ vy_run_rebuild_index(struct vy_run *run, const char *dir,
 		uint32_t page_row_count = 0;
 		uint64_t page_row_index_offset = 0;
 		uint64_t row_offset = xlog_cursor_tx_pos(&cursor);
+		bool is_page_bloom = false;
 
 		struct xrow_header xrow;
 		while ((rc = xlog_cursor_next_row(&cursor, &xrow)) == 0) {
+			if (xrow.type == VY_RUN_PAGE_BLOOM) {
+				is_page_bloom = true;
+				continue;
+			}
 			if (xrow.type == VY_RUN_ROW_INDEX) {
 				page_row_index_offset = row_offset;
 				row_offset = xlog_cursor_tx_pos(&cursor);
@@ -2561,6 +3661,19 @@ vy_run_rebuild_index(struct vy_run *run, const char *dir,
 			row_offset = xlog_cursor_tx_pos(&cursor);
 		}
 		struct vy_page_info *info;
+		if (is_page_bloom) {
+			/* The bloom filter of the previous page. */
+			if (run->info.page_count > 0) {
+				info = run->page_info +
+				       run->info.page_count - 1;
+				info->bloom_offset = page_offset;
+				info->bloom_size = next_page_offset -
+						   page_offset;
+				info->bloom_unpacked_size =
+					xlog_cursor_tx_pos(&cursor);
+			}
+			continue;
+		}
 		info = run->page_info + run->info.page_count;
 		if (vy_page_info_create(info, page_offset, page_min_key) != 0)
 			goto close_err;
@@ -2590,7 +3703,8 @@ vy_run_rebuild_index(struct vy_run *run, const char *dir,
 	}
 	struct xrow_header xrow;
 	while ((rc = xlog_cursor_next(&cursor, &xrow, false)) == 0) {
-		if (xrow.type == VY_RUN_ROW_INDEX)
+		if (xrow.type == VY_RUN_ROW_INDEX ||
+		    xrow.type == VY_RUN_PAGE_BLOOM)
 			continue;
 
 		struct tuple *tuple = vy_stmt_decode(&xrow, cmp_def, mem_format,
@@ -2602,6 +3716,8 @@ vy_run_rebuild_index(struct vy_run *run, const char *dir,
 	run->info.has_bloom = true;
 
 	region_truncate(region, mem_used);
+	if (vy_run_set_path(run, path) != 0)
+		goto close_err;
 	run->fd = cursor.fd;
 	xlog_cursor_close(&cursor, true);
 	/* New run index is ready for write, unlink old file if exists */
@@ -2643,7 +3759,7 @@ vy_slice_stream_read_page(struct vy_slice_stream *stream)
 		return -1;
 
 	if (vy_page_read(stream->page, page_info,
-			 stream->slice->run->fd, zdctx) != 0) {
+			 stream->slice->run, zdctx) != 0) {
 		vy_page_delete(stream->page);
 		stream->page = NULL;
 		return -1;
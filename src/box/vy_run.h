@@ -42,6 +42,7 @@
 #include "index_def.h"
 
 #include "small/mempool.h"
+#include "small/rlist.h"
 #include "salad/bloom.h"
 
 #if defined(__cplusplus)
@@ -49,6 +50,42 @@ extern "C" {
 #endif /* defined(__cplusplus) */
 
 struct vy_run_reader;
+struct mh_vy_page_t;
+struct ZSTD_DDict_s;
+
+/**
+ * Cache of decompressed run pages shared by all run iterators.
+ * Saves a disk read and decompression on lookups of hot pages
+ * that missed the tuple cache. Page bloom filters loaded on
+ * demand are kept within the same memory quota. Pages and
+ * filters are evicted in LRU order when the cache exceeds
+ * its quota.
+ */
+struct vy_page_cache {
+	/** (run id, page no) -> struct vy_page. */
+	struct mh_vy_page_t *pages;
+	/** Cached pages, most recently used first. */
+	struct rlist lru;
+	/** Number of cached pages. */
+	size_t count;
+	/** Loaded page bloom filters, most recently used first. */
+	struct rlist bloom_lru;
+	/** Number of loaded page bloom filters. */
+	size_t bloom_count;
+	/**
+	 * Incremented on each use of a cached page or filter,
+	 * to tell which of the two LRU lists has the older tail.
+	 */
+	uint64_t clock;
+	/** Memory used by cached pages and page bloom filters. */
+	size_t mem_used;
+	/** Max memory cached pages can use, 0 disables the cache. */
+	size_t mem_quota;
+	/** Number of page loads served from the cache. */
+	int64_t hit;
+	/** Number of page loads that had to read the disk. */
+	int64_t miss;
+};
 
 /** Part of vinyl environment for run read/write */
 struct vy_run_env {
@@ -65,6 +102,8 @@ struct vy_run_env {
 	 * processing the next read request.
 	 */
 	int next_reader;
+	/** Cache of pages read by run iterators. */
+	struct vy_page_cache page_cache;
 };
 
 /**
@@ -85,6 +124,16 @@ struct vy_run_info {
 	bool has_bloom;
 	/** Bloom filter of all tuples in run */
 	struct bloom bloom;
+	/**
+	 * Zstd dictionary trained on the first pages of the run,
+	 * NULL if none. Run file transactions starting at
+	 * @dict_offset are compressed with it.
+	 */
+	char *dict;
+	/** Size of @dict. */
+	uint32_t dict_size;
+	/** Offset of the first run file tx compressed with @dict. */
+	uint64_t dict_offset;
 };
 
 /**
@@ -103,6 +152,36 @@ struct vy_page_info {
 	char *min_key;
 	/** Offset of the row index in the page. */
 	uint32_t row_index_offset;
+	/**
+	 * Offset of the page bloom filter in the run file,
+	 * 0 if the page doesn't have a filter.
+	 */
+	uint64_t bloom_offset;
+	/** Size of the page bloom filter in the run file. */
+	uint32_t bloom_size;
+	/** Size of the page bloom filter in memory, i.e. unpacked. */
+	uint32_t bloom_unpacked_size;
+	/**
+	 * Bloom filter of keys stored in the page. Loaded from
+	 * the run file on the first lookup that needs it, NULL
+	 * until then or after it's evicted from the page cache.
+	 */
+	struct vy_page_bloom *bloom;
+};
+
+/**
+ * Bloom filter of a run page loaded into the page cache.
+ */
+struct vy_page_bloom {
+	struct bloom bloom;
+	/** Page the filter is loaded for. */
+	struct vy_page_info *page_info;
+	/** Page cache the filter is accounted in. */
+	struct vy_page_cache *cache;
+	/** vy_page_cache::clock at the last use of the filter. */
+	uint64_t last_used;
+	/** Link in vy_page_cache::bloom_lru. */
+	struct rlist in_lru;
 };
 
 /**
@@ -113,8 +192,15 @@ struct vy_run {
 	struct vy_run_info info;
 	/** Info about the run pages stored in the index file. */
 	struct vy_page_info *page_info;
+	/**
+	 * Digested @info.dict used for decompressing pages,
+	 * NULL if the run has no dictionary.
+	 */
+	struct ZSTD_DDict_s *zddict;
 	/** Run data file. */
 	int fd;
+	/** Path to the run data file, for error reporting. */
+	char *path;
 	/** Unique ID of this run. */
 	int64_t id;
 	/** Number of statements in this run. */
@@ -254,6 +340,16 @@ struct vy_run_iterator {
 	/** LRU cache of two active pages (two pages is enough). */
 	struct vy_page *curr_page;
 	struct vy_page *prev_page;
+	/**
+	 * Sequential access detection for read ahead: the
+	 * number of the page loaded last, the number of pages
+	 * loaded one after another in the iteration order, and
+	 * the number of the page next to the last one advised
+	 * for read ahead.
+	 */
+	int64_t last_page_no;
+	int64_t seq_page_count;
+	int64_t readahead_page_no;
 	/** Is false until first .._get or .._next_.. method is called */
 	bool search_started;
 	/** Search is finished, you will not get more values from iterator */
@@ -264,6 +360,8 @@ struct vy_run_iterator {
  * Vinyl page stored in memory.
  */
 struct vy_page {
+	/** Id of the run the page belongs to. */
+	int64_t run_id;
 	/** Page position in the run file. */
 	uint32_t page_no;
 	/** Size of page data in memory, i.e. unpacked. */
@@ -274,13 +372,23 @@ struct vy_page {
 	uint32_t *row_index;
 	/** Pointer to the page data. */
 	char *data;
+	/** Number of iterators and caches holding the page. */
+	int refs;
+	/** Set if the page is in vy_page_cache. */
+	bool in_cache;
+	/** vy_page_cache::clock at the last use of the page. */
+	uint64_t last_used;
+	/** Link in vy_page_cache::lru. */
+	struct rlist in_lru;
 };
 
 /**
  * Initialize vinyl run environment
+ * @param env         Environment to initialize.
+ * @param page_cache  Memory quota of the page cache.
  */
-void
-vy_run_env_create(struct vy_run_env *env);
+int
+vy_run_env_create(struct vy_run_env *env, size_t page_cache);
 
 /**
  * Destroy vinyl run environment
@@ -307,6 +415,14 @@ vy_run_page_info(struct vy_run *run, uint32_t pos)
 	return &run->page_info[pos];
 }
 
+/** Return true if the run has a bloom filter per page. */
+static inline bool
+vy_run_has_page_bloom(struct vy_run *run)
+{
+	return run->info.page_count > 0 &&
+	       run->page_info[0].bloom_offset != 0;
+}
+
 static inline bool
 vy_run_is_empty(struct vy_run *run)
 {
@@ -400,7 +516,9 @@ vy_run_write(struct vy_run *run, const char *dirpath,
 	     struct vy_stmt_stream *wi, uint64_t page_size,
 	     const struct key_def *cmp_def,
 	     const struct key_def *key_def,
-	     size_t max_output_count, double bloom_fpr);
+	     size_t max_output_count, double bloom_fpr,
+	     bool bloom_per_page, int compression_level,
+	     uint32_t compression_dict_size);
 
 /**
  * Allocate a new run slice.
@@ -84,6 +84,11 @@ struct vy_run_iterator_stat {
 	 * prevent a disk read.
 	 */
 	int64_t bloom_miss;
+	/**
+	 * Number of pages advised for read ahead while
+	 * scanning runs.
+	 */
+	int64_t readahead;
 	/**
 	 * Number of statements actually read from the disk.
 	 * It may be greater than the number of statements
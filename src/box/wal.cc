@@ -41,6 +41,8 @@
 #include "cbus.h"
 #include "coio_task.h"
 #include "replication.h"
+#include "small/ibuf.h"
+#include "tt_pthread.h"
 
 
 const char *wal_mode_STRS[] = { "none", "write", "fsync", NULL };
@@ -63,6 +65,47 @@ struct wal_thread {
 	struct cpipe tx_pipe;
 };
 
+/**
+ * Header of a row stored in the WAL tail buffer.
+ * Followed by the row encoded the same way as in xlog.
+ */
+struct wal_tail_row {
+	/** Length of the encoded row. */
+	uint32_t len;
+	/** Id of the replica the row originates from. */
+	uint32_t replica_id;
+	/** Row LSN. */
+	int64_t lsn;
+};
+
+/**
+ * In-memory copy of the most recently written WAL rows.
+ * It's filled by the WAL thread and read by relays, so
+ * that replicas which keep up with the master don't have
+ * to re-read and decode xlog files, each on its own.
+ */
+struct wal_tail {
+	/** Protects all members below. */
+	pthread_mutex_t mutex;
+	/** Ring buffer memory, NULL if the buffer is disabled. */
+	char *data;
+	/** Size of the ring buffer. */
+	size_t size;
+	/**
+	 * Offsets of the first stored row and of the end of
+	 * the last one. Both grow monotonically, the position
+	 * in the ring is the offset modulo size.
+	 */
+	int64_t begin;
+	int64_t end;
+	/**
+	 * WAL vclock preceding the first stored row, i.e.
+	 * every row evicted from the buffer or written before
+	 * it was created is covered by this vclock.
+	 */
+	struct vclock vclock;
+};
+
 /*
  * WAL writer - maintain a Write Ahead Log for every change
  * in the data state.
@@ -82,11 +125,31 @@ struct wal_writer
 	 * the wal-tx bus and are rolled back "on arrival".
 	 */
 	struct stailq rollback;
+	/**
+	 * Group commit: a batch of requests collected in tx
+	 * thread and not passed to WAL thread yet, NULL if
+	 * there's none. Only used if wal_commit_delay > 0.
+	 */
+	struct wal_msg *pending;
+	/** Sends the pending batch when wal_commit_delay expires. */
+	struct ev_timer pending_timer;
+	/** A setting from instance configuration - wal_commit_delay */
+	double commit_delay;
+	/** wal_max_batch_rows - max number of rows in a batch. */
+	int64_t max_batch_rows;
+	/** wal_max_batch_bytes - max size of rows in a batch. */
+	int64_t max_batch_bytes;
 	/* ----------------- wal ------------------- */
 	/** A setting from instance configuration - rows_per_wal */
 	int64_t wal_max_rows;
 	/** A setting from instance configuration - wal_max_size */
 	int64_t wal_max_size;
+	/**
+	 * A setting from instance configuration - wal_preallocate.
+	 * If set, disk space for wal_max_size bytes is allocated
+	 * when a new WAL file is created.
+	 */
+	bool wal_preallocate;
 	/** Another one - wal_mode */
 	enum wal_mode wal_mode;
 	/** wal_dir, from the configuration file. */
@@ -117,6 +180,8 @@ struct wal_writer
 	 * Used for replication relays.
 	 */
 	struct rlist watchers;
+	/** Rows recently written to the WAL, for relays. */
+	struct wal_tail tail;
 };
 
 struct wal_msg: public cmsg {
@@ -127,6 +192,10 @@ struct wal_msg: public cmsg {
 	 * be rolled back.
 	 */
 	struct stailq rollback;
+	/** The number of rows in the batch. */
+	int64_t n_rows;
+	/** The size of the batch rows bodies. */
+	int64_t size;
 };
 
 /**
@@ -164,6 +233,64 @@ wal_msg_create(struct wal_msg *batch)
 	cmsg_init(batch, wal_request_route);
 	stailq_create(&batch->commit);
 	stailq_create(&batch->rollback);
+	batch->n_rows = 0;
+	batch->size = 0;
+}
+
+/** Append a request to a batch. */
+static void
+wal_msg_add(struct wal_msg *batch, struct journal_entry *entry)
+{
+	stailq_add_tail_entry(&batch->commit, entry, fifo);
+	batch->n_rows += entry->n_rows;
+	for (int i = 0; i < entry->n_rows; i++) {
+		struct xrow_header *row = entry->rows[i];
+		for (int j = 0; j < row->bodycnt; j++)
+			batch->size += row->body[j].iov_len;
+	}
+}
+
+/**
+ * Return true if no more requests may be added to
+ * a batch according to the group commit limits.
+ */
+static bool
+wal_msg_is_full(struct wal_writer *writer, struct wal_msg *batch)
+{
+	return batch->n_rows >= writer->max_batch_rows ||
+	       batch->size >= writer->max_batch_bytes;
+}
+
+/** Pass a batch of requests to WAL thread. */
+static void
+wal_writer_push(struct wal_writer *writer, struct wal_msg *batch)
+{
+	cpipe_push_input(&wal_thread.wal_pipe, batch);
+	wal_thread.wal_pipe.n_input += batch->n_rows * XROW_IOVMAX;
+	cpipe_flush_input(&wal_thread.wal_pipe);
+}
+
+/**
+ * Pass the batch collected for group commit, if any,
+ * to WAL thread.
+ */
+static void
+wal_writer_push_pending(struct wal_writer *writer)
+{
+	struct wal_msg *batch = writer->pending;
+	if (batch == NULL)
+		return;
+	writer->pending = NULL;
+	ev_timer_stop(loop(), &writer->pending_timer);
+	wal_writer_push(writer, batch);
+}
+
+static void
+wal_writer_pending_timer_cb(ev_loop *loop, ev_timer *watcher, int events)
+{
+	(void) loop;
+	(void) events;
+	wal_writer_push_pending((struct wal_writer *) watcher->data);
 }
 
 static struct wal_msg *
@@ -254,6 +381,208 @@ tx_schedule_rollback(struct cmsg *msg)
 	stailq_create(&writer->rollback);
 }
 
+static void
+wal_tail_create(struct wal_tail *tail, size_t size,
+		const struct vclock *vclock)
+{
+	tt_pthread_mutex_init(&tail->mutex, NULL);
+	tail->data = NULL;
+	tail->size = 0;
+	if (size > 0) {
+		tail->data = (char *) malloc(size);
+		if (tail->data == NULL) {
+			say_warn("failed to allocate %zu bytes for "
+				 "the WAL tail buffer, relays will "
+				 "read xlog files", size);
+		} else {
+			tail->size = size;
+		}
+	}
+	tail->begin = tail->end = 0;
+	vclock_copy(&tail->vclock, vclock);
+}
+
+static void
+wal_tail_destroy(struct wal_tail *tail)
+{
+	free(tail->data);
+	tt_pthread_mutex_destroy(&tail->mutex);
+}
+
+/** Copy data to the ring buffer at the given offset. */
+static void
+wal_tail_copy_in(struct wal_tail *tail, int64_t offset,
+		 const void *src, size_t len)
+{
+	size_t pos = offset % tail->size;
+	size_t n = MIN(len, tail->size - pos);
+	memcpy(tail->data + pos, src, n);
+	memcpy(tail->data, (const char *) src + n, len - n);
+}
+
+/** Copy data from the ring buffer at the given offset. */
+static void
+wal_tail_copy_out(struct wal_tail *tail, int64_t offset,
+		  void *dst, size_t len)
+{
+	size_t pos = offset % tail->size;
+	size_t n = MIN(len, tail->size - pos);
+	memcpy(dst, tail->data + pos, n);
+	memcpy((char *) dst + n, tail->data, len - n);
+}
+
+/**
+ * Drop all rows from the buffer so that readers which
+ * haven't seen all the rows covered by @vclock fall back
+ * on xlog files.
+ */
+static void
+wal_tail_reset(struct wal_tail *tail, const struct vclock *vclock)
+{
+	tail->begin = tail->end;
+	vclock_copy(&tail->vclock, vclock);
+}
+
+/**
+ * Append a row to the buffer, evicting the oldest rows
+ * if there isn't enough space. Must be called with the
+ * mutex locked.
+ *
+ * @retval  0 success
+ * @retval -1 the row can't be stored (check diag)
+ */
+static int
+wal_tail_append(struct wal_tail *tail, struct xrow_header *row)
+{
+	struct iovec iov[XROW_IOVMAX];
+	int iovcnt = xrow_header_encode(row, 0, iov, 0);
+	if (iovcnt < 0)
+		return -1;
+	struct wal_tail_row hdr;
+	hdr.len = 0;
+	for (int i = 0; i < iovcnt; i++)
+		hdr.len += iov[i].iov_len;
+	hdr.replica_id = row->replica_id;
+	hdr.lsn = row->lsn;
+	size_t need = sizeof(hdr) + hdr.len;
+	if (need > tail->size) {
+		diag_set(OutOfMemory, need, "wal_tail", "row");
+		return -1;
+	}
+	while (tail->end - tail->begin + need > tail->size) {
+		struct wal_tail_row old;
+		wal_tail_copy_out(tail, tail->begin, &old, sizeof(old));
+		vclock_follow(&tail->vclock, old.replica_id, old.lsn);
+		tail->begin += sizeof(old) + old.len;
+	}
+	wal_tail_copy_in(tail, tail->end, &hdr, sizeof(hdr));
+	int64_t offset = tail->end + sizeof(hdr);
+	for (int i = 0; i < iovcnt; i++) {
+		wal_tail_copy_in(tail, offset, iov[i].iov_base,
+				 iov[i].iov_len);
+		offset += iov[i].iov_len;
+	}
+	tail->end = offset;
+	return 0;
+}
+
+/**
+ * Store rows of the requests which have been successfully
+ * written to disk in the WAL tail buffer.
+ */
+static void
+wal_tail_write(struct wal_writer *writer, struct stailq *commit,
+	       struct journal_entry *last_commit_entry)
+{
+	struct wal_tail *tail = &writer->tail;
+	if (tail->data == NULL || last_commit_entry == NULL)
+		return;
+	tt_pthread_mutex_lock(&tail->mutex);
+	struct journal_entry *entry;
+	stailq_foreach_entry(entry, commit, fifo) {
+		struct xrow_header **row = entry->rows;
+		for (; row < entry->rows + entry->n_rows; row++) {
+			if (wal_tail_append(tail, *row) == 0)
+				continue;
+			/*
+			 * Skipping a row would make readers miss
+			 * it, so drop everything and let them catch
+			 * up from xlog files.
+			 */
+			diag_log();
+			diag_clear(diag_get());
+			wal_tail_reset(tail, &writer->vclock);
+			goto out;
+		}
+		if (entry == last_commit_entry)
+			break;
+	}
+out:
+	tt_pthread_mutex_unlock(&tail->mutex);
+}
+
+int
+wal_tail_read(int64_t *offset, const struct vclock *vclock,
+	      struct ibuf *out)
+{
+	struct wal_tail *tail = &wal_writer_singleton.tail;
+	int rc = -1;
+	tt_pthread_mutex_lock(&tail->mutex);
+	if (tail->data == NULL)
+		goto out;
+	if (*offset < 0) {
+		/*
+		 * The reader hasn't used the buffer yet, check
+		 * that it has seen all evicted rows and find
+		 * the first row it hasn't.
+		 */
+		if (vclock_compare(&tail->vclock, vclock) > 0)
+			goto out;
+		*offset = tail->begin;
+		while (*offset < tail->end) {
+			struct wal_tail_row hdr;
+			wal_tail_copy_out(tail, *offset, &hdr, sizeof(hdr));
+			if (hdr.lsn > vclock_get(vclock, hdr.replica_id))
+				break;
+			*offset += sizeof(hdr) + hdr.len;
+		}
+	} else if (*offset < tail->begin) {
+		/* The reader lags behind the buffer. */
+		goto out;
+	}
+	if (*offset < tail->end) {
+		size_t size = tail->end - *offset;
+		void *data = ibuf_alloc(out, size);
+		if (data == NULL)
+			goto out;
+		wal_tail_copy_out(tail, *offset, data, size);
+		*offset = tail->end;
+	}
+	rc = 0;
+out:
+	if (rc != 0)
+		*offset = -1;
+	tt_pthread_mutex_unlock(&tail->mutex);
+	return rc;
+}
+
+int
+wal_tail_next_row(const char **pos, const char *end,
+		  struct xrow_header *row)
+{
+	struct wal_tail_row hdr;
+	assert(*pos + sizeof(hdr) <= end);
+	memcpy(&hdr, *pos, sizeof(hdr));
+	*pos += sizeof(hdr);
+	const char *row_end = *pos + hdr.len;
+	assert(row_end <= end);
+	(void) end;
+	if (xrow_header_decode(row, pos, row_end) != 0)
+		return -1;
+	assert(row->replica_id == hdr.replica_id && row->lsn == hdr.lsn);
+	return 0;
+}
+
 /**
  * Initialize WAL writer context. Even though it's a singleton,
  * encapsulate the details just in case we may use
@@ -263,11 +592,13 @@ static void
 wal_writer_create(struct wal_writer *writer, enum wal_mode wal_mode,
 		  const char *wal_dirname, const struct tt_uuid *instance_uuid,
 		  struct vclock *vclock, int64_t wal_max_rows,
-		  int64_t wal_max_size)
+		  int64_t wal_max_size, bool wal_preallocate,
+		  int64_t wal_tail_size, int wal_compression_level)
 {
 	writer->wal_mode = wal_mode;
 	writer->wal_max_rows = wal_max_rows;
 	writer->wal_max_size = wal_max_size;
+	writer->wal_preallocate = wal_preallocate;
 	journal_create(&writer->base, wal_mode == WAL_NONE ?
 		       wal_write_in_wal_mode_none : wal_write, NULL);
 
@@ -275,15 +606,26 @@ wal_writer_create(struct wal_writer *writer, enum wal_mode wal_mode,
 	xlog_clear(&writer->current_wal);
 	if (wal_mode == WAL_FSYNC)
 		writer->wal_dir.open_wflags |= O_SYNC;
+	writer->wal_dir.compression_level = wal_compression_level;
 
 	stailq_create(&writer->rollback);
 	cmsg_init(&writer->in_rollback, NULL);
 
+	writer->pending = NULL;
+	writer->commit_delay = 0;
+	writer->max_batch_rows = INT64_MAX;
+	writer->max_batch_bytes = INT64_MAX;
+	ev_timer_init(&writer->pending_timer, wal_writer_pending_timer_cb,
+		      0, 0);
+	writer->pending_timer.data = writer;
+
 	/* Create and fill writer->vclock. */
 	vclock_create(&writer->vclock);
 	vclock_copy(&writer->vclock, vclock);
 
 	rlist_create(&writer->watchers);
+	wal_tail_create(&writer->tail, wal_mode == WAL_NONE ? 0 :
+			wal_tail_size, vclock);
 }
 
 /** Destroy a WAL writer structure. */
@@ -291,6 +633,7 @@ static void
 wal_writer_destroy(struct wal_writer *writer)
 {
 	xdir_destroy(&writer->wal_dir);
+	wal_tail_destroy(&writer->tail);
 }
 
 /** WAL thread routine. */
@@ -319,20 +662,42 @@ wal_thread_start()
 void
 wal_init(enum wal_mode wal_mode, const char *wal_dirname,
 	 const struct tt_uuid *instance_uuid, struct vclock *vclock,
-	 int64_t wal_max_rows, int64_t wal_max_size)
+	 int64_t wal_max_rows, int64_t wal_max_size,
+	 bool wal_preallocate, int64_t wal_tail_size,
+	 int wal_compression_level)
 {
 	assert(wal_max_rows > 1);
 
 	struct wal_writer *writer = &wal_writer_singleton;
 
 	wal_writer_create(writer, wal_mode, wal_dirname, instance_uuid,
-			  vclock, wal_max_rows, wal_max_size);
+			  vclock, wal_max_rows, wal_max_size, wal_preallocate,
+			  wal_tail_size, wal_compression_level);
 
 	xdir_scan_xc(&writer->wal_dir);
 
 	journal_set(&writer->base);
 }
 
+void
+wal_set_commit_delay(double delay)
+{
+	struct wal_writer *writer = &wal_writer_singleton;
+	writer->commit_delay = delay;
+	if (delay == 0)
+		wal_writer_push_pending(writer);
+}
+
+void
+wal_set_max_batch(int64_t rows, int64_t bytes)
+{
+	struct wal_writer *writer = &wal_writer_singleton;
+	writer->max_batch_rows = rows;
+	writer->max_batch_bytes = bytes;
+	if (writer->pending != NULL && wal_msg_is_full(writer, writer->pending))
+		wal_writer_push_pending(writer);
+}
+
 /**
  * Stop WAL thread, wait until it exits, and destroy WAL writer
  * if it was initialized. Called on shutdown.
@@ -340,6 +705,8 @@ wal_init(enum wal_mode wal_mode, const char *wal_dirname,
 void
 wal_thread_stop()
 {
+	if (journal_is_initialized(&wal_writer_singleton.base))
+		wal_writer_push_pending(&wal_writer_singleton);
 	cbus_stop_loop(&wal_thread.wal_pipe);
 
 	if (cord_join(&wal_thread.cord)) {
@@ -417,6 +784,12 @@ wal_checkpoint(struct vclock *vclock, bool rotate)
 		{wal_checkpoint_f, &wal_thread.tx_pipe},
 		{wal_checkpoint_done_f, NULL},
 	};
+	/*
+	 * Requests of the pending batch have already been
+	 * applied in memory, so they must precede the
+	 * checkpoint in WAL.
+	 */
+	wal_writer_push_pending(writer);
 	vclock_create(vclock);
 	struct wal_checkpoint msg;
 	cmsg_init(&msg, wal_checkpoint_route);
@@ -512,6 +885,16 @@ wal_opt_rotate(struct wal_writer *writer)
 		return -1;
 	}
 	xdir_add_vclock(&writer->wal_dir, vclock);
+	/*
+	 * Appending to a preallocated file doesn't update
+	 * file system metadata on each write, which makes
+	 * syncing the file cheaper. Not being able to
+	 * preallocate is not fatal: the file will grow
+	 * as usual.
+	 */
+	if (writer->wal_preallocate &&
+	    xlog_fallocate(&writer->current_wal, writer->wal_max_size) != 0)
+		diag_log();
 
 	wal_notify_watchers(writer, WAL_EVENT_ROTATE);
 	return 0;
@@ -523,6 +906,18 @@ wal_writer_clear_bus(struct cmsg *msg)
 	(void) msg;
 }
 
+static void
+tx_writer_clear_pending(struct cmsg *msg)
+{
+	(void) msg;
+	/*
+	 * Requests of the pending batch may have seen changes
+	 * of the failed ones. Send the batch ahead of the
+	 * rollback message, so that it's rolled back as well.
+	 */
+	wal_writer_push_pending(&wal_writer_singleton);
+}
+
 static void
 wal_writer_end_rollback(struct cmsg *msg)
 {
@@ -543,7 +938,7 @@ wal_writer_begin_rollback(struct wal_writer *writer)
 		 * valve is closed by non-empty writer->rollback
 		 * list.
 		 */
-		{ wal_writer_clear_bus, &wal_thread.wal_pipe },
+		{ tx_writer_clear_pending, &wal_thread.wal_pipe },
 		{ wal_writer_clear_bus, &wal_thread.tx_pipe },
 		/*
 		 * Step 2: writer->rollback queue contains all
@@ -676,6 +1071,7 @@ done:
 			      &wal_msg->rollback);
 		wal_writer_begin_rollback(writer);
 	}
+	wal_tail_write(writer, &wal_msg->commit, last_commit_entry);
 	fiber_gc();
 	wal_notify_watchers(writer, WAL_EVENT_WRITE);
 }
@@ -738,11 +1134,35 @@ wal_write(struct journal *journal, struct journal_entry *entry)
 	}
 
 	struct wal_msg *batch;
-	if (!stailq_empty(&wal_thread.wal_pipe.input) &&
-	    (batch = wal_msg(stailq_first_entry(&wal_thread.wal_pipe.input,
-						struct cmsg, fifo)))) {
-
-		stailq_add_tail_entry(&batch->commit, entry, fifo);
+	if (writer->commit_delay > 0) {
+		/*
+		 * Group commit: collect concurrent requests in
+		 * a batch until it's full or the delay expires,
+		 * so that they are written to disk with a single
+		 * write and fsync.
+		 */
+		batch = writer->pending;
+		if (batch == NULL) {
+			batch = (struct wal_msg *)
+				region_alloc_xc(&fiber()->gc,
+						sizeof(struct wal_msg));
+			wal_msg_create(batch);
+			writer->pending = batch;
+			ev_timer_set(&writer->pending_timer,
+				     writer->commit_delay, 0);
+			ev_timer_start(loop(), &writer->pending_timer);
+		}
+		wal_msg_add(batch, entry);
+		if (wal_msg_is_full(writer, batch))
+			wal_writer_push_pending(writer);
+	} else if (!stailq_empty(&wal_thread.wal_pipe.input) &&
+		   (batch = wal_msg(stailq_first_entry(
+				&wal_thread.wal_pipe.input,
+				struct cmsg, fifo))) != NULL &&
+		   !wal_msg_is_full(writer, batch)) {
+		wal_msg_add(batch, entry);
+		wal_thread.wal_pipe.n_input += entry->n_rows * XROW_IOVMAX;
+		cpipe_flush_input(&wal_thread.wal_pipe);
 	} else {
 		batch = (struct wal_msg *)
 			region_alloc_xc(&fiber()->gc,
@@ -753,11 +1173,9 @@ wal_write(struct journal *journal, struct journal_entry *entry)
 		 * since cpipe_push() may pass the batch to WAL
 		 * thread right away.
 		 */
-		stailq_add_tail_entry(&batch->commit, entry, fifo);
-		cpipe_push(&wal_thread.wal_pipe, batch);
+		wal_msg_add(batch, entry);
+		wal_writer_push(writer, batch);
 	}
-	wal_thread.wal_pipe.n_input += entry->n_rows * XROW_IOVMAX;
-	cpipe_flush_input(&wal_thread.wal_pipe);
 	/**
 	 * It's not safe to spuriously wakeup this fiber
 	 * since in that case it will ignore a possible
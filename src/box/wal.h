@@ -39,6 +39,8 @@
 struct fiber;
 struct vclock;
 struct wal_writer;
+struct ibuf;
+struct xrow_header;
 
 enum wal_mode { WAL_NONE = 0, WAL_WRITE, WAL_FSYNC, WAL_MODE_MAX };
 
@@ -55,11 +57,29 @@ wal_thread_start();
 void
 wal_init(enum wal_mode wal_mode, const char *wal_dirname,
 	 const struct tt_uuid *instance_uuid, struct vclock *vclock,
-	 int64_t wal_max_rows, int64_t wal_max_size);
+	 int64_t wal_max_rows, int64_t wal_max_size,
+	 bool wal_preallocate, int64_t wal_tail_size,
+	 int wal_compression_level);
 
 enum wal_mode
 wal_mode();
 
+/**
+ * Set the group commit delay: for how long tx thread may
+ * collect requests in a batch before passing it to WAL
+ * thread, so that they are written with one write and
+ * fsync. 0 disables group commit.
+ */
+void
+wal_set_commit_delay(double delay);
+
+/**
+ * Set the max number of rows and the max size of rows
+ * of a batch written by WAL thread at once.
+ */
+void
+wal_set_max_batch(int64_t rows, int64_t bytes);
+
 void
 wal_thread_stop();
 
@@ -138,6 +158,39 @@ void
 wal_clear_watcher(struct wal_watcher *watcher,
 		  void (*process_cb)(struct cbus_endpoint *));
 
+/**
+ * Copy rows recently written to the WAL that follow @vclock
+ * from the in-memory WAL tail buffer to @out. Rows are copied
+ * in the order they were written and must be decoded with
+ * wal_tail_next_row(). Some of them may already be covered
+ * by @vclock and should be skipped by the caller.
+ *
+ * @param offset[inout] position of the reader in the buffer,
+ *                      must be -1 on the first call. Set to
+ *                      -1 on failure.
+ * @param vclock        rows already seen by the reader.
+ * @param out           buffer to copy rows to.
+ *
+ * @retval  0 all rows following @vclock have been copied
+ * @retval -1 the buffer is disabled or some of the rows have
+ *            already been evicted from it, the caller must
+ *            read them from xlog files.
+ */
+int
+wal_tail_read(int64_t *offset, const struct vclock *vclock,
+	      struct ibuf *out);
+
+/**
+ * Decode the next row copied by wal_tail_read().
+ * The row body points to the buffer the row was copied to.
+ *
+ * @retval  0 success
+ * @retval -1 error (check diag)
+ */
+int
+wal_tail_next_row(const char **pos, const char *end,
+		  struct xrow_header *row);
+
 void
 wal_atfork();
 
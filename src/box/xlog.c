@@ -57,6 +57,8 @@ typedef uint32_t log_magic_t;
 
 static const log_magic_t row_marker = mp_bswap_u32(0xd5ba0bab); /* host byte order */
 static const log_magic_t zrow_marker = mp_bswap_u32(0xd5ba0bba); /* host byte order */
+/* Compressed with a zstd dictionary stored apart from the file. */
+static const log_magic_t zdrow_marker = mp_bswap_u32(0xd5ba0bbd); /* host byte order */
 static const log_magic_t eof_marker = mp_bswap_u32(0xd510aded); /* host byte order */
 static const char inprogress_suffix[] = ".inprogress";
 
@@ -294,6 +296,7 @@ xdir_create(struct xdir *dir, const char *dirname,
 		unreachable();
 	}
 	dir->type = type;
+	dir->compression_level = XLOG_COMPRESSION_LEVEL_DEFAULT;
 }
 
 /**
@@ -660,6 +663,7 @@ xlog_init(struct xlog *xlog)
 	xlog->sync_interval = SNAP_SYNC_INTERVAL;
 	xlog->sync_time = ev_monotonic_time();
 	xlog->is_autocommit = true;
+	xlog->compression_level = XLOG_COMPRESSION_LEVEL_DEFAULT;
 	obuf_create(&xlog->obuf, &cord()->slabc, XLOG_TX_AUTOCOMMIT_THRESHOLD);
 	obuf_create(&xlog->zbuf, &cord()->slabc, XLOG_TX_AUTOCOMMIT_THRESHOLD);
 	xlog->zctx = ZSTD_createCCtx();
@@ -874,6 +878,7 @@ xdir_create_xlog(struct xdir *dir, struct xlog *xlog,
 	/* free file cache if dir should be synced */
 	xlog->free_cache = dir->sync_interval != 0 ? true: false;
 	xlog->rate_limit = 0;
+	xlog->compression_level = dir->compression_level;
 
 	/* Rename xlog file */
 	if (dir->suffix != INPROGRESS && xlog_rename(xlog)) {
@@ -887,31 +892,28 @@ xdir_create_xlog(struct xdir *dir, struct xlog *xlog,
 }
 
 /**
- * Write a sequence of uncompressed xrow objects.
- *
- * @retval -1 error
- * @retval >= 0 the number of bytes written
+ * Populate the fixheader reserved at the beginning of a block
+ * of uncompressed xrow objects.
  */
-static off_t
-xlog_tx_write_plain(struct xlog *log)
+static void
+xlog_tx_encode_plain(struct obuf *obuf)
 {
 	/**
 	 * We created an obuf savepoint at start of xlog_tx,
 	 * now populate it with data.
 	 */
-	char *fixheader = (char *)log->obuf.iov[0].iov_base;
+	char *fixheader = (char *)obuf->iov[0].iov_base;
 	*(log_magic_t *)fixheader = row_marker;
 	char *data = fixheader + sizeof(log_magic_t);
 
-	data = mp_encode_uint(data,
-			      obuf_size(&log->obuf) - XLOG_FIXHEADER_SIZE);
+	data = mp_encode_uint(data, obuf_size(obuf) - XLOG_FIXHEADER_SIZE);
 	/* Encode crc32 for previous row */
 	data = mp_encode_uint(data, 0);
 	/* Encode crc32 for current row */
 	uint32_t crc32c = 0;
 	struct iovec *iov;
 	size_t offset = XLOG_FIXHEADER_SIZE;
-	for (iov = log->obuf.iov; iov->iov_len; ++iov) {
+	for (iov = obuf->iov; iov->iov_len; ++iov) {
 		crc32c = crc32_calc(crc32c,
 				    (char *)iov->iov_base + offset,
 				    iov->iov_len - offset);
@@ -930,42 +932,57 @@ xlog_tx_write_plain(struct xlog *log)
 			data += padding - 1;
 		}
 	}
-
-	ERROR_INJECT(ERRINJ_WAL_WRITE_DISK, {
-		diag_set(ClientError, ER_INJECTION, "xlog write injection");
-		return -1;
-	});
-
-	ssize_t written = fio_writevn(log->fd, log->obuf.iov, log->obuf.pos + 1);
-	if (written < 0) {
-		diag_set(SystemError, "failed to write to '%s' file",
-			 log->filename);
-		return -1;
-	}
-	return obuf_size(&log->obuf);
 }
 
 /**
- * Write a compressed block of xrow objects.
- * @retval -1  error
- * @retval >= 0 the number of bytes written
+ * Compress a block of xrow objects accumulated in @a obuf
+ * and append it, prefixed with a fixheader, to @a zbuf.
+ * If @a zcdict is not NULL, it is used as the dictionary and
+ * the block is marked with zdrow_marker.
+ *
+ * @retval -1 error, @a zbuf is left as it was
+ * @retval 0 success
  */
-static off_t
-xlog_tx_write_zstd(struct xlog *log)
+static int
+xlog_tx_encode_zstd(struct obuf *obuf, struct obuf *zbuf,
+		    ZSTD_CCtx *zctx, int compression_level,
+		    const ZSTD_CDict *zcdict)
 {
-	char *fixheader = (char *)obuf_alloc(&log->zbuf,
-					     XLOG_FIXHEADER_SIZE);
+	struct obuf_svp svp = obuf_create_svp(zbuf);
+	size_t zbuf_size = obuf_size(zbuf);
+	char *fixheader = (char *)obuf_alloc(zbuf, XLOG_FIXHEADER_SIZE);
+	if (fixheader == NULL) {
+		diag_set(OutOfMemory, XLOG_FIXHEADER_SIZE, "runtime arena",
+			  "compression buffer");
+		goto error;
+	}
 
 	uint32_t crc32c = 0;
 	struct iovec *iov;
-	/* 3 is compression level. */
-	ZSTD_compressBegin(log->zctx, 3);
+	size_t rc;
+	if (zcdict != NULL) {
+		/*
+		 * The level the dictionary was digested with
+		 * is used.
+		 */
+#if ZSTD_VERSION_NUMBER >= 10300
+		rc = ZSTD_compressBegin_usingCDict(zctx, zcdict);
+#else
+		rc = ZSTD_compressBegin_usingCDict(zctx, zcdict, 0);
+#endif
+	} else {
+		rc = ZSTD_compressBegin(zctx, compression_level);
+	}
+	if (ZSTD_isError(rc)) {
+		diag_set(ClientError, ER_COMPRESSION, ZSTD_getErrorName(rc));
+		goto error;
+	}
 	size_t offset = XLOG_FIXHEADER_SIZE;
-	for (iov = log->obuf.iov; iov->iov_len; ++iov) {
+	for (iov = obuf->iov; iov->iov_len; ++iov) {
 		/* Estimate max output buffer size. */
 		size_t zmax_size = ZSTD_compressBound(iov->iov_len - offset);
 		/* Allocate a destination buffer. */
-		void *zdst = obuf_reserve(&log->zbuf, zmax_size);
+		void *zdst = obuf_reserve(zbuf, zmax_size);
 		if (!zdst) {
 			diag_set(OutOfMemory, zmax_size, "runtime arena",
 				  "compression buffer");
@@ -977,13 +994,13 @@ xlog_tx_write_zstd(struct xlog *log)
 		 * If it's the last iov or the last
 		 * log has 0 bytes, end the stream.
 		 */
-		if (iov == log->obuf.iov + log->obuf.pos ||
+		if (iov == obuf->iov + obuf->pos ||
 		    !(iov + 1)->iov_len) {
 			fcompress = ZSTD_compressEnd;
 		} else {
 			fcompress = ZSTD_compressContinue;
 		}
-		size_t zsize = fcompress(log->zctx, zdst, zmax_size,
+		size_t zsize = fcompress(zctx, zdst, zmax_size,
 					 (char *)iov->iov_base + offset,
 					 iov->iov_len - offset);
 		if (ZSTD_isError(zsize)) {
@@ -992,18 +1009,19 @@ xlog_tx_write_zstd(struct xlog *log)
 			goto error;
 		}
 		/* Advance output buffer to the end of compressed data. */
-		obuf_alloc(&log->zbuf, zsize);
+		obuf_alloc(zbuf, zsize);
 		/* Update crc32c */
 		crc32c = crc32_calc(crc32c, (char *)zdst, zsize);
 		/* Discount fixheader size for all iovs after first. */
 		offset = 0;
 	}
 
-	*(log_magic_t *)fixheader = zrow_marker;
+	*(log_magic_t *)fixheader = zcdict != NULL ?
+				    zdrow_marker : zrow_marker;
 	char *data;
 	data = fixheader + sizeof(log_magic_t);
-	data = mp_encode_uint(data,
-			      obuf_size(&log->zbuf) - XLOG_FIXHEADER_SIZE);
+	data = mp_encode_uint(data, obuf_size(zbuf) - zbuf_size -
+			      XLOG_FIXHEADER_SIZE);
 	/* Encode crc32 for previous row */
 	data = mp_encode_uint(data, 0);
 	/* Encode crc32 for current row */
@@ -1018,10 +1036,51 @@ xlog_tx_write_zstd(struct xlog *log)
 			data += padding - 1;
 		}
 	}
+	return 0;
+error:
+	obuf_rollback_to_svp(zbuf, &svp);
+	return -1;
+}
+
+/**
+ * Write a sequence of uncompressed xrow objects.
+ *
+ * @retval -1 error
+ * @retval >= 0 the number of bytes written
+ */
+static off_t
+xlog_tx_write_plain(struct xlog *log)
+{
+	xlog_tx_encode_plain(&log->obuf);
+
+	ERROR_INJECT(ERRINJ_WAL_WRITE_DISK, {
+		diag_set(ClientError, ER_INJECTION, "xlog write injection");
+		return -1;
+	});
+
+	ssize_t written = fio_writevn(log->fd, log->obuf.iov, log->obuf.pos + 1);
+	if (written < 0) {
+		diag_set(SystemError, "failed to write to '%s' file",
+			 log->filename);
+		return -1;
+	}
+	return obuf_size(&log->obuf);
+}
+
+/**
+ * Write a compressed block of xrow objects.
+ * @retval -1  error
+ * @retval >= 0 the number of bytes written
+ */
+static off_t
+xlog_tx_write_zstd(struct xlog *log)
+{
+	if (xlog_tx_encode_zstd(&log->obuf, &log->zbuf, log->zctx,
+				log->compression_level, log->zcdict) != 0)
+		return -1;
 
 	ERROR_INJECT(ERRINJ_WAL_WRITE_DISK, {
 		diag_set(ClientError, ER_INJECTION, "xlog write injection");
-		obuf_reset(&log->zbuf);
 		goto error;
 	});
 
@@ -1046,26 +1105,16 @@ error:
 #define SYNC_ROUND_UP(size)	(SYNC_ROUND_DOWN(size + SYNC_MASK))
 
 /**
- * Writes xlog batch to file
+ * Account a write of @a rows rows to a log file: advance
+ * the file offset, sync and throttle, or truncate the file
+ * back to the last good position if the write failed.
+ *
+ * @retval -1 the write failed
+ * @retval >= 0 the number of bytes written
  */
 static ssize_t
-xlog_tx_write(struct xlog *log)
+xlog_tx_complete(struct xlog *log, ssize_t written, int64_t rows)
 {
-	if (obuf_size(&log->obuf) == XLOG_FIXHEADER_SIZE)
-		return 0;
-	ssize_t written;
-
-	if (obuf_size(&log->obuf) >= XLOG_TX_COMPRESS_THRESHOLD) {
-		written = xlog_tx_write_zstd(log);
-	} else {
-		written = xlog_tx_write_plain(log);
-	}
-	ERROR_INJECT(ERRINJ_WAL_WRITE, {
-		diag_set(ClientError, ER_INJECTION, "xlog write injection");
-		written = -1;
-	});
-
-	obuf_reset(&log->obuf);
 	/*
 	 * Simplify recovery after a temporary write failure:
 	 * truncate the file to the best known good write
@@ -1078,8 +1127,8 @@ xlog_tx_write(struct xlog *log)
 		return -1;
 	}
 	log->offset += written;
-	log->rows += log->tx_rows;
-	log->tx_rows = 0;
+	log->rows += rows;
+	log->allocated = MAX(log->allocated - written, 0);
 	if ((log->sync_interval && log->offset >=
 	    (off_t)(log->synced_size + log->sync_interval)) ||
 	    (log->rate_limit && log->offset >=
@@ -1121,6 +1170,63 @@ xlog_tx_write(struct xlog *log)
 	return written;
 }
 
+int
+xlog_fallocate(struct xlog *log, size_t size)
+{
+#ifdef HAVE_FALLOCATE
+	static bool fallocate_not_supported = false;
+	if (fallocate_not_supported || log->allocated >= (off_t) size)
+		return 0;
+	off_t offset = log->offset + log->allocated;
+	off_t len = size - log->allocated;
+	if (fallocate(log->fd, FALLOC_FL_KEEP_SIZE, offset, len) != 0) {
+		if (errno == ENOSYS || errno == EOPNOTSUPP) {
+			say_warn("fallocate is not supported, "
+				 "proceeding without it");
+			fallocate_not_supported = true;
+			return 0;
+		}
+		diag_set(SystemError, "%s: can't allocate disk space",
+			 log->filename);
+		return -1;
+	}
+	log->allocated += len;
+	return 0;
+#else
+	(void) log;
+	(void) size;
+	return 0;
+#endif /* HAVE_FALLOCATE */
+}
+
+/**
+ * Writes xlog batch to file
+ */
+static ssize_t
+xlog_tx_write(struct xlog *log)
+{
+	if (obuf_size(&log->obuf) == XLOG_FIXHEADER_SIZE)
+		return 0;
+	ssize_t written;
+
+	if (log->compression_level > 0 &&
+	    obuf_size(&log->obuf) >= XLOG_TX_COMPRESS_THRESHOLD) {
+		written = xlog_tx_write_zstd(log);
+	} else {
+		written = xlog_tx_write_plain(log);
+	}
+	ERROR_INJECT(ERRINJ_WAL_WRITE, {
+		diag_set(ClientError, ER_INJECTION, "xlog write injection");
+		written = -1;
+	});
+
+	obuf_reset(&log->obuf);
+	if (xlog_tx_complete(log, written, log->tx_rows) < 0)
+		return -1;
+	log->tx_rows = 0;
+	return written;
+}
+
 /*
  * Add a row to a log and possibly flush the log.
  *
@@ -1289,6 +1395,19 @@ xlog_close(struct xlog *l, bool reuse_fd)
 		say_error("%s: failed to write EOF marker: %s", l->filename,
 			  diag_last_error(diag_get())->errmsg);
 
+	/*
+	 * Release disk space preallocated and left unused.
+	 * The file size was not changed by preallocation,
+	 * so truncating to it frees only the blocks past EOF.
+	 * Do it before the sync, so that the metadata update
+	 * is made durable along with the data.
+	 */
+	if (l->allocated > 0) {
+		off_t size = l->offset + (rc == 0 ? sizeof(eof_marker) : 0);
+		if (ftruncate(l->fd, size) != 0)
+			say_syserror("%s: ftruncate() failed", l->filename);
+	}
+
 	/*
 	 * Sync the file before closing, since
 	 * otherwise we can end up with a partially
@@ -1325,6 +1444,136 @@ xlog_atfork(struct xlog *xlog)
 
 /* }}} */
 
+/* {{{ struct xlog_batch */
+
+int
+xlog_batch_create(struct xlog_batch *batch, int compression_level)
+{
+	memset(batch, 0, sizeof(*batch));
+	batch->zctx = ZSTD_createCCtx();
+	if (batch->zctx == NULL) {
+		diag_set(ClientError, ER_COMPRESSION,
+			 "failed to create context");
+		return -1;
+	}
+	obuf_create(&batch->obuf, &cord()->slabc, XLOG_TX_AUTOCOMMIT_THRESHOLD);
+	obuf_create(&batch->out, &cord()->slabc, XLOG_TX_AUTOCOMMIT_THRESHOLD);
+	batch->compression_level = compression_level;
+	return 0;
+}
+
+void
+xlog_batch_destroy(struct xlog_batch *batch)
+{
+	obuf_destroy(&batch->obuf);
+	obuf_destroy(&batch->out);
+	ZSTD_freeCCtx(batch->zctx);
+}
+
+/**
+ * Encode the tx block being filled and move it to
+ * the complete blocks of a batch.
+ */
+static int
+xlog_batch_encode(struct xlog_batch *batch)
+{
+	if (obuf_size(&batch->obuf) <= XLOG_FIXHEADER_SIZE)
+		return 0;
+	if (batch->compression_level > 0 &&
+	    obuf_size(&batch->obuf) >= XLOG_TX_COMPRESS_THRESHOLD) {
+		if (xlog_tx_encode_zstd(&batch->obuf, &batch->out,
+					batch->zctx,
+					batch->compression_level,
+					NULL) != 0)
+			return -1;
+	} else {
+		xlog_tx_encode_plain(&batch->obuf);
+		struct obuf_svp svp = obuf_create_svp(&batch->out);
+		struct iovec *iov;
+		for (iov = batch->obuf.iov; iov->iov_len; ++iov) {
+			if (obuf_dup(&batch->out, iov->iov_base,
+				     iov->iov_len) < iov->iov_len) {
+				diag_set(OutOfMemory, iov->iov_len,
+					 "runtime arena", "xlog batch");
+				obuf_rollback_to_svp(&batch->out, &svp);
+				return -1;
+			}
+		}
+	}
+	obuf_reset(&batch->obuf);
+	batch->rows += batch->tx_rows;
+	batch->tx_rows = 0;
+	return 0;
+}
+
+ssize_t
+xlog_batch_write_row(struct xlog_batch *batch,
+		     const struct xrow_header *packet)
+{
+	/* Reserve space for a fixheader, @sa xlog_write_row(). */
+	if (obuf_size(&batch->obuf) == 0) {
+		if (!obuf_alloc(&batch->obuf, XLOG_FIXHEADER_SIZE)) {
+			diag_set(OutOfMemory, XLOG_FIXHEADER_SIZE,
+				  "runtime arena", "xlog batch");
+			return -1;
+		}
+	}
+
+	struct obuf_svp svp = obuf_create_svp(&batch->obuf);
+	size_t page_offset = obuf_size(&batch->obuf);
+	struct iovec iov[XROW_IOVMAX];
+	/** don't write sync to the disk */
+	int iovcnt = xrow_header_encode(packet, 0, iov, 0);
+	if (iovcnt < 0)
+		return -1;
+	for (int i = 0; i < iovcnt; ++i) {
+		if (obuf_dup(&batch->obuf, iov[i].iov_base, iov[i].iov_len) <
+		    iov[i].iov_len) {
+			diag_set(OutOfMemory, iov[i].iov_len,
+				  "runtime arena", "xlog batch");
+			obuf_rollback_to_svp(&batch->obuf, &svp);
+			return -1;
+		}
+	}
+	batch->tx_rows++;
+
+	size_t row_size = obuf_size(&batch->obuf) - page_offset;
+	if (obuf_size(&batch->obuf) >= XLOG_TX_AUTOCOMMIT_THRESHOLD &&
+	    xlog_batch_encode(batch) != 0)
+		return -1;
+	return row_size;
+}
+
+int
+xlog_batch_flush(struct xlog_batch *batch)
+{
+	return xlog_batch_encode(batch);
+}
+
+ssize_t
+xlog_write_batch(struct xlog *log, struct xlog_batch *batch)
+{
+	assert(batch->tx_rows == 0);
+	if (xlog_flush(log) < 0)
+		return -1;
+	if (obuf_size(&batch->out) == 0)
+		return 0;
+
+	ssize_t written = fio_writevn(log->fd, batch->out.iov,
+				      batch->out.pos + 1);
+	if (written < 0) {
+		diag_set(SystemError, "failed to write to '%s' file",
+			 log->filename);
+	}
+	ERROR_INJECT(ERRINJ_WAL_WRITE, {
+		diag_set(ClientError, ER_INJECTION, "xlog write injection");
+		written = -1;
+	});
+	return xlog_tx_complete(log, written, batch->rows);
+}
+
+/* }}} */
+
 /* {{{ struct xlog_cursor */
 
 #define XLOG_READ_AHEAD		(1 << 14)
@@ -1408,8 +1657,9 @@ xlog_cursor_decompress(char **rows, char *rows_end, const char **data,
  */
 struct xlog_fixheader {
 	/**
-	 * xlog tx magic, row_marker for plain xrows
-	 * or zrow_marker for compressed.
+	 * xlog tx magic, row_marker for plain xrows,
+	 * zrow_marker for compressed or zdrow_marker for
+	 * compressed with a dictionary.
 	 */
 	log_magic_t magic;
 	/**
@@ -1445,7 +1695,8 @@ xlog_fixheader_decode(struct xlog_fixheader *fixheader,
 	/* Decode magic */
 	fixheader->magic = load_u32(pos);
 	if (fixheader->magic != row_marker &&
-	    fixheader->magic != zrow_marker) {
+	    fixheader->magic != zrow_marker &&
+	    fixheader->magic != zdrow_marker) {
 		diag_set(XlogError, "invalid magic: 0x%x", fixheader->magic);
 		return -1;
 	}
@@ -1496,7 +1747,8 @@ xlog_fixheader_decode(struct xlog_fixheader *fixheader,
 
 int
 xlog_tx_decode(const char *data, const char *data_end,
-	       char *rows, char *rows_end, ZSTD_DStream *zdctx)
+	       char *rows, char *rows_end, ZSTD_DStream *zdctx,
+	       const ZSTD_DDict *zddict)
 {
 	/* Decode fixheader */
 	struct xlog_fixheader fixheader;
@@ -1534,8 +1786,18 @@ xlog_tx_decode(const char *data, const char *data_end,
 	}
 
 	/* Decompress zstd rows */
-	assert(fixheader.magic == zrow_marker);
-	ZSTD_initDStream(zdctx);
+	if (fixheader.magic == zdrow_marker) {
+		if (zddict == NULL) {
+			diag_set(ClientError, ER_DECOMPRESSION,
+				 "tx is compressed with a dictionary "
+				 "which is not available");
+			return -1;
+		}
+		ZSTD_initDStream_usingDDict(zdctx, zddict);
+	} else {
+		assert(fixheader.magic == zrow_marker);
+		ZSTD_initDStream(zdctx);
+	}
 	int rc = xlog_cursor_decompress(&rows, rows_end, &data, data_end,
 					zdctx);
 	if (rc < 0) {
@@ -1600,6 +1862,18 @@ xlog_tx_cursor_create(struct xlog_tx_cursor *tx_cursor,
 		return 0;
 	};
 
+	if (fixheader.magic == zdrow_marker) {
+		/*
+		 * The dictionary is stored apart from the file.
+		 * Not an XlogError: readers must not skip such
+		 * a tx as corrupted.
+		 */
+		diag_set(ClientError, ER_DECOMPRESSION,
+			 "tx is compressed with a dictionary "
+			 "which is not available");
+		ibuf_destroy(&tx_cursor->rows);
+		return -1;
+	}
 	assert(fixheader.magic == zrow_marker);
 	ZSTD_initDStream(zdctx);
 	int rc;
@@ -1671,11 +1945,36 @@ xlog_cursor_find_tx_magic(struct xlog_cursor *i)
 		++i->rbuf.rpos;
 		assert(i->rbuf.rpos + sizeof(log_magic_t) <= i->rbuf.wpos);
 		magic = load_u32(i->rbuf.rpos);
-	} while (magic != row_marker && magic != zrow_marker);
+	} while (magic != row_marker && magic != zrow_marker &&
+		 magic != zdrow_marker);
 
 	return 0;
 }
 
+/**
+ * Handle an eof marker at the cursor position: check
+ * that there is no more data in the file.
+ *
+ * @retval 1 eof
+ * @retval -1 error
+ */
+static int
+xlog_cursor_eof(struct xlog_cursor *i)
+{
+	int rc = xlog_cursor_ensure(i, sizeof(log_magic_t) + sizeof(char));
+
+	if (rc < 0)
+		return -1;
+	if (rc == 0) {
+		diag_set(XlogError, "%s: has some data after "
+			  "eof marker at %lld", i->name,
+			  xlog_cursor_pos(i));
+		return -1;
+	}
+	i->state = XLOG_CURSOR_EOF;
+	return 1;
+}
+
 int
 xlog_cursor_next_tx(struct xlog_cursor *i)
 {
@@ -1690,7 +1989,7 @@ xlog_cursor_next_tx(struct xlog_cursor *i)
 		return 1;
 	if (load_u32(i->rbuf.rpos) == eof_marker) {
 		/* eof marker found */
-		goto eof_found;
+		return xlog_cursor_eof(i);
 	}
 
 	ssize_t to_load;
@@ -1709,23 +2008,51 @@ xlog_cursor_next_tx(struct xlog_cursor *i)
 
 	i->state = XLOG_CURSOR_TX;
 	return 0;
-eof_found:
-	/*
-	 * A eof marker is read, check that there is no
-	 * more data in the file.
-	 */
-	rc = xlog_cursor_ensure(i, sizeof(log_magic_t) + sizeof(char));
+}
 
+int
+xlog_cursor_next_tx_raw(struct xlog_cursor *i,
+			const char **data, const char **data_end)
+{
+	int rc;
+	assert(i->state == XLOG_CURSOR_ACTIVE);
+
+	/* load at least magic to check eof */
+	rc = xlog_cursor_ensure(i, sizeof(log_magic_t));
 	if (rc < 0)
 		return -1;
-	if (rc == 0) {
-		diag_set(XlogError, "%s: has some data after "
-			  "eof marker at %lld", i->name,
-			  xlog_cursor_pos(i));
-		return -1;
+	if (rc > 0)
+		return 1;
+	if (load_u32(i->rbuf.rpos) == eof_marker) {
+		/* eof marker found */
+		return xlog_cursor_eof(i);
 	}
-	i->state = XLOG_CURSOR_EOF;
-	return 1;
+
+	const char *pos;
+	struct xlog_fixheader fixheader;
+	while (true) {
+		/* The read buffer may move, start over each time. */
+		pos = i->rbuf.rpos;
+		ssize_t to_load = xlog_fixheader_decode(&fixheader, &pos,
+							 i->rbuf.wpos);
+		if (to_load < 0)
+			return -1;
+		if (to_load == 0 &&
+		    i->rbuf.wpos - pos >= (ptrdiff_t)fixheader.len)
+			break;
+		if (to_load == 0)
+			to_load = fixheader.len - (i->rbuf.wpos - pos);
+		/* not enough data in read buffer */
+		rc = xlog_cursor_ensure(i, ibuf_used(&i->rbuf) + to_load);
+		if (rc < 0)
+			return -1;
+		if (rc > 0)
+			return 1;
+	}
+	*data = i->rbuf.rpos;
+	*data_end = pos + fixheader.len;
+	i->rbuf.rpos = (char *)*data_end;
+	return 0;
 }
 
 int
@@ -69,6 +69,14 @@ enum xdir_type {
  */
 enum log_suffix { NONE, INPROGRESS };
 
+enum {
+	/**
+	 * Default zstd compression level of xlog transactions.
+	 * Level 0 disables compression.
+	 */
+	XLOG_COMPRESSION_LEVEL_DEFAULT = 3,
+};
+
 /**
  * A handle for a data directory with write ahead logs, snapshots,
  * vylogs.
@@ -135,6 +143,11 @@ struct xdir {
 	 * corresponding file cache will be marked as free
 	 */
 	uint64_t sync_interval;
+	/**
+	 * Zstd compression level of xlog files created in
+	 * this directory, 0 disables compression.
+	 */
+	int compression_level;
 };
 
 /**
@@ -277,6 +290,11 @@ struct xlog {
 	bool is_autocommit;
 	/** The current offset in the log file, for writing. */
 	off_t offset;
+	/**
+	 * The size of disk space preallocated past the current
+	 * offset with xlog_fallocate(), for writing.
+	 */
+	off_t allocated;
 	/**
 	 * Output buffer, works as row accumulator for
 	 * compression.
@@ -284,6 +302,16 @@ struct xlog {
 	struct obuf obuf;
 	/** The context of zstd compression */
 	ZSTD_CCtx *zctx;
+	/** Zstd compression level, 0 disables compression. */
+	int compression_level;
+	/**
+	 * Digested zstd dictionary to compress transactions
+	 * with, NULL if none. Not owned by the xlog. May be set
+	 * between transactions. Transactions compressed with a
+	 * dictionary are marked as such, the dictionary itself
+	 * must be stored apart from the file.
+	 */
+	const ZSTD_CDict *zcdict;
 	/**
 	 * Compressed output buffer
 	 */
@@ -429,6 +457,20 @@ xlog_tx_commit(struct xlog *log);
 void
 xlog_tx_rollback(struct xlog *log);
 
+/**
+ * Preallocate disk space for the next @a size bytes
+ * written to a log file. The file size is not changed,
+ * so the log can still be read while it is written.
+ * The space which is left unused is released when the
+ * file is closed. Does nothing if the file system doesn't
+ * support preallocation.
+ *
+ * @retval 0 success
+ * @retval -1 error
+ */
+int
+xlog_fallocate(struct xlog *log, size_t size);
+
 /**
  * Flush buffered rows and sync file
  */
@@ -462,6 +504,95 @@ xlog_close(struct xlog *l, bool reuse_fd);
 void
 xlog_atfork(struct xlog *xlog);
 
+/* {{{ xlog_batch - encode xlog tx blocks in memory */
+
+/**
+ * A buffer of rows packed into xlog tx blocks in memory, in
+ * exactly the format xlog_write_row() produces on disk. Lets
+ * several threads encode and compress rows of one log and
+ * leave only the write itself to the thread owning the file.
+ * @sa xlog_write_batch().
+ */
+struct xlog_batch {
+	/** Rows of the tx block being filled. */
+	struct obuf obuf;
+	/** Complete tx blocks, ready to be written. */
+	struct obuf out;
+	/** The context of zstd compression. */
+	ZSTD_CCtx *zctx;
+	/** Compression level for zstd, 0 disables compression. */
+	int compression_level;
+	/** The number of rows in complete tx blocks. */
+	int64_t rows;
+	/** The number of rows in the tx block being filled. */
+	int64_t tx_rows;
+};
+
+/**
+ * Create an empty batch. The buffers are allocated from
+ * the slab cache of the calling cord, so the batch must be
+ * filled, reset and destroyed in the same cord.
+ *
+ * @retval 0 success
+ * @retval -1 error, check diag
+ */
+int
+xlog_batch_create(struct xlog_batch *batch, int compression_level);
+
+void
+xlog_batch_destroy(struct xlog_batch *batch);
+
+/**
+ * Add a row to a batch. Once the tx block being filled
+ * exceeds XLOG_TX_AUTOCOMMIT_THRESHOLD, it is encoded and
+ * appended to the complete blocks.
+ *
+ * @retval -1 error, check diag
+ * @retval >= 0 the number of bytes added to the buffer
+ */
+ssize_t
+xlog_batch_write_row(struct xlog_batch *batch,
+		     const struct xrow_header *packet);
+
+/**
+ * Complete the tx block being filled, if any.
+ *
+ * @retval 0 success
+ * @retval -1 error, check diag
+ */
+int
+xlog_batch_flush(struct xlog_batch *batch);
+
+/** The size of complete tx blocks of a batch, in bytes. */
+static inline size_t
+xlog_batch_size(struct xlog_batch *batch)
+{
+	return obuf_size(&batch->out);
+}
+
+/** Discard complete tx blocks of a batch. */
+static inline void
+xlog_batch_reset(struct xlog_batch *batch)
+{
+	obuf_reset(&batch->out);
+	batch->rows = 0;
+}
+
+/**
+ * Append complete tx blocks of a batch to a log file.
+ * Rows buffered in the log itself are flushed first.
+ * The batch is left intact and may be written from
+ * any thread, as long as its owner doesn't touch it
+ * meanwhile.
+ *
+ * @retval -1 error, check diag
+ * @retval >= 0 the number of bytes written
+ */
+ssize_t
+xlog_write_batch(struct xlog *log, struct xlog_batch *batch);
+
+/* }}} */
+
 /* {{{ xlog_tx_cursor - iterate over rows in xlog transaction */
 
 /**
@@ -524,13 +655,17 @@ xlog_tx_cursor_pos(struct xlog_tx_cursor *tx_cursor)
  * @param data_end the end of @a data buffer
  * @param[out] rows a buffer to store decoded rows
  * @param[out] rows_end the end of @a rows buffer
+ * @param zdctx zstd decompression context
+ * @param zddict zstd dictionary the file was compressed with,
+ *        NULL if none; a tx compressed with a dictionary
+ *        can't be decoded without it
  * @retval  0 success
  * @retval -1 error, check diag
  */
 int
 xlog_tx_decode(const char *data, const char *data_end,
 	       char *rows, char *rows_end,
-	       ZSTD_DStream *zdctx);
+	       ZSTD_DStream *zdctx, const ZSTD_DDict *zddict);
 
 /* }}} */
 
@@ -629,6 +764,22 @@ xlog_cursor_close(struct xlog_cursor *cursor, bool reuse_fd);
 int
 xlog_cursor_next_tx(struct xlog_cursor *cursor);
 
+/**
+ * Read the next tx from xlog without decoding it, so that
+ * it can be decoded elsewhere, e.g. in another thread, with
+ * xlog_tx_cursor_create(). Only the fixheader is checked.
+ * On success, [*data, *data_end) is the tx including its
+ * fixheader. The memory belongs to the cursor and is valid
+ * until the cursor is advanced.
+ *
+ * @retval 0 success
+ * @retval 1 eof
+ * @retval -1 error, check diag
+ */
+int
+xlog_cursor_next_tx_raw(struct xlog_cursor *cursor,
+			const char **data, const char **data_end);
+
 /**
  * Fetch next xrow from current xlog tx
  *
@@ -379,10 +379,18 @@ iproto_reply_map_key(struct obuf *buf, uint32_t size, uint8_t key)
 void
 iproto_reply_select(struct obuf *buf, struct obuf_svp *svp, uint64_t sync,
 		    uint32_t schema_version, uint32_t count)
+{
+	iproto_reply_select_zc(buf, svp, sync, schema_version, count, 0);
+}
+
+void
+iproto_reply_select_zc(struct obuf *buf, struct obuf_svp *svp, uint64_t sync,
+		       uint32_t schema_version, uint32_t count,
+		       size_t data_size)
 {
 	char *pos = (char *) obuf_svp_to_ptr(buf, svp);
 	iproto_header_encode(pos, IPROTO_OK, sync, schema_version,
-			        obuf_size(buf) - svp->used -
+			        obuf_size(buf) - svp->used + data_size -
 				IPROTO_HEADER_LEN);
 
 	struct iproto_body_bin body = iproto_body_bin;
@@ -348,6 +348,16 @@ void
 iproto_reply_select(struct obuf *buf, struct obuf_svp *svp, uint64_t sync,
 		    uint32_t schema_version, uint32_t count);
 
+/**
+ * Same as iproto_reply_select(), but the response body is
+ * followed by @a data_size bytes of tuples which are sent
+ * to the client from outside of @a buf.
+ */
+void
+iproto_reply_select_zc(struct obuf *buf, struct obuf_svp *svp, uint64_t sync,
+		       uint32_t schema_version, uint32_t count,
+		       size_t data_size);
+
 /**
  * Write header of the key to a preallocated buffer by svp.
  * @param buf Buffer to write to.
@@ -76,12 +76,20 @@ histogram_collect(struct histogram *hist, int64_t val);
 void
 histogram_discard(struct histogram *hist, int64_t val);
 
+/**
+ * Add all observations collected by histogram @src to
+ * histogram @dst. Both must have the same bucket boundaries.
+ */
+void
+histogram_merge(struct histogram *dst, const struct histogram *src);
+
 /**
  * Calculate a percentile, i.e. the value below which a given
- * percentage of observations fall.
+ * percentage of observations fall. The percentage may be
+ * fractional, e.g. 99.9.
  */
 int64_t
-histogram_percentile(struct histogram *hist, int pct);
+histogram_percentile(struct histogram *hist, double pct);
 
 /**
  * Print string representation of a histogram.
@@ -76,7 +76,97 @@ bitset_test(struct bitset *bitset, size_t pos)
 
 	assert(page->first_pos <= pos && pos < page->first_pos +
 	       BITSET_PAGE_DATA_SIZE * CHAR_BIT);
-	return bit_test(bitset_page_data(page), pos - page->first_pos);
+	return bitset_page_test(page, pos - page->first_pos);
+}
+
+/**
+ * Replace @a old page in the pages tree with @a page
+ * and free the old one.
+ */
+static void
+bitset_replace_page(struct bitset *bitset, struct bitset_page *old,
+		    struct bitset_page *page)
+{
+	assert(old->first_pos == page->first_pos);
+	assert(old->cardinality == page->cardinality);
+	bitset_pages_remove(&bitset->pages, old);
+	bitset_pages_insert(&bitset->pages, page);
+	bitset_page_destroy(old);
+	bitset->realloc(old, 0);
+	bitset->version++;
+}
+
+/**
+ * Move a full sparse page to an allocation with room for
+ * @a capacity offsets.
+ * @retval the new page
+ * @retval NULL on memory allocation error
+ */
+static struct bitset_page *
+bitset_page_sparse_grow(struct bitset *bitset, struct bitset_page *sparse,
+			uint32_t capacity)
+{
+	assert(capacity > sparse->capacity);
+	size_t size = bitset_page_sparse_alloc_size(capacity);
+	struct bitset_page *page = bitset->realloc(NULL, size);
+	if (page == NULL)
+		return NULL;
+
+	bitset_page_sparse_create(page, capacity);
+	page->first_pos = sparse->first_pos;
+	page->cardinality = sparse->cardinality;
+	memcpy(bitset_page_sparse_data(page), bitset_page_sparse_data(sparse),
+	       sparse->cardinality * sizeof(uint16_t));
+	bitset_replace_page(bitset, sparse, page);
+	return page;
+}
+
+/**
+ * Convert a full sparse page to a bitmap.
+ * @retval the new page
+ * @retval NULL on memory allocation error
+ */
+static struct bitset_page *
+bitset_page_make_dense(struct bitset *bitset, struct bitset_page *sparse)
+{
+	size_t size = bitset_page_alloc_size(bitset->realloc);
+	struct bitset_page *page = bitset->realloc(NULL, size);
+	if (page == NULL)
+		return NULL;
+
+	bitset_page_create(page);
+	page->first_pos = sparse->first_pos;
+	page->cardinality = sparse->cardinality;
+	bitset_page_or(page, sparse);
+	bitset_replace_page(bitset, sparse, page);
+	return page;
+}
+
+/**
+ * Convert a bitmap page with few bits set to a sparse page.
+ * Memory allocation errors are ignored: the page is left
+ * as is then.
+ */
+static void
+bitset_page_make_sparse(struct bitset *bitset, struct bitset_page *dense)
+{
+	assert(dense->cardinality <= BITSET_PAGE_SPARSE_MAX);
+	uint32_t capacity = bitset_page_sparse_capacity(dense->cardinality);
+	size_t size = bitset_page_sparse_alloc_size(capacity);
+	struct bitset_page *page = bitset->realloc(NULL, size);
+	if (page == NULL)
+		return;
+
+	bitset_page_sparse_create(page, capacity);
+	page->first_pos = dense->first_pos;
+	uint16_t *offsets = bitset_page_sparse_data(page);
+	size_t pos;
+	struct bit_iterator it;
+	bit_iterator_init(&it, bitset_page_data(dense),
+			  BITSET_PAGE_DATA_SIZE, true);
+	while ((pos = bit_iterator_next(&it)) != SIZE_MAX)
+		offsets[page->cardinality++] = pos;
+	bitset_replace_page(bitset, dense, page);
 }
 
 int
@@ -88,13 +178,14 @@ bitset_set(struct bitset *bitset, size_t pos)
 	/* Find a page in pages tree */
 	struct bitset_page *page = bitset_pages_search(&bitset->pages, &key);
 	if (page == NULL) {
-		/* Allocate a new page */
-		size_t size = bitset_page_alloc_size(bitset->realloc);
+		/* Allocate a new page, new pages are always sparse */
+		size_t size = bitset_page_sparse_alloc_size(
+				BITSET_PAGE_SPARSE_MIN);
 		page = bitset->realloc(NULL, size);
 		if (page == NULL)
 			return -1;
 
-		bitset_page_create(page);
+		bitset_page_sparse_create(page, BITSET_PAGE_SPARSE_MIN);
 		page->first_pos = key.first_pos;
 
 		/* Insert the page into pages tree */
@@ -103,12 +194,39 @@ bitset_set(struct bitset *bitset, size_t pos)
 
 	assert(page->first_pos <= pos && pos < page->first_pos +
 	       BITSET_PAGE_DATA_SIZE * CHAR_BIT);
-	bool prev = bit_set(bitset_page_data(page), pos - page->first_pos);
+	size_t offset = pos - page->first_pos;
+	if (page->is_sparse) {
+		uint32_t idx;
+		if (bitset_page_sparse_find(page, offset, &idx)) {
+			/* Value has not changed */
+			return 1;
+		}
+		if (page->cardinality == page->capacity &&
+		    page->capacity < BITSET_PAGE_SPARSE_MAX) {
+			page = bitset_page_sparse_grow(bitset, page,
+				bitset_page_sparse_capacity(
+					page->cardinality + 1));
+			if (page == NULL)
+				return -1;
+		}
+		if (page->cardinality < page->capacity) {
+			uint16_t *offsets = bitset_page_sparse_data(page);
+			memmove(offsets + idx + 1, offsets + idx,
+				(page->cardinality - idx) * sizeof(*offsets));
+			offsets[idx] = offset;
+			goto done;
+		}
+		page = bitset_page_make_dense(bitset, page);
+		if (page == NULL)
+			return -1;
+	}
+
+	bool prev = bit_set(bitset_page_data(page), offset);
 	if (prev) {
 		/* Value has not changed */
 		return 1;
 	}
-
+done:
 	bitset->cardinality++;
 	page->cardinality++;
 
@@ -128,9 +246,19 @@ bitset_clear(struct bitset *bitset, size_t pos)
 
 	assert(page->first_pos <= pos && pos < page->first_pos +
 	       BITSET_PAGE_DATA_SIZE * CHAR_BIT);
-	bool prev = bit_clear(bitset_page_data(page), pos - page->first_pos);
-	if (!prev) {
-		return 0;
+	size_t offset = pos - page->first_pos;
+	if (page->is_sparse) {
+		uint32_t idx;
+		if (!bitset_page_sparse_find(page, offset, &idx))
+			return 0;
+		uint16_t *offsets = bitset_page_sparse_data(page);
+		memmove(offsets + idx, offsets + idx + 1,
+			(page->cardinality - idx - 1) * sizeof(*offsets));
+	} else {
+		bool prev = bit_clear(bitset_page_data(page), offset);
+		if (!prev) {
+			return 0;
+		}
 	}
 
 	assert(bitset->cardinality > 0);
@@ -144,6 +272,10 @@ bitset_clear(struct bitset *bitset, size_t pos)
 		/* Free the page */
 		bitset_page_destroy(page);
 		bitset->realloc(page, 0);
+		bitset->version++;
+	} else if (!page->is_sparse &&
+		   page->cardinality <= BITSET_PAGE_SPARSE_MAX / 2) {
+		bitset_page_make_sparse(bitset, page);
 	}
 
 	return 1;
@@ -164,6 +296,13 @@ bitset_info(struct bitset *bitset, struct bitset_info *info)
 	struct bitset_page *page = bitset_pages_first(&bitset->pages);
 	while (page != NULL) {
 		info->pages++;
+		if (page->is_sparse) {
+			info->sparse_pages++;
+			info->mem_used +=
+				bitset_page_sparse_alloc_size(page->capacity);
+		} else {
+			info->mem_used += info->page_total_size;
+		}
 		cardinality_check += page->cardinality;
 		page = bitset_pages_next(&bitset->pages, page);
 	}
@@ -186,6 +325,7 @@ bitset_dump(struct bitset *bitset, int verbose, FILE *stream)
 		info.page_data_size, info.page_total_size);
 	fprintf(stream, "    " "page_bit    = %zu\n", PAGE_BIT);
 	fprintf(stream, "    " "pages       = %zu\n", info.pages);
+	fprintf(stream, "    " "sparse      = %zu\n", info.sparse_pages);
 
 
 	size_t cardinality = bitset_cardinality(bitset);
@@ -204,8 +344,9 @@ bitset_dump(struct bitset *bitset, int verbose, FILE *stream)
 		fprintf(stream, "    "
 			"utilization = undefined\n");
 	}
-	size_t mem_data  = info.page_data_size * info.pages;
-	size_t mem_total = info.page_total_size * info.pages;
+	size_t mem_data  = info.page_data_size *
+			   (info.pages - info.sparse_pages);
+	size_t mem_total = info.mem_used;
 
 	fprintf(stream, "    " "mem_data    = %zu bytes\n", mem_data);
 	fprintf(stream, "    " "mem_total   = %zu bytes "
@@ -234,9 +375,10 @@ bitset_dump(struct bitset *bitset, int verbose, FILE *stream)
 		fprintf(stream, "        " "[%zu, %zu) ",
 			page->first_pos, page_last_pos);
 
-		fprintf(stream, "utilization = %8.4f%% (%zu/%zu)",
+		fprintf(stream, "utilization = %8.4f%% (%zu/%zu)%s",
 			(float) page->cardinality * 1e2 / PAGE_BIT,
-			page->cardinality, PAGE_BIT);
+			(size_t) page->cardinality, PAGE_BIT,
+			page->is_sparse ? " sparse" : "");
 
 		if (verbose < 2) {
 			fprintf(stream, "\n");
@@ -246,6 +388,16 @@ bitset_dump(struct bitset *bitset, int verbose, FILE *stream)
 
 		fprintf(stream, "vals = {");
 
+		if (page->is_sparse) {
+			uint16_t *offsets = bitset_page_sparse_data(page);
+			for (uint32_t i = 0; i < page->cardinality; i++) {
+				fprintf(stream, "%zu, ",
+					page->first_pos + offsets[i]);
+			}
+			fprintf(stream, "}\n");
+			continue;
+		}
+
 		size_t pos = 0;
 		struct bit_iterator it;
 		bit_iterator_init(&it, bitset_page_data(page),
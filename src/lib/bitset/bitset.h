@@ -69,7 +69,14 @@ extern "C" {
 struct bitset_page {
 	size_t first_pos;
 	rb_node(struct bitset_page) node;
-	size_t cardinality;
+	/**
+	 * Set if the page stores a sorted array of offsets
+	 * of set bits instead of a bitmap.
+	 */
+	bool is_sparse;
+	/** Number of offsets a sparse page has room for. */
+	uint16_t capacity;
+	uint32_t cardinality;
 	uint8_t data[0];
 };
 
@@ -83,6 +90,12 @@ struct bitset {
 	/** @cond false */
 	bitset_pages_t pages;
 	size_t cardinality;
+	/**
+	 * Incremented whenever a page is freed or moved to
+	 * a new allocation, so that iterators can tell if the
+	 * page pointers they hold are still valid.
+	 */
+	size_t version;
 	void *(*realloc)(void *ptr, size_t size);
 	/** @endcond */
 };
@@ -151,6 +164,10 @@ bitset_cardinality(const struct bitset *bitset) {
 struct bitset_info {
 	/** Number of allocated pages */
 	size_t pages;
+	/** How many of the allocated pages are sparse */
+	size_t sparse_pages;
+	/** Total size of all pages (in bytes) */
+	size_t mem_used;
 	/** Data (payload) size of one page (in bytes) */
 	size_t page_data_size;
 	/** Full size of one page (in bytes, including padding and tree data) */
@@ -40,6 +40,12 @@ const size_t ITERATOR_CONJ_DEFAULT_CAPACITY = 32;
 
 struct bitset_iterator_conj {
 	size_t page_first_pos;
+	/**
+	 * Sum of versions of the bitsets at the time pages
+	 * were looked up. If it changes, a page may have been
+	 * freed or moved, see bitset_iterator_conj_revalidate().
+	 */
+	size_t version;
 	size_t size;
 	size_t capacity;
 	struct bitset **bitsets;
@@ -231,6 +237,15 @@ bitset_iterator_init(struct bitset_iterator *it, struct bitset_expr *expr,
 	return 0;
 }
 
+static size_t
+bitset_iterator_conj_version(struct bitset_iterator_conj *conj)
+{
+	size_t version = 0;
+	for (size_t b = 0; b < conj->size; b++)
+		version += conj->bitsets[b]->version;
+	return version;
+}
+
 static void
 bitset_iterator_conj_rewind(struct bitset_iterator_conj *conj, size_t pos)
 {
@@ -245,6 +260,7 @@ bitset_iterator_conj_rewind(struct bitset_iterator_conj *conj, size_t pos)
 
 	struct bitset_page key;
 	key.first_pos = pos;
+	conj->version = bitset_iterator_conj_version(conj);
 
 	restart:
 	for (size_t b = 0; b < conj->size; b++) {
@@ -279,6 +295,34 @@ bitset_iterator_conj_rewind(struct bitset_iterator_conj *conj, size_t pos)
 	conj->page_first_pos = key.first_pos;
 }
 
+/**
+ * Look up the pages of the conjunction at conj->page_first_pos
+ * again if the bitsets have been modified since they were
+ * looked up, since the pages may have been freed or moved.
+ *
+ * @retval false if a positive bitset has no page at this
+ *         position anymore, so the conjunction is all zeros
+ */
+static bool
+bitset_iterator_conj_revalidate(struct bitset_iterator_conj *conj)
+{
+	size_t version = bitset_iterator_conj_version(conj);
+	if (version == conj->version)
+		return true;
+	conj->version = version;
+
+	struct bitset_page key;
+	key.first_pos = conj->page_first_pos;
+	bool is_valid = true;
+	for (size_t b = 0; b < conj->size; b++) {
+		conj->pages[b] = bitset_pages_search(&conj->bitsets[b]->pages,
+						     &key);
+		if (conj->pages[b] == NULL && !conj->pre_nots[b])
+			is_valid = false;
+	}
+	return is_valid;
+}
+
 static int
 bitset_iterator_conj_cmp(const void *p1, const void *p2)
 {
@@ -296,37 +340,96 @@ bitset_iterator_conj_cmp(const void *p1, const void *p2)
 	}
 }
 
+/**
+ * Check if conj->pages[b] should be taken into account at
+ * conj->page_first_pos.
+ */
+static inline bool
+bitset_iterator_conj_has_page(struct bitset_iterator_conj *conj, size_t b)
+{
+	if (!conj->pre_nots[b]) {
+		/* conj->pages[b] is rewinded to conj->page_first_pos */
+		assert(conj->pages[b]->first_pos == conj->page_first_pos);
+		return true;
+	}
+	/*
+	 * If page is NULL or its position is not equal
+	 * to conj->page_first_pos then conj->bitset[b]
+	 * does not have page with the required position and
+	 * all bits in this page are considered to be zeros.
+	 * Since NAND(a, zeros) => a, we can simple skip this
+	 * bitset here.
+	 */
+	return conj->pages[b] != NULL &&
+	       conj->pages[b]->first_pos == conj->page_first_pos;
+}
+
+/**
+ * Evaluate the conjunction at conj->page_first_pos and OR
+ * the result with @a dst.
+ *
+ * The result can't have more bits set than the smallest
+ * positive page of the conjunction. If that page is sparse,
+ * only its bits are checked against the other pages.
+ * Otherwise the pages are combined word by word in @a tmp.
+ */
 static void
-bitset_iterator_conj_prepare_page(struct bitset_iterator_conj *conj,
-				  struct bitset_page *dst)
+bitset_iterator_conj_or_page(struct bitset_iterator_conj *conj,
+			     struct bitset_page *dst,
+			     struct bitset_page *tmp)
 {
 	assert(conj != NULL);
 	assert(dst != NULL);
 	assert(conj->size > 0);
 	assert(conj->page_first_pos != SIZE_MAX);
 
-	bitset_page_set_ones(dst);
+	if (!bitset_iterator_conj_revalidate(conj))
+		return;
+
+	struct bitset_page *min = NULL;
 	for (size_t b = 0; b < conj->size; b++) {
-		if (!conj->pre_nots[b]) {
-			/* conj->pages[b] is rewinded to conj->page_first_pos */
-			assert(conj->pages[b]->first_pos == conj->page_first_pos);
-			bitset_page_and(dst, conj->pages[b]);
-		} else {
-			/*
-			 * If page is NULL or its position is not equal
-			 * to conj->page_first_pos then conj->bitset[b]
-			 * does not have page with the required position and
-			 * all bits in this page are considered to be zeros.
-			 * Since NAND(a, zeros) => a, we can simple skip this
-			 * bitset here.
-			 */
-			if (conj->pages[b] == NULL ||
-			    conj->pages[b]->first_pos != conj->page_first_pos)
-				continue;
-
-			bitset_page_nand(dst, conj->pages[b]);
+		if (conj->pre_nots[b])
+			continue;
+		assert(conj->pages[b]->first_pos == conj->page_first_pos);
+		if (min == NULL ||
+		    conj->pages[b]->cardinality < min->cardinality)
+			min = conj->pages[b];
+	}
+
+	if (min != NULL && min->is_sparse) {
+		uint16_t *offsets = bitset_page_sparse_data(min);
+		void *data = bitset_page_data(dst);
+		for (uint32_t i = 0; i < min->cardinality; i++) {
+			size_t b;
+			for (b = 0; b < conj->size; b++) {
+				if (conj->pages[b] == min ||
+				    !bitset_iterator_conj_has_page(conj, b))
+					continue;
+				bool is_set = bitset_page_test(conj->pages[b],
+							       offsets[i]);
+				if (is_set == conj->pre_nots[b])
+					break;
+			}
+			if (b == conj->size)
+				bit_set(data, offsets[i]);
 		}
+		return;
+	}
+
+	if (min != NULL)
+		bitset_page_copy(tmp, min);
+	else
+		bitset_page_set_ones(tmp);
+	for (size_t b = 0; b < conj->size; b++) {
+		if (conj->pages[b] == min ||
+		    !bitset_iterator_conj_has_page(conj, b))
+			continue;
+		if (!conj->pre_nots[b])
+			bitset_page_and(tmp, conj->pages[b]);
+		else
+			bitset_page_nand(tmp, conj->pages[b]);
 	}
+	bitset_page_or(dst, tmp);
 }
 
 static void
@@ -351,10 +454,9 @@ bitset_iterator_prepare_page(struct bitset_iterator *it)
 		if (it->conjs[c].page_first_pos > it->page->first_pos)
 			break;
 
-		/* Get result from conj */
-		bitset_iterator_conj_prepare_page(&it->conjs[c], it->page_tmp);
-		/* OR page from conjunction with it->page */
-		bitset_page_or(it->page, it->page_tmp);
+		/* OR result from conj with it->page */
+		bitset_iterator_conj_or_page(&it->conjs[c], it->page,
+					     it->page_tmp);
 	}
 
 	/* Init the bit iterator on it->page */
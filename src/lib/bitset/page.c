@@ -44,6 +44,24 @@ bitset_page_create(struct bitset_page *page);
 extern inline void
 bitset_page_destroy(struct bitset_page *page);
 
+extern inline uint32_t
+bitset_page_sparse_capacity(uint32_t cardinality);
+
+extern inline size_t
+bitset_page_sparse_alloc_size(uint32_t capacity);
+
+extern inline uint16_t *
+bitset_page_sparse_data(struct bitset_page *page);
+
+extern inline void
+bitset_page_sparse_create(struct bitset_page *page, uint32_t capacity);
+
+extern inline bool
+bitset_page_sparse_find(struct bitset_page *page, size_t pos, uint32_t *idx);
+
+extern inline bool
+bitset_page_test(struct bitset_page *page, size_t pos);
+
 extern inline size_t
 bitset_page_first_pos(size_t pos);
 
@@ -53,6 +71,9 @@ bitset_page_set_zeros(struct bitset_page *page);
 extern inline void
 bitset_page_set_ones(struct bitset_page *page);
 
+extern inline void
+bitset_page_copy(struct bitset_page *dst, struct bitset_page *src);
+
 extern inline void
 bitset_page_and(struct bitset_page *dst, struct bitset_page *src);
 
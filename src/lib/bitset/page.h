@@ -55,7 +55,19 @@ extern "C" {
 
 enum {
 	/** How many bytes to store in one page */
-	BITSET_PAGE_DATA_SIZE = 160
+	BITSET_PAGE_DATA_SIZE = 160,
+	/**
+	 * Max number of bits set in a sparse page. A sparse
+	 * page stores offsets of set bits in a sorted array
+	 * instead of a bitmap. The array grows with the page
+	 * cardinality and takes as much memory as the bitmap
+	 * when it has this many offsets. A page is converted
+	 * to a bitmap when it gets more bits set and back when
+	 * the number of set bits drops to half of this value.
+	 */
+	BITSET_PAGE_SPARSE_MAX = BITSET_PAGE_DATA_SIZE / sizeof(uint16_t),
+	/** Initial number of offsets a sparse page has room for. */
+	BITSET_PAGE_SPARSE_MIN = 4,
 };
 
 #if defined(ENABLE_AVX)
@@ -128,6 +140,80 @@ bitset_page_destroy(struct bitset_page *page)
 	/* nothing */
 }
 
+/**
+ * Return the capacity of a sparse page that stores
+ * @a cardinality offsets: the next power of two capped
+ * by BITSET_PAGE_SPARSE_MAX.
+ */
+inline uint32_t
+bitset_page_sparse_capacity(uint32_t cardinality)
+{
+	assert(cardinality <= BITSET_PAGE_SPARSE_MAX);
+	uint32_t capacity = BITSET_PAGE_SPARSE_MIN;
+	while (capacity < cardinality)
+		capacity *= 2;
+	return capacity < BITSET_PAGE_SPARSE_MAX ?
+	       capacity : BITSET_PAGE_SPARSE_MAX;
+}
+
+inline size_t
+bitset_page_sparse_alloc_size(uint32_t capacity)
+{
+	assert(capacity <= BITSET_PAGE_SPARSE_MAX);
+	return sizeof(struct bitset_page) + capacity * sizeof(uint16_t);
+}
+
+inline uint16_t *
+bitset_page_sparse_data(struct bitset_page *page)
+{
+	assert(page->is_sparse);
+	return (uint16_t *) page->data;
+}
+
+inline void
+bitset_page_sparse_create(struct bitset_page *page, uint32_t capacity)
+{
+	memset(page, 0, bitset_page_sparse_alloc_size(capacity));
+	page->is_sparse = true;
+	page->capacity = capacity;
+}
+
+/**
+ * Find offset @a pos in a sparse page.
+ * @param[out] idx index of the offset in the array if found,
+ *             otherwise the index to insert it at
+ * @retval true if the bit is set
+ */
+inline bool
+bitset_page_sparse_find(struct bitset_page *page, size_t pos, uint32_t *idx)
+{
+	uint16_t *offsets = bitset_page_sparse_data(page);
+	uint32_t begin = 0, end = page->cardinality;
+	while (begin < end) {
+		uint32_t mid = begin + (end - begin) / 2;
+		if (offsets[mid] < pos)
+			begin = mid + 1;
+		else
+			end = mid;
+	}
+	*idx = begin;
+	return begin < page->cardinality && offsets[begin] == pos;
+}
+
+/**
+ * Test bit @a pos of a page of any kind.
+ * @param pos bit offset from the page start
+ */
+inline bool
+bitset_page_test(struct bitset_page *page, size_t pos)
+{
+	if (page->is_sparse) {
+		uint32_t idx;
+		return bitset_page_sparse_find(page, pos, &idx);
+	}
+	return bit_test(bitset_page_data(page), pos);
+}
+
 inline size_t
 bitset_page_first_pos(size_t pos) {
 	return pos - (pos % (BITSET_PAGE_DATA_SIZE * CHAR_BIT));
@@ -147,9 +233,39 @@ bitset_page_set_ones(struct bitset_page *page)
 	memset(data, -1, BITSET_PAGE_DATA_SIZE);
 }
 
+inline void
+bitset_page_copy(struct bitset_page *dst, struct bitset_page *src)
+{
+	assert(!src->is_sparse);
+	memcpy(bitset_page_data(dst), bitset_page_data(src),
+	       BITSET_PAGE_DATA_SIZE);
+}
+
+/*
+ * Page kernels. The destination page is always a bitmap.
+ * Bitmaps are processed a SIMD word at a time, see
+ * bitset_word_t, sparse pages - an offset at a time.
+ */
+
 inline void
 bitset_page_and(struct bitset_page *dst, struct bitset_page *src)
 {
+	if (src->is_sparse) {
+		/* Only the bits set in src may survive. */
+		uint16_t *offsets = bitset_page_sparse_data(src);
+		uint16_t kept[BITSET_PAGE_SPARSE_MAX];
+		uint32_t count = 0;
+		void *data = bitset_page_data(dst);
+		for (uint32_t i = 0; i < src->cardinality; i++) {
+			if (bit_test(data, offsets[i]))
+				kept[count++] = offsets[i];
+		}
+		bitset_page_set_zeros(dst);
+		for (uint32_t i = 0; i < count; i++)
+			bit_set(data, kept[i]);
+		return;
+	}
+
 	bitset_word_t *d = (bitset_word_t *) bitset_page_data(dst);
 	bitset_word_t *s = (bitset_word_t *) bitset_page_data(src);
 
@@ -163,6 +279,14 @@ bitset_page_and(struct bitset_page *dst, struct bitset_page *src)
 inline void
 bitset_page_nand(struct bitset_page *dst, struct bitset_page *src)
 {
+	if (src->is_sparse) {
+		uint16_t *offsets = bitset_page_sparse_data(src);
+		void *data = bitset_page_data(dst);
+		for (uint32_t i = 0; i < src->cardinality; i++)
+			bit_clear(data, offsets[i]);
+		return;
+	}
+
 	bitset_word_t *d = (bitset_word_t *) bitset_page_data(dst);
 	bitset_word_t *s = (bitset_word_t *) bitset_page_data(src);
 
@@ -176,6 +300,14 @@ bitset_page_nand(struct bitset_page *dst, struct bitset_page *src)
 inline void
 bitset_page_or(struct bitset_page *dst, struct bitset_page *src)
 {
+	if (src->is_sparse) {
+		uint16_t *offsets = bitset_page_sparse_data(src);
+		void *data = bitset_page_data(dst);
+		for (uint32_t i = 0; i < src->cardinality; i++)
+			bit_set(data, offsets[i]);
+		return;
+	}
+
 	bitset_word_t *d = (bitset_word_t *) bitset_page_data(dst);
 	bitset_word_t *s = (bitset_word_t *) bitset_page_data(src);
 
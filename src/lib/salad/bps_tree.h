@@ -274,6 +274,17 @@
 #error "BPS_TREE_COMPARE_KEY must be defined"
 #endif
 
+/**
+ * Function to check that two elements are the same element,
+ * used only by the debug checks. Defaults to operator ==,
+ * a tree of structures must define it.
+ * Examples:
+ * #define BPS_TREE_IS_IDENTICAL(a, b) ((a).ptr == (b).ptr)
+ */
+#ifndef BPS_TREE_IS_IDENTICAL
+#define BPS_TREE_IS_IDENTICAL(a, b) ((a) == (b))
+#endif
+
 /**
  * A switch to define the type of search in an array elements.
  * By default, bps_tree uses binary search to find a particular
@@ -4592,7 +4603,8 @@ bps_tree_debug_check_block(const struct bps_tree *tree, struct bps_block *block,
 						       inner->child_ids[i]);
 			bps_tree_elem_t calc_max_elem =
 				bps_tree_debug_find_max_elem(tree, tmp_block);
-			if (inner->elems[i] != calc_max_elem)
+			if (!BPS_TREE_IS_IDENTICAL(inner->elems[i],
+						   calc_max_elem))
 				result |= 0x4000;
 		}
 		if (block->size > 1) {
@@ -4651,7 +4663,8 @@ bps_tree_debug_check(const struct bps_tree *tree)
 		return result;
 	}
 	struct bps_block *root = bps_tree_root(tree);
-	if (tree->max_elem != bps_tree_debug_find_max_elem(tree, root))
+	if (!BPS_TREE_IS_IDENTICAL(tree->max_elem,
+				   bps_tree_debug_find_max_elem(tree, root)))
 		result |= 0x8;
 	size_t calc_count = 0;
 	bps_tree_block_id_t expected_prev_id = (bps_tree_block_id_t)(-1);
@@ -5017,12 +5030,14 @@ bps_tree_debug_check_move_to_right_leaf(struct bps_tree *tree, bool assertme)
 				}
 
 				if (a.header.size)
-					if (ma != a.elems[a.header.size - 1]) {
+					if (!BPS_TREE_IS_IDENTICAL(ma,
+						a.elems[a.header.size - 1])) {
 						result |= (1 << 5);
 						assert(!assertme);
 					}
 				if (b.header.size)
-					if (mb != b.elems[b.header.size - 1]) {
+					if (!BPS_TREE_IS_IDENTICAL(mb,
+						b.elems[b.header.size - 1])) {
 						result |= (1 << 5);
 						assert(!assertme);
 					}
@@ -5114,12 +5129,14 @@ bps_tree_debug_check_move_to_left_leaf(struct bps_tree *tree, bool assertme)
 				}
 
 				if (a.header.size)
-					if (ma != a.elems[a.header.size - 1]) {
+					if (!BPS_TREE_IS_IDENTICAL(ma,
+						a.elems[a.header.size - 1])) {
 						result |= (1 << 7);
 						assert(!assertme);
 					}
 				if (b.header.size)
-					if (mb != b.elems[b.header.size - 1]) {
+					if (!BPS_TREE_IS_IDENTICAL(mb,
+						b.elems[b.header.size - 1])) {
 						result |= (1 << 7);
 						assert(!assertme);
 					}
@@ -5225,16 +5242,16 @@ bps_tree_debug_check_insert_and_move_to_right_leaf(struct bps_tree *tree,
 					}
 
 					if (i - u + 1)
-						if (ma
-							!= a.elems[a.header.size
-								- 1]) {
+						if (!BPS_TREE_IS_IDENTICAL(ma,
+							a.elems[a.header.size
+								- 1])) {
 							result |= (1 << 9);
 							assert(!assertme);
 						}
 					if (j + u)
-						if (mb
-							!= b.elems[b.header.size
-								- 1]) {
+						if (!BPS_TREE_IS_IDENTICAL(mb,
+							b.elems[b.header.size
+								- 1])) {
 							result |= (1 << 9);
 							assert(!assertme);
 						}
@@ -5341,16 +5358,16 @@ bps_tree_debug_check_insert_and_move_to_left_leaf(struct bps_tree *tree,
 					}
 
 					if (i + u)
-						if (ma
-							!= a.elems[a.header.size
-								- 1]) {
+						if (!BPS_TREE_IS_IDENTICAL(ma,
+							a.elems[a.header.size
+								- 1])) {
 							result |= (1 << 11);
 							assert(!assertme);
 						}
 					if (j - u + 1)
-						if (mb
-							!= b.elems[b.header.size
-								- 1]) {
+						if (!BPS_TREE_IS_IDENTICAL(mb,
+							b.elems[b.header.size
+								- 1])) {
 							result |= (1 << 11);
 							assert(!assertme);
 						}
@@ -6126,4 +6143,5 @@ bps_tree_debug_check_internal_functions(bool assertme)
 #undef bps_tree_debug_check_move_to_left_inner
 #undef bps_tree_debug_check_insert_and_move_to_right_inner
 #undef bps_tree_debug_check_insert_and_move_to_left_inner
+#undef BPS_TREE_IS_IDENTICAL
 /* }}} */
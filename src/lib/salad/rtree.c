@@ -32,8 +32,10 @@
 #include <string.h>
 #include <assert.h>
 #include <limits.h>
+#include <math.h>
 #include <stddef.h>
 #include <sys/types.h>
+#include "third_party/qsort_arg.h"
 
 /*------------------------------------------------------------------------- */
 /* R-tree internal structures definition */
@@ -42,7 +44,7 @@ enum {
 	/* rtree will try to determine optimal page size */
 	RTREE_OPTIMAL_BRANCHES_IN_PAGE = 18,
 	/* actual number of branches could be up to double of the previous
-	 * constant */
+	 * constant; pages of trees with narrow coordinates are capped */
 	RTREE_MAXIMUM_BRANCHES_IN_PAGE = RTREE_OPTIMAL_BRANCHES_IN_PAGE * 2
 };
 
@@ -51,11 +53,12 @@ struct rtree_page_branch {
 		struct rtree_page *page;
 		record_t record;
 	} data;
-	struct rtree_rect rect;
+	/* Only tree->dimension * 2 coordinates are stored */
+	union rtree_box box;
 };
 
 enum {
-	RTREE_BRANCH_DATA_SIZE = offsetof(struct rtree_page_branch, rect)
+	RTREE_BRANCH_DATA_SIZE = offsetof(struct rtree_page_branch, box)
 };
 
 struct rtree_page {
@@ -256,86 +259,239 @@ rtree_rect_intersection(const struct rtree_rect *item1,
 	}
 }
 
-static bool
-rtree_rect_intersects_rect(const struct rtree_rect *rt1,
-			   const struct rtree_rect *rt2,
-			   unsigned dimension)
+/*------------------------------------------------------------------------- */
+/* R-tree box methods */
+/*------------------------------------------------------------------------- */
+
+/*
+ * Convert a coordinate to int32 rounding it down (if is_upper
+ * is false) or up (if is_upper is true). Out of range values
+ * saturate at the type bounds.
+ */
+static int32_t
+rtree_coord_to_int32(coord_t c, bool is_upper)
 {
-	for (int i = dimension; --i >= 0; ) {
-		const coord_t *coords1 = &rt1->coords[2 * i];
-		const coord_t *coords2 = &rt2->coords[2 * i];
-		if (coords1[0] > coords2[1] || coords1[1] < coords2[0])
-			return false;
-	}
-	return true;
+	c = is_upper ? ceil(c) : floor(c);
+	if (c >= INT32_MAX)
+		return INT32_MAX;
+	if (!(c > INT32_MIN))
+		return INT32_MIN;
+	return (int32_t)c;
 }
 
-static bool
-rtree_rect_in_rect(const struct rtree_rect *rt1,
-		   const struct rtree_rect *rt2,
-		   unsigned dimension)
+/*
+ * Convert a coordinate to float rounding it down (if is_upper
+ * is false) or up (if is_upper is true).
+ */
+static float
+rtree_coord_to_float(coord_t c, bool is_upper)
 {
-	for (int i = dimension; --i >= 0; ) {
-		const coord_t *coords1 = &rt1->coords[2 * i];
-		const coord_t *coords2 = &rt2->coords[2 * i];
-		if (coords1[0] < coords2[0] || coords1[1] > coords2[1])
-			return false;
-	}
-	return true;
+	float f = (float)c;
+	if (is_upper && f < c)
+		f = nextafterf(f, INFINITY);
+	else if (!is_upper && f > c)
+		f = nextafterf(f, -INFINITY);
+	return f;
 }
 
-static bool
-rtree_rect_strict_in_rect(const struct rtree_rect *rt1,
-			  const struct rtree_rect *rt2,
-			  unsigned dimension)
+/*
+ * Store a rectangle in the tree coordinate type. The box is
+ * rounded outward, so that it covers the rectangle: the lower
+ * bounds are rounded down and the upper bounds are rounded up.
+ */
+static void
+rtree_box_set(const struct rtree *tree, union rtree_box *box,
+	      const struct rtree_rect *rect)
 {
-	for (int i = dimension; --i >= 0; ) {
-		const coord_t *coords1 = &rt1->coords[2 * i];
-		const coord_t *coords2 = &rt2->coords[2 * i];
-		if (coords1[0] <= coords2[0] || coords1[1] >= coords2[1])
-			return false;
+	unsigned n = tree->dimension * 2;
+	switch (tree->coord_type) {
+	case RTREE_COORD_DOUBLE:
+		for (unsigned i = 0; i < n; i++)
+			box->d[i] = rect->coords[i];
+		break;
+	case RTREE_COORD_FLOAT:
+		for (unsigned i = 0; i < n; i++)
+			box->f[i] = rtree_coord_to_float(rect->coords[i],
+							 i % 2 != 0);
+		break;
+	case RTREE_COORD_INT32:
+		for (unsigned i = 0; i < n; i++)
+			box->i[i] = rtree_coord_to_int32(rect->coords[i],
+							 i % 2 != 0);
+		break;
 	}
-	return true;
 }
 
-static bool
-rtree_rect_holds_rect(const struct rtree_rect *rt1,
-		      const struct rtree_rect *rt2,
-		      unsigned dimension)
+/* Load a stored box to a rectangle */
+static void
+rtree_box_get(const struct rtree *tree, const union rtree_box *box,
+	      struct rtree_rect *rect)
 {
-	return rtree_rect_in_rect(rt2, rt1, dimension);
+	unsigned n = tree->dimension * 2;
+	switch (tree->coord_type) {
+	case RTREE_COORD_DOUBLE:
+		for (unsigned i = 0; i < n; i++)
+			rect->coords[i] = box->d[i];
+		break;
+	case RTREE_COORD_FLOAT:
+		for (unsigned i = 0; i < n; i++)
+			rect->coords[i] = box->f[i];
+		break;
+	case RTREE_COORD_INT32:
+		for (unsigned i = 0; i < n; i++)
+			rect->coords[i] = box->i[i];
+		break;
+	}
 }
 
-static bool
-rtree_rect_strict_holds_rect(const struct rtree_rect *rt1,
-			     const struct rtree_rect *rt2,
-			     unsigned dimension)
+/* Get a single coordinate of a stored box */
+static coord_t
+rtree_box_coord(const struct rtree *tree, const union rtree_box *box,
+		unsigned i)
 {
-	return rtree_rect_strict_in_rect(rt2, rt1, dimension);
+	switch (tree->coord_type) {
+	case RTREE_COORD_FLOAT:
+		return box->f[i];
+	case RTREE_COORD_INT32:
+		return box->i[i];
+	default:
+		return box->d[i];
+	}
 }
 
-static bool
-rtree_rect_equal_to_rect(const struct rtree_rect *rt1,
-			 const struct rtree_rect *rt2,
-			 unsigned dimension)
+/*
+ * Box comparison kernels, one set per coordinate type. They work
+ * on stored boxes directly, a search rectangle is converted to the
+ * tree coordinate type once. A kernel checks a condition on every
+ * axis; 2D boxes are checked without loops and branches, so that
+ * the compiler can use packed comparisons.
+ */
+#define RTREE_BOX_INTERSECTS(c1, c2, i) \
+	(!((c1[i] > c2[i + 1]) | (c1[i + 1] < c2[i])))
+#define RTREE_BOX_IN(c1, c2, i) \
+	(!((c1[i] < c2[i]) | (c1[i + 1] > c2[i + 1])))
+#define RTREE_BOX_STRICT_IN(c1, c2, i) \
+	(!((c1[i] <= c2[i]) | (c1[i + 1] >= c2[i + 1])))
+#define RTREE_BOX_EQUAL(c1, c2, i) \
+	((c1[i] == c2[i]) & (c1[i + 1] == c2[i + 1]))
+
+#define RTREE_BOX_KERNEL_DEF(name, m, cond)				\
+static bool								\
+rtree_box_##name##_##m(const union rtree_box *b1,			\
+		       const union rtree_box *b2, unsigned dimension)	\
+{									\
+	if (dimension == 2)						\
+		return cond(b1->m, b2->m, 0) & cond(b1->m, b2->m, 2);	\
+	for (unsigned i = 0; i < dimension * 2; i += 2) {		\
+		if (!cond(b1->m, b2->m, i))				\
+			return false;					\
+	}								\
+	return true;							\
+}
+
+#define RTREE_BOX_KERNELS_DEF(m)					\
+RTREE_BOX_KERNEL_DEF(intersects, m, RTREE_BOX_INTERSECTS)		\
+RTREE_BOX_KERNEL_DEF(in, m, RTREE_BOX_IN)				\
+RTREE_BOX_KERNEL_DEF(strict_in, m, RTREE_BOX_STRICT_IN)		\
+RTREE_BOX_KERNEL_DEF(equal, m, RTREE_BOX_EQUAL)			\
+									\
+static bool								\
+rtree_box_holds_##m(const union rtree_box *b1,				\
+		    const union rtree_box *b2, unsigned dimension)	\
+{									\
+	return rtree_box_in_##m(b2, b1, dimension);			\
+}									\
+									\
+static bool								\
+rtree_box_strict_holds_##m(const union rtree_box *b1,			\
+			   const union rtree_box *b2,			\
+			   unsigned dimension)				\
+{									\
+	return rtree_box_strict_in_##m(b2, b1, dimension);		\
+}
+
+RTREE_BOX_KERNELS_DEF(d)
+RTREE_BOX_KERNELS_DEF(f)
+RTREE_BOX_KERNELS_DEF(i)
+
+bool
+rtree_rect_match(const struct rtree_rect *rect, const struct rtree_rect *key,
+		 enum spatial_search_op op, unsigned dimension)
 {
-	for (int i = dimension * 2; --i >= 0; )
-		if (rt1->coords[i] != rt2->coords[i])
+	const coord_t *r = rect->coords;
+	const coord_t *k = key->coords;
+	for (unsigned i = 0; i < dimension * 2; i += 2) {
+		bool match;
+		switch (op) {
+		case SOP_EQUALS:
+			match = RTREE_BOX_EQUAL(k, r, i);
+			break;
+		case SOP_CONTAINS:
+			match = RTREE_BOX_IN(k, r, i);
+			break;
+		case SOP_STRICT_CONTAINS:
+			match = RTREE_BOX_STRICT_IN(k, r, i);
+			break;
+		case SOP_OVERLAPS:
+			match = RTREE_BOX_INTERSECTS(k, r, i);
+			break;
+		case SOP_BELONGS:
+			match = RTREE_BOX_IN(r, k, i);
+			break;
+		case SOP_STRICT_BELONGS:
+			match = RTREE_BOX_STRICT_IN(r, k, i);
+			break;
+		default:
+			return true;
+		}
+		if (!match)
 			return false;
+	}
 	return true;
 }
 
+#undef RTREE_BOX_KERNELS_DEF
+#undef RTREE_BOX_KERNEL_DEF
+#undef RTREE_BOX_EQUAL
+#undef RTREE_BOX_STRICT_IN
+#undef RTREE_BOX_IN
+#undef RTREE_BOX_INTERSECTS
+
 static bool
-rtree_always_true(const struct rtree_rect *rt1,
-		  const struct rtree_rect *rt2,
-		  unsigned dimension)
+rtree_box_always_true(const union rtree_box *b1,
+		      const union rtree_box *b2,
+		      unsigned dimension)
 {
-	(void) rt1;
-	(void) rt2;
+	(void) b1;
+	(void) b2;
 	(void) dimension;
 	return true;
 }
 
+/* Box comparison kernels for a coordinate type */
+struct rtree_box_ops {
+	rtree_comparator_t intersects;
+	rtree_comparator_t in;
+	rtree_comparator_t strict_in;
+	rtree_comparator_t holds;
+	rtree_comparator_t strict_holds;
+	rtree_comparator_t equal;
+};
+
+#define RTREE_BOX_OPS(m) {						\
+	rtree_box_intersects_##m, rtree_box_in_##m,			\
+	rtree_box_strict_in_##m, rtree_box_holds_##m,			\
+	rtree_box_strict_holds_##m, rtree_box_equal_##m			\
+}
+
+static const struct rtree_box_ops rtree_box_ops[] = {
+	/* [RTREE_COORD_DOUBLE] = */ RTREE_BOX_OPS(d),
+	/* [RTREE_COORD_FLOAT]  = */ RTREE_BOX_OPS(f),
+	/* [RTREE_COORD_INT32]  = */ RTREE_BOX_OPS(i),
+};
+
+#undef RTREE_BOX_OPS
+
 /*------------------------------------------------------------------------- */
 /* R-tree page methods */
 /*------------------------------------------------------------------------- */
@@ -371,11 +527,11 @@ rtree_branch_get(const struct rtree *tree, const struct rtree_page *page,
 }
 
 static void
-rtree_branch_copy(struct rtree_page_branch *to,
-		  const struct rtree_page_branch *from, unsigned dimension)
+rtree_branch_copy(const struct rtree *tree, struct rtree_page_branch *to,
+		  const struct rtree_page_branch *from)
 {
 	to->data = from->data;
-	rtree_rect_copy(&to->rect, &from->rect, dimension);
+	memcpy(&to->box, &from->box, tree->dimension * 2 * tree->coord_size);
 }
 
 
@@ -402,14 +558,25 @@ static void
 rtree_page_cover(const struct rtree *tree, const struct rtree_page *page,
 		 struct rtree_rect *res)
 {
-	rtree_rect_copy(res, &rtree_branch_get(tree, page, 0)->rect,
-			tree->dimension);
+	rtree_box_get(tree, &rtree_branch_get(tree, page, 0)->box, res);
 	for (unsigned i = 1; i < page->n; i++) {
-		rtree_rect_add(res, &rtree_branch_get(tree, page, i)->rect,
-			       tree->dimension);
+		struct rtree_rect rect;
+		rtree_box_get(tree, &rtree_branch_get(tree, page, i)->box,
+			      &rect);
+		rtree_rect_add(res, &rect, tree->dimension);
 	}
 }
 
+/* Set the box of a branch to the cover of a page */
+static void
+rtree_branch_set_cover(const struct rtree *tree, struct rtree_page_branch *b,
+		       const struct rtree_page *page)
+{
+	struct rtree_rect cover;
+	rtree_page_cover(tree, page, &cover);
+	rtree_box_set(tree, &b->box, &cover);
+}
+
 /* Create root page by first inserting record */
 static void
 rtree_page_init_with_record(const struct rtree *tree, struct rtree_page *page,
@@ -417,7 +584,7 @@ rtree_page_init_with_record(const struct rtree *tree, struct rtree_page *page,
 {
 	struct rtree_page_branch *b = rtree_branch_get(tree, page, 0);
 	page->n = 1;
-	rtree_rect_copy(&b->rect, rect, tree->dimension);
+	rtree_box_set(tree, &b->box, rect);
 	b->data.record = obj;
 }
 
@@ -428,10 +595,10 @@ rtree_page_init_with_pages(const struct rtree *tree, struct rtree_page *page,
 {
 	page->n = 2;
 	struct rtree_page_branch *b = rtree_branch_get(tree, page, 0);
-	rtree_page_cover(tree, page1, &b->rect);
+	rtree_branch_set_cover(tree, b, page1);
 	b->data.page = page1;
 	b = rtree_branch_get(tree, page, 1);
-	rtree_page_cover(tree, page2, &b->rect);
+	rtree_branch_set_cover(tree, b, page2);
 	b->data.page = page2;
 }
 
@@ -440,13 +607,13 @@ rtree_split_page(struct rtree *tree, struct rtree_page *page,
 		 const struct rtree_page_branch *br)
 {
 	assert(page->n == tree->page_max_fill);
-	const struct rtree_rect *rects[RTREE_MAXIMUM_BRANCHES_IN_PAGE + 1];
+	struct rtree_rect rects[RTREE_MAXIMUM_BRANCHES_IN_PAGE + 1];
 	unsigned ids[RTREE_MAXIMUM_BRANCHES_IN_PAGE + 1];
-	rects[0] = &br->rect;
+	rtree_box_get(tree, &br->box, &rects[0]);
 	ids[0] = 0;
 	for (unsigned i = 0; i < page->n; i++) {
 		struct rtree_page_branch *b = rtree_branch_get(tree, page, i);
-		rects[i + 1] = &b->rect;
+		rtree_box_get(tree, &b->box, &rects[i + 1]);
 		ids[i + 1] = i + 1;
 	}
 	const unsigned n = page->n + 1;
@@ -457,11 +624,11 @@ rtree_split_page(struct rtree *tree, struct rtree_page *page,
 	for (unsigned a = 0; a < d; a++) {
 		for (unsigned i = 0; i < n - 1; i++) {
 			unsigned min_i = i;
-			coord_t min_l = rects[ids[i]]->coords[2 * a];
-			coord_t min_r = rects[ids[i]]->coords[2 * a + 1];
+			coord_t min_l = rects[ids[i]].coords[2 * a];
+			coord_t min_r = rects[ids[i]].coords[2 * a + 1];
 			for (unsigned j = i + 1; j < n; j++) {
-				coord_t l = rects[ids[j]]->coords[2 * a];
-				coord_t r = rects[ids[j]]->coords[2 * a + 1];
+				coord_t l = rects[ids[j]].coords[2 * a];
+				coord_t r = rects[ids[j]].coords[2 * a + 1];
 				if (l < min_l || (l == min_l && r < min_r)) {
 					min_i = j;
 					min_l = l;
@@ -476,17 +643,17 @@ rtree_split_page(struct rtree *tree, struct rtree_page *page,
 		coord_t dir_hm[RTREE_MAXIMUM_BRANCHES_IN_PAGE + 1];
 		coord_t rev_hm[RTREE_MAXIMUM_BRANCHES_IN_PAGE + 1];
 		dir_hm[0] = 0;
-		rtree_rect_copy(&test_rect, rects[ids[0]], d);
+		rtree_rect_copy(&test_rect, &rects[ids[0]], d);
 		dir_hm[1] = rtree_rect_half_margin(&test_rect, d);
 		for (unsigned i = 1; i < n - tree->page_min_fill; i++) {
-			rtree_rect_add(&test_rect, rects[ids[i]], d);
+			rtree_rect_add(&test_rect, &rects[ids[i]], d);
 			dir_hm[i + 1] = rtree_rect_half_margin(&test_rect, d);
 		}
 		rev_hm[0] = 0;
-		rtree_rect_copy(&test_rect, rects[ids[n - 1]], d);
+		rtree_rect_copy(&test_rect, &rects[ids[n - 1]], d);
 		rev_hm[1] = rtree_rect_half_margin(&test_rect, d);
 		for (unsigned i = 1; i < n - tree->page_min_fill; i++) {
-			rtree_rect_add(&test_rect, rects[ids[n - i - 1]], d);
+			rtree_rect_add(&test_rect, &rects[ids[n - i - 1]], d);
 			rev_hm[i + 1] = rtree_rect_half_margin(&test_rect, d);
 		}
 		coord_t s = 0;
@@ -503,11 +670,11 @@ rtree_split_page(struct rtree *tree, struct rtree_page *page,
 	unsigned a = best_axis;
 	for (unsigned i = 0; i < n - 1; i++) {
 		unsigned min_i = i;
-		coord_t min_l = rects[ids[i]]->coords[2 * a];
-		coord_t min_r = rects[ids[i]]->coords[2 * a + 1];
+		coord_t min_l = rects[ids[i]].coords[2 * a];
+		coord_t min_r = rects[ids[i]].coords[2 * a + 1];
 		for (unsigned j = i + 1; j < n; j++) {
-			coord_t l = rects[ids[j]]->coords[2 * a];
-			coord_t r = rects[ids[j]]->coords[2 * a + 1];
+			coord_t l = rects[ids[j]].coords[2 * a];
+			coord_t r = rects[ids[j]].coords[2 * a + 1];
 			if (l < min_l || (l == min_l && r < min_r)) {
 				min_i = j;
 				min_l = l;
@@ -525,13 +692,13 @@ rtree_split_page(struct rtree *tree, struct rtree_page *page,
 		unsigned k1 = tree->page_min_fill + k;
 		/* unsigned k2 = n - k1; */
 		struct rtree_rect rt1, rt2, over_rt;
-		rtree_rect_copy(&rt1, rects[ids[0]], d);
+		rtree_rect_copy(&rt1, &rects[ids[0]], d);
 		for (unsigned i = 1; i < k1; i++) {
-			rtree_rect_add(&rt1, rects[ids[i]], d);
+			rtree_rect_add(&rt1, &rects[ids[i]], d);
 		}
-		rtree_rect_copy(&rt2, rects[ids[k1]], d);
+		rtree_rect_copy(&rt2, &rects[ids[k1]], d);
 		for (unsigned i = k1 + 1; i < n; i++) {
-			rtree_rect_add(&rt2, rects[ids[i]], d);
+			rtree_rect_add(&rt2, &rects[ids[i]], d);
 		}
 		rtree_rect_intersection(&rt1, &rt2, &over_rt, d);
 		area_t overlap = rtree_rect_area(&over_rt, d);
@@ -559,7 +726,7 @@ rtree_split_page(struct rtree *tree, struct rtree_page *page,
 			from_b = rtree_branch_get(tree, page, ids[i] - 1);
 			taken[ids[i] - 1] = 1;
 		}
-		rtree_branch_copy(new_b, from_b, d);
+		rtree_branch_copy(tree, new_b, from_b);
 	}
 	unsigned moved = 0;
 	for (unsigned i = 0, j = 0; j < page->n; j++) {
@@ -567,7 +734,7 @@ rtree_split_page(struct rtree *tree, struct rtree_page *page,
 			struct rtree_page_branch *to, *from;
 			to = rtree_branch_get(tree, page, i++);
 			from = rtree_branch_get(tree, page, j);
-			rtree_branch_copy(to, from, tree->dimension);
+			rtree_branch_copy(tree, to, from);
 			moved++;
 		}
 	}
@@ -575,7 +742,7 @@ rtree_split_page(struct rtree *tree, struct rtree_page *page,
 	if (moved + 1 == k2) {
 		struct rtree_page_branch *to;
 		to = rtree_branch_get(tree, page, moved);
-		rtree_branch_copy(to, br, tree->dimension);
+		rtree_branch_copy(tree, to, br);
 	}
 	new_page->n = k1;
 	page->n = k2;
@@ -589,7 +756,7 @@ rtree_page_add_branch(struct rtree *tree, struct rtree_page *page,
 	if (page->n < tree->page_max_fill) {
 		struct rtree_page_branch *b;
 		b = rtree_branch_get(tree, page, page->n++);
-		rtree_branch_copy(b, br, tree->dimension);
+		rtree_branch_copy(tree, b, br);
 		return NULL;
 	} else {
 		return rtree_split_page(tree, page, br);
@@ -604,7 +771,7 @@ rtree_page_remove_branch(struct rtree *tree, struct rtree_page *page, int i)
 		struct rtree_page_branch *to, *from;
 		to = rtree_branch_get(tree, page, j);
 		from = rtree_branch_get(tree, page, j + 1);
-		rtree_branch_copy(to, from, tree->dimension);
+		rtree_branch_copy(tree, to, from);
 	}
 }
 
@@ -621,10 +788,12 @@ rtree_page_insert(struct rtree *tree, struct rtree_page *page,
 		for (unsigned i = 0; i < page->n; i++) {
 			struct rtree_page_branch *b;
 			b = rtree_branch_get(tree, page, i);
-			area_t r_area = rtree_rect_area(&b->rect,
+			struct rtree_rect b_rect;
+			rtree_box_get(tree, &b->box, &b_rect);
+			area_t r_area = rtree_rect_area(&b_rect,
 							tree->dimension);
 			struct rtree_rect cover;
-			rtree_rect_cover(&b->rect, rect,
+			rtree_rect_cover(&b_rect, rect,
 					 &cover, tree->dimension);
 			area_t incr = rtree_rect_area(&cover,
 						      tree->dimension);
@@ -646,40 +815,45 @@ rtree_page_insert(struct rtree *tree, struct rtree_page *page,
 							 rect, obj, level);
 		if (q == NULL) {
 			/* child was not split */
-			rtree_rect_add(&b->rect, rect, tree->dimension);
+			struct rtree_rect b_rect;
+			rtree_box_get(tree, &b->box, &b_rect);
+			rtree_rect_add(&b_rect, rect, tree->dimension);
+			rtree_box_set(tree, &b->box, &b_rect);
 			return NULL;
 		} else {
 			/* child was split */
-			rtree_page_cover(tree, p, &b->rect);
+			rtree_branch_set_cover(tree, b, p);
 			br.data.page = q;
-			rtree_page_cover(tree, q, &br.rect);
+			rtree_branch_set_cover(tree, &br, q);
 			return rtree_page_add_branch(tree, page, &br);
 		}
 	} else {
 		br.data.record = obj;
-		rtree_rect_copy(&br.rect, rect, tree->dimension);
+		rtree_box_set(tree, &br.box, rect);
 		return rtree_page_add_branch(tree, page, &br);
 	}
 }
 
 static bool
 rtree_page_remove(struct rtree *tree, struct rtree_page *page,
-		  const struct rtree_rect *rect, record_t obj,
+		  const union rtree_box *box, record_t obj,
 		  int level, struct rtree_reinsert_list *rlist)
 {
 	unsigned d = tree->dimension;
+	rtree_comparator_t intersects =
+		rtree_box_ops[tree->coord_type].intersects;
 	if (--level != 0) {
 		for (unsigned i = 0; i < page->n; i++) {
 			struct rtree_page_branch *b;
 			b = rtree_branch_get(tree, page, i);
-			if (!rtree_rect_intersects_rect(&b->rect, rect, d))
+			if (!intersects(&b->box, box, d))
 				continue;
 			struct rtree_page *next_page = b->data.page;
-			if (!rtree_page_remove(tree, next_page, rect,
+			if (!rtree_page_remove(tree, next_page, box,
 					       obj, level, rlist))
 				continue;
 			if (next_page->n >= tree->page_min_fill) {
-				rtree_page_cover(tree, next_page, &b->rect);
+				rtree_branch_set_cover(tree, b, next_page);
 			} else {
 				/* not enough entries in child */
 				set_next_reinsert_page(tree, next_page,
@@ -729,7 +903,7 @@ rtree_iterator_goto_first(struct rtree_iterator *itr, unsigned sp,
 		for (unsigned i = 0, n = pg->n; i < n; i++) {
 			struct rtree_page_branch *b;
 			b = rtree_branch_get(itr->tree, pg, i);
-			if (itr->leaf_cmp(&itr->rect, &b->rect, d)) {
+			if (itr->leaf_cmp(&itr->box, &b->box, d)) {
 				itr->stack[sp].page = pg;
 				itr->stack[sp].pos = i;
 				return true;
@@ -739,7 +913,7 @@ rtree_iterator_goto_first(struct rtree_iterator *itr, unsigned sp,
 		for (unsigned i = 0, n = pg->n; i < n; i++) {
 			struct rtree_page_branch *b;
 			b = rtree_branch_get(itr->tree, pg, i);
-			if (itr->intr_cmp(&itr->rect, &b->rect, d)
+			if (itr->intr_cmp(&itr->box, &b->box, d)
 			    && rtree_iterator_goto_first(itr, sp + 1,
 							 b->data.page))
 			{
@@ -762,7 +936,7 @@ rtree_iterator_goto_next(struct rtree_iterator *itr, unsigned sp)
 		for (unsigned i = itr->stack[sp].pos, n = pg->n; ++i < n;) {
 			struct rtree_page_branch *b;
 			b = rtree_branch_get(itr->tree, pg, i);
-			if (itr->leaf_cmp(&itr->rect, &b->rect, d)) {
+			if (itr->leaf_cmp(&itr->box, &b->box, d)) {
 				itr->stack[sp].pos = i;
 				return true;
 			}
@@ -771,7 +945,7 @@ rtree_iterator_goto_next(struct rtree_iterator *itr, unsigned sp)
 		for (int i = itr->stack[sp].pos, n = pg->n; ++i < n;) {
 			struct rtree_page_branch *b;
 			b = rtree_branch_get(itr->tree, pg, i);
-			if (itr->intr_cmp(&itr->rect, &b->rect, d)
+			if (itr->intr_cmp(&itr->box, &b->box, d)
 			    && rtree_iterator_goto_first(itr, sp + 1,
 							 b->data.page))
 			{
@@ -873,12 +1047,14 @@ rtree_iterator_process_neigh(struct rtree_iterator *itr,
 	for (int i = 0, n = pg->n; i < n; i++) {
 		struct rtree_page_branch *b;
 		b = rtree_branch_get(itr->tree, pg, i);
+		struct rtree_rect rect;
+		rtree_box_get(itr->tree, &b->box, &rect);
 		coord_t distance;
 		if (itr->tree->distance_type == RTREE_EUCLID)
-			distance = rtree_rect_neigh_distance2(&b->rect,
+			distance = rtree_rect_neigh_distance2(&rect,
 							      &itr->rect, d);
 		else
-			distance = rtree_rect_neigh_distance(&b->rect,
+			distance = rtree_rect_neigh_distance(&rect,
 							     &itr->rect, d);
 		struct rtree_neighbor *neigh =
 			rtree_iterator_new_neighbor(itr, b->data.page,
@@ -943,7 +1119,8 @@ rtree_iterator_next(struct rtree_iterator *itr)
 int
 rtree_init(struct rtree *tree, unsigned dimension, uint32_t extent_size,
 	   rtree_extent_alloc_t extent_alloc, rtree_extent_free_t extent_free,
-	   void *alloc_ctx, enum rtree_distance_type distance_type)
+	   void *alloc_ctx, enum rtree_distance_type distance_type,
+	   enum rtree_coord_type coord_type)
 {
 	tree->n_records = 0;
 	tree->height = 0;
@@ -954,10 +1131,28 @@ rtree_init(struct rtree *tree, unsigned dimension, uint32_t extent_size,
 
 	tree->dimension = dimension;
 	tree->distance_type = distance_type;
+	tree->coord_type = coord_type;
+	switch (coord_type) {
+	case RTREE_COORD_FLOAT:
+		tree->coord_size = sizeof(float);
+		break;
+	case RTREE_COORD_INT32:
+		tree->coord_size = sizeof(int32_t);
+		break;
+	default:
+		assert(coord_type == RTREE_COORD_DOUBLE);
+		tree->coord_size = sizeof(coord_t);
+		break;
+	}
 	tree->page_branch_size =
-		(RTREE_BRANCH_DATA_SIZE + dimension * 2 * sizeof(coord_t));
+		(RTREE_BRANCH_DATA_SIZE + dimension * 2 * tree->coord_size);
+	/*
+	 * The page size depends on the dimension only, so that
+	 * narrower coordinates give more branches per page.
+	 */
 	tree->page_size = RTREE_OPTIMAL_BRANCHES_IN_PAGE *
-		tree->page_branch_size + sizeof(int);
+		(RTREE_BRANCH_DATA_SIZE + dimension * 2 * sizeof(coord_t)) +
+		sizeof(int);
 	/* round up to closest power of 2 */
 	int lz = __builtin_clz(tree->page_size - 1);
 	tree->page_size = 1u << (sizeof(int) * CHAR_BIT - lz);
@@ -965,6 +1160,8 @@ rtree_init(struct rtree *tree, unsigned dimension, uint32_t extent_size,
 	       tree->page_branch_size * RTREE_OPTIMAL_BRANCHES_IN_PAGE);
 	tree->page_max_fill = (tree->page_size - sizeof(int)) /
 		tree->page_branch_size;
+	if (tree->page_max_fill > RTREE_MAXIMUM_BRANCHES_IN_PAGE)
+		tree->page_max_fill = RTREE_MAXIMUM_BRANCHES_IN_PAGE;
 	tree->page_min_fill = tree->page_max_fill * 2 / 5;
 	tree->neighbours_in_page = (tree->page_size - sizeof(void *))
 		/ sizeof(struct rtree_neighbor);
@@ -1006,6 +1203,140 @@ rtree_insert(struct rtree *tree, struct rtree_rect *rect, record_t obj)
 	tree->n_records++;
 }
 
+size_t
+rtree_bulk_elem_size(const struct rtree *tree)
+{
+	return tree->page_branch_size;
+}
+
+void
+rtree_bulk_elem_set(const struct rtree *tree, void *elem,
+		    const struct rtree_rect *rect, record_t obj)
+{
+	struct rtree_page_branch *b = (struct rtree_page_branch *)elem;
+	b->data.record = obj;
+	rtree_box_set(tree, &b->box, rect);
+}
+
+struct rtree_bulk_cmp_arg {
+	const struct rtree *tree;
+	unsigned axis;
+};
+
+/* Compare centers of branch boxes along the given axis */
+static int
+rtree_bulk_cmp(const void *a, const void *b, void *arg)
+{
+	struct rtree_bulk_cmp_arg *cmp_arg = (struct rtree_bulk_cmp_arg *)arg;
+	const struct rtree *tree = cmp_arg->tree;
+	unsigned i = cmp_arg->axis * 2;
+	const union rtree_box *ba = &((const struct rtree_page_branch *)a)->box;
+	const union rtree_box *bb = &((const struct rtree_page_branch *)b)->box;
+	coord_t sa = rtree_box_coord(tree, ba, i) +
+		     rtree_box_coord(tree, ba, i + 1);
+	coord_t sb = rtree_box_coord(tree, bb, i) +
+		     rtree_box_coord(tree, bb, i + 1);
+	return sa < sb ? -1 : sa > sb ? 1 : 0;
+}
+
+/* Minimal s such that s ** n >= x */
+static size_t
+rtree_bulk_root(size_t x, unsigned n)
+{
+	size_t s = 1;
+	for (;;) {
+		double p = 1;
+		for (unsigned i = 0; i < n && p < x; i++)
+			p *= s;
+		if (p >= x)
+			return s;
+		s++;
+	}
+}
+
+/*
+ * Sort-Tile-Recursive ordering of branches: sort along the axis,
+ * cut into slabs of whole pages, order every slab along the
+ * remaining axes.
+ */
+static void
+rtree_bulk_sort(const struct rtree *tree, char *elems, size_t count,
+		unsigned axis)
+{
+	size_t size = tree->page_branch_size;
+	size_t fill = tree->page_max_fill;
+	struct rtree_bulk_cmp_arg arg = {tree, axis};
+	qsort_arg(elems, count, size, rtree_bulk_cmp, &arg);
+	if (axis + 1 == tree->dimension || count <= fill)
+		return;
+	size_t n_pages = (count + fill - 1) / fill;
+	size_t n_slabs = rtree_bulk_root(n_pages, tree->dimension - axis);
+	size_t slab_count = (n_pages + n_slabs - 1) / n_slabs * fill;
+	for (size_t i = 0; i < count; i += slab_count) {
+		size_t n = count - i < slab_count ? count - i : slab_count;
+		rtree_bulk_sort(tree, elems + i * size, n, axis + 1);
+	}
+}
+
+void
+rtree_bulk_load(struct rtree *tree, void *elems, size_t count)
+{
+	assert(tree->root == NULL);
+	if (count == 0)
+		return;
+	size_t size = tree->page_branch_size;
+	size_t fill = tree->page_max_fill;
+	char *level = (char *)elems;
+	size_t level_count = count;
+	unsigned height = 0;
+	for (;;) {
+		height++;
+		assert(height <= RTREE_MAX_HEIGHT);
+		rtree_bulk_sort(tree, level, level_count, 0);
+		size_t n_pages = (level_count + fill - 1) / fill;
+		size_t pos = 0;
+		for (size_t i = 0; i < n_pages; i++) {
+			size_t n = level_count - pos;
+			if (n > fill)
+				n = fill;
+			/*
+			 * Share the branches of the last two pages
+			 * if the last one would be underfilled.
+			 */
+			if (i + 2 == n_pages &&
+			    level_count - pos - fill < tree->page_min_fill)
+				n = (level_count - pos) / 2;
+			struct rtree_page *page = rtree_page_alloc(tree);
+			tree->n_pages++;
+			page->n = n;
+			for (size_t j = 0; j < n; j++) {
+				struct rtree_page_branch *from =
+					(struct rtree_page_branch *)
+					(level + (pos + j) * size);
+				rtree_branch_copy(tree, rtree_branch_get(tree,
+						  page, j), from);
+			}
+			pos += n;
+			/*
+			 * The page becomes a branch of the upper level.
+			 * Its slot has already been copied, since i < pos.
+			 */
+			struct rtree_page_branch *b =
+				(struct rtree_page_branch *)(level + i * size);
+			rtree_branch_set_cover(tree, b, page);
+			b->data.page = page;
+		}
+		assert(pos == level_count);
+		level_count = n_pages;
+		if (level_count == 1)
+			break;
+	}
+	tree->root = ((struct rtree_page_branch *)level)->data.page;
+	tree->height = height;
+	tree->n_records = count;
+	tree->version++;
+}
+
 bool
 rtree_remove(struct rtree *tree, const struct rtree_rect *rect, record_t obj)
 {
@@ -1013,7 +1344,9 @@ rtree_remove(struct rtree *tree, const struct rtree_rect *rect, record_t obj)
 	rlist.chain = NULL;
 	if (tree->height == 0)
 		return false;
-	if (!rtree_page_remove(tree, tree->root, rect, obj, tree->height, &rlist))
+	union rtree_box box;
+	rtree_box_set(tree, &box, rect);
+	if (!rtree_page_remove(tree, tree->root, &box, obj, tree->height, &rlist))
 		return false;
 	struct rtree_page *pg = rlist.chain;
 	int level = rlist.level;
@@ -1021,9 +1354,11 @@ rtree_remove(struct rtree *tree, const struct rtree_rect *rect, record_t obj)
 		for (int i = 0, n = pg->n; i < n; i++) {
 			struct rtree_page_branch *b;
 			b = rtree_branch_get(tree, pg, i);
+			struct rtree_rect b_rect;
+			rtree_box_get(tree, &b->box, &b_rect);
 			struct rtree_page *p =
 				rtree_page_insert(tree, tree->root,
-						  &b->rect, b->data.record,
+						  &b_rect, b->data.record,
 						  tree->height - level);
 			if (p != NULL) {
 				/* root splitted */
@@ -1064,33 +1399,43 @@ rtree_search(const struct rtree *tree, const struct rtree_rect *rect,
 	assert(itr->tree == 0 || itr->tree == tree);
 	itr->tree = tree;
 	itr->version = tree->version;
+	/*
+	 * The rectangle is rounded outward to the tree coordinate
+	 * type, as rectangles of records are. Rounding preserves
+	 * all the predicates but strict ones, which are checked
+	 * as non-strict then, see rtree_rect_match().
+	 */
 	rtree_rect_copy(&itr->rect, rect, tree->dimension);
+	rtree_box_set(tree, &itr->box, rect);
 	itr->op = op;
 	assert(tree->height <= RTREE_MAX_HEIGHT);
+	const struct rtree_box_ops *ops = &rtree_box_ops[tree->coord_type];
+	bool is_exact = tree->coord_type == RTREE_COORD_DOUBLE;
 	switch (op) {
 	case SOP_ALL:
-		itr->intr_cmp = itr->leaf_cmp = rtree_always_true;
+		itr->intr_cmp = itr->leaf_cmp = rtree_box_always_true;
 		break;
 	case SOP_EQUALS:
-		itr->intr_cmp = rtree_rect_in_rect;
-		itr->leaf_cmp = rtree_rect_equal_to_rect;
+		itr->intr_cmp = ops->in;
+		itr->leaf_cmp = ops->equal;
 		break;
 	case SOP_CONTAINS:
-		itr->intr_cmp = itr->leaf_cmp = rtree_rect_in_rect;
+		itr->intr_cmp = itr->leaf_cmp = ops->in;
 		break;
 	case SOP_STRICT_CONTAINS:
-		itr->intr_cmp = itr->leaf_cmp = rtree_rect_strict_in_rect;
+		itr->intr_cmp = itr->leaf_cmp =
+			is_exact ? ops->strict_in : ops->in;
 		break;
 	case SOP_OVERLAPS:
-		itr->intr_cmp = itr->leaf_cmp = rtree_rect_intersects_rect;
+		itr->intr_cmp = itr->leaf_cmp = ops->intersects;
 		break;
 	case SOP_BELONGS:
-		itr->intr_cmp = rtree_rect_intersects_rect;
-		itr->leaf_cmp = rtree_rect_holds_rect;
+		itr->intr_cmp = ops->intersects;
+		itr->leaf_cmp = ops->holds;
 		break;
 	case SOP_STRICT_BELONGS:
-		itr->intr_cmp = rtree_rect_intersects_rect;
-		itr->leaf_cmp = rtree_rect_strict_holds_rect;
+		itr->intr_cmp = ops->intersects;
+		itr->leaf_cmp = is_exact ? ops->strict_holds : ops->holds;
 		break;
 	case SOP_NEIGHBOR:
 		if (tree->root) {
@@ -1099,11 +1444,11 @@ rtree_search(const struct rtree *tree, const struct rtree_rect *rect,
 			sq_coord_t distance;
 			if (tree->distance_type == RTREE_EUCLID)
 				distance =
-				rtree_rect_neigh_distance2(&cover, rect,
+				rtree_rect_neigh_distance2(&cover, &itr->rect,
 							   tree->dimension);
 			else
 				distance =
-				rtree_rect_neigh_distance(&cover, rect,
+				rtree_rect_neigh_distance(&cover, &itr->rect,
 							  tree->dimension);
 			struct rtree_neighbor *n =
 				rtree_iterator_new_neighbor(itr, tree->root,
@@ -1160,10 +1505,12 @@ rtree_debug_print_page(const struct rtree *tree, const struct rtree_page *page,
 	for (int i = 0; i < page->n; i++) {
 		struct rtree_page_branch *b;
 		b = rtree_branch_get(tree, page, i);
+		struct rtree_rect rect;
+		rtree_box_get(tree, &b->box, &rect);
 		double v = 1;
 		for (unsigned j = 0; j < d; j++) {
-			double d1 = b->rect.coords[j * 2];
-			double d2 = b->rect.coords[j * 2 + 1];
+			double d1 = rect.coords[j * 2];
+			double d2 = rect.coords[j * 2 + 1];
 			v *= (d2 - d1) / 100;
 			printf("[%04.1lf-%04.1lf:%04.1lf]", d2, d1, d2 - d1);
 		}
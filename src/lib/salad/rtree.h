@@ -31,6 +31,7 @@
  * SUCH DAMAGE.
  */
 #include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
 #include "small/matras.h"
 
@@ -109,9 +110,27 @@ struct rtree_rect
 	coord_t coords[RTREE_MAX_DIMENSION * 2];
 };
 
-/* Type of function, comparing two rectangles */
-typedef bool (*rtree_comparator_t)(const struct rtree_rect *rt1,
-				   const struct rtree_rect *rt2,
+/* Type of coordinates stored in tree pages */
+enum rtree_coord_type {
+	RTREE_COORD_DOUBLE = 0, /* 64-bit floating point */
+	RTREE_COORD_FLOAT = 1, /* 32-bit floating point */
+	RTREE_COORD_INT32 = 2 /* 32-bit integer */
+};
+
+/*
+ * A box as it is stored in tree pages: the same layout as
+ * rtree_rect, but coordinates are of the tree coordinate type.
+ * Only tree->dimension * 2 coordinates are actually stored.
+ */
+union rtree_box {
+	coord_t d[RTREE_MAX_DIMENSION * 2];
+	float f[RTREE_MAX_DIMENSION * 2];
+	int32_t i[RTREE_MAX_DIMENSION * 2];
+};
+
+/* Type of function, comparing two boxes */
+typedef bool (*rtree_comparator_t)(const union rtree_box *b1,
+				   const union rtree_box *b2,
 				   unsigned dimension);
 
 /* Type distance comparison */
@@ -152,6 +171,10 @@ struct rtree
 	void *free_pages;
 	/* Distance type */
 	enum rtree_distance_type distance_type;
+	/* Type of coordinates stored in pages */
+	enum rtree_coord_type coord_type;
+	/* Size of a coordinate stored in pages, in bytes */
+	unsigned coord_size;
 };
 
 /* Struct for iteration and retrieving rtree values */
@@ -161,6 +184,8 @@ struct rtree_iterator
 	const struct rtree *tree;
 	/* Rectangle of current iteration operation */
 	struct rtree_rect rect;
+	/* The same rectangle rounded to the tree coordinate type */
+	union rtree_box box;
 	/* Type of current iteration operation */
 	enum spatial_search_op op;
 	/* Flag that means that no more values left */
@@ -232,12 +257,19 @@ rtree_set2dp(struct rtree_rect *rect, coord_t x, coord_t y);
  * @param extent_alloc - extent allocation function
  * @param extent_free - extent deallocation function
  * @param alloc_ctx - argument passed to extent allocator
+ * @param distance_type - distance used by SOP_NEIGHBOR search
+ * @param coord_type - type of coordinates stored in tree pages.
+ *  Bounding boxes are rounded outward to the type (with saturation
+ *  for RTREE_COORD_INT32), so narrower types fit more branches in
+ *  a page, but a search may return records that don't match it;
+ *  see rtree_rect_match()
  * @return 0 on success, -1 on error
  */
 int
 rtree_init(struct rtree *tree, unsigned dimension, uint32_t extent_size,
 	   rtree_extent_alloc_t extent_alloc, rtree_extent_free_t extent_free,
-	   void *alloc_ctx, enum rtree_distance_type distance_type);
+	   void *alloc_ctx, enum rtree_distance_type distance_type,
+	   enum rtree_coord_type coord_type);
 
 /**
  * @brief Destroy a tree
@@ -266,6 +298,21 @@ bool
 rtree_search(const struct rtree *tree, const struct rtree_rect *rect,
 	     enum spatial_search_op op, struct rtree_iterator *itr);
 
+/**
+ * @brief Check if a record rectangle matches a search exactly.
+ * A tree with coord_type other than RTREE_COORD_DOUBLE stores
+ * rounded bounding boxes, so records it finds must be checked
+ * against their actual rectangles.
+ * @return true if the record matches
+ * @param rect - rectangle of a record
+ * @param key - rectangle of a search
+ * @param op - type of search, see enum spatial_search_op for details
+ * @param dimension - number of dimensions
+ */
+bool
+rtree_rect_match(const struct rtree_rect *rect, const struct rtree_rect *key,
+		 enum spatial_search_op op, unsigned dimension);
+
 /**
  * @brief Insert a record to the tree
  * @param tree - pointer to a tree
@@ -275,6 +322,41 @@ rtree_search(const struct rtree *tree, const struct rtree_rect *rect,
 void
 rtree_insert(struct rtree *tree, struct rtree_rect *rect, record_t obj);
 
+/**
+ * @brief Size of an element of the array passed to rtree_bulk_load()
+ * @param tree - pointer to a tree
+ */
+size_t
+rtree_bulk_elem_size(const struct rtree *tree);
+
+/**
+ * @brief Set an element of the array passed to rtree_bulk_load()
+ * @param tree - pointer to a tree
+ * @param elem - pointer to the element
+ * @param rect - rectangle of the record
+ * @param obj - record
+ */
+void
+rtree_bulk_elem_set(const struct rtree *tree, void *elem,
+		    const struct rtree_rect *rect, record_t obj);
+
+/**
+ * @brief Fill an empty tree with records in one go (bulk loading).
+ * The tree is built bottom-up with the Sort-Tile-Recursive algorithm:
+ * records are sorted by the centers of their rectangles along the first
+ * axis, cut into slabs, each slab is sorted along the next axis and so
+ * on; then consecutive records are packed into full pages. Upper levels
+ * are built the same way from the covers of the pages below. This is
+ * much faster than inserting records one by one and the pages are much
+ * better filled and overlap less.
+ * @param tree - pointer to an empty tree
+ * @param elems - array of elements set by rtree_bulk_elem_set(),
+ *  the array is reordered and overwritten
+ * @param count - number of elements in the array
+ */
+void
+rtree_bulk_load(struct rtree *tree, void *elems, size_t count);
+
 /**
  * @brief Remove the record from a tree
  * @return true if the record deleted (false otherwise)
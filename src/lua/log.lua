@@ -9,6 +9,7 @@ ffi.cdef[[
 
     extern sayfunc_t _say;
     extern void say_logrotate(int);
+    uint64_t say_logger_async_dropped(void);
 
     enum say_level {
         S_FATAL,
@@ -73,6 +74,10 @@ local function log_pid()
     return tonumber(ffi.C.log_pid)
 end
 
+local function log_dropped()
+    return tonumber(ffi.C.say_logger_async_dropped())
+end
+
 local compat_warning_said = false
 local compat_v16 = {
     logger_pid = function()
@@ -92,6 +97,7 @@ return setmetatable({
     error = say_closure(S_ERROR);
     rotate = log_rotate;
     pid = log_pid;
+    dropped = log_dropped;
     level = log_level;
 }, {
     __index = compat_v16;
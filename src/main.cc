@@ -430,6 +430,12 @@ load_cfg()
 	if (background)
 		daemonize();
 
+	/* The logger thread must be started after fork(). */
+	if (cfg_geti("log_async") && say_logger_async_init() != 0) {
+		diag_log();
+		panic("failed to start the logger thread");
+	}
+
 	/*
 	 * after (optional) daemonising to avoid confusing messages with
 	 * different pids
@@ -44,7 +44,12 @@
 #include <syslog.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/uio.h>
+#include <time.h>
 #include <arpa/inet.h>
+#include <pthread.h>
+#include <sched.h>
+#include <pmatomic.h>
 
 pid_t log_pid = 0;
 int log_level = S_INFO;
@@ -68,6 +73,67 @@ sayf(int level, const char *filename, int line, const char *error,
 
 sayfunc_t _say = sayf;
 
+enum {
+	/** Number of records in the async logger ring, power of 2. */
+	SAY_ASYNC_RING_SIZE = 512,
+	/** Max number of records written by a single writev(). */
+	SAY_ASYNC_BATCH = 64,
+	/** How long the logger thread sleeps if not woken up, ms. */
+	SAY_ASYNC_IDLE_TIMEOUT = 100,
+};
+
+/**
+ * A preformatted log record in the async logger ring.
+ * The ring is a bounded multi-producer single-consumer
+ * queue: a record at position pos is free for a producer
+ * when its seq == pos and ready for the consumer when
+ * seq == pos + 1. The consumer releases the record for the
+ * next round by setting seq to pos + SAY_ASYNC_RING_SIZE.
+ */
+struct say_async_record {
+	uint64_t seq;
+	/** Length of the record, including the trailing '\n'. */
+	int len;
+	char buf[PIPE_BUF];
+};
+
+/** Async logger state, see say_logger_async_init(). */
+static struct {
+	/**
+	 * Set if vsay() pushes records to the ring. Accessed
+	 * atomically: it is cleared by the main thread while
+	 * other threads may be logging.
+	 */
+	bool is_enabled;
+	/**
+	 * Number of threads that are pushing a record right
+	 * now. The ring isn't freed until it drops to zero.
+	 */
+	int producer_count;
+	struct say_async_record *ring;
+	/** Next position to push to, shared by producers. */
+	uint64_t tail;
+	/** Next position to pop from, owned by the logger thread. */
+	uint64_t head;
+	/** Number of records dropped because the ring was full. */
+	uint64_t dropped;
+	/** Set while the logger thread waits for records. */
+	bool is_sleeping;
+	/** Set to make the logger thread exit. */
+	bool is_stopped;
+	/**
+	 * The process that started the logger thread. A forked
+	 * child doesn't have the thread and writes synchronously.
+	 */
+	pid_t pid;
+	struct cord cord;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+} say_async;
+
+static void
+say_logger_async_free(void);
+
 static char
 level_to_char(int level)
 {
@@ -390,6 +456,7 @@ say_logger_init(const char *init_str, int level, int nonblock, int background)
 void
 say_logger_free()
 {
+	say_logger_async_free();
 	if (logger_type == SAY_LOGGER_SYSLOG && log_fd != -1)
 		close(log_fd);
 	free(syslog_ident);
@@ -458,6 +525,302 @@ say_encode_tarantool_header(char *buf, int len, struct tm *tm, ev_tstamp now,
 	return pos;
 }
 
+/**
+ * Write a formatted record to the log. Reconnect to syslog
+ * if the previous write to it has failed.
+ */
+static void
+say_write(const char *buf, size_t len)
+{
+	if (logger_type != SAY_LOGGER_SYSLOG) {
+		(void) write(log_fd, buf, len);
+	} else if (log_fd < 0 || write(log_fd, buf, len) <= 0) {
+		/*
+		 * Try to reconnect, if write to syslog has
+		 * failed. Syslog write can fail, if, for example,
+		 * syslogd is restarted. In such a case write to
+		 * UNIX socket starts return -1 even for UDP.
+		 */
+		if (log_fd >= 0)
+			close(log_fd);
+		log_fd = say_syslog_connect();
+		if (log_fd >= 0) {
+			/*
+			 * In a case or error the log message is
+			 * lost. We can not wait for connection -
+			 * it would block thread. Try to reconnect
+			 * on next vsay().
+			 */
+			(void) write(log_fd, buf, len);
+		}
+	}
+}
+
+static inline struct say_async_record *
+say_async_record(uint64_t pos)
+{
+	return &say_async.ring[pos & (SAY_ASYNC_RING_SIZE - 1)];
+}
+
+/**
+ * Push a formatted record to the async logger ring and wake
+ * up the logger thread if it sleeps. Never blocks: if the
+ * ring is full, the record is dropped.
+ */
+static void
+say_async_push(const char *buf, int len)
+{
+	struct say_async_record *rec;
+	uint64_t pos = pm_atomic_load_explicit(&say_async.tail,
+					       pm_memory_order_relaxed);
+	while (true) {
+		rec = say_async_record(pos);
+		uint64_t seq = pm_atomic_load_explicit(&rec->seq,
+						pm_memory_order_acquire);
+		int64_t diff = (int64_t)(seq - pos);
+		if (diff == 0) {
+			if (pm_atomic_compare_exchange_weak_explicit(
+					&say_async.tail, &pos, pos + 1,
+					pm_memory_order_relaxed,
+					pm_memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			/* The logger thread lags a whole ring behind. */
+			pm_atomic_fetch_add_explicit(&say_async.dropped, 1,
+						     pm_memory_order_relaxed);
+			return;
+		} else {
+			/* Another producer has taken the record. */
+			pos = pm_atomic_load_explicit(&say_async.tail,
+						      pm_memory_order_relaxed);
+		}
+	}
+	memcpy(rec->buf, buf, len);
+	rec->len = len;
+	pm_atomic_store_explicit(&rec->seq, pos + 1, pm_memory_order_release);
+	/* Pairs with the fence in say_async_wait(). */
+	pm_atomic_thread_fence(pm_memory_order_seq_cst);
+	if (pm_atomic_load_explicit(&say_async.is_sleeping,
+				    pm_memory_order_relaxed)) {
+		tt_pthread_mutex_lock(&say_async.mutex);
+		tt_pthread_cond_signal(&say_async.cond);
+		tt_pthread_mutex_unlock(&say_async.mutex);
+	}
+}
+
+/** Check if the record at the ring head is ready to be written. */
+static inline bool
+say_async_is_ready(void)
+{
+	uint64_t pos = say_async.head;
+	return pm_atomic_load_explicit(&say_async_record(pos)->seq,
+				       pm_memory_order_acquire) == pos + 1;
+}
+
+/** Wait until a record is pushed or the logger is stopped. */
+static void
+say_async_wait(void)
+{
+	tt_pthread_mutex_lock(&say_async.mutex);
+	pm_atomic_store_explicit(&say_async.is_sleeping, true,
+				 pm_memory_order_relaxed);
+	/* Pairs with the fence in say_async_push(). */
+	pm_atomic_thread_fence(pm_memory_order_seq_cst);
+	if (!say_async_is_ready() &&
+	    !pm_atomic_load_explicit(&say_async.is_stopped,
+				     pm_memory_order_relaxed)) {
+		/*
+		 * The timeout is a safety net only, producers
+		 * signal the condition when they see the flag.
+		 */
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_nsec += SAY_ASYNC_IDLE_TIMEOUT * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+		pthread_cond_timedwait(&say_async.cond, &say_async.mutex,
+				       &deadline);
+	}
+	pm_atomic_store_explicit(&say_async.is_sleeping, false,
+				 pm_memory_order_relaxed);
+	tt_pthread_mutex_unlock(&say_async.mutex);
+}
+
+/**
+ * Write all records that are ready, SAY_ASYNC_BATCH records
+ * per system call.
+ * @retval Number of written records.
+ */
+static int
+say_async_flush(void)
+{
+	struct iovec iov[SAY_ASYNC_BATCH];
+	int total = 0;
+	while (true) {
+		uint64_t pos = say_async.head;
+		int count = 0;
+		while (count < SAY_ASYNC_BATCH) {
+			struct say_async_record *rec =
+				say_async_record(pos + count);
+			if (pm_atomic_load_explicit(&rec->seq,
+					pm_memory_order_acquire) !=
+			    pos + count + 1)
+				break;
+			iov[count].iov_base = rec->buf;
+			iov[count].iov_len = rec->len;
+			count++;
+		}
+		if (count == 0)
+			return total;
+		if (logger_type != SAY_LOGGER_SYSLOG) {
+			(void) writev(log_fd, iov, count);
+		} else {
+			/* Syslog expects one message per datagram. */
+			for (int i = 0; i < count; i++)
+				say_write(iov[i].iov_base, iov[i].iov_len);
+		}
+		for (int i = 0; i < count; i++) {
+			pm_atomic_store_explicit(&say_async_record(pos + i)->seq,
+						 pos + i + SAY_ASYNC_RING_SIZE,
+						 pm_memory_order_release);
+		}
+		say_async.head = pos + count;
+		total += count;
+	}
+}
+
+/** Logger thread: drain the ring until stopped. */
+static void *
+say_async_f(void *arg)
+{
+	(void) arg;
+	uint64_t dropped_reported = 0;
+	while (true) {
+		if (say_async_flush() > 0) {
+			uint64_t dropped = say_logger_async_dropped();
+			if (dropped != dropped_reported) {
+				say_warn("%llu log messages dropped, "
+					 "the log is too slow",
+					 (unsigned long long)
+					 (dropped - dropped_reported));
+				dropped_reported = dropped;
+			}
+			continue;
+		}
+		if (pm_atomic_load_explicit(&say_async.is_stopped,
+					    pm_memory_order_relaxed))
+			break;
+		say_async_wait();
+	}
+	return NULL;
+}
+
+int
+say_logger_async_init(void)
+{
+	assert(!say_async.is_enabled);
+	say_async.ring = (struct say_async_record *)
+		calloc(SAY_ASYNC_RING_SIZE, sizeof(*say_async.ring));
+	if (say_async.ring == NULL) {
+		diag_set(OutOfMemory,
+			 SAY_ASYNC_RING_SIZE * sizeof(*say_async.ring),
+			 "calloc", "say_async.ring");
+		return -1;
+	}
+	for (uint64_t pos = 0; pos < SAY_ASYNC_RING_SIZE; pos++)
+		say_async.ring[pos].seq = pos;
+	say_async.head = say_async.tail = 0;
+	say_async.dropped = 0;
+	say_async.is_sleeping = false;
+	say_async.is_stopped = false;
+	say_async.pid = getpid();
+	tt_pthread_mutex_init(&say_async.mutex, NULL);
+	tt_pthread_cond_init(&say_async.cond, NULL);
+	if (cord_start(&say_async.cord, "log", say_async_f, NULL) != 0) {
+		tt_pthread_cond_destroy(&say_async.cond);
+		tt_pthread_mutex_destroy(&say_async.mutex);
+		free(say_async.ring);
+		say_async.ring = NULL;
+		return -1;
+	}
+	pm_atomic_store_explicit(&say_async.is_enabled, true,
+				 pm_memory_order_release);
+	return 0;
+}
+
+/**
+ * Push a record to the async logger ring unless the async
+ * logger is disabled. Registers the caller as a producer, so
+ * that say_logger_async_free() waits for it to finish.
+ *
+ * @retval true the record was pushed (or dropped as overflow)
+ * @retval false the async logger is disabled
+ */
+static bool
+say_async_try_push(const char *buf, int len)
+{
+	/*
+	 * Both the counter update and the flag load are
+	 * sequentially consistent and pair with the flag store
+	 * and the counter load in say_logger_async_free(): either
+	 * the producer sees the flag cleared or the main thread
+	 * sees the producer.
+	 */
+	pm_atomic_fetch_add_explicit(&say_async.producer_count, 1,
+				     pm_memory_order_seq_cst);
+	bool is_enabled = pm_atomic_load_explicit(&say_async.is_enabled,
+						  pm_memory_order_seq_cst);
+	if (is_enabled)
+		say_async_push(buf, len);
+	pm_atomic_fetch_sub_explicit(&say_async.producer_count, 1,
+				     pm_memory_order_release);
+	return is_enabled;
+}
+
+/**
+ * Stop the logger thread and write the records it has not
+ * written yet. Messages logged after this point are written
+ * synchronously.
+ */
+static void
+say_logger_async_free(void)
+{
+	if (!pm_atomic_load_explicit(&say_async.is_enabled,
+				     pm_memory_order_relaxed) ||
+	    say_async.pid != getpid())
+		return;
+	pm_atomic_store_explicit(&say_async.is_enabled, false,
+				 pm_memory_order_seq_cst);
+	/*
+	 * Wait for threads that saw the logger enabled to finish
+	 * pushing, so that the ring and the mutex outlive them.
+	 */
+	while (pm_atomic_load_explicit(&say_async.producer_count,
+				       pm_memory_order_seq_cst) > 0)
+		sched_yield();
+	pm_atomic_store_explicit(&say_async.is_stopped, true,
+				 pm_memory_order_relaxed);
+	tt_pthread_mutex_lock(&say_async.mutex);
+	tt_pthread_cond_signal(&say_async.cond);
+	tt_pthread_mutex_unlock(&say_async.mutex);
+	if (cord_join(&say_async.cord) != 0)
+		diag_log();
+	say_async_flush();
+	tt_pthread_cond_destroy(&say_async.cond);
+	tt_pthread_mutex_destroy(&say_async.mutex);
+	free(say_async.ring);
+	say_async.ring = NULL;
+}
+
+uint64_t
+say_logger_async_dropped(void)
+{
+	return pm_atomic_load_explicit(&say_async.dropped,
+				       pm_memory_order_relaxed);
+}
+
 void
 vsay(int level, const char *filename, int line, const char *error,
      const char *format, va_list ap)
@@ -514,28 +877,10 @@ vsay(int level, const char *filename, int line, const char *error,
 	if (p >= len - 1)
 		p = len - 1;
 	*(buf + p) = '\n';
-	if (logger_type != SAY_LOGGER_SYSLOG) {
-		(void) write(log_fd, buf, p + 1);
-	} else if (log_fd < 0 || write(log_fd, buf, p + 1) <= 0) {
-		/*
-		 * Try to reconnect, if write to syslog has
-		 * failed. Syslog write can fail, if, for example,
-		 * syslogd is restarted. In such a case write to
-		 * UNIX socket starts return -1 even for UDP.
-		 */
-		if (log_fd >= 0)
-			close(log_fd);
-		log_fd = say_syslog_connect();
-		if (log_fd >= 0) {
-			/*
-			 * In a case or error the log message is
-			 * lost. We can not wait for connection -
-			 * it would block thread. Try to reconnect
-			 * on next vsay().
-			 */
-			(void) write(log_fd, buf, p + 1);
-		}
-	}
+	if (level != S_FATAL && say_async.pid == pid &&
+	    say_async_try_push(buf, p + 1))
+		return;
+	say_write(buf, p + 1);
 
 	if (level == S_FATAL && log_fd != STDERR_FILENO)
 		(void) write(STDERR_FILENO, buf, p + 1);
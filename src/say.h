@@ -33,6 +33,7 @@
 #include <trivia/util.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdarg.h>
 #include <errno.h>
 #include <sys/types.h> /* pid_t */
@@ -80,6 +81,24 @@ void say_logger_init(const char *init_str,
 void
 say_logger_free();
 
+/**
+ * Switch the logger to the asynchronous mode: vsay() formats
+ * a message and pushes it to a bounded lock-free ring, while
+ * a dedicated logger thread writes the ring to the log in
+ * batches. If the ring is full, the message is dropped.
+ * Must be called after say_logger_init() and daemonization,
+ * since the thread doesn't survive fork().
+ *
+ * @retval  0 success
+ * @retval -1 error, diag is set
+ */
+int
+say_logger_async_init(void);
+
+/** Number of messages dropped by the asynchronous logger. */
+uint64_t
+say_logger_async_dropped(void);
+
 CFORMAT(printf, 5, 0) void
 vsay(int level, const char *filename, int line, const char *error,
      const char *format, va_list ap);
@@ -167,6 +167,7 @@
 #cmakedefine HAVE_SCHED_YIELD 1
 #cmakedefine HAVE_POSIX_FADVISE 1
 #cmakedefine HAVE_MREMAP 1
+#cmakedefine HAVE_FALLOCATE 1
 
 #cmakedefine HAVE_PRCTL_H 1
 
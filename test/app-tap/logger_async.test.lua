@@ -0,0 +1,56 @@
+#!/usr/bin/env tarantool
+
+local test = require('tap').test('log_async')
+test:plan(6)
+
+local log = require('log')
+local fio = require('fio')
+local fiber = require('fiber')
+local clock = require('clock')
+
+--
+-- The pipe logger doesn't read anything for a second, so the
+-- logger thread blocks on a full pipe and the ring overflows.
+--
+local filename = "logger_async.log"
+fio.unlink(filename)
+box.cfg{
+    log = 'pipe: sleep 1 && cat > ' .. filename,
+    log_nonblock = false,
+    log_async = true,
+    memtx_memory = 107374182,
+}
+test:is(box.cfg.log_async, true, "log_async")
+test:is(log.dropped(), 0, "nothing dropped")
+
+local start = clock.monotonic()
+for i = 1, 5000 do
+    log.info("message %d", i)
+end
+test:ok(clock.monotonic() - start < 0.5, "logging doesn't block")
+test:ok(log.dropped() > 0, "messages dropped")
+
+-- Wait until a line matching the pattern is written to the log.
+local function wait_line(pattern)
+    local deadline = clock.monotonic() + 10
+    while clock.monotonic() < deadline do
+        local file = io.open(filename)
+        if file ~= nil then
+            for line in file:lines() do
+                if line:match(pattern) then
+                    file:close()
+                    return true
+                end
+            end
+            file:close()
+        end
+        fiber.sleep(0.1)
+    end
+    return false
+end
+
+test:ok(wait_line("message 1$"), "first message written")
+test:ok(wait_line("log messages dropped"), "drops reported")
+
+test:check()
+os.exit()
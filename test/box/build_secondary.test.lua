@@ -0,0 +1,49 @@
+env = require('test_run')
+test_run = env.new()
+
+--
+-- Secondary keys of many spaces are built in bulk at recovery,
+-- more tree indexes than there are build fibers.
+--
+test_run:cmd('create server build_secondary with script = "box/lua/build_secondary.lua"')
+test_run:cmd("start server build_secondary")
+test_run:cmd('switch build_secondary')
+
+test_run:cmd("setopt delimiter ';'")
+for i = 1, 20 do
+    local s = box.schema.space.create('test' .. i)
+    s:create_index('pk')
+    s:create_index('sk', {parts = {2, 'string'}, unique = false})
+    s:create_index('uk', {parts = {3, 'unsigned'}})
+    s:create_index('hash', {type = 'hash', parts = {4, 'string'}})
+    for j = 1, 100 * i do
+        s:insert{j, 'v' .. j % 7, j * 100 + i, 'k' .. j}
+    end
+end;
+test_run:cmd("setopt delimiter ''");
+check()
+box.snapshot()
+
+-- Rows recovered from the WAL.
+test_run:cmd("setopt delimiter ';'")
+for i = 1, 20 do
+    local s = box.space['test' .. i]
+    for j = 100 * i + 1, 150 * i do
+        s:insert{j, 'v' .. j % 7, j * 100 + i, 'k' .. j}
+    end
+    s:delete{1}
+end;
+test_run:cmd("setopt delimiter ''");
+check()
+
+test_run:cmd('switch default')
+test_run:cmd('restart server build_secondary')
+test_run:cmd('switch build_secondary')
+check()
+box.space.test20.index.sk:select('v3', {limit = 3})
+box.space.test7.index.uk:get{70007}
+box.space.test7.index.hash:get{'k700'}
+
+test_run:cmd('switch default')
+test_run:cmd("stop server build_secondary")
+test_run:cmd("cleanup server build_secondary")
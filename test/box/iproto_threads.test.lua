@@ -0,0 +1,36 @@
+env = require('test_run')
+test_run = env.new()
+
+test_run:cmd('create server iproto_threads with script = "box/lua/iproto_threads.lua"')
+test_run:cmd("start server iproto_threads")
+test_run:cmd('switch iproto_threads')
+
+fiber = require('fiber')
+net = require('net.box')
+box.cfg.iproto_threads
+#box.stat.net.THREADS
+box.schema.user.grant('guest', 'read,write,execute', 'universe')
+
+-- Connections are spread evenly across the network threads.
+LISTEN = require('uri').parse(box.cfg.listen)
+conns = {}
+for i = 1, 8 do conns[i] = net.connect(LISTEN.host, LISTEN.service) end
+for i = 1, 8 do conns[i]:ping() end
+function connection_counts() local t = {} for i, s in ipairs(box.stat.net.THREADS) do t[i] = s.CONNECTIONS end return t end
+connection_counts()
+box.stat.net().THREADS[1].CONNECTIONS
+
+-- Requests are served by every connection.
+ok = true
+for i = 1, 8 do ok = ok and conns[i]:eval('return 1 + 1') == 2 end
+ok
+
+for i = 1, 8 do conns[i]:close() end
+function connection_total() local n = 0 for _, s in ipairs(box.stat.net.THREADS) do n = n + s.CONNECTIONS end return n end
+while connection_total() > 0 do fiber.sleep(0.01) end
+connection_counts()
+box.schema.user.revoke('guest', 'read,write,execute', 'universe')
+
+test_run:cmd("switch default")
+test_run:cmd("stop server iproto_threads")
+test_run:cmd("cleanup server iproto_threads")
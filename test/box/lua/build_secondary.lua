@@ -0,0 +1,34 @@
+#!/usr/bin/env tarantool
+os = require('os')
+
+box.cfg{
+    listen              = os.getenv("LISTEN"),
+    worker_pool_threads = 2,
+}
+
+-- Check that all keys of the test spaces are consistent
+-- with the primary key.
+function check()
+    local spaces, rows, ok = 0, 0, true
+    for i = 1, 20 do
+        local s = box.space['test' .. i]
+        local n = s:count()
+        ok = ok and s.index.sk:len() == n and s.index.uk:len() == n and
+             s.index.hash:len() == n
+        local prev = nil
+        for _, t in s.index.sk:pairs() do
+            ok = ok and (prev == nil or prev[2] < t[2] or
+                         (prev[2] == t[2] and prev[1] < t[1]))
+            prev = t
+        end
+        for _, t in s:pairs() do
+            ok = ok and s.index.uk:get{t[3]}[1] == t[1] and
+                 s.index.hash:get{t[4]}[1] == t[1]
+        end
+        spaces = spaces + 1
+        rows = rows + n
+    end
+    return {spaces, rows, ok}
+end
+
+require('console').listen(os.getenv('ADMIN'))
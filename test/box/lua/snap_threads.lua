@@ -0,0 +1,10 @@
+#!/usr/bin/env tarantool
+os = require('os')
+
+box.cfg{
+    listen              = os.getenv("LISTEN"),
+    snap_write_threads  = 3,
+    snap_read_threads   = 3,
+}
+
+require('console').listen(os.getenv('ADMIN'))
@@ -0,0 +1,10 @@
+#!/usr/bin/env tarantool
+os = require('os')
+
+box.cfg{
+    listen              = os.getenv("LISTEN"),
+    wal_preallocate     = true,
+    wal_max_size        = 4 * 1024 * 1024,
+}
+
+require('console').listen(os.getenv('ADMIN'))
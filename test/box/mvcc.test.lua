@@ -0,0 +1,95 @@
+env = require('test_run')
+test_run = env.new()
+
+test_run:cmd('create server mvcc with script = "box/lua/mvcc.lua"')
+test_run:cmd("start server mvcc")
+test_run:cmd('switch mvcc')
+
+fiber = require('fiber')
+box.cfg.memtx_use_mvcc_engine
+
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+_ = s:create_index('sk', {parts = {2, 'unsigned'}, unique = false})
+
+-- A transaction can yield.
+function yield_txn() box.begin() s:replace{1, 10} fiber.sleep(0) s:replace{2, 20} box.commit() end
+yield_txn()
+s:select{}
+
+-- Uncommitted changes are invisible to others, and an attempt
+-- to overwrite them is a conflict.
+wait = fiber.channel(1)
+done = fiber.channel(1)
+function writer(commit) box.begin() s:replace{3, 30} wait:get() if commit then box.commit() else box.rollback() end done:put(true) end
+_ = fiber.create(writer, false)
+s:get{3}
+s.index.sk:select{30}
+s:replace{3, 33}
+wait:put(true)
+done:get()
+s:get{3}
+_ = fiber.create(writer, true)
+s:replace{3, 33}
+wait:put(true)
+done:get()
+s:get{3}
+
+-- A transaction reads from the read view created by its
+-- first statement.
+result = fiber.channel(1)
+function reader() box.begin() local old = s:get{1} wait:get() result:put({old, s:get{1}, s.index.sk:select{11}, s:count()}) box.commit() end
+_ = fiber.create(reader)
+s:replace{1, 11}
+s:insert{4, 40}
+wait:put(true)
+result:get()
+s:get{1}
+s:count()
+
+-- A transaction can't overwrite a change made after its
+-- read view was created.
+function updater() box.begin() s:get{2} wait:get() local ok, err = pcall(s.replace, s, {2, 22}) box.rollback() result:put({ok, tostring(err)}) end
+_ = fiber.create(updater)
+s:replace{2, 21}
+wait:put(true)
+result:get()
+s:get{2}
+
+-- A prepared change is rolled back if the WAL write fails, so
+-- it can't be overwritten until it's committed.
+errinj = box.error.injection
+function wal_writer() local ok, err = pcall(s.replace, s, {5, 50}) result:put({ok, tostring(err)}) end
+errinj.set("ERRINJ_WAL_DELAY", true)
+_ = fiber.create(wal_writer)
+s:get{5}
+s:replace{5, 55}
+s:delete{5}
+errinj.set("ERRINJ_WAL_WRITE", true)
+errinj.set("ERRINJ_WAL_DELAY", false)
+result:get()
+errinj.set("ERRINJ_WAL_WRITE", false)
+s:get{5}
+s.index.sk:select{50}
+s:replace{5, 55}
+s.index.sk:select{55}
+
+-- Old versions stay in indexes while a read view needs them
+-- and are removed when the last such transaction ends.
+t = box.schema.space.create('t')
+_ = t:create_index('pk')
+for i = 1, 10 do t:insert{i} end
+function holder() box.begin() t:get{1} wait:get() box.commit() done:put(true) end
+_ = fiber.create(holder)
+for i = 1, 10 do t:delete{i} end
+t:count(), t.index.pk:len()
+t:truncate()
+wait:put(true)
+done:get()
+t:count(), t.index.pk:len()
+t:drop()
+s:drop()
+
+test_run:cmd("switch default")
+test_run:cmd("stop server mvcc")
+test_run:cmd("cleanup server mvcc")
@@ -759,3 +759,23 @@ c:close()
 box.schema.user.revoke('guest','read,write,execute','universe')
 
 space:drop()
+
+--
+-- Large SELECT responses are sent right from tuple memory.
+--
+space = box.schema.space.create('test')
+_ = space:create_index('primary')
+box.schema.user.grant('guest', 'read', 'space', 'test')
+pad = string.rep('x', 1000)
+for i = 1, 1000 do space:insert{i, pad} end
+c = net.connect(box.cfg.listen)
+res = c.space.test:select()
+#res
+res[1][1] == 1 and res[1000][1] == 1000 and res[1000][2] == pad
+-- a small response after a large one
+c.space.test:select({}, {limit = 100})[100][1]
+c.space.test:select{5}[1][1]
+res = nil
+c:close()
+box.schema.user.revoke('guest', 'read', 'space', 'test')
+space:drop()
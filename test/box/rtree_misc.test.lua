@@ -238,3 +238,27 @@ i:select({0, 0, 0}, {iterator = 'neighbor'})
 i:select({1, 2, 3, 4, 5, 6}, {iterator = 'BITS_ALL_SET' } )
 
 s:drop()
+
+-- coordinate types
+s = box.schema.space.create('spatial')
+i = s:create_index('primary')
+i = s:create_index('spatial', {type = 'rtree', unique = false, parts = {2, 'array'}, coord_type = 'float'})
+s:insert{1, {0.25, 0.25}}
+s:insert{2, {1.75, 1.75}}
+i:select({0.25, 0.25})
+i:select({0, 0, 1, 1}, {iterator = 'le'})
+i:alter{coord_type = 'int32'}
+-- bounding boxes are rounded outward, found records are checked exactly
+i:select({0, 0})
+i:select({2, 2})
+i:select({0.25, 0.25})
+i:select({0, 0, 1, 1}, {iterator = 'le'})
+i:select({0, 0, 0.25, 0.25}, {iterator = 'lt'})
+i:select({0, 0, 0.5, 0.5}, {iterator = 'lt'})
+i:select({0.5, 0.5, 1, 1}, {iterator = 'overlaps'})
+i:select({0, 0}, {iterator = 'neighbor'})
+i:alter{coord_type = 'double'}
+i:select({0, 0})
+i:alter{coord_type = 'half'}
+box.space._index:insert{s.id, 2, 's', 'rtree', {unique = false, coord_type = 'half'}, {{2, 'array'}}}
+s:drop()
@@ -0,0 +1,88 @@
+env = require('test_run')
+test_run = env.new()
+
+--
+-- A snapshot written by several threads is recovered by
+-- several threads into the same data.
+--
+test_run:cmd('create server snap_threads with script = "box/lua/snap_threads.lua"')
+test_run:cmd("start server snap_threads")
+test_run:cmd('switch snap_threads')
+box.cfg.snap_write_threads
+box.cfg.snap_read_threads
+
+test_run:cmd("setopt delimiter ';'")
+for i = 1, 5 do
+    local s = box.schema.space.create('test' .. i)
+    s:create_index('pk')
+    s:create_index('sk', {parts = {2, 'string'}, unique = false})
+    s:create_index('hash', {type = 'hash', parts = {3, 'unsigned'}})
+    for j = 1, 1000 * i do
+        s:insert{j, 'v' .. j % 10, j * 10 + i}
+    end
+end;
+test_run:cmd("setopt delimiter ''");
+function check() local res = {} for i = 1, 5 do local s = box.space['test' .. i] local ok = true for _, t in s:pairs() do ok = ok and s.index.hash:get{t[3]}[1] == t[1] end res[i] = {s:count(), s.index.sk:count('v3'), s.index.hash:len(), ok} end return res end
+check()
+
+--
+-- A big space is split into key ranges written by
+-- different threads.
+--
+big = box.schema.space.create('big')
+_ = big:create_index('pk')
+test_run:cmd("setopt delimiter ';'")
+for i = 0, 299 do
+    box.begin()
+    for j = 1, 1000 do
+        big:insert{i * 1000 + j, i}
+    end
+    box.commit()
+end;
+test_run:cmd("setopt delimiter ''");
+box.snapshot()
+test_run:grep_log('snap_threads', 'writing space .big. in 3 key ranges') ~= nil
+
+--
+-- Rows of system spaces precede rows of user spaces in
+-- the snapshot file, and row LSNs grow across the file.
+--
+fio = require('fio')
+xlog = require('xlog')
+test_run:cmd("setopt delimiter ';'")
+function check_snap()
+    local files = fio.glob(fio.pathjoin(box.cfg.memtx_dir, '*.snap'))
+    table.sort(files)
+    local lsn = -1
+    local is_sorted = true
+    local user_rows = 0
+    for _, row in xlog.pairs(files[#files]) do
+        local row_lsn = row.HEADER.lsn or 0
+        is_sorted = is_sorted and row_lsn > lsn
+        lsn = row_lsn
+        if row.BODY.space_id < box.schema.SYSTEM_ID_MAX then
+            is_sorted = is_sorted and user_rows == 0
+        else
+            user_rows = user_rows + 1
+        end
+    end
+    return is_sorted, user_rows
+end;
+test_run:cmd("setopt delimiter ''");
+check_snap()
+
+test_run:cmd('switch default')
+test_run:cmd('restart server snap_threads')
+test_run:cmd('switch snap_threads')
+function check() local res = {} for i = 1, 5 do local s = box.space['test' .. i] local ok = true for _, t in s:pairs() do ok = ok and s.index.hash:get{t[3]}[1] == t[1] end res[i] = {s:count(), s.index.sk:count('v3'), s.index.hash:len(), ok} end return res end
+check()
+box.space.test5:get{5000}
+box.space.test3.index.sk:select('v7', {limit = 3})
+box.space.big:count()
+box.space.big:min()
+box.space.big:max()
+box.space.big:get{150000}
+
+test_run:cmd('switch default')
+test_run:cmd("stop server snap_threads")
+test_run:cmd("cleanup server snap_threads")
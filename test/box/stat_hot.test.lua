@@ -0,0 +1,35 @@
+-- heavy hitter sampling is disabled by default
+box.cfg.hotspot_sample_rate
+box.cfg{hotspot_sample_rate = 2}
+box.cfg{hotspot_sample_rate = -1}
+
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+box.stat.hot.reset()
+box.cfg{hotspot_sample_rate = 1}
+
+for i = 1, 10 do s:replace{1} end
+for i = 1, 5 do s:replace{i + 1, 'x'} end
+for i = 1, 5 do s:select{1} end
+s:select{} -- range scans are accounted to the space only
+s:upsert({1}, {{'=', 2, 'y'}})
+s:update({100}, {{'=', 2, 'y'}})
+
+hot = box.stat.hot()
+hot.spaces[1].space_id == s.id
+hot.spaces[1].count
+hot.spaces[1].error
+hot.keys[1].space_id == s.id
+hot.keys[1].index_id
+hot.keys[1].key
+hot.keys[1].count
+#hot.keys
+
+box.cfg{hotspot_sample_rate = 0}
+s:replace{1}
+box.stat.hot().spaces[1].count
+box.stat.hot.reset()
+box.stat.hot().spaces
+box.stat.hot().keys
+
+s:drop()
@@ -21,6 +21,15 @@ box.stat.net.RECEIVED.total > 0
 -- box.stat.net.EVENTS.total > 0
 -- box.stat.net.LOCKS.total > 0
 
+-- request latency percentiles
+latency = box.stat.net.LATENCY
+latency.SELECT.total.p50 > 0
+latency.SELECT.total.p50 <= latency.SELECT.total.p999
+latency.SELECT.tx.p99 <= latency.SELECT.total.p99
+latency.FLUSH.p50 > 0
+latency.INSERT
+box.stat.net().LATENCY.SELECT ~= nil
+
 space:drop()
 cn:close()
 box.schema.user.revoke('guest','read,write,execute','universe')
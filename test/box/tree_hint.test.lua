@@ -0,0 +1,47 @@
+-- elements of tree indexes with the hint option are ordered by
+-- comparison hints first, check the order agrees with the one of
+-- tuple comparators
+s = box.schema.space.create('test')
+i1 = s:create_index('i1', {parts = {1, 'integer'}, hint = true})
+i2 = s:create_index('i2', {parts = {2, 'number', 1, 'integer'}, hint = true})
+i3 = s:create_index('i3', {parts = {3, 'string', 1, 'integer'}, hint = true})
+
+_ = s:insert{-100, 1.5, 'abcdefgh1'}
+_ = s:insert{-1, -1, 'abcdefgh'}
+_ = s:insert{0, 0, ''}
+_ = s:insert{1, 1, 'abcdefgh0'}
+_ = s:insert{2, 1.25, 'abc'}
+_ = s:insert{100, -0.5, 'b'}
+_ = s:insert{18446744073709551615ULL, 1e10, 'abcdefghi'}
+_ = s:insert{-9223372036854775808LL, -1000.5, 'abcdefgg'}
+
+i1:select{}
+i2:select{}
+i3:select{}
+
+i1:select({1}, {iterator = 'GE'})
+i1:select({-1}, {iterator = 'LT'})
+i2:select({1}, {iterator = 'GT'})
+i2:select({-0.5})
+i2:select({0}, {iterator = 'LE'})
+i3:select({'abcdefgh'})
+i3:select({'abcdefgh'}, {iterator = 'GT', limit = 3})
+i3:select({'abcdefgh0'}, {iterator = 'LE'})
+
+_ = s:delete{2}
+_ = s:delete{100}
+i2:select{}
+i3:select{}
+
+-- hints are off by default and toggling them rebuilds the index
+i4 = s:create_index('i4', {parts = {3, 'string', 1, 'integer'}})
+box.space._index:get{s.id, i4.id}[5].hint
+box.space._index:get{s.id, i3.id}[5].hint
+i3:alter({hint = false})
+box.space._index:get{s.id, i3.id}[5].hint
+i3:select({'abcdefgh'}, {iterator = 'GE'})
+i4:alter({hint = true})
+i4:select({'abcdefgh'}, {iterator = 'GE'})
+s:create_index('i5', {parts = {1, 'integer'}, hint = 1})
+
+s:drop()
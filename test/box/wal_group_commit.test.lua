@@ -0,0 +1,60 @@
+-- group commit is disabled by default
+box.cfg.wal_commit_delay
+box.cfg.wal_max_batch_rows
+box.cfg.wal_max_batch_bytes
+box.cfg{wal_commit_delay = -1}
+box.cfg{wal_max_batch_rows = 0}
+box.cfg{wal_max_batch_bytes = 0}
+
+fiber = require('fiber')
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+
+test_run = require('test_run').new()
+test_run:cmd("setopt delimiter ';'")
+function write(count)
+    local ch = fiber.channel(count)
+    for i = 1, count do
+        fiber.create(function()
+            ch:put((pcall(s.auto_increment, s, {i})))
+        end)
+    end
+    local ok = 0
+    for i = 1, count do
+        if ch:get() then ok = ok + 1 end
+    end
+    return ok
+end;
+test_run:cmd("setopt delimiter ''");
+
+box.cfg{wal_commit_delay = 0.01}
+lsn = box.info.lsn
+write(100)
+box.info.lsn - lsn
+s:count()
+
+-- a batch is sent as soon as it's full
+box.cfg{wal_commit_delay = 100, wal_max_batch_rows = 10}
+write(50)
+s:count()
+
+-- disabling group commit sends the pending batch
+ch = fiber.channel(1)
+_ = fiber.create(function() ch:put((pcall(s.replace, s, {1000}))) end)
+ch:get(0.1)
+box.cfg{wal_commit_delay = 0}
+ch:get()
+s:get{1000}
+
+box.cfg{wal_max_batch_rows = 4096}
+write(10)
+s:count()
+
+-- checkpoint flushes the pending batch
+box.cfg{wal_commit_delay = 100}
+_ = fiber.create(function() ch:put((pcall(s.replace, s, {2000}))) end)
+box.snapshot()
+ch:get()
+box.cfg{wal_commit_delay = 0}
+
+s:drop()
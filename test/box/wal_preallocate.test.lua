@@ -0,0 +1,37 @@
+env = require('test_run')
+test_run = env.new()
+
+test_run:cmd('create server prealloc with script = "box/lua/wal_preallocate.lua"')
+test_run:cmd("start server prealloc")
+test_run:cmd('switch prealloc')
+
+fio = require('fio')
+xlog = require('xlog')
+box.cfg.wal_preallocate
+
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+for i = 1, 100 do s:insert{i, string.rep('x', 100)} end
+files = fio.glob(fio.pathjoin(box.cfg.wal_dir, '*.xlog'))
+table.sort(files)
+path = files[#files]
+
+-- Preallocation doesn't change the file size.
+size = fio.stat(path).size
+size < box.cfg.wal_max_size
+
+-- The file can be read while it is being written.
+rows = 0
+for _, row in xlog.pairs(path) do if row.BODY.space_id == s.id then rows = rows + 1 end end
+rows
+
+-- The file is closed on checkpoint: it ends with the EOF
+-- marker and the space left unused is released.
+box.snapshot()
+fio.stat(path).size - size
+fio.stat(path).blocks * 512 < box.cfg.wal_max_size
+s:drop()
+
+test_run:cmd("switch default")
+test_run:cmd("stop server prealloc")
+test_run:cmd("cleanup server prealloc")
@@ -0,0 +1,44 @@
+env = require('test_run')
+test_run = env.new()
+fiber = require('fiber')
+
+box.schema.user.grant('guest', 'replication')
+m = box.schema.space.create('test', {engine = 'memtx'})
+_ = m:create_index('pk')
+v = box.schema.space.create('vtest', {engine = 'vinyl'})
+_ = v:create_index('pk')
+
+test_run:cmd("create server replica with rpl_master=default, script='replication/replica_batch.lua'")
+test_run:cmd("start server replica")
+test_run:cmd("switch replica")
+fiber = require('fiber')
+test_run = require('test_run').new()
+box.cfg.replication_apply_batch
+-- Block the applier on the first row, so that the following
+-- rows are buffered and applied as one batch.
+box.error.injection.set("ERRINJ_WAL_DELAY", true)
+
+test_run:cmd("switch default")
+m:insert{0}
+for i = 1, 10 do m:insert{i} end
+-- A row of another engine makes the batch fall back to
+-- row-by-row apply in the middle.
+v:insert{1}
+for i = 11, 20 do m:insert{i} end
+fiber.sleep(0.1)
+
+test_run:cmd("switch replica")
+box.error.injection.set("ERRINJ_WAL_DELAY", false)
+while box.space.test:count() < 21 do fiber.sleep(0.01) end
+box.space.test:count()
+box.space.test:get{20}
+box.space.vtest:select{}
+box.info.replication[1].upstream.status
+box.info.vclock[1] == test_run:eval('default', 'return box.info.vclock[1]')[1]
+
+test_run:cmd("switch default")
+test_run:cmd("stop server replica")
+test_run:cmd("cleanup server replica")
+m:drop()
+v:drop()
+box.schema.user.revoke('guest', 'replication')
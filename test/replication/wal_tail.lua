@@ -0,0 +1,9 @@
+#!/usr/bin/env tarantool
+
+box.cfg({
+    listen              = os.getenv("LISTEN"),
+    memtx_memory        = 107374182,
+    wal_relay_buffer_size = 64 * 1024,
+})
+
+require('console').listen(os.getenv('ADMIN'))
@@ -0,0 +1,50 @@
+env = require('test_run')
+test_run = env.new()
+
+--
+-- A replica which keeps up with the master is served from
+-- the in-memory WAL tail buffer, a replica which falls behind
+-- it reads xlog files.
+--
+test_run:cmd("create server wal_tail with script='replication/wal_tail.lua'")
+test_run:cmd("start server wal_tail")
+test_run:cmd("switch wal_tail")
+test_run = require('test_run').new()
+fiber = require('fiber')
+box.cfg.wal_relay_buffer_size
+box.schema.user.grant('guest', 'replication')
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+
+test_run:cmd("create server replica with rpl_master=wal_tail, script='replication/replica.lua'")
+test_run:cmd("start server replica")
+test_run:cmd("switch wal_tail")
+for i = 1, 100 do s:replace{i} end
+test_run:cmd("switch replica")
+fiber = require('fiber')
+while box.space.test:count() < 100 do fiber.sleep(0.01) end
+box.space.test:count()
+test_run:cmd("switch wal_tail")
+test_run:grep_log('wal_tail', 'reading rows from the WAL tail buffer') ~= nil
+test_run:grep_log('wal_tail', 'fell behind the WAL tail buffer') == nil
+
+-- Make the relay miss WAL events while the master writes
+-- much more than fits in the buffer.
+box.error.injection.set("ERRINJ_RELAY_DROP_EVENTS", true)
+pad = string.rep('x', 1000)
+for i = 1, 1000 do s:replace{i, pad} end
+box.error.injection.set("ERRINJ_RELAY_DROP_EVENTS", false)
+_ = s:replace{1001, pad}
+while test_run:grep_log('wal_tail', 'fell behind the WAL tail buffer') == nil do fiber.sleep(0.01) end
+test_run:cmd("switch replica")
+while box.space.test:count() < 1001 do fiber.sleep(0.01) end
+box.space.test:count()
+box.space.test:get(1000)[2] == string.rep('x', 1000)
+test_run:cmd("switch wal_tail")
+box.info.vclock[1] == test_run:eval('replica', 'return box.info.vclock[1]')[1]
+
+test_run:cmd("switch default")
+test_run:cmd("stop server replica")
+test_run:cmd("cleanup server replica")
+test_run:cmd("stop server wal_tail")
+test_run:cmd("cleanup server wal_tail")
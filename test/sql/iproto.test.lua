@@ -179,6 +179,21 @@ _ = space:replace{1, 1, string.rep('a', 4 * 1024 * 1024)}
 res = cn:execute('select * from test')
 res.metadata
 
+-- Large result sets with columns of several types, split between
+-- slabs of the buffer the rows are encoded to.
+cn:execute('create table test4 (id primary key, a int, b float, c text, d)')
+space4 = box.space.test4
+for i = 1, 3000 do space4:replace{i, i * 3, i + 0.5, string.rep(string.char(65 + i % 26), i % 700), i % 2 == 0 and box.NULL or 'x'} end
+function check(rows, first, step) local ok = true for j, row in ipairs(rows) do local t = space4:get{first + (j - 1) * step} if #row ~= #t then ok = false end for k = 1, #t do if row[k] ~= t[k] then ok = false end end end return ok end
+res = cn:execute('select * from test4')
+#res.rows
+check(res.rows, 1, 1)
+res = cn:execute('select * from test4 where id % 7 = 0')
+#res.rows
+check(res.rows, 7, 7)
+res = nil
+cn:execute('drop table test4')
+
 cn:close()
 box.schema.user.revoke('guest', 'read,write,execute', 'universe')
 box.sql.execute('drop table test')
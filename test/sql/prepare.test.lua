@@ -0,0 +1,90 @@
+test_run = require('test_run').new()
+msgpack = require('msgpack')
+socket = require('socket')
+uri = require('uri')
+
+--
+-- IPROTO_PREPARE and IPROTO_EXECUTE by statement id. net.box
+-- has no API for them yet, so requests are encoded by hand.
+--
+box.sql.execute('create table test (id primary key, a)')
+box.space.test:replace{1, 10}
+box.space.test:replace{2, 20}
+box.schema.user.grant('guest','read,write,execute', 'universe')
+
+u = uri.parse(box.cfg.listen)
+s = socket.tcp_connect(u.host, u.service)
+greeting = s:read(128)
+sync = 0
+test_run:cmd("setopt delimiter ';'")
+function request(type, body)
+    sync = sync + 1
+    local data = msgpack.encode({[0x00] = type, [0x01] = sync}) ..
+                 msgpack.encode(body)
+    s:write(msgpack.encode(#data) .. data)
+    local size = msgpack.decode(s:read(5))
+    local response = s:read(size)
+    local header, pos = msgpack.decode(response)
+    body = msgpack.decode(response, pos)
+    if header[0x00] ~= 0 then
+        return {error = body[0x31]}
+    end
+    return body
+end;
+function prepare(sql)
+    local res = request(12, {[0x40] = sql})
+    return res.error ~= nil and res or res[0x45]
+end;
+function execute(id, bind)
+    local res = request(11, {[0x45] = id, [0x41] = bind or {}})
+    if res.error ~= nil then
+        return res
+    end
+    return res[0x30] or res[0x43][0x44]
+end;
+test_run:cmd("setopt delimiter ''");
+
+select_id = prepare('select * from test where id >= ?')
+type(select_id)
+select_id > 0
+execute(select_id, {1})
+execute(select_id, {2})
+-- The same text is prepared into the same statement.
+prepare('select * from test where id >= ?') == select_id
+insert_id = prepare('insert into test values (?, ?)')
+insert_id ~= select_id
+execute(insert_id, {3, 30})
+execute(select_id, {3})
+
+-- Errors.
+prepare('select * from not_existing_table')
+err = execute(select_id + 1000).error
+err == string.format('Prepared statement %d was not found', select_id + 1000)
+request(11, {[0x45] = 0})
+request(12, {[0x45] = select_id})
+
+--
+-- DDL invalidates compiled statements, but their ids remain
+-- valid: a statement is compiled again on next use.
+--
+box.sql.execute('drop table test')
+execute(select_id, {1})
+box.sql.execute('create table test (id primary key, a, b)')
+box.space.test:replace{1, 10, 100}
+execute(select_id, {1})
+execute(insert_id, {2, 20})
+_ = box.space.test:create_index('a', {parts = {2, 'scalar'}})
+execute(select_id, {1})
+
+--
+-- Statements executed by text never evict prepared ones,
+-- however many of them there are.
+--
+for i = 1, 1100 do request(11, {[0x40] = 'select * from test where id = ' .. i, [0x41] = {}}) end
+execute(select_id, {1})
+-- A statement executed by text gets an id once prepared.
+prepare('select * from test where id = 1') > insert_id
+
+s:close()
+box.schema.user.revoke('guest', 'read,write,execute', 'universe')
+box.sql.execute('drop table test')
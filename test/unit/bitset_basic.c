@@ -195,12 +195,74 @@ void test_get_set()
 	footer();
 }
 
+static
+void test_sparse()
+{
+	header();
+
+	struct bitset bm;
+	bitset_create(&bm, realloc);
+	struct bitset_info info;
+
+	/* A few bits in a page are stored as a sparse page */
+	const size_t first = 2560;
+	for (size_t i = 0; i < 8; i++)
+		fail_if(bitset_set(&bm, first + i * 7) < 0);
+	bitset_info(&bm, &info);
+	fail_unless(info.pages == 1);
+	fail_unless(info.sparse_pages == 1);
+	size_t mem_used = info.mem_used;
+	fail_unless(mem_used < info.page_total_size);
+
+	/* The offset array grows with the page */
+	for (size_t i = 8; i < 64; i++)
+		fail_if(bitset_set(&bm, first + i * 7) < 0);
+	bitset_info(&bm, &info);
+	fail_unless(info.pages == 1);
+	fail_unless(info.sparse_pages == 1);
+	fail_unless(info.mem_used > mem_used);
+	for (size_t i = 0; i < 64 * 7; i++)
+		fail_unless(bitset_test(&bm, first + i) == (i % 7 == 0));
+
+	/* More bits convert the page to a bitmap */
+	for (size_t i = 64; i < 128; i++)
+		fail_if(bitset_set(&bm, first + i * 7) < 0);
+	bitset_info(&bm, &info);
+	fail_unless(info.pages == 1);
+	fail_unless(info.sparse_pages == 0);
+	fail_unless(bitset_cardinality(&bm) == 128);
+	for (size_t i = 0; i < 128 * 7; i++)
+		fail_unless(bitset_test(&bm, first + i) == (i % 7 == 0));
+
+	/* And back to a sparse page when most bits are cleared */
+	for (size_t i = 3; i < 128; i++)
+		fail_if(bitset_clear(&bm, first + i * 7) < 0);
+	bitset_info(&bm, &info);
+	fail_unless(info.pages == 1);
+	fail_unless(info.sparse_pages == 1);
+	fail_unless(bitset_cardinality(&bm) == 3);
+	for (size_t i = 0; i < 128 * 7; i++)
+		fail_unless(bitset_test(&bm, first + i) ==
+			    (i % 7 == 0 && i < 3 * 7));
+
+	for (size_t i = 0; i < 3; i++)
+		fail_if(bitset_clear(&bm, first + i * 7) < 0);
+	bitset_info(&bm, &info);
+	fail_unless(info.pages == 0);
+	fail_unless(bitset_cardinality(&bm) == 0);
+
+	bitset_destroy(&bm);
+
+	footer();
+}
+
 int main(int argc, char *argv[])
 {
 	setbuf(stdout, NULL);
 	srand(time(NULL));
 	test_cardinality();
 	test_get_set();
+	test_sparse();
 
 	return 0;
 }
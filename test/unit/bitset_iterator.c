@@ -474,6 +474,52 @@ void test_disjunction()
 	footer();
 }
 
+static
+void test_modify()
+{
+	header();
+
+	struct bitset **bitsets = bitsets_create(2);
+	const size_t page_bit = 1280;
+
+	bitset_set(bitsets[0], 0);
+	bitset_set(bitsets[1], page_bit + 1);
+	bitset_set(bitsets[1], 2 * page_bit + 1);
+
+	struct bitset_expr expr;
+	bitset_expr_create(&expr, realloc);
+	for (size_t b = 0; b < 2; b++) {
+		fail_unless(bitset_expr_add_conj(&expr) == 0);
+		fail_unless(bitset_expr_add_param(&expr, b, false) == 0);
+	}
+
+	struct bitset_iterator it;
+	bitset_iterator_create(&it, realloc);
+	fail_unless(bitset_iterator_init(&it, &expr, bitsets, 2) == 0);
+	bitset_expr_destroy(&expr);
+
+	fail_unless(bitset_iterator_next(&it) == 0);
+
+	/*
+	 * The iterator has looked up the pages of the second
+	 * bitset already. Move one of them to a new allocation
+	 * and free the other one.
+	 */
+	for (size_t i = 2; i < 100; i++)
+		fail_if(bitset_set(bitsets[1], page_bit + i) < 0);
+	fail_unless(bitset_clear(bitsets[1], 2 * page_bit + 1) == 1);
+
+	for (size_t i = 1; i < 100; i++)
+		fail_unless(bitset_iterator_next(&it) == page_bit + i);
+	fail_unless(bitset_iterator_next(&it) == SIZE_MAX);
+
+	bitset_iterator_destroy(&it);
+
+	bitsets_destroy(bitsets, 2);
+
+	footer();
+}
+
 int main(void)
 {
 	setbuf(stdout, NULL);
@@ -489,6 +535,7 @@ int main(void)
 	test_not_empty();
 	test_not_last();
 	test_disjunction();
+	test_modify();
 
 	return 0;
 }
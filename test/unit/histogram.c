@@ -171,6 +171,42 @@ test_percentile(void)
 	footer();
 }
 
+static void
+test_merge(void)
+{
+	header();
+
+	size_t n_buckets;
+	int64_t *buckets = gen_buckets(&n_buckets);
+
+	size_t data_len;
+	int64_t *data = gen_rand_data(&data_len);
+
+	struct histogram *hist = histogram_new(buckets, n_buckets);
+	struct histogram *part1 = histogram_new(buckets, n_buckets);
+	struct histogram *part2 = histogram_new(buckets, n_buckets);
+	for (size_t i = 0; i < data_len; i++) {
+		histogram_collect(hist, data[i]);
+		histogram_collect(i % 3 == 0 ? part1 : part2, data[i]);
+	}
+	histogram_merge(part1, part2);
+
+	fail_if(part1->total != hist->total);
+	fail_if(part1->max != hist->max);
+	for (size_t b = 0; b < n_buckets; b++)
+		fail_if(part1->buckets[b].count != hist->buckets[b].count);
+	fail_if(histogram_percentile(part1, 99.9) !=
+		histogram_percentile(hist, 99.9));
+
+	histogram_delete(part2);
+	histogram_delete(part1);
+	histogram_delete(hist);
+	free(data);
+	free(buckets);
+
+	footer();
+}
+
 int
 main()
 {
@@ -178,4 +214,5 @@ main()
 	test_counts();
 	test_discard();
 	test_percentile();
+	test_merge();
 }
@@ -42,7 +42,7 @@ simple_check()
 	struct rtree tree;
 	rtree_init(&tree, 2, extent_size,
 		   extent_alloc, extent_free, &page_count,
-		   RTREE_EUCLID);
+		   RTREE_EUCLID, RTREE_COORD_DOUBLE);
 
 	printf("Insert 1..X, remove 1..X\n");
 	for (size_t i = 1; i <= rounds; i++) {
@@ -236,7 +236,7 @@ neighbor_test()
 		struct rtree tree;
 		rtree_init(&tree, 2, extent_size,
 			   extent_alloc, extent_free, &page_count,
-			   RTREE_EUCLID);
+			   RTREE_EUCLID, RTREE_COORD_DOUBLE);
 
 		rtree_test_build(&tree, arr, i);
 
@@ -260,7 +260,7 @@ neighbor_test()
 	rtree_iterator_init(&iterator);
 	struct rtree tree;
 	rtree_init(&tree, 2, extent_size, extent_alloc, extent_free, &page_count, 
-			RTREE_EUCLID);
+			RTREE_EUCLID, RTREE_COORD_DOUBLE);
 	if (rtree_search(&tree, &basis, SOP_NEIGHBOR, &iterator)) {
 		fail("found in empty", "true");
 	}
@@ -276,12 +276,204 @@ neighbor_test()
 	footer();
 }
 
+static void
+bulk_load_check()
+{
+	header();
+
+	const size_t counts[] = {0, 1, 10, 100, 1000, 10000};
+	struct rtree_rect rect;
+	static struct rtree_rect basis;
+
+	for (size_t k = 0; k < sizeof(counts) / sizeof(counts[0]); k++) {
+		size_t count = counts[k];
+		struct rtree tree;
+		rtree_init(&tree, 2, extent_size,
+			   extent_alloc, extent_free, &page_count,
+			   RTREE_EUCLID, RTREE_COORD_DOUBLE);
+
+		size_t elem_size = rtree_bulk_elem_size(&tree);
+		char *elems = (char *)malloc(count * elem_size + 1);
+		for (size_t i = 0; i < count; i++) {
+			/* Insert in an order other than the spatial one */
+			size_t j = (i * 7919) % count;
+			rtree_set2d(&rect, j, j, j + 0.5, j + 0.5);
+			rtree_bulk_elem_set(&tree, elems + i * elem_size,
+					    &rect, (record_t)(j + 1));
+		}
+		rtree_bulk_load(&tree, elems, count);
+		free(elems);
+
+		if (rtree_number_of_records(&tree) != count) {
+			fail("Tree count mismatch (bulk)", "true");
+		}
+		struct rtree_iterator iterator;
+		rtree_iterator_init(&iterator);
+		for (size_t i = 0; i < count; i++) {
+			rtree_set2d(&rect, i, i, i + 0.5, i + 0.5);
+			if (!rtree_search(&tree, &rect, SOP_EQUALS,
+					  &iterator)) {
+				fail("element in tree (bulk)", "false");
+			}
+			if (rtree_iterator_next(&iterator) !=
+			    (record_t)(i + 1)) {
+				fail("right search result (bulk)", "true");
+			}
+			if (rtree_iterator_next(&iterator)) {
+				fail("single search result (bulk)", "true");
+			}
+		}
+		if (!rtree_search(&tree, &basis, SOP_NEIGHBOR, &iterator) &&
+		    count != 0) {
+			fail("search is successful (bulk)", "true");
+		}
+		for (size_t i = 0; i < count; i++) {
+			if (rtree_iterator_next(&iterator) !=
+			    (record_t)(i + 1)) {
+				fail("wrong neighbor search result (bulk)",
+				     "true");
+			}
+		}
+		rtree_iterator_destroy(&iterator);
+
+		/* The tree must remain usable after bulk loading */
+		rtree_set2d(&rect, count, count, count + 0.5, count + 0.5);
+		rtree_insert(&tree, &rect, (record_t)(count + 1));
+		for (size_t i = 0; i <= count; i++) {
+			rtree_set2d(&rect, i, i, i + 0.5, i + 0.5);
+			if (!rtree_remove(&tree, &rect, (record_t)(i + 1))) {
+				fail("delete element in tree (bulk)", "false");
+			}
+		}
+		if (rtree_number_of_records(&tree) != 0) {
+			fail("Tree count mismatch (bulk)", "true");
+		}
+		rtree_destroy(&tree);
+	}
+
+	footer();
+}
+
+static void
+coord_type_check()
+{
+	header();
+
+	const enum rtree_coord_type types[] = {
+		RTREE_COORD_DOUBLE, RTREE_COORD_FLOAT, RTREE_COORD_INT32
+	};
+	const size_t count = 1000;
+	size_t double_size = 0;
+	struct rtree_rect rect;
+	struct rtree_iterator iterator;
+
+	for (size_t k = 0; k < sizeof(types) / sizeof(types[0]); k++) {
+		struct rtree tree;
+		rtree_init(&tree, 2, extent_size,
+			   extent_alloc, extent_free, &page_count,
+			   RTREE_EUCLID, types[k]);
+		rtree_iterator_init(&iterator);
+		for (size_t i = 0; i < count; i++) {
+			rtree_set2d(&rect, i, i, i + 1, i + 1);
+			rtree_insert(&tree, &rect, (record_t)(i + 1));
+		}
+		if (types[k] == RTREE_COORD_DOUBLE) {
+			double_size = rtree_used_size(&tree);
+		} else if (rtree_used_size(&tree) >= double_size) {
+			fail("narrow coordinates take less memory", "false");
+		}
+		for (size_t i = 0; i < count; i++) {
+			rtree_set2d(&rect, i, i, i + 1, i + 1);
+			if (!rtree_search(&tree, &rect, SOP_EQUALS,
+					  &iterator)) {
+				fail("element in tree (coord)", "false");
+			}
+			if (rtree_iterator_next(&iterator) !=
+			    (record_t)(i + 1)) {
+				fail("right search result (coord)", "true");
+			}
+			if (rtree_iterator_next(&iterator)) {
+				fail("single search result (coord)", "true");
+			}
+		}
+		rtree_set2d(&rect, 10.2, 10.2, 19.8, 19.8);
+		if (!rtree_search(&tree, &rect, SOP_BELONGS, &iterator)) {
+			fail("elements in rectangle (coord)", "false");
+		}
+		size_t found = 0, matched = 0;
+		record_t rec;
+		while ((rec = rtree_iterator_next(&iterator)) != NULL) {
+			found++;
+			size_t i = (size_t)rec - 1;
+			struct rtree_rect rec_rect;
+			rtree_set2d(&rec_rect, i, i, i + 1, i + 1);
+			if (rtree_rect_match(&rec_rect, &rect, SOP_BELONGS, 2))
+				matched++;
+		}
+		/* Rectangle bounds are rounded outward for integers */
+		if (found != (types[k] == RTREE_COORD_INT32 ? 10 : 8)) {
+			fail("count of elements in rectangle (coord)", "true");
+		}
+		if (matched != 8) {
+			fail("count of matching elements (coord)", "true");
+		}
+		for (size_t i = 0; i < count; i++) {
+			rtree_set2d(&rect, i, i, i + 1, i + 1);
+			if (!rtree_remove(&tree, &rect, (record_t)(i + 1))) {
+				fail("delete element in tree (coord)", "false");
+			}
+		}
+		if (rtree_number_of_records(&tree) != 0) {
+			fail("Tree count mismatch (coord)", "true");
+		}
+		rtree_iterator_destroy(&iterator);
+		rtree_destroy(&tree);
+	}
+
+	/* Boxes are rounded outward to integers */
+	struct rtree tree;
+	rtree_init(&tree, 2, extent_size, extent_alloc, extent_free,
+		   &page_count, RTREE_EUCLID, RTREE_COORD_INT32);
+	rtree_iterator_init(&iterator);
+	struct rtree_rect rec_rect;
+	rtree_set2dp(&rec_rect, 0.4, -2.6);
+	rtree_insert(&tree, &rec_rect, (record_t)1);
+	rtree_set2dp(&rect, 1e12, -1e12);
+	rtree_insert(&tree, &rect, (record_t)2);
+	if (!rtree_search(&tree, &rec_rect, SOP_EQUALS, &iterator) ||
+	    rtree_iterator_next(&iterator) != (record_t)1) {
+		fail("rounded element in tree", "false");
+	}
+	rtree_set2d(&rect, 0.5, -3, 1, -2);
+	if (!rtree_search(&tree, &rect, SOP_OVERLAPS, &iterator) ||
+	    rtree_iterator_next(&iterator) != (record_t)1) {
+		fail("rounded element covers the rectangle", "false");
+	}
+	if (rtree_rect_match(&rec_rect, &rect, SOP_OVERLAPS, 2)) {
+		fail("rounded element matches exactly", "true");
+	}
+	rtree_set2dp(&rect, 0, -3);
+	if (rtree_search(&tree, &rect, SOP_EQUALS, &iterator)) {
+		fail("rounded element equals its bounds", "true");
+	}
+	rtree_set2dp(&rect, INT32_MAX, INT32_MIN);
+	if (!rtree_search(&tree, &rect, SOP_EQUALS, &iterator) ||
+	    rtree_iterator_next(&iterator) != (record_t)2) {
+		fail("saturated element in tree", "false");
+	}
+	rtree_iterator_destroy(&iterator);
+	rtree_destroy(&tree);
+
+	footer();
+}
 
 int
 main(void)
 {
 	simple_check();
 	neighbor_test();
+	bulk_load_check();
+	coord_type_check();
 	if (page_count != 0) {
 		fail("memory leak!", "true");
 	}
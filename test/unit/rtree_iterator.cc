@@ -36,7 +36,7 @@ iterator_check()
 	struct rtree tree;
 	rtree_init(&tree, 2, extent_size,
 		   extent_alloc, extent_free, &extent_count,
-		   RTREE_EUCLID);
+		   RTREE_EUCLID, RTREE_COORD_DOUBLE);
 
 	/* Filling tree */
 	const size_t count1 = 10000;
@@ -219,7 +219,7 @@ iterator_invalidate_check()
 		struct rtree tree;
 		rtree_init(&tree, 2, extent_size,
 			   extent_alloc, extent_free, &extent_count,
-			   RTREE_EUCLID);
+			   RTREE_EUCLID, RTREE_COORD_DOUBLE);
 		struct rtree_iterator iterators[test_size];
 		for (size_t i = 0; i < test_size; i++)
 			rtree_iterator_init(iterators + i);
@@ -265,7 +265,7 @@ iterator_invalidate_check()
 		struct rtree tree;
 		rtree_init(&tree, 2, extent_size,
 			   extent_alloc, extent_free, &extent_count,
-			   RTREE_EUCLID);
+			   RTREE_EUCLID, RTREE_COORD_DOUBLE);
 		struct rtree_iterator iterators[test_size];
 		for (size_t i = 0; i < test_size; i++)
 			rtree_iterator_init(iterators + i);
@@ -492,7 +492,7 @@ rand_test()
 	struct rtree tree;
 	rtree_init(&tree, DIMENSION, extent_size,
 		   extent_alloc, extent_free, &page_count,
-		   RTREE_EUCLID);
+		   RTREE_EUCLID, RTREE_COORD_DOUBLE);
 
 	printf("\tDIMENSION: %u, page size: %u, max fill good: %d\n",
 	       DIMENSION, tree.page_size, tree.page_max_fill >= 10);
@@ -3,6 +3,7 @@
 #include "vy_index.h"
 #include "vy_cache.h"
 #include "vy_run.h"
+#include "xlog.h"
 #include "fiber.h"
 #include <small/lsregion.h>
 #include <small/slab_cache.h>
@@ -33,7 +34,7 @@ test_basic()
 	is(rc, 0, "vy_index_env_create");
 
 	struct vy_run_env run_env;
-	vy_run_env_create(&run_env);
+	vy_run_env_create(&run_env, 0);
 
 	struct vy_cache_env cache_env;
 	vy_cache_env_create(&cache_env, slab_cache, QUOTA);
@@ -165,7 +166,8 @@ test_basic()
 
 	rc = vy_run_write(run, dir_name, 0, pk->id,
 			  write_stream, 4096, pk->cmp_def, pk->key_def,
-			  100500, 0.1);
+			  100500, 0.1, false,
+			  XLOG_COMPRESSION_LEVEL_DEFAULT, 0);
 	is(rc, 0, "vy_run_write");
 
 	write_stream->iface->close(write_stream);
@@ -202,7 +204,8 @@ test_basic()
 
 	rc = vy_run_write(run, dir_name, 0, pk->id,
 			  write_stream, 4096, pk->cmp_def, pk->key_def,
-			  100500, 0.1);
+			  100500, 0.1, false,
+			  XLOG_COMPRESSION_LEVEL_DEFAULT, 0);
 	is(rc, 0, "vy_run_write");
 
 	write_stream->iface->close(write_stream);
@@ -297,15 +300,179 @@ test_basic()
 	footer();
 }
 
+static void
+test_page_bloom()
+{
+	header();
+	plan(15);
+
+	const size_t QUOTA = 100 * 1024 * 1024;
+	int64_t generation = 0;
+	struct slab_cache *slab_cache = cord_slab_cache();
+	struct lsregion lsregion;
+	lsregion_create(&lsregion, slab_cache->arena);
+
+	int rc;
+	struct vy_index_env index_env;
+	rc = vy_index_env_create(&index_env, ".", &lsregion, &generation,
+				 NULL, NULL);
+	is(rc, 0, "vy_index_env_create");
+
+	/* A page cache too small to keep all page filters. */
+	struct vy_run_env run_env;
+	vy_run_env_create(&run_env, 1024);
+
+	struct vy_cache_env cache_env;
+	vy_cache_env_create(&cache_env, slab_cache, QUOTA);
+
+	struct vy_cache cache;
+	uint32_t fields[] = { 0 };
+	uint32_t types[] = { FIELD_TYPE_UNSIGNED };
+	struct key_def *key_def = box_key_def_new(fields, types, 1);
+	isnt(key_def, NULL, "key_def is not NULL");
+
+	vy_cache_create(&cache, &cache_env, key_def);
+
+	struct tuple_format *format = tuple_format_new(&vy_tuple_format_vtab,
+						       &key_def, 1, 0, NULL, 0);
+	isnt(format, NULL, "tuple_format_new is not NULL");
+	tuple_format_ref(format);
+
+	struct index_opts index_opts = index_opts_default;
+	index_opts.bloom_per_page = true;
+	struct index_def *index_def =
+		index_def_new(512, 0, "primary", sizeof("primary"), TREE,
+			      &index_opts, key_def, NULL);
+
+	struct vy_index *pk = vy_index_new(&index_env, &cache_env, index_def,
+					   format, NULL);
+	isnt(pk, NULL, "index is not NULL")
+
+	struct vy_range *range = vy_range_new(1, NULL, NULL, pk->cmp_def);
+
+	isnt(pk, NULL, "range is not NULL")
+	vy_index_add_range(pk, range);
+
+	struct rlist read_views = RLIST_HEAD_INITIALIZER(read_views);
+
+	char dir_tmpl[] = "./vy_point_test.XXXXXX";
+	char *dir_name = mkdtemp(dir_tmpl);
+	isnt(dir_name, NULL, "temp dir name is not NULL")
+	char path[PATH_MAX];
+	strcpy(path, dir_name);
+	strcat(path, "/0");
+	rc = mkdir(path, 0777);
+	is(rc, 0, "temp dir create (2)");
+	strcat(path, "/0");
+	rc = mkdir(path, 0777);
+	is(rc, 0, "temp dir create (3)");
+
+	/* Write a run of even keys with a bloom filter per page. */
+	const size_t num_of_keys = 200;
+	struct vy_mem *run_mem =
+		vy_mem_new(pk->env->allocator, *pk->env->p_generation,
+			   pk->cmp_def, pk->mem_format,
+			   pk->mem_format_with_colmask,
+			   pk->upsert_format, 0);
+	for (size_t i = 0; i < num_of_keys; i += 2) {
+		struct vy_stmt_template tmpl_val =
+			STMT_TEMPLATE(1, REPLACE, i, i);
+		vy_mem_insert_template(run_mem, &tmpl_val);
+	}
+	struct vy_stmt_stream *write_stream
+		= vy_write_iterator_new(pk->cmp_def, pk->disk_format,
+					pk->upsert_format, pk->id == 0,
+					true, &read_views);
+	vy_write_iterator_new_mem(write_stream, run_mem);
+	struct vy_run *run = vy_run_new(1);
+	isnt(run, NULL, "vy_run_new");
+
+	rc = vy_run_write(run, dir_name, 0, pk->id,
+			  write_stream, 256, pk->cmp_def, pk->key_def,
+			  100500, 0.1, true,
+			  XLOG_COMPRESSION_LEVEL_DEFAULT, 0);
+	is(rc, 0, "vy_run_write");
+	ok(run->info.page_count > 1 && !run->info.has_bloom &&
+	   vy_run_has_page_bloom(run), "run has page filters only");
+
+	write_stream->iface->close(write_stream);
+	vy_mem_delete(run_mem);
+
+	vy_index_add_run(pk, run);
+	struct vy_slice *slice = vy_slice_new(1, run, NULL, NULL, pk->cmp_def);
+	vy_range_add_slice(range, slice);
+	vy_run_unref(run);
+
+	/* Look up every key, odd keys are absent. */
+	bool results_ok = true;
+	bool has_errors = false;
+	struct vy_read_view rv;
+	rv.vlsn = INT64_MAX;
+	const struct vy_read_view *prv = &rv;
+	for (size_t i = 0; i < num_of_keys; i++) {
+		struct vy_stmt_template tmpl_key =
+			STMT_TEMPLATE(0, SELECT, i);
+		struct tuple *key =
+			vy_new_simple_stmt(format, pk->upsert_format,
+					   pk->mem_format_with_colmask,
+					   &tmpl_key);
+		struct vy_point_iterator itr;
+		vy_point_iterator_open(&itr, &run_env, pk,
+				       NULL, &prv, key);
+		struct tuple *res;
+		rc = vy_point_iterator_get(&itr, &res);
+		tuple_unref(key);
+		if (rc != 0) {
+			has_errors = true;
+			continue;
+		}
+		if (i % 2 != 0) {
+			if (res != NULL)
+				results_ok = false;
+			continue;
+		}
+		uint32_t got = 0;
+		if (res == NULL || tuple_field_u32(res, 1, &got) != 0 ||
+		    got != i)
+			results_ok = false;
+	}
+
+	is(results_ok, true, "select results");
+	is(has_errors, false, "no errors happened");
+	ok(pk->stat.disk.iterator.bloom_hit > 0, "page filter hits");
+	ok(run_env.page_cache.bloom_count > 0 &&
+	   run_env.page_cache.mem_used <= run_env.page_cache.mem_quota,
+	   "page filters are kept within the page cache quota");
+
+	vy_index_unref(pk);
+	index_def_delete(index_def);
+	tuple_format_unref(format);
+	vy_cache_destroy(&cache);
+	box_key_def_delete(key_def);
+	vy_cache_env_destroy(&cache_env);
+	vy_run_env_destroy(&run_env);
+	vy_index_env_destroy(&index_env);
+
+	lsregion_destroy(&lsregion);
+
+	strcpy(path, "rm -rf ");
+	strcat(path, dir_name);
+	system(path);
+
+	check_plan();
+	footer();
+}
+
 int
 main()
 {
-	plan(1);
+	plan(2);
 
 	vy_iterator_C_test_init(128 * 1024);
 	crc32_init();
 
 	test_basic();
+	test_page_bloom();
 
 	vy_iterator_C_test_finish();
 
@@ -0,0 +1,102 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "vy_quota.h"
+#include "unit.h"
+
+static void
+test_pace_disabled(void)
+{
+	header();
+
+	struct vy_quota q;
+	vy_quota_init(&q, NULL, NULL, NULL);
+	fail_unless(vy_quota_pace(&q, SIZE_MAX, 1) == 0);
+
+	footer();
+}
+
+static void
+test_pace_burst(void)
+{
+	header();
+
+	struct vy_quota q;
+	vy_quota_init(&q, NULL, NULL, NULL);
+	vy_quota_set_rate_limit(&q, 1000);
+
+	/* A full budget lets one second worth of bytes through. */
+	fail_unless(vy_quota_pace(&q, 600, 1) == 0);
+	fail_unless(vy_quota_pace(&q, 400, 1) == 0);
+	fail_unless(vy_quota_pace(&q, 1, 1) == 0.001);
+
+	/* An idle period doesn't accumulate more than that. */
+	fail_unless(vy_quota_pace(&q, 0, 100) == 0);
+	fail_unless(vy_quota_pace(&q, 1000, 100) == 0);
+	fail_unless(vy_quota_pace(&q, 500, 100) == 0.5);
+
+	footer();
+}
+
+static void
+test_pace_debt(void)
+{
+	header();
+
+	struct vy_quota q;
+	vy_quota_init(&q, NULL, NULL, NULL);
+	vy_quota_set_rate_limit(&q, 1000);
+	fail_unless(vy_quota_pace(&q, 1000, 1) == 0);
+
+	/* Each consumer in debt waits for its own turn. */
+	fail_unless(vy_quota_pace(&q, 250, 1) == 0.25);
+	fail_unless(vy_quota_pace(&q, 250, 1) == 0.5);
+
+	/* The debt is repaid at the rate limit. */
+	fail_unless(vy_quota_pace(&q, 0, 1.25) == 0.25);
+	fail_unless(vy_quota_pace(&q, 0, 1.5) == 0);
+	fail_unless(vy_quota_pace(&q, 125, 1.625) == 0);
+
+	/* Time going backwards doesn't refill the budget. */
+	fail_unless(vy_quota_pace(&q, 125, 1.5) == 0.125);
+
+	footer();
+}
+
+static void
+test_pace_rate_change(void)
+{
+	header();
+
+	struct vy_quota q;
+	vy_quota_init(&q, NULL, NULL, NULL);
+	vy_quota_set_rate_limit(&q, 1000);
+	fail_unless(vy_quota_pace(&q, 1500, 1) == 0.5);
+
+	/* The debt is kept, but repaid at the new rate. */
+	vy_quota_set_rate_limit(&q, 2000);
+	fail_unless(vy_quota_pace(&q, 500, 1) == 0.5);
+	fail_unless(vy_quota_pace(&q, 0, 1.25) == 0.25);
+
+	/* Disabling the limit lets everything through. */
+	vy_quota_set_rate_limit(&q, 0);
+	fail_unless(vy_quota_pace(&q, SIZE_MAX, 1.25) == 0);
+
+	/* Enabling it again starts with a full budget. */
+	vy_quota_set_rate_limit(&q, 500);
+	fail_unless(vy_quota_pace(&q, 500, 1.25) == 0);
+	fail_unless(vy_quota_pace(&q, 250, 1.25) == 0.5);
+
+	footer();
+}
+
+int
+main()
+{
+	test_pace_disabled();
+	test_pace_burst();
+	test_pace_debt();
+	test_pace_rate_change();
+	return 0;
+}
@@ -0,0 +1,72 @@
+test_run = require('test_run').new()
+fiber = require('fiber')
+digest = require('digest')
+errinj = box.error.injection
+
+--
+-- Compaction of a big range is split in parts, each part is
+-- written to a separate run by its own worker.
+--
+s = box.schema.space.create('test', {engine = 'vinyl', id = 9000})
+_ = s:create_index('pk', {range_size = 24 * 1024, page_size = 1024, run_count_per_level = 1, run_size_ratio = 2})
+function fill(first, last, step) for i = first, last, step do s:replace{i, digest.urandom(100)} end box.snapshot() end
+function wait_compact(count) while s.index.pk:info().disk.compact.count < count do fiber.sleep(0.01) end end
+function is_sorted() local prev = 0 for _, t in s:pairs() do if t[1] <= prev then return false end prev = t[1] end return true end
+
+-- If a part fails, the other parts are rolled back.
+errinj.set('ERRINJ_VY_SCHED_TIMEOUT', 0.04)
+errinj.set('ERRINJ_VY_COMPACT_PART', 1)
+fill(1, 300, 2)
+fill(2, 400, 2)
+while test_run:grep_log('default', '9000/0: failed to compact range') == nil do fiber.sleep(0.01) end
+s.index.pk:info().disk.compact.count
+s.index.pk:info().run_count
+s:count()
+
+errinj.set('ERRINJ_VY_COMPACT_PART', -1)
+wait_compact(1)
+test_run:grep_log('default', '9000/0: started compacting range.*parts 2') ~= nil
+s.index.pk:info().range_count
+s.index.pk:info().run_count
+s:count()
+is_sorted()
+
+--
+-- Runs of a split compaction share dump LSN. Their slices
+-- are recovered from the metadata log in the key order.
+--
+test_run:cmd('restart server default')
+fiber = require('fiber')
+digest = require('digest')
+errinj = box.error.injection
+s = box.space.test
+function fill(first, last, step) for i = first, last, step do s:replace{i, digest.urandom(100)} end box.snapshot() end
+function wait_compact(count) while s.index.pk:info().disk.compact.count < count do fiber.sleep(0.01) end end
+function is_sorted() local prev = 0 for _, t in s:pairs() do if t[1] <= prev then return false end prev = t[1] end return true end
+
+s.index.pk:info().range_count
+s.index.pk:info().run_count
+s:count()
+is_sorted()
+
+--
+-- A range consisting of a split compaction output is split
+-- at a part boundary, so that every new range gets whole
+-- part slices. Fail compaction to keep the ranges as they
+-- are right after the split.
+--
+errinj.set('ERRINJ_VY_SCHED_TIMEOUT', 0.04)
+errinj.set('ERRINJ_VY_COMPACT_PART', 0)
+fill(2, 400, 20)
+fill(2, 400, 10)
+while s.index.pk:info().range_count < 2 do fiber.sleep(0.01) end
+test_run:grep_log('default', '9000/0: split range') ~= nil
+-- Two dumped slices and a part slice in each range.
+s.index.pk:info().run_histogram
+
+errinj.set('ERRINJ_VY_COMPACT_PART', -1)
+errinj.set('ERRINJ_VY_SCHED_TIMEOUT', 0)
+wait_compact(1)
+s:count()
+is_sorted()
+s:drop()
@@ -0,0 +1,50 @@
+#!/usr/bin/env tarantool
+
+box.cfg{
+    listen = os.getenv("LISTEN"),
+    wal_compression_level = 9,
+    snap_compression_level = 1,
+    vinyl_compression_level = 19,
+}
+
+local fio = require('fio')
+local xlog = require('xlog')
+
+function fill(s, first, last)
+    for i = first, last do
+        s:replace{i, 'key' .. i, string.rep('value' .. i % 10, 20)}
+    end
+end
+
+function sum(s)
+    local n = 0
+    for _, t in s:pairs() do n = n + t[1] + #t[2] + #t[3] end
+    return n
+end
+
+-- Check if any run of the primary index of a vinyl space
+-- is compressed with a dictionary.
+function has_dict(s)
+    local dir = fio.pathjoin(box.cfg.vinyl_dir, s.id, 0)
+    for _, path in ipairs(fio.glob(fio.pathjoin(dir, '*.index'))) do
+        for _, row in xlog.pairs(path) do
+            if row.BODY.dictionary ~= nil then return true end
+        end
+    end
+    return false
+end
+
+-- Read the runs of the primary index of a vinyl space with
+-- the xlog reader, which has no access to their dictionaries.
+function read_runs(s)
+    local dir = fio.pathjoin(box.cfg.vinyl_dir, s.id, 0)
+    for _, path in ipairs(fio.glob(fio.pathjoin(dir, '*.run'))) do
+        local ok, err = pcall(function()
+            for _ in xlog.pairs(path) do end
+        end)
+        if not ok then return false, tostring(err) end
+    end
+    return true
+end
+
+require('console').listen(os.getenv('ADMIN'))
@@ -0,0 +1,67 @@
+test_run = require('test_run').new()
+
+--
+-- Check that files written at non-default compression levels
+-- and runs compressed with a trained dictionary are read back.
+--
+test_run:cmd("create server test with script='vinyl/compression.lua'")
+test_run:cmd("start server test")
+test_run:cmd('switch test')
+
+box.cfg.wal_compression_level
+box.cfg.snap_compression_level
+box.cfg.vinyl_compression_level
+
+-- Snapshot rows.
+snap = box.schema.space.create('snap')
+_ = snap:create_index('pk')
+fill(snap, 1, 1000)
+
+-- Run rows, with a dictionary.
+run = box.schema.space.create('run', {engine = 'vinyl'})
+pk = run:create_index('pk', {page_size = 8192, run_count_per_level = 1, compression_dict_size = 4096})
+pk.options.compression_dict_size
+fill(run, 1, 1000)
+box.snapshot()
+has_dict(run)
+read_runs(run)
+
+-- WAL rows, in transactions big enough to be compressed.
+wal = box.schema.space.create('wal')
+_ = wal:create_index('pk')
+box.begin() fill(wal, 1, 500) box.commit()
+box.begin() fill(run, 1001, 1500) box.commit()
+
+sum(snap)
+sum(run)
+sum(wal)
+
+test_run:cmd('switch default')
+test_run:cmd('restart server test')
+test_run:cmd('switch test')
+
+snap = box.space.snap
+run = box.space.run
+wal = box.space.wal
+snap:count()
+run:count()
+wal:count()
+sum(snap)
+sum(run)
+sum(wal)
+run:get{777}[2]
+run:get{1234}[2]
+
+-- Compaction reads and rewrites runs with a dictionary.
+box.snapshot()
+while run.index.pk:info().run_count > 1 do require('fiber').sleep(0.01) end
+has_dict(run)
+sum(run)
+
+snap:drop()
+run:drop()
+wal:drop()
+
+test_run:cmd('switch default')
+test_run:cmd("stop server test")
+test_run:cmd("cleanup server test")
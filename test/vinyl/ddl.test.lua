@@ -121,6 +121,23 @@ sec.options.bloom_fpr
 third.options.bloom_fpr
 space:drop()
 
+-- Per-page bloom filters.
+space = box.schema.space.create('test', {engine='vinyl'})
+pk = space:create_index('pk', {bloom_per_page = true, page_size = 128})
+pk.options.bloom_per_page
+for i = 1, 100, 2 do space:replace{i} end
+box.snapshot()
+-- Absent keys are filtered out by the page filters.
+hit = pk:info().disk.iterator.bloom.hit
+for i = 2, 100, 2 do assert(space:get{i} == nil) end
+pk:info().disk.iterator.bloom.hit > hit
+space:get{50}
+space:get{51}
+#space:select()
+pk:alter({bloom_per_page = false})
+pk.options.bloom_per_page
+space:drop()
+
 --
 -- gh-2109: allow alter some opts of not empty indexes
 --
@@ -263,3 +280,47 @@ index = space:create_index('test', { type = 'tree', parts = { 2, 'any' }})
 index = space:create_index('test', { type = 'tree', parts = { 2, 'array' }})
 index = space:create_index('test', { type = 'tree', parts = { 2, 'map' }})
 space:drop()
+
+--
+-- Page filters are found again after restart, and after the
+-- .index file is rebuilt from the .run file.
+--
+space = box.schema.space.create('test', {engine='vinyl'})
+pk = space:create_index('pk', {bloom_per_page = true, page_size = 128})
+for i = 1, 100, 2 do space:replace{i} end
+box.snapshot()
+test_run:cmd('restart server default')
+space = box.space.test
+pk = space.index.pk
+pk.options.bloom_per_page
+for i = 2, 100, 2 do assert(space:get{i} == nil) end
+pk:info().disk.iterator.bloom.hit > 0
+space:get{51}
+space:drop()
+
+test_run = require('test_run').new()
+test_run:cmd('create server force_recovery with script="vinyl/force_recovery.lua"')
+test_run:cmd('start server force_recovery')
+test_run:cmd('switch force_recovery')
+fio = require('fio')
+space = box.schema.space.create('test', {engine='vinyl'})
+pk = space:create_index('pk', {bloom_per_page = true, page_size = 128})
+for i = 1, 100, 2 do space:replace{i} end
+box.snapshot()
+for _, f in pairs(fio.glob(box.cfg.vinyl_dir .. '/' .. space.id .. '/0/*.index')) do fio.unlink(f) end
+test_run = require('test_run').new()
+test_run:cmd('switch default')
+test_run:cmd('stop server force_recovery')
+test_run:cmd('start server force_recovery')
+test_run:cmd('switch force_recovery')
+fio = require('fio')
+space = box.space.test
+pk = space.index.pk
+#fio.glob(box.cfg.vinyl_dir .. '/' .. space.id .. '/0/*.index')
+for i = 2, 100, 2 do assert(space:get{i} == nil) end
+pk:info().disk.iterator.bloom.hit > 0
+space:get{51}
+#space:select()
+test_run:cmd('switch default')
+test_run:cmd('stop server force_recovery')
+test_run:cmd('cleanup server force_recovery')
@@ -0,0 +1,55 @@
+test_run = require('test_run').new()
+
+--
+-- Check that a page loaded from disk is kept in the page cache
+-- and the next read of the same page doesn't go to disk.
+--
+function page_cache() return box.info.vinyl().performance.page_cache end
+
+s = box.schema.space.create('test', {engine = 'vinyl'})
+_ = s:create_index('pk')
+for i = 1, 100 do s:replace{i, string.rep('x', 100)} end
+box.snapshot()
+
+page_cache().limit == box.cfg.vinyl_page_cache
+old = page_cache()
+read = s.index.pk:info().disk.iterator.read.pages
+
+-- Cold read: the page is loaded from disk and cached.
+s:get{1}[1]
+new = page_cache()
+new.count - old.count
+new.used > old.used
+new.miss - old.miss
+new.hit - old.hit
+s.index.pk:info().disk.iterator.read.pages - read
+
+-- Read the same page again (a different key, so that the tuple
+-- cache doesn't serve it): it's found in the page cache.
+old = new
+s:get{2}[1]
+new = page_cache()
+new.count - old.count
+new.used == old.used
+new.miss - old.miss
+new.hit - old.hit
+s.index.pk:info().disk.iterator.read.pages - read
+
+s:drop()
+
+-- Page bloom filters loaded on demand are accounted in the
+-- page cache.
+s = box.schema.space.create('test', {engine = 'vinyl'})
+_ = s:create_index('pk', {bloom_per_page = true, page_size = 128})
+for i = 1, 100, 2 do s:replace{i} end
+box.snapshot()
+old = page_cache()
+s:get{2}
+new = page_cache()
+new.blooms - old.blooms
+new.used > old.used
+new.count - old.count
+-- The second lookup uses the cached filter.
+s:get{4}
+page_cache().blooms - new.blooms
+s:drop()
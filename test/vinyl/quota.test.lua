@@ -49,3 +49,10 @@ _ = space:replace{1, 1, string.rep('a', 1024 * 1024 * 5)}
 box.info.vinyl().memory.used
 
 space:drop()
+
+--
+-- Writes are not throttled while memory usage is below
+-- the watermark.
+--
+box.info.vinyl().throttle.rate
+box.info.vinyl().throttle.count
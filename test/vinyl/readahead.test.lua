@@ -0,0 +1,41 @@
+test_run = require('test_run').new()
+
+--
+-- Check that a run iterator advises read ahead when it scans
+-- a run, in both directions, but not on point lookups.
+--
+function readahead(s) return s.index.pk:info().disk.iterator.readahead end
+function pages(s) return s.index.pk:info().disk.pages end
+
+function fill(s) for i = 1, 400 do s:replace{i, string.rep('x', 100)} end box.snapshot() end
+
+fwd = box.schema.space.create('fwd', {engine = 'vinyl'})
+_ = fwd:create_index('pk')
+fill(fwd)
+bwd = box.schema.space.create('bwd', {engine = 'vinyl'})
+_ = bwd:create_index('pk')
+fill(bwd)
+pts = box.schema.space.create('pts', {engine = 'vinyl'})
+_ = pts:create_index('pk')
+fill(pts)
+
+pages(fwd) > 16
+readahead(fwd)
+
+-- Point lookups never read ahead.
+for i = 1, 400, 50 do pts:get{i} end
+readahead(pts)
+
+-- Forward scan reads ahead up to the last page.
+#fwd:select({}, {iterator = 'GE'})
+readahead(fwd) > 0
+readahead(fwd) <= pages(fwd)
+
+-- Backward scan reads ahead down to the first page.
+#bwd:select({}, {iterator = 'LE'})
+readahead(bwd) > 0
+readahead(bwd) <= pages(bwd)
+
+fwd:drop()
+bwd:drop()
+pts:drop()
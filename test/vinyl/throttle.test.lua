@@ -0,0 +1,44 @@
+test_run = require('test_run').new()
+
+test_run:cmd("create server test with script='vinyl/throttle.lua'")
+test_run:cmd("start server test")
+test_run:cmd('switch test')
+
+fiber = require('fiber')
+
+--
+-- Check that transactions are paced once memory usage exceeds
+-- the watermark and that pacing never takes longer than
+-- vinyl_timeout allows.
+--
+box.cfg{vinyl_timeout = 0.05}
+box.error.injection.set('ERRINJ_VY_RUN_WRITE', true)
+
+s = box.schema.space.create('test', {engine = 'vinyl'})
+_ = s:create_index('pk')
+
+pad = string.rep('x', 256 * 1024)
+for i = 1, 224 do s:replace{i, pad} end
+
+-- Wait for the quota timer to lower the watermark.
+while box.info.vinyl().throttle.rate == 0 do fiber.sleep(0.01) end
+box.info.vinyl().memory.used > box.info.vinyl().memory.watermark
+
+count = box.info.vinyl().throttle.count
+time = box.info.vinyl().throttle.time
+start = fiber.time()
+for i = 225, 240 do s:replace{i, pad} end
+elapsed = fiber.time() - start
+
+box.info.vinyl().throttle.count > count
+box.info.vinyl().throttle.time - time <= 16 * box.cfg.vinyl_timeout + 1e-6
+elapsed < 16 * box.cfg.vinyl_timeout + 1
+box.info.vinyl().memory.used < box.info.vinyl().memory.limit
+s:count()
+
+s:drop()
+box.error.injection.set('ERRINJ_VY_RUN_WRITE', false)
+
+test_run:cmd('switch default')
+test_run:cmd("stop server test")
+test_run:cmd("cleanup server test")